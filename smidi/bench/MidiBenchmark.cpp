@@ -0,0 +1,400 @@
+/*!
+ * \file MidiBenchmark.cpp
+ * Contains implementation of MidiBenchmark harness and global allocation counting.
+ */
+
+#include "MidiBenchmark.h"
+#include <smidi/MidiTimestamp.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+	std::atomic<unsigned long long> allocations(0);
+
+	struct Entry
+	{
+		std::string             name;
+		MidiBenchmark::Function function;
+	};
+
+	std::vector<Entry>& registry()
+	{
+		static std::vector<Entry> entries;
+		return entries;
+	}
+
+	/*!
+	 * Counts system calls of the calling thread with `raw_syscalls:sys_enter` tracepoint.
+	 * Usually requires `kernel.perf_event_paranoid` <= 1 or CAP_PERFMON.
+	 */
+	class SyscallCounter
+	{
+	public:
+		SyscallCounter()
+			: _fd(-1)
+			, _overhead(0)
+		{
+			const char* idFiles[] = {"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+			                         "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"};
+			for (const char* idFile : idFiles)
+			{
+				std::ifstream file(idFile);
+				unsigned long long id = 0;
+				if (file >> id)
+				{
+					perf_event_attr attributes = {};
+					attributes.type = PERF_TYPE_TRACEPOINT;
+					attributes.size = sizeof(attributes);
+					attributes.config = id;
+					attributes.disabled = 1;
+					attributes.exclude_hv = 1;
+					_fd = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+					if (_fd >= 0)
+					{
+						// the disabling ioctl is counted too
+						start();
+						_overhead = stop();
+						break;
+					}
+				}
+			}
+		}
+
+		~SyscallCounter()
+		{
+			if (_fd >= 0)
+			{
+				close(_fd);
+			}
+		}
+
+		bool isAvailable() const
+		{
+			return _fd >= 0;
+		}
+
+		void start()
+		{
+			if (_fd >= 0)
+			{
+				ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+
+		long long stop()
+		{
+			long long result = -1;
+			if (_fd >= 0)
+			{
+				ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+				unsigned long long count = 0;
+				if (read(_fd, &count, sizeof(count)) == sizeof(count))
+				{
+					result = static_cast<long long>(count) - _overhead;
+					result = result < 0 ? 0 : result;
+				}
+			}
+			return result;
+		}
+
+	private:
+		int       _fd;
+		long long _overhead;
+	};
+
+	SyscallCounter& syscallCounter()
+	{
+		static SyscallCounter counter;
+		return counter;
+	}
+
+	std::string jsonEscape(const std::string& text)
+	{
+		std::string result;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+			{
+				result += '\\';
+			}
+			result += c;
+		}
+		return result;
+	}
+
+	void writeJson(std::ostream& stream, const std::vector<MidiBenchmark::Result>& results)
+	{
+		stream << "{\n  \"benchmarks\": [\n";
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			const MidiBenchmark::Result& result = results[i];
+			stream << "    {\"name\": \"" << jsonEscape(result.name) << "\"";
+			if (result.skipReason.empty())
+			{
+				stream << ", \"iterations\": " << result.iterations
+				       << ", \"ns_per_op\": " << result.nanosecondsPerOperation
+				       << ", \"allocs_per_op\": " << result.allocationsPerOperation
+				       << ", \"syscalls_per_op\": ";
+				if (result.syscallsPerOperation < 0.0)
+				{
+					stream << "null";
+				}
+				else
+				{
+					stream << result.syscallsPerOperation;
+				}
+				if (result.gigabytesPerSecond > 0.0)
+				{
+					stream << ", \"gb_per_s\": " << result.gigabytesPerSecond;
+				}
+			}
+			else
+			{
+				stream << ", \"skipped\": \"" << jsonEscape(result.skipReason) << "\"";
+			}
+			stream << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		stream << "  ]\n}\n";
+	}
+
+	void writeTable(std::ostream& stream, const std::vector<MidiBenchmark::Result>& results)
+	{
+		char line[256];
+		std::snprintf(line, sizeof(line), "%-48s %14s %12s %12s %12s %10s\n", "Benchmark", "Iterations", "ns/op", "allocs/op", "syscalls/op", "GB/s");
+		stream << line;
+		for (const MidiBenchmark::Result& result : results)
+		{
+			if (!result.skipReason.empty())
+			{
+				std::snprintf(line, sizeof(line), "%-48s skipped: %s\n", result.name.c_str(), result.skipReason.c_str());
+			}
+			else
+			{
+				char syscalls[32] = "n/a";
+				if (result.syscallsPerOperation >= 0.0)
+				{
+					std::snprintf(syscalls, sizeof(syscalls), "%.3f", result.syscallsPerOperation);
+				}
+				char throughput[32] = "";
+				if (result.gigabytesPerSecond > 0.0)
+				{
+					std::snprintf(throughput, sizeof(throughput), "%.2f", result.gigabytesPerSecond);
+				}
+				std::snprintf(line, sizeof(line), "%-48s %14llu %12.1f %12.3f %12s %10s\n", result.name.c_str(), result.iterations,
+				              result.nanosecondsPerOperation, result.allocationsPerOperation, syscalls, throughput);
+			}
+			stream << line;
+		}
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	void* pointer = std::malloc(size ? size : 1);
+	if (!pointer)
+	{
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+MidiBenchmark::State::State(unsigned long long iterations)
+	: _iterations(iterations)
+	, _remaining(iterations)
+	, _startTime(0)
+	, _elapsed(0)
+	, _startAllocations(0)
+	, _allocations(0)
+	, _startSyscalls(0)
+	, _syscalls(-1)
+	, _bytesPerOperation(0)
+	, _stopped(false)
+{
+}
+
+void MidiBenchmark::State::skip(const std::string& reason)
+{
+	_skipReason = reason;
+	_remaining = 0;
+	_stopped = true;
+}
+
+void MidiBenchmark::State::setBytesPerOperation(unsigned long long bytes)
+{
+	_bytesPerOperation = bytes;
+}
+
+unsigned long long MidiBenchmark::State::iterations() const
+{
+	return _iterations;
+}
+
+void MidiBenchmark::State::start()
+{
+	_startAllocations = allocationCount();
+	syscallCounter().start();
+	_startTime = MidiTimestamp::now();
+}
+
+void MidiBenchmark::State::stop()
+{
+	if (!_stopped)
+	{
+		_elapsed = MidiTimestamp::now() - _startTime;
+		_syscalls = syscallCounter().stop();
+		_allocations = allocationCount() - _startAllocations;
+		_stopped = true;
+	}
+}
+
+bool MidiBenchmark::add(const std::string& name, MidiBenchmark::Function function)
+{
+	registry().push_back(Entry{name, std::move(function)});
+	return true;
+}
+
+unsigned long long MidiBenchmark::allocationCount()
+{
+	return allocations.load(std::memory_order_relaxed);
+}
+
+int MidiBenchmark::run(int argc, char* argv[])
+{
+	std::string filter;
+	unsigned long long minimalTime = 200000000ULL;
+	bool json = false;
+	std::string jsonFile;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument(argv[i]);
+		if (argument.compare(0, 9, "--filter=") == 0)
+		{
+			filter = argument.substr(9);
+		}
+		else if (argument.compare(0, 11, "--min-time=") == 0)
+		{
+			minimalTime = std::strtoull(argument.c_str() + 11, nullptr, 10) * 1000000ULL;
+		}
+		else if (argument == "--json")
+		{
+			json = true;
+		}
+		else if (argument.compare(0, 7, "--json=") == 0)
+		{
+			json = true;
+			jsonFile = argument.substr(7);
+		}
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--filter=<substring>] [--min-time=<ms>] [--json[=<file>]]\n";
+			return 1;
+		}
+	}
+
+	std::vector<Result> results;
+	for (const Entry& entry : registry())
+	{
+		if (!filter.empty() && entry.name.find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		Result result = {entry.name, 0, 0.0, 0.0, -1.0, 0.0, std::string()};
+		unsigned long long iterations = 1;
+		for (;;)
+		{
+			State state(iterations);
+			entry.function(state);
+			state.stop();
+			if (!state._skipReason.empty())
+			{
+				result.skipReason = state._skipReason;
+				break;
+			}
+			if (state._elapsed >= minimalTime || iterations >= (1ULL << 40))
+			{
+				result.iterations = iterations;
+				result.nanosecondsPerOperation = static_cast<double>(state._elapsed) / iterations;
+				result.allocationsPerOperation = static_cast<double>(state._allocations) / iterations;
+				result.syscallsPerOperation = state._syscalls < 0 ? -1.0 : static_cast<double>(state._syscalls) / iterations;
+				if (state._bytesPerOperation > 0 && state._elapsed > 0)
+				{
+					// bytes per nanosecond is GB/s
+					result.gigabytesPerSecond = static_cast<double>(state._bytesPerOperation) * iterations / state._elapsed;
+				}
+				break;
+			}
+			// aim 20% above the minimal time, but grow at most 10x per batch
+			const double perIteration = static_cast<double>(state._elapsed > 0 ? state._elapsed : 1) / iterations;
+			unsigned long long next = static_cast<unsigned long long>(minimalTime * 1.2 / perIteration);
+			next = next > iterations * 10 ? iterations * 10 : next;
+			iterations = next > iterations ? next : iterations + 1;
+		}
+		results.push_back(result);
+		if (!json)
+		{
+			std::cerr << "." << std::flush;
+		}
+	}
+
+	if (json)
+	{
+		if (jsonFile.empty())
+		{
+			writeJson(std::cout, results);
+		}
+		else
+		{
+			std::ofstream file(jsonFile);
+			writeJson(file, results);
+		}
+	}
+	else
+	{
+		std::cerr << "\n";
+		if (!syscallCounter().isAvailable())
+		{
+			std::cerr << "System call counting is unavailable (perf tracepoints are not permitted)\n";
+		}
+		writeTable(std::cout, results);
+	}
+	return 0;
+}
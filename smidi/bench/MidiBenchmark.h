@@ -0,0 +1,138 @@
+#pragma once
+
+/*!
+ * \file MidiBenchmark.h
+ * Contains minimal micro-benchmark harness used by smidi_bench.
+ */
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief The MidiBenchmark class is a registry and runner of micro-benchmarks.
+ *
+ * Every benchmark is measured in batches, the batch size grows until the batch runs for at least the minimal time.
+ * For the last batch the harness reports:
+ * - nanoseconds per operation (steady clock),
+ * - heap allocations per operation (global operator new is counted by the harness),
+ * - system calls per operation made by the benchmark thread (`raw_syscalls:sys_enter` perf tracepoint,
+ *   reported as unavailable when perf events are not permitted),
+ * - throughput in GB/s for benchmarks that set the number of bytes processed per operation.
+ *
+ * ~~~cpp
+ * SMIDI_BENCHMARK(MidiMessage_Copy)
+ * {
+ *     const MidiMessage message({0x90, 0x3C, 0x64});
+ *     while (state.next())
+ *     {
+ *         MidiMessage copy(message);
+ *         MidiBenchmark::doNotOptimize(copy);
+ *     }
+ * }
+ * ~~~
+ */
+class MidiBenchmark
+{
+public:
+	/*!
+	 * \brief The State class controls iterations of a single batch.
+	 *
+	 * Code before the first next() call is the setup and is not measured.
+	 */
+	class State
+	{
+	public:
+		explicit State(unsigned long long iterations);
+
+		//! Returns `true` while there are iterations left. Starts measurement on the first call.
+		bool next()
+		{
+			if (_remaining == _iterations)
+			{
+				start();
+			}
+			if (_remaining == 0)
+			{
+				stop();
+				return false;
+			}
+			--_remaining;
+			return true;
+		}
+
+		//! Marks benchmark as skipped (e.g. no ALSA sequencer), must be called before the first next()
+		void skip(const std::string& reason);
+
+		//! Sets the number of bytes one operation processes, enables throughput reporting
+		void setBytesPerOperation(unsigned long long bytes);
+
+		unsigned long long iterations() const;
+
+	private:
+		friend class MidiBenchmark;
+
+		void start();
+		void stop();
+
+	private:
+		unsigned long long _iterations;
+		unsigned long long _remaining;
+		unsigned long long _startTime;
+		unsigned long long _elapsed;
+		unsigned long long _startAllocations;
+		unsigned long long _allocations;
+		unsigned long long _startSyscalls;
+		long long          _syscalls;
+		unsigned long long _bytesPerOperation;
+		bool               _stopped;
+		std::string        _skipReason;
+	};
+
+	using Function = std::function<void(State&)>;
+
+	//! Result of a single benchmark
+	struct Result
+	{
+		std::string        name;
+		unsigned long long iterations;
+		double             nanosecondsPerOperation;
+		double             allocationsPerOperation;
+		double             syscallsPerOperation;     //!< negative if syscall counting is unavailable
+		double             gigabytesPerSecond;       //!< zero if the benchmark doesn't report processed bytes
+		std::string        skipReason;               //!< not empty if the benchmark was skipped
+	};
+
+public:
+	//! Registers benchmark, used by SMIDI_BENCHMARK
+	static bool add(const std::string& name, Function function);
+
+	/*!
+	 * \brief Runs registered benchmarks
+	 *
+	 * Command line options:
+	 * - `--filter=<substring>` runs only benchmarks which names contain the substring,
+	 * - `--min-time=<milliseconds>` minimal duration of the measured batch (default 200),
+	 * - `--json[=<file>]` writes results as JSON to stdout or to the file instead of the table.
+	 */
+	static int run(int argc, char* argv[]);
+
+	//! Prevents compiler from optimizing the value away
+	template <typename T>
+	static void doNotOptimize(const T& value)
+	{
+		asm volatile("" : : "g"(&value) : "memory");
+	}
+
+	//! Returns number of heap allocations made by the process so far
+	static unsigned long long allocationCount();
+};
+
+#define SMIDI_BENCHMARK_CONCAT_IMPL(a, b) a##b
+#define SMIDI_BENCHMARK_CONCAT(a, b) SMIDI_BENCHMARK_CONCAT_IMPL(a, b)
+
+//! Defines and registers benchmark, `state` (MidiBenchmark::State&) is available inside the body
+#define SMIDI_BENCHMARK(name) \
+	static void SMIDI_BENCHMARK_CONCAT(benchmark_, name)(MidiBenchmark::State& state); \
+	static const bool SMIDI_BENCHMARK_CONCAT(registered_, name) = MidiBenchmark::add(#name, &SMIDI_BENCHMARK_CONCAT(benchmark_, name)); \
+	static void SMIDI_BENCHMARK_CONCAT(benchmark_, name)(MidiBenchmark::State& state)
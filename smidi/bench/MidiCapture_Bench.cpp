@@ -0,0 +1,83 @@
+#include "MidiBenchmark.h"
+#include <smidi/MidiCapture.h>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+	std::string temporaryPath()
+	{
+		char path[] = "/tmp/smidi_bench_XXXXXX";
+		const int descriptor = mkstemp(path);
+		if (descriptor >= 0)
+		{
+			close(descriptor);
+		}
+		return path;
+	}
+}
+
+SMIDI_BENCHMARK(MidiCapture_CaptureNoteOn)
+{
+	MidiCapture::Options options;
+	options.capacity = 64 * 1024;
+	options.drainInterval = std::chrono::milliseconds(1);
+	MidiCapture capture(options);
+	const std::size_t port = capture.addPort("smidi bench capture");
+	const std::string path = temporaryPath();
+	if (!capture.open(path))
+	{
+		state.skip("can't create capture file");
+		std::remove(path.c_str());
+		return;
+	}
+	const MidiMessage message({MidiMessage::NoteOn, 60, 100}, 1);
+
+	// the cost seen by the thread that captures, the writer thread drains the ring meanwhile
+	while (state.next())
+	{
+		capture.capture(port, message);
+	}
+	capture.close();
+	std::remove(path.c_str());
+}
+
+SMIDI_BENCHMARK(MidiCaptureReader_Decode1k)
+{
+	const std::size_t kRecords = 1000;
+	const std::string path = temporaryPath();
+	{
+		MidiCapture::Options options;
+		options.capacity = kRecords;
+		MidiCapture capture(options);
+		const std::size_t port = capture.addPort("smidi bench capture");
+		capture.open(path);
+		for (std::size_t i = 0; i < kRecords; ++i)
+		{
+			capture.capture(port, MidiMessage({MidiMessage::NoteOn, static_cast<unsigned char>(i % 128), 100}, 1000000000ULL + i * 250000));
+		}
+		capture.close();
+	}
+
+	MidiCaptureReader reader;
+	if (!reader.open(path))
+	{
+		state.skip("can't read capture file");
+		std::remove(path.c_str());
+		return;
+	}
+	MidiCaptureRecord record;
+	unsigned long long bytes = 0;
+	while (state.next())
+	{
+		reader.rewind();
+		while (reader.next(record))
+		{
+			bytes += record.size;
+		}
+	}
+	MidiBenchmark::doNotOptimize(bytes);
+	reader.close();
+	std::remove(path.c_str());
+}
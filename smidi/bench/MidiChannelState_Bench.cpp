@@ -0,0 +1,44 @@
+#include "MidiBenchmark.h"
+#include <smidi/MidiChannelState.h>
+#include <vector>
+
+SMIDI_BENCHMARK(MidiChannelState_ProcessControlChange)
+{
+	MidiChannelState channelState;
+	const MidiMessage message({MidiMessage::ControlChange | 3, 7, 100});
+
+	while (state.next())
+	{
+		channelState.process(message);
+	}
+}
+
+SMIDI_BENCHMARK(MidiChannelState_Snapshot)
+{
+	MidiChannelState channelState;
+	for (unsigned int i = 0; i < 128; ++i)
+	{
+		channelState.process({static_cast<unsigned char>(MidiMessage::ControlChange | (i % 16)), static_cast<unsigned char>(i), 64});
+	}
+
+	while (state.next())
+	{
+		const MidiChannelState::Snapshot snapshot = channelState.snapshot();
+		MidiBenchmark::doNotOptimize(snapshot);
+	}
+}
+
+SMIDI_BENCHMARK(MidiChannelState_RestoreMessages)
+{
+	MidiChannelState channelState;
+	for (unsigned int i = 0; i < 128; ++i)
+	{
+		channelState.process({static_cast<unsigned char>(MidiMessage::ControlChange | (i % 16)), static_cast<unsigned char>(i), 64});
+	}
+
+	while (state.next())
+	{
+		const std::vector<MidiMessage> messages = channelState.restoreMessages();
+		MidiBenchmark::doNotOptimize(messages);
+	}
+}
@@ -0,0 +1,120 @@
+#include "MidiBenchmark.h"
+#include "../src/linux/alsa/MidiEventEncoder.h"
+#include <smidi/MidiMessage.h>
+
+namespace
+{
+	const int kEncoderBufferSize = 256;
+
+	MidiMessage sysExMessage()
+	{
+		std::vector<unsigned char> bytes(32, 0x42);
+		bytes.front() = MidiMessage::SysEx;
+		bytes.back() = MidiMessage::SysExEnd;
+		return MidiMessage(bytes);
+	}
+
+	void encode(MidiBenchmark::State& state, const MidiMessage& message)
+	{
+		MidiEventEncoder encoder(kEncoderBufferSize);
+		encoder.setRunningStatusEnabled(false);
+		snd_seq_event_t event;
+		while (state.next())
+		{
+			encoder.encode(&event, message);
+			MidiBenchmark::doNotOptimize(event);
+		}
+	}
+
+	void decode(MidiBenchmark::State& state, const MidiMessage& message)
+	{
+		MidiEventEncoder encoder(kEncoderBufferSize);
+		encoder.setRunningStatusEnabled(false);
+		snd_seq_event_t event;
+		if (!encoder.encode(&event, message))
+		{
+			state.skip("message couldn't be encoded");
+			return;
+		}
+		MidiEventEncoder decoder(kEncoderBufferSize);
+		decoder.setRunningStatusEnabled(false);
+		MidiMessage decoded;
+		decoded.resizeBuffer(message.size());
+		while (state.next())
+		{
+			decoded.resizeBuffer(message.size());
+			decoder.decode(&event, decoded);
+			MidiBenchmark::doNotOptimize(decoded);
+		}
+	}
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_EncodeNoteOn)
+{
+	encode(state, MidiMessage({0x90, 0x3C, 0x64}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_EncodeControlChange)
+{
+	encode(state, MidiMessage({0xB0, 0x07, 0x7F}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_EncodeProgramChange)
+{
+	encode(state, MidiMessage({0xC0, 0x05}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_EncodePitchWheel)
+{
+	encode(state, MidiMessage({0xE0, 0x00, 0x40}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_EncodeSongPosition)
+{
+	encode(state, MidiMessage({MidiMessage::SongPosition, 0x10, 0x00}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_EncodeMidiClock)
+{
+	encode(state, MidiMessage({MidiMessage::MidiClock}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_EncodeSysEx32)
+{
+	encode(state, sysExMessage());
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_DecodeNoteOn)
+{
+	decode(state, MidiMessage({0x90, 0x3C, 0x64}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_DecodeControlChange)
+{
+	decode(state, MidiMessage({0xB0, 0x07, 0x7F}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_DecodeProgramChange)
+{
+	decode(state, MidiMessage({0xC0, 0x05}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_DecodePitchWheel)
+{
+	decode(state, MidiMessage({0xE0, 0x00, 0x40}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_DecodeSongPosition)
+{
+	decode(state, MidiMessage({MidiMessage::SongPosition, 0x10, 0x00}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_DecodeMidiClock)
+{
+	decode(state, MidiMessage({MidiMessage::MidiClock}));
+}
+
+SMIDI_BENCHMARK(MidiEventEncoder_DecodeSysEx32)
+{
+	decode(state, sysExMessage());
+}
@@ -0,0 +1,137 @@
+#include "MidiBenchmark.h"
+#include <smidi/MidiFile.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace
+{
+	const std::size_t kTracks = 16;
+	const std::size_t kTrackSize = 50 * 1024 * 1024 / kTracks;
+
+	void appendUint32(std::vector<unsigned char>& bytes, std::size_t value)
+	{
+		for (int shift = 24; shift >= 0; shift -= 8)
+		{
+			bytes.push_back(static_cast<unsigned char>(value >> shift));
+		}
+	}
+
+	// format 1: conductor track with a tempo change every 4 beats and 16 tracks of dense notes with running status
+	std::vector<unsigned char> largeFile()
+	{
+		std::vector<unsigned char> file = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, kTracks + 1, 0x01, 0xE0};
+
+		std::vector<unsigned char> conductor;
+		for (unsigned int tempo = 0; conductor.size() < 64 * 1024; ++tempo)
+		{
+			const unsigned int microseconds = 400000 + (tempo % 50) * 4000;
+			conductor.insert(conductor.end(), {0x8F, 0x00, 0xFF, 0x51, 0x03});
+			conductor.insert(conductor.end(), {static_cast<unsigned char>(microseconds >> 16), static_cast<unsigned char>(microseconds >> 8), static_cast<unsigned char>(microseconds)});
+		}
+		conductor.insert(conductor.end(), {0x00, 0xFF, 0x2F, 0x00});
+		file.insert(file.end(), {'M', 'T', 'r', 'k'});
+		appendUint32(file, conductor.size());
+		file.insert(file.end(), conductor.begin(), conductor.end());
+
+		for (std::size_t track = 0; track < kTracks; ++track)
+		{
+			std::vector<unsigned char> events = {0x00, static_cast<unsigned char>(0x90 | track), 0x3C, 0x64};
+			for (unsigned int i = 0; events.size() < kTrackSize; ++i)
+			{
+				// note on and off (velocity 0) in turns, 1 to 16 ticks apart
+				events.insert(events.end(), {static_cast<unsigned char>(1 + ((i + track) & 0x0F)), static_cast<unsigned char>(0x30 + (i & 0x1F)), static_cast<unsigned char>((i & 1) ? 0 : 100)});
+			}
+			events.insert(events.end(), {0x00, 0xFF, 0x2F, 0x00});
+			file.insert(file.end(), {'M', 'T', 'r', 'k'});
+			appendUint32(file, events.size());
+			file.insert(file.end(), events.begin(), events.end());
+		}
+		return file;
+	}
+
+	//! The file is written once and removed when the benchmark process exits
+	struct LargeFile
+	{
+		LargeFile()
+			: size(0)
+		{
+			char pathTemplate[] = "/tmp/smidi_bench_XXXXXX";
+			const int descriptor = mkstemp(pathTemplate);
+			if (descriptor >= 0)
+			{
+				const std::vector<unsigned char> data = largeFile();
+				if (write(descriptor, data.data(), data.size()) == static_cast<ssize_t>(data.size()))
+				{
+					path = pathTemplate;
+					size = data.size();
+				}
+				close(descriptor);
+			}
+		}
+
+		~LargeFile()
+		{
+			if (!path.empty())
+			{
+				std::remove(path.c_str());
+			}
+		}
+
+		std::string path;
+		std::size_t size;
+	};
+
+	const LargeFile& largeFilePath()
+	{
+		static const LargeFile file;
+		return file;
+	}
+}
+
+SMIDI_BENCHMARK(MidiFile_Open50MB)
+{
+	const LargeFile& largeFile = largeFilePath();
+	if (largeFile.path.empty())
+	{
+		state.skip("couldn't write the file to /tmp");
+		return;
+	}
+	MidiFile file;
+
+	// one operation is mapping, indexing of 17 tracks and reading of the tempo map
+	while (state.next())
+	{
+		file.open(largeFile.path);
+		MidiBenchmark::doNotOptimize(file);
+		file.close();
+	}
+}
+
+SMIDI_BENCHMARK(MidiFile_MergeTracks50MB)
+{
+	const LargeFile& largeFile = largeFilePath();
+	if (largeFile.path.empty())
+	{
+		state.skip("couldn't write the file to /tmp");
+		return;
+	}
+	MidiFile file;
+	file.open(largeFile.path);
+	state.setBytesPerOperation(largeFile.size);
+	MidiMessage message;
+	unsigned long long events = 0;
+
+	// one operation is every event of all tracks in tick order with absolute time, copied into a message
+	while (state.next())
+	{
+		for (const MidiFileEvent& event : file.events())
+		{
+			event.copyTo(message);
+			++events;
+		}
+		MidiBenchmark::doNotOptimize(message);
+	}
+	MidiBenchmark::doNotOptimize(events);
+}
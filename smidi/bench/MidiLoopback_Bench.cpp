@@ -0,0 +1,51 @@
+#include "MidiBenchmark.h"
+#include <smidi/MidiLoopback.h>
+#include <smidi/MidiInPort.h>
+#include <smidi/MidiOutPort.h>
+#include <vector>
+
+namespace
+{
+	void countMessage(void* context, const MidiMessage&)
+	{
+		++*static_cast<unsigned long long*>(context);
+	}
+}
+
+SMIDI_BENCHMARK(MidiLoopback_SendReceive)
+{
+	MidiLoopback loopback("smidi bench loopback", std::make_shared<MidiSimulatedClock>());
+	std::shared_ptr<MidiInPort> input = loopback.inputPort();
+	std::shared_ptr<MidiOutPort> output = loopback.outputPort();
+	unsigned long long messages = 0;
+	input->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+	input->setMessageHandler(MidiInPort::MessageHandler(&countMessage, &messages));
+	const MidiMessage message({MidiMessage::NoteOn, 60, 100});
+
+	// one operation is one message through the ring and the dispatcher, eventfd signalling included
+	while (state.next())
+	{
+		output->sendMessage(message);
+		input->processPending();
+	}
+	MidiBenchmark::doNotOptimize(messages);
+}
+
+SMIDI_BENCHMARK(MidiLoopback_SendReceiveBatch64)
+{
+	MidiLoopback loopback("smidi bench loopback", std::make_shared<MidiSimulatedClock>());
+	std::shared_ptr<MidiInPort> input = loopback.inputPort();
+	std::shared_ptr<MidiOutPort> output = loopback.outputPort();
+	unsigned long long messages = 0;
+	input->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+	input->setMessageHandler(MidiInPort::MessageHandler(&countMessage, &messages));
+	const std::vector<MidiMessage> batch(64, MidiMessage({MidiMessage::ControlChange, 7, 100}));
+
+	// one operation is 64 messages sent at once and drained with a single processPending()
+	while (state.next())
+	{
+		output->sendMessages(batch.data(), batch.size());
+		input->processPending();
+	}
+	MidiBenchmark::doNotOptimize(messages);
+}
@@ -0,0 +1,57 @@
+#include "MidiBenchmark.h"
+#include <smidi/MidiMerger.h>
+#include <smidi/MidiLoopback.h>
+#include <smidi/MidiOutPort.h>
+#include <memory>
+#include <vector>
+
+namespace
+{
+	void countMessage(void* context, std::size_t, const MidiMessage&)
+	{
+		++*static_cast<unsigned long long*>(context);
+	}
+}
+
+SMIDI_BENCHMARK(MidiMerger_8InputsBatch64)
+{
+	const std::size_t kInputs = 8;
+	const std::size_t kMessagesPerInput = 8;
+	std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual);
+	MidiMerger::Options options;
+	options.reorderWindow = std::chrono::microseconds(200);
+	options.dispatchMode = MidiInPort::DispatchMode::CallerThread;
+	MidiMerger merger(kInputs, options, clock);
+	std::vector<std::unique_ptr<MidiLoopback>> loopbacks;
+	MidiLoopback::Options loopbackOptions;
+	loopbackOptions.jitter = std::chrono::microseconds(100);
+	for (std::size_t i = 0; i < kInputs; ++i)
+	{
+		loopbackOptions.seed = i;
+		loopbacks.emplace_back(new MidiLoopback("smidi bench merger", clock, loopbackOptions));
+		loopbacks.back()->inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		loopbacks.back()->inputPort()->setMessageHandler(merger.handler(i));
+	}
+	unsigned long long messages = 0;
+	merger.setHandler(MidiMerger::Handler(&countMessage, &messages));
+	const MidiMessage message({MidiMessage::ControlChange, 1, 64});
+
+	// one operation is 8 messages from each of 8 inputs put in timestamp order, loopback hops included
+	while (state.next())
+	{
+		for (const std::unique_ptr<MidiLoopback>& loopback : loopbacks)
+		{
+			for (std::size_t i = 0; i < kMessagesPerInput; ++i)
+			{
+				loopback->outputPort()->sendMessage(message);
+			}
+		}
+		clock->advance(1000000);
+		for (const std::unique_ptr<MidiLoopback>& loopback : loopbacks)
+		{
+			loopback->inputPort()->processPending();
+		}
+		merger.processPending();
+	}
+	MidiBenchmark::doNotOptimize(messages);
+}
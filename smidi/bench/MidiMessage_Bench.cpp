@@ -0,0 +1,63 @@
+#include "MidiBenchmark.h"
+#include <smidi/MidiMessage.h>
+
+SMIDI_BENCHMARK(MidiMessage_ConstructInitializerList)
+{
+	while (state.next())
+	{
+		MidiMessage message({0x90, 0x3C, 0x64});
+		MidiBenchmark::doNotOptimize(message);
+	}
+}
+
+SMIDI_BENCHMARK(MidiMessage_ConstructFromBuffer)
+{
+	const unsigned char bytes[] = {0xB0, 0x07, 0x7F};
+	while (state.next())
+	{
+		MidiMessage message(bytes, sizeof(bytes), 12345ULL);
+		MidiBenchmark::doNotOptimize(message);
+	}
+}
+
+SMIDI_BENCHMARK(MidiMessage_Copy)
+{
+	const MidiMessage message({0x90, 0x3C, 0x64}, 12345ULL);
+	while (state.next())
+	{
+		MidiMessage copy(message);
+		MidiBenchmark::doNotOptimize(copy);
+	}
+}
+
+SMIDI_BENCHMARK(MidiMessage_CopyAssignReusingBuffer)
+{
+	const MidiMessage message({0x90, 0x3C, 0x64}, 12345ULL);
+	MidiMessage target({0x80, 0x3C, 0x00});
+	while (state.next())
+	{
+		target = message;
+		MidiBenchmark::doNotOptimize(target);
+	}
+}
+
+SMIDI_BENCHMARK(MidiMessage_SysExAppend256)
+{
+	// SysEx split by the driver into 4 parts of 64 bytes
+	std::vector<unsigned char> first(64, 0x11);
+	first.front() = MidiMessage::SysEx;
+	std::vector<unsigned char> last(64, 0x22);
+	last.back() = MidiMessage::SysExEnd;
+	const MidiMessage firstPart(first);
+	const MidiMessage middlePart(std::vector<unsigned char>(64, 0x33));
+	const MidiMessage lastPart(last);
+
+	while (state.next())
+	{
+		MidiMessage sysex(firstPart);
+		sysex += middlePart;
+		sysex += middlePart;
+		sysex += lastPart;
+		MidiBenchmark::doNotOptimize(sysex);
+	}
+}
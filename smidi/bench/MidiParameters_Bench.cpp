@@ -0,0 +1,34 @@
+#include "MidiBenchmark.h"
+#include <smidi/MidiParameters.h>
+
+SMIDI_BENCHMARK(MidiParameterDecoder_ControllerPair)
+{
+	unsigned long long sum = 0;
+	MidiParameterDecoder decoder([&sum](const MidiParameterEvent& event) { sum += event.value; });
+	MidiMessage msb({MidiMessage::ControlChange, 1, 64});
+	MidiMessage lsb({MidiMessage::ControlChange, 33, 0});
+
+	// a fader moving in fine steps: MSB and LSB per change
+	while (state.next())
+	{
+		decoder.process(msb);
+		decoder.process(lsb);
+	}
+	MidiBenchmark::doNotOptimize(sum);
+}
+
+SMIDI_BENCHMARK(MidiParameterEncoder_NrpnFineSteps)
+{
+	MidiParameterEncoder encoder;
+	MidiMessage messages[MidiParameterEncoder::kMaxMessages];
+	MidiParameterEvent event = {MidiParameterEvent::Nrpn, 0, 1 * 128 + 2, 0, true, 0};
+	std::size_t count = 0;
+
+	// mostly the LSB changes, the parameter number and MSB are not resent
+	while (state.next())
+	{
+		event.value = (event.value + 1) & 0x3FFF;
+		count += encoder.encode(event, messages);
+	}
+	MidiBenchmark::doNotOptimize(count);
+}
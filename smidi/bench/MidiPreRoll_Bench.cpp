@@ -0,0 +1,45 @@
+#include "MidiBenchmark.h"
+#include <smidi/MidiPreRoll.h>
+#include <vector>
+
+SMIDI_BENCHMARK(MidiPreRoll_RecordNoteOn)
+{
+	MidiPreRoll preRoll(1);
+	const MidiMessage message({MidiMessage::NoteOn, 60, 100}, 1);
+
+	// the cost on the input thread, as if the port handler got the message
+	while (state.next())
+	{
+		preRoll.record(0, message);
+	}
+}
+
+SMIDI_BENCHMARK(MidiPreRoll_RecordSysEx64)
+{
+	MidiPreRoll preRoll(1);
+	std::vector<unsigned char> bytes(64, 0x55);
+	bytes.front() = MidiMessage::SysEx;
+	bytes.back() = MidiMessage::SysExEnd;
+	const MidiMessage message(bytes, 1);
+	state.setBytesPerOperation(bytes.size());
+
+	while (state.next())
+	{
+		preRoll.record(0, message);
+	}
+}
+
+SMIDI_BENCHMARK(MidiPreRoll_Snapshot10k)
+{
+	MidiPreRoll preRoll(1);
+	for (unsigned long long i = 0; i < 10000; ++i)
+	{
+		preRoll.record(0, MidiMessage({MidiMessage::NoteOn, static_cast<unsigned char>(i % 128), 100}, 1 + i));
+	}
+
+	while (state.next())
+	{
+		const std::vector<MidiPreRoll::Event> events = preRoll.snapshot(std::chrono::hours(24 * 365 * 100));
+		MidiBenchmark::doNotOptimize(events);
+	}
+}
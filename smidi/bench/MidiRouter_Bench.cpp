@@ -0,0 +1,88 @@
+#include "MidiBenchmark.h"
+#include <smidi/MidiRouter.h>
+#include <smidi/MidiLoopback.h>
+
+namespace
+{
+	void countMessage(void* context, const MidiMessage&)
+	{
+		++*static_cast<unsigned long long*>(context);
+	}
+
+	MidiPipeline<MidiTypeFilter, MidiChannelMap, MidiTranspose, MidiVelocityCurve, MidiControllerMap> fullPipeline()
+	{
+		return makeMidiPipeline(MidiTypeFilter(MidiTypeFilter::Reject, {MidiMessage::ActiveSense}),
+		                        MidiChannelMap::all(9),
+		                        MidiTranspose(12),
+		                        MidiVelocityCurve(MidiCurve::gamma(0.7)),
+		                        MidiControllerMap().map(1, 11));
+	}
+}
+
+SMIDI_BENCHMARK(MidiPipeline_FiveStages)
+{
+	const auto pipeline = fullPipeline();
+	MidiMessage message({MidiMessage::NoteOn, 60, 100});
+	unsigned char* bytes = message;
+	unsigned long long passed = 0;
+
+	// one operation is one message through all stages, the note is reset so it never leaves the range
+	while (state.next())
+	{
+		bytes[0] = MidiMessage::NoteOn;
+		bytes[1] = 60;
+		MidiBenchmark::doNotOptimize(bytes);
+		passed += pipeline(bytes, 3);
+	}
+	MidiBenchmark::doNotOptimize(passed);
+}
+
+SMIDI_BENCHMARK(MidiRouter_ThruOneRoute)
+{
+	MidiLoopback source("smidi bench source", std::make_shared<MidiSimulatedClock>());
+	MidiLoopback destination("smidi bench destination", std::make_shared<MidiSimulatedClock>());
+	unsigned long long messages = 0;
+	source.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+	destination.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+	destination.inputPort()->setMessageHandler(MidiInPort::MessageHandler(&countMessage, &messages));
+	MidiRouter router;
+	router.addRoute(source.inputPort(), destination.outputPort(), fullPipeline());
+	source.inputPort()->setMessageHandler(router.handler(source.inputPort()));
+	const MidiMessage message({MidiMessage::NoteOn, 60, 100});
+
+	// one operation is one message from the source port to the handler of the destination port,
+	// MidiLoopback_SendReceive is the cost of the two loopback hops without the router
+	while (state.next())
+	{
+		source.outputPort()->sendMessage(message);
+		source.inputPort()->processPending();
+		destination.inputPort()->processPending();
+	}
+	MidiBenchmark::doNotOptimize(messages);
+}
+
+SMIDI_BENCHMARK(MidiRouter_FanOut8Routes)
+{
+	MidiLoopback source("smidi bench source", std::make_shared<MidiSimulatedClock>());
+	MidiLoopback destination("smidi bench destination", std::make_shared<MidiSimulatedClock>());
+	unsigned long long messages = 0;
+	source.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+	destination.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+	destination.inputPort()->setMessageHandler(MidiInPort::MessageHandler(&countMessage, &messages));
+	MidiRouter router;
+	for (unsigned char channel = 0; channel < 8; ++channel)
+	{
+		router.addRoute(source.inputPort(), destination.outputPort(), makeMidiPipeline(MidiChannelMap::all(channel), MidiTranspose(channel)));
+	}
+	source.inputPort()->setMessageHandler(router.handler(source.inputPort()));
+	const MidiMessage message({MidiMessage::NoteOn, 60, 100});
+
+	// one operation is one incoming message forwarded by 8 routes, i.e. 8 messages delivered
+	while (state.next())
+	{
+		source.outputPort()->sendMessage(message);
+		source.inputPort()->processPending();
+		destination.inputPort()->processPending();
+	}
+	MidiBenchmark::doNotOptimize(messages);
+}
@@ -0,0 +1,104 @@
+#include "MidiBenchmark.h"
+#include "../src/linux/alsa/MidiQueue.h"
+#include "../src/linux/alsa/MidiAlsaConstants.h"
+#include <smidi/MidiDeviceEnumerator.h>
+
+namespace
+{
+	//! Output-only sequencer client with a single port, nothing is subscribed to it
+	class BenchSequencer
+	{
+	public:
+		BenchSequencer()
+			: _sequencer(nullptr)
+			, _port(MidiAlsaConstants::kInvalidId)
+		{
+			if (snd_seq_open(&_sequencer, "default", SND_SEQ_OPEN_OUTPUT, SND_SEQ_NONBLOCK) == MidiAlsaConstants::kNoError)
+			{
+				snd_seq_set_client_name(_sequencer, "smidi bench");
+				_port = snd_seq_create_simple_port(_sequencer, "smidi bench out", SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ, SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+			}
+			else
+			{
+				_sequencer = nullptr;
+			}
+		}
+
+		~BenchSequencer()
+		{
+			if (_sequencer)
+			{
+				snd_seq_close(_sequencer);
+			}
+		}
+
+		bool isValid() const
+		{
+			return _sequencer && _port >= 0;
+		}
+
+		snd_seq_t* sequencer() const
+		{
+			return _sequencer;
+		}
+
+		int port() const
+		{
+			return _port;
+		}
+
+		//! Removes the events waiting in the queue, nothing would ever deliver them
+		void removeQueuedEvents(int queue)
+		{
+			snd_seq_remove_events_t* removeEvents = nullptr;
+			snd_seq_remove_events_alloca(&removeEvents);
+			snd_seq_remove_events_set_condition(removeEvents, SND_SEQ_REMOVE_OUTPUT);
+			snd_seq_remove_events_set_queue(removeEvents, queue);
+			snd_seq_remove_events(_sequencer, removeEvents);
+		}
+
+	private:
+		snd_seq_t* _sequencer;
+		int        _port;
+	};
+}
+
+SMIDI_BENCHMARK(MidiQueue_EnqueueMidiSyncEventsBeat)
+{
+	BenchSequencer sequencer;
+	if (!sequencer.isValid())
+	{
+		state.skip("ALSA sequencer is not available");
+		return;
+	}
+	MidiQueue queue;
+	queue.init(sequencer.sequencer(), "smidi bench queue");
+	queue.setTempo(120.0);
+	queue.start();
+
+	// one operation is one beat: 24 MIDI Clocks scheduled on the queue, which are removed again,
+	// or the kernel pool would be full after a few hundred beats and only the error path measured
+	while (state.next())
+	{
+		queue.enqueueMidiSyncEvents(sequencer.port(), false, false, 24);
+		sequencer.removeQueuedEvents(queue);
+	}
+
+	queue.stop();
+	queue.close();
+}
+
+SMIDI_BENCHMARK(MidiDeviceEnumerator_Startup)
+{
+	BenchSequencer sequencer;
+	if (!sequencer.isValid())
+	{
+		state.skip("ALSA sequencer is not available");
+		return;
+	}
+	while (state.next())
+	{
+		MidiDeviceEnumerator enumerator;
+		MidiBenchmark::doNotOptimize(enumerator);
+	}
+}
@@ -0,0 +1,86 @@
+#include "MidiBenchmark.h"
+#include <smidi/MidiStreamParser.h>
+#include <vector>
+
+namespace
+{
+	const std::size_t kStreamSize = 64 * 1024;
+
+	// SysEx dumps (e.g. sample or patch transfers): 1 KiB messages with a clock now and then
+	std::vector<unsigned char> sysExStream()
+	{
+		std::vector<unsigned char> stream;
+		while (stream.size() < kStreamSize)
+		{
+			stream.push_back(MidiMessage::SysEx);
+			for (int i = 0; i < 1022; ++i)
+			{
+				stream.push_back(static_cast<unsigned char>(i & 0x7F));
+				if (i == 511)
+				{
+					stream.push_back(MidiMessage::MidiClock);
+				}
+			}
+			stream.push_back(MidiMessage::SysExEnd);
+		}
+		return stream;
+	}
+
+	// dense controller data with running status
+	std::vector<unsigned char> channelStream()
+	{
+		std::vector<unsigned char> stream;
+		while (stream.size() < kStreamSize)
+		{
+			stream.push_back(0xB0);
+			for (int i = 0; i < 32; ++i)
+			{
+				stream.push_back(static_cast<unsigned char>(i));
+				stream.push_back(static_cast<unsigned char>(127 - i * 2));
+			}
+		}
+		return stream;
+	}
+
+	void countMessage(void* context, const MidiMessage&)
+	{
+		++*static_cast<std::size_t*>(context);
+	}
+
+	void parseStream(MidiBenchmark::State& state, const std::vector<unsigned char>& stream, MidiStreamParser::ScanMode scanMode)
+	{
+		std::size_t messages = 0;
+		MidiStreamParser parser(MidiStreamParser::kDefaultMaxSysExSize, scanMode);
+		parser.setHandler(MidiStreamParser::Handler(&countMessage, &messages));
+		state.setBytesPerOperation(stream.size());
+
+		// warm up, so SysEx buffer is allocated outside of the measurement
+		parser.parse(stream.data(), stream.size(), 0);
+
+		while (state.next())
+		{
+			parser.parse(stream.data(), stream.size(), 0);
+		}
+		MidiBenchmark::doNotOptimize(messages);
+	}
+}
+
+SMIDI_BENCHMARK(MidiStreamParser_SysEx64K_Vector)
+{
+	parseStream(state, sysExStream(), MidiStreamParser::ScanMode::Vector);
+}
+
+SMIDI_BENCHMARK(MidiStreamParser_SysEx64K_Scalar)
+{
+	parseStream(state, sysExStream(), MidiStreamParser::ScanMode::Scalar);
+}
+
+SMIDI_BENCHMARK(MidiStreamParser_RunningStatus64K_Vector)
+{
+	parseStream(state, channelStream(), MidiStreamParser::ScanMode::Vector);
+}
+
+SMIDI_BENCHMARK(MidiStreamParser_RunningStatus64K_Scalar)
+{
+	parseStream(state, channelStream(), MidiStreamParser::ScanMode::Scalar);
+}
@@ -0,0 +1,6 @@
+#include "MidiBenchmark.h"
+
+int main(int argc, char* argv[])
+{
+	return MidiBenchmark::run(argc, argv);
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+/*!
+ * \file MidiCapture.h
+ * Contains MidiCapture - always-on capture of MIDI traffic into a memory mapped ring file, and MidiCaptureReader.
+ */
+
+#include "MidiClock.h"
+#include "MidiInPort.h"
+#include "MidiMessage.h"
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief The MidiCaptureRecord struct is a non-owning view of one captured message
+ * \class MidiCaptureRecord MidiCapture.h <smidi/MidiCapture.h>
+ *
+ * `data` points into the file mapping and is valid while the MidiCaptureReader is open.
+ */
+struct MidiCaptureRecord
+{
+	unsigned long long   timestamp; //!< Timestamp of the message in nanoseconds (MidiTimestamp time base).
+	const unsigned char* data;      //!< Raw bytes of the message.
+	std::size_t          size;      //!< Number of bytes.
+	std::size_t          port;      //!< Index of the port in MidiCaptureReader::portNames().
+
+	/*!
+	 * \brief Writes the message into the MidiMessage, reusing its buffer
+	 * \param [out] message message with the captured timestamp.
+	 */
+	void copyTo(MidiMessage& message) const;
+
+	//! Returns the record as new MidiMessage, see copyTo()
+	MidiMessage toMessage() const;
+};
+
+/*!
+ * \brief The MidiCapture class writes every message of its ports into a fixed size ring file
+ * \class MidiCapture MidiCapture.h <smidi/MidiCapture.h>
+ * \sa MidiCaptureReader
+ *
+ * Meant to run during the whole show, so the last minutes (hours, depending on the file size and the traffic)
+ * can be looked at afterwards. capture() only copies the message into a preallocated lock-free ring, it never
+ * waits and never touches the file. A writer thread drains the ring into the shared file mapping, there are no
+ * write calls at all: the kernel writes the dirty pages back on its own, and what was copied into the mapping
+ * survives a crash of the process.
+ *
+ * The file is a header with the port names followed by fixed size blocks used as a ring, when the file is full
+ * the oldest block is overwritten. A record is the timestamp delta from the previous record of the block
+ * (zigzag varint, so timestamps going back between ports cost nothing extra), the port index and the size
+ * (varints) and the raw bytes, so a Note On takes 6 bytes. Every block starts with the absolute time of its first
+ * record and the number of bytes used, which is updated after every record.
+ *
+ * Ports are named with addPort(), the capture doesn't touch message handlers: the traffic of an input port,
+ * of an output port or of MidiMerger is fed with capture() from where the application handles or sends it,
+ * or with handler() when the input port has nothing else to do.
+ *
+ * ~~~cpp
+ * MidiCapture capture;
+ * const std::size_t keyboardIndex = capture.addPort(keyboard->name());
+ * const std::size_t outputIndex = capture.addPort("Synth out");
+ * keyboard->setMessageHandler([&](const MidiMessage& message)
+ * {
+ *     capture.capture(keyboardIndex, message);
+ *     output->sendMessage(message);
+ *     capture.capture(outputIndex, message);
+ * });
+ * capture.open("/var/log/show.smcap");
+ * ~~~
+ */
+class MidiCapture
+{
+public:
+	/*!
+	 * \brief The Options struct describes the size of the file and buffering
+	 */
+	struct Options
+	{
+		std::size_t               fileSize;      //!< Size of the file, rounded down to whole blocks.
+		std::size_t               blockSize;     //!< Size of a block, the largest message that can be captured is a bit smaller.
+		std::size_t               capacity;      //!< Capacity of the ring between capture() and the writer in messages.
+		std::chrono::milliseconds drainInterval; //!< How often the writer thread copies messages into the file.
+
+		//! Default options: 16 MiB file of 64 KiB blocks, 8192 messages, 10 milliseconds drain interval
+		Options();
+	};
+
+	/*!
+	 * \brief The Counters struct contains counters of the current or the last capture
+	 */
+	struct Counters
+	{
+		unsigned long long captured;    //!< Messages written to the file.
+		unsigned long long dropped;     //!< Messages lost because the ring was full or they didn't fit a block.
+		unsigned long long overwritten; //!< Blocks of older messages overwritten after the file got full.
+		unsigned long long bytes;       //!< Bytes of records written to the file.
+	};
+
+public:
+	/*!
+	 * \brief Constructor
+	 * \param [in] options file size and buffering.
+	 * \param [in] clock time source, messages without timestamp are stamped with it.
+	 */
+	explicit MidiCapture(const Options& options = Options(), std::shared_ptr<MidiClock> clock = MidiClock::system());
+
+	//! Destructor closes the file
+	~MidiCapture();
+
+	MidiCapture(const MidiCapture&) = delete;
+	MidiCapture& operator=(const MidiCapture&) = delete;
+
+	/*!
+	 * \brief Adds a port, must be called before open()
+	 * \param [in] name name of the port stored in the file.
+	 * \return index of the port for capture(), ports are numbered from 0 in the order they are added
+	 */
+	std::size_t addPort(const std::string& name);
+
+	/*!
+	 * \brief Creates the file and starts capturing
+	 * \param [in] path path to the file, an existing file is overwritten.
+	 * \return `false` if the file can't be created and mapped, the port names don't fit its header or
+	 * the capture is already running
+	 */
+	bool open(const std::string& path);
+
+	/*!
+	 * \brief Stops capturing, writes the rest of the messages and unmaps the file
+	 * \return `false` if the capture was not running
+	 */
+	bool close();
+
+	//! Returns `true` between open() and close()
+	bool isCapturing() const;
+
+	/*!
+	 * \brief Captures the message, can be called from any thread, doesn't block
+	 * \param [in] port index of the port.
+	 * \param [in] message the message, the current time of the clock is used if it doesn't have a timestamp.
+	 */
+	void capture(std::size_t port, const MidiMessage& message);
+
+	//! Returns handler which calls capture() with the port index, for MidiInPort::setMessageHandler(), the capture must outlive the port handler
+	MidiInPort::MessageHandler handler(std::size_t port);
+
+	//! Returns counters of the current or the last capture
+	Counters counters() const;
+
+private:
+	class Implementation;
+	std::unique_ptr<Implementation> _impl;
+};
+
+/*!
+ * \brief The MidiCaptureReader class reads files written by MidiCapture
+ * \class MidiCaptureReader MidiCapture.h <smidi/MidiCapture.h>
+ * \sa MidiCapture
+ *
+ * The file is memory mapped, open() only orders the blocks from the oldest to the newest. Records are decoded by
+ * next(), nothing is allocated per record. A file left by a crashed process is read up to the last record
+ * copied into it. Reading a file that is still being captured into may return the records of the block being
+ * overwritten at that moment in a torn state, decoding of such a block stops at the first malformed record.
+ *
+ * ~~~cpp
+ * MidiCaptureReader reader;
+ * if (reader.open("/var/log/show.smcap"))
+ * {
+ *     MidiCaptureRecord record;
+ *     while (reader.next(record))
+ *     {
+ *         // reader.portNames()[record.port], record.timestamp
+ *     }
+ * }
+ * ~~~
+ */
+class MidiCaptureReader
+{
+public:
+	MidiCaptureReader();
+	~MidiCaptureReader();
+
+	MidiCaptureReader(const MidiCaptureReader&) = delete;
+	MidiCaptureReader& operator=(const MidiCaptureReader&) = delete;
+
+	/*!
+	 * \brief Maps the file and moves to the oldest record
+	 * \param [in] path path to the file.
+	 * \return `false` if the file can't be mapped or is not a capture file
+	 */
+	bool open(const std::string& path);
+
+	//! Unmaps the file, records yielded before are not valid anymore
+	void close();
+
+	bool isOpen() const;
+
+	//! Returns names of the captured ports, record port is the index in this list
+	const std::vector<std::string>& portNames() const;
+
+	/*!
+	 * \brief Decodes the next record, the oldest first
+	 * \param [out] record the record.
+	 * \return `false` after the newest record
+	 */
+	bool next(MidiCaptureRecord& record);
+
+	//! Moves back to the oldest record
+	void rewind();
+
+private:
+	struct Block
+	{
+		const unsigned char* begin;
+		const unsigned char* end;
+		unsigned long long   baseTime;
+	};
+
+	bool parse();
+
+private:
+	const unsigned char*     _data;
+	std::size_t              _size;
+	void*                    _mapping;
+	std::vector<std::string> _portNames;
+	std::vector<Block>       _blocks;     // blocks in capture order
+	std::size_t              _block;      // block being decoded
+	const unsigned char*     _position;   // next record in the block
+	unsigned long long       _time;       // timestamp of the previous record
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+/*!
+ * \file MidiChannelState.h
+ * Contains MidiChannelState - current state of all 16 MIDI channels built from the message stream.
+ */
+
+#include "MidiInPort.h"
+#include "MidiMessage.h"
+#include <memory>
+#include <vector>
+
+/*!
+ * \brief The MidiChannelState class tracks controllers, held notes, programs, pressure and pitch bend of 16 channels
+ * \class MidiChannelState MidiChannelState.h <smidi/MidiChannelState.h>
+ *
+ * Feed it with everything an input port receives (`port->setMessageHandler(state.handler())`) or with everything
+ * that is sent to an output port (process() next to sendMessage()). One thread feeds the state, any thread reads
+ * it: every query is a single lock-free load, and snapshot() takes a consistent copy of all channels at once
+ * (seqlock: the copy is retried if a message was processed meanwhile). reset() can be called from any thread, the
+ * feeding thread waits only while a reset is in progress.
+ *
+ * Values which were never received are kUnknown (kUnknownPitchBend), so restoreMessages() brings a device that
+ * connects late up to the state with only the messages that matter. Reset All Controllers, All Notes Off (and
+ * the other channel mode messages that imply it) and System Reset change the state as the MIDI 1.0 specification
+ * and RP-015 describe, channel mode controllers (120-127) themselves are not kept.
+ *
+ * Channels are 0 to 15, note and controller numbers 0 to 127, larger values wrap.
+ *
+ * ~~~cpp
+ * MidiChannelState state;
+ * keyboard->setMessageHandler(state.handler());
+ * // from any thread:
+ * const unsigned char volume = state.controller(2, 7);
+ * // a synth was plugged in:
+ * const std::vector<MidiMessage> restore = state.restoreMessages();
+ * synth->sendMessages(restore.data(), restore.size());
+ * ~~~
+ */
+class MidiChannelState
+{
+public:
+	//! Value of a controller, program, pressure or poly pressure that was never received
+	static const unsigned char kUnknown = 0xFF;
+
+	//! Pitch bend value of a channel that never received one
+	static const unsigned int kUnknownPitchBend = 0xFFFF;
+
+	//! Number of MIDI channels
+	static const unsigned int kChannels = 16;
+
+	/*!
+	 * \brief The Snapshot struct is a consistent copy of the state of all channels
+	 */
+	struct Snapshot
+	{
+		unsigned char  controllers[kChannels][128];  //!< Controller values, kUnknown if never received.
+		unsigned char  notes[kChannels][128];        //!< Velocities of held notes, 0 if the note is not held.
+		unsigned char  polyPressure[kChannels][128]; //!< Poly pressure (after touch) of notes, kUnknown if never received.
+		unsigned char  programs[kChannels];          //!< Programs, kUnknown if never received.
+		unsigned char  pressures[kChannels];         //!< Channel pressure, kUnknown if never received.
+		unsigned short pitchBends[kChannels];        //!< 14-bit pitch bend (8192 is the center), kUnknownPitchBend if never received.
+
+		/*!
+		 * \brief Returns the messages that bring a device from its power-up state to this state
+		 * \param [in] includeNotes also Note On (and poly pressure) for the held notes.
+		 *
+		 * Per channel: bank select, program, the other known controllers, pitch bend and pressure. Data entry,
+		 * (N)RPN numbers and channel mode controllers are left out, replaying them would change other parameters.
+		 */
+		std::vector<MidiMessage> restoreMessages(bool includeNotes = false) const;
+	};
+
+public:
+	//! Constructor, all values are unknown and no note is held
+	MidiChannelState();
+	~MidiChannelState();
+
+	MidiChannelState(const MidiChannelState&) = delete;
+	MidiChannelState& operator=(const MidiChannelState&) = delete;
+
+	/*!
+	 * \brief Applies the message to the state, the feeding thread only
+	 * \param [in] message any message, those which don't change channel state are ignored.
+	 */
+	void process(const MidiMessage& message);
+
+	//! Returns handler which calls process(), for MidiInPort::setMessageHandler(), the state must outlive the port handler
+	MidiInPort::MessageHandler handler();
+
+	//! Forgets everything as if the state was just constructed, can be called from any thread
+	void reset();
+
+	//! Returns the value of the controller, kUnknown if never received
+	unsigned char controller(unsigned int channel, unsigned int number) const;
+
+	//! Returns the velocity of the held note, 0 if it is not held
+	unsigned char noteVelocity(unsigned int channel, unsigned int note) const;
+
+	//! Returns the poly pressure of the note, kUnknown if never received
+	unsigned char polyPressure(unsigned int channel, unsigned int note) const;
+
+	//! Returns the program of the channel, kUnknown if never received
+	unsigned char program(unsigned int channel) const;
+
+	//! Returns the channel pressure, kUnknown if never received
+	unsigned char channelPressure(unsigned int channel) const;
+
+	//! Returns the 14-bit pitch bend of the channel, kUnknownPitchBend if never received
+	unsigned int pitchBend(unsigned int channel) const;
+
+	//! Returns a consistent copy of all channels, can be called from any thread
+	Snapshot snapshot() const;
+
+	//! Returns snapshot().restoreMessages(includeNotes)
+	std::vector<MidiMessage> restoreMessages(bool includeNotes = false) const;
+
+private:
+	class Implementation;
+	std::unique_ptr<Implementation> _impl;
+};
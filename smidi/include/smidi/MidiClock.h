@@ -0,0 +1,96 @@
+#pragma once
+
+/*!
+ * \file MidiClock.h
+ * Contains MidiClock - time source of the software clocks, and MidiSimulatedClock for tests.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+/*!
+ * \brief The MidiClock class is the time source and the sleeping primitive of the software timed parts of the library
+ * \class MidiClock MidiClock.h <smidi/MidiClock.h>
+ * \sa MidiSimulatedClock
+ *
+ * Used by software MidiSync generators and by MidiLoopback ports. Time is in nanoseconds, the system clock
+ * has the same epoch as MidiTimestamp::now(), so its times can be used as MidiMessage timestamps.
+ */
+class MidiClock
+{
+public:
+	//! Trivial destructor
+	virtual ~MidiClock() = default;
+
+	//! Returns current time in nanoseconds
+	virtual unsigned long long now() const = 0;
+
+	/*!
+	 * \brief Blocks the calling thread until the time comes
+	 * \param [in] time absolute time in nanoseconds.
+	 *
+	 * May return earlier (e.g. on a signal), callers should check now() again.
+	 */
+	virtual void sleepUntil(unsigned long long time) = 0;
+
+	//! Returns the real time clock (`CLOCK_MONOTONIC`), shared by all users
+	static std::shared_ptr<MidiClock> system();
+};
+
+/*!
+ * \brief The MidiSimulatedClock class is a virtual time source for deterministic tests
+ * \class MidiSimulatedClock MidiClock.h <smidi/MidiClock.h>
+ *
+ * In Mode::Instant sleeping advances the time to the wake up time right away, so an hour of MIDI Clock is
+ * generated in milliseconds. In Mode::Manual the time stands still until advance() or advanceTo() is called,
+ * sleeping threads wake up as soon as the time they wait for comes.
+ *
+ * ~~~cpp
+ * std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual);
+ * MidiLoopback loopback("Test", clock);
+ * loopback.outputPort()->sendMessage(message);
+ * clock->advance(1000000); // 1 ms
+ * loopback.inputPort()->processPending();
+ * ~~~
+ */
+class MidiSimulatedClock : public MidiClock
+{
+public:
+	/*!
+	 * \enum Mode
+	 * Defines how the simulated time goes.
+	 */
+	enum class Mode
+	{
+		Instant, //!< sleepUntil() moves the time forward and returns immediately.
+		Manual   //!< Time moves only with advance() and advanceTo().
+	};
+
+public:
+	/*!
+	 * \brief Constructor
+	 * \param [in] mode how the time goes.
+	 * \param [in] startTime initial time in nanoseconds.
+	 */
+	explicit MidiSimulatedClock(Mode mode = Mode::Instant, unsigned long long startTime = 0);
+
+	virtual unsigned long long now() const override;
+	virtual void sleepUntil(unsigned long long time) override;
+
+	//! Returns the mode set in the constructor
+	Mode mode() const;
+
+	//! Moves the time forward by the interval in nanoseconds and wakes up the sleeping threads
+	void advance(unsigned long long interval);
+
+	//! Moves the time forward to the time (never backwards) and wakes up the sleeping threads
+	void advanceTo(unsigned long long time);
+
+private:
+	Mode                            _mode;
+	std::atomic<unsigned long long> _now;
+	std::mutex                      _mutex;
+	std::condition_variable         _advanced;
+};
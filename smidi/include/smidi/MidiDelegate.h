@@ -0,0 +1,215 @@
+#pragma once
+
+/*!
+ * \file MidiDelegate.h
+ * Contains MidiDelegate - non-allocating callable wrapper used for MIDI callbacks.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature>
+class MidiDelegate;
+
+/*!
+ * \brief The MidiDelegate class is a small-buffer replacement for `std::function` that never allocates.
+ * \class MidiDelegate MidiDelegate.h <smidi/MidiDelegate.h>
+ *
+ * Delegate keeps either a plain function pointer together with a context pointer or a callable object
+ * (e.g. lambda) stored inline. Callable object has to fit into MidiDelegate::kCapacity bytes, this is checked
+ * at compile time, so creating, copying and invoking delegate is always allocation-free.
+ *
+ * ~~~cpp
+ * MidiDelegate<void(const MidiMessage&)> handler = [&counter](const MidiMessage&) { ++counter; };
+ * ~~~
+ */
+template <typename Result, typename... Arguments>
+class MidiDelegate<Result(Arguments...)>
+{
+public:
+	//! Size of the inline storage for callable objects (in bytes)
+	static constexpr std::size_t kCapacity = 4 * sizeof(void*);
+
+	//! Type of the function pointer which is invoked with the context pointer as the first argument
+	using FunctionWithContext = Result (*)(void* context, Arguments...);
+
+public:
+	//! Creates empty delegate
+	MidiDelegate() noexcept
+	    : _invoker(nullptr)
+	    , _manager(nullptr)
+	{
+	}
+
+	//! Creates empty delegate, allows `handler = nullptr`
+	MidiDelegate(std::nullptr_t) noexcept
+	    : MidiDelegate()
+	{
+	}
+
+	/*!
+	 * \brief Creates delegate from function pointer and context
+	 * \param [in] function function to call. Context pointer is passed as the first argument.
+	 * \param [in] context arbitrary user pointer. Delegate doesn't own it.
+	 */
+	MidiDelegate(FunctionWithContext function, void* context) noexcept
+	    : MidiDelegate()
+	{
+		if (function)
+		{
+			store(BoundFunction{function, context});
+		}
+	}
+
+	/*!
+	 * \brief Creates delegate from callable object (lambda, functor or function pointer)
+	 * \param [in] callable object to store inline. It's size should not exceed kCapacity.
+	 */
+	template <typename Callable,
+	          typename Stored = typename std::decay<Callable>::type,
+	          typename = typename std::enable_if<!std::is_same<Stored, MidiDelegate>::value>::type>
+	MidiDelegate(Callable&& callable)
+	    : MidiDelegate()
+	{
+		static_assert(sizeof(Stored) <= kCapacity, "Callable object is too big for MidiDelegate inline storage");
+		static_assert(alignof(Stored) <= alignof(Storage), "Callable object alignment is not supported by MidiDelegate");
+		store(std::forward<Callable>(callable));
+	}
+
+	//! Copy constructor copies stored callable
+	MidiDelegate(const MidiDelegate& other)
+	    : MidiDelegate()
+	{
+		copyFrom(other);
+	}
+
+	//! Move constructor. Moved-from delegate stays valid.
+	MidiDelegate(MidiDelegate&& other)
+	    : MidiDelegate()
+	{
+		copyFrom(other);
+	}
+
+	//! Destroys stored callable
+	~MidiDelegate()
+	{
+		reset();
+	}
+
+	//! Copy assignment
+	MidiDelegate& operator=(const MidiDelegate& other)
+	{
+		if (this != &other)
+		{
+			reset();
+			copyFrom(other);
+		}
+		return *this;
+	}
+
+	//! Move assignment
+	MidiDelegate& operator=(MidiDelegate&& other)
+	{
+		return operator=(static_cast<const MidiDelegate&>(other));
+	}
+
+	//! Makes delegate empty
+	MidiDelegate& operator=(std::nullptr_t)
+	{
+		reset();
+		return *this;
+	}
+
+	//! Returns `true` if delegate holds a callable
+	explicit operator bool() const noexcept
+	{
+		return _invoker != nullptr;
+	}
+
+	/*!
+	 * \brief Invokes stored callable
+	 * \warning Invoking empty delegate is undefined behaviour, check it with `operator bool()` first.
+	 */
+	Result operator()(Arguments... arguments) const
+	{
+		return _invoker(const_cast<void*>(static_cast<const void*>(&_storage)), std::forward<Arguments>(arguments)...);
+	}
+
+private:
+	using Storage = typename std::aligned_storage<kCapacity, alignof(std::max_align_t)>::type;
+	using Invoker = Result (*)(void*, Arguments&&...);
+	using Manager = void (*)(void* destination, const void* source);
+
+	struct BoundFunction
+	{
+		FunctionWithContext function;
+		void*               context;
+
+		Result operator()(Arguments... arguments) const
+		{
+			return function(context, std::forward<Arguments>(arguments)...);
+		}
+	};
+
+	template <typename Stored>
+	static Result invoke(void* storage, Arguments&&... arguments)
+	{
+		return (*static_cast<Stored*>(storage))(std::forward<Arguments>(arguments)...);
+	}
+
+	// copies object to destination if source is set, destroys destination otherwise
+	template <typename Stored>
+	static void manage(void* destination, const void* source)
+	{
+		if (source)
+		{
+			new (destination) Stored(*static_cast<const Stored*>(source));
+		}
+		else
+		{
+			static_cast<Stored*>(destination)->~Stored();
+		}
+	}
+
+	template <typename Callable>
+	void store(Callable&& callable)
+	{
+		using Stored = typename std::decay<Callable>::type;
+		new (&_storage) Stored(std::forward<Callable>(callable));
+		_invoker = &invoke<Stored>;
+		// trivially copyable callables (function pointers, lambdas capturing pointers) are copied with memcpy
+		_manager = std::is_trivially_copyable<Stored>::value ? nullptr : &manage<Stored>;
+	}
+
+	void copyFrom(const MidiDelegate& other)
+	{
+		if (other._manager)
+		{
+			other._manager(&_storage, &other._storage);
+		}
+		else
+		{
+			std::memcpy(&_storage, &other._storage, sizeof(Storage));
+		}
+		_invoker = other._invoker;
+		_manager = other._manager;
+	}
+
+	void reset()
+	{
+		if (_manager)
+		{
+			_manager(&_storage, nullptr);
+		}
+		_invoker = nullptr;
+		_manager = nullptr;
+	}
+
+private:
+	Storage _storage;
+	Invoker _invoker;
+	Manager _manager;
+};
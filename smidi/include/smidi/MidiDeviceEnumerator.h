@@ -6,6 +6,7 @@
 
 #include <list>
 #include <memory>
+#include <string>
 
 class MidiDevice;
 
@@ -19,13 +20,67 @@ class MidiDevice;
 class MidiDeviceEnumerator
 {
 public:
+	/*!
+	 * \enum Backend
+	 * Defines the driver API devices are enumerated and ports are opened with.
+	 */
+	enum class Backend
+	{
+		Sequencer, //!< ALSA sequencer: software clients and hardware, shared ports, routing and queues (default).
+		RawMidi,   //!< ALSA raw MIDI (`hw:card,device,subdevice`): hardware only, exclusive access, lowest latency.
+		Loopback   //!< In-process MidiLoopback device (kLoopbackDeviceName), no driver at all: for tests and benchmarks.
+	};
+
+	//! Name of the only device of Backend::Loopback
+	static const char* const kLoopbackDeviceName;
+
+	/*!
+	 * \brief The Route struct describes direct connection from one device port to another (MIDI thru)
+	 *
+	 * Ports are identified by names (MidiDevice::name() and MidiPort::name()), so the route stays the same when
+	 * the device is unplugged and plugged again.
+	 */
+	struct Route
+	{
+		std::string sourceDevice;          //!< Device MIDI comes from.
+		std::string sourcePort;            //!< Name of its input port (port smidi would receive from).
+		std::string destinationDevice;     //!< Device MIDI goes to.
+		std::string destinationPort;       //!< Name of its output port (port smidi would send to).
+		bool        timestamped = false;   //!< Events are stamped with real time of the enumerator's queue on the way.
+
+		//! Routes are equal if they connect the same ports the same way
+		bool operator==(const Route& other) const
+		{
+			return connectsSamePorts(other) && timestamped == other.timestamped;
+		}
+
+		//! Returns `true` if the route connects the same ports as `other`
+		bool connectsSamePorts(const Route& other) const
+		{
+			return sourceDevice == other.sourceDevice && sourcePort == other.sourcePort && destinationDevice == other.destinationDevice && destinationPort == other.destinationPort;
+		}
+	};
 
-	//! Constructor
-	MidiDeviceEnumerator();
+public:
+	/*!
+	 * \brief Constructor
+	 * \param [in] backend driver API to use.
+	 *
+	 * With Backend::RawMidi devices are sound cards and ports are their raw MIDI subdevices. Ports write and parse
+	 * MIDI bytes themselves, so running status is supported in both directions (see MidiOutPort::setRunningStatusEnabled())
+	 * and MidiSync is generated by a software clock.
+	 *
+	 * With Backend::Loopback there is a single device whose output port is connected to its input port,
+	 * see MidiLoopback.
+	 */
+	explicit MidiDeviceEnumerator(Backend backend = Backend::Sequencer);
 
 	//! Destructor
 	~MidiDeviceEnumerator();
 
+	//! Returns the backend selected in the constructor
+	Backend backend() const;
+
 	//! Returns the names of available MIDI devices
 	std::list<std::string> deviceNames() const;
 
@@ -45,10 +100,42 @@ public:
 	 *
 	 * With current implementatio all device object references that were created with createDevice() will be
 	 * released internally. The holder of such references should also release them.
+	 *
+	 * With the Sequencer backend the destinations of the routes from a device that has disappeared get All Notes Off,
+	 * the notes a route passes are not tracked. Which output ports the application itself fed from the device only
+	 * the application knows, it calls MidiOutPort::releaseNotes() on them.
 	 */
 	void updateDeviceList();
 
+	/*!
+	 * \brief Connects device ports directly in the driver
+	 * \param [in] route source and destination ports.
+	 * \return `true` if the route is added (connected now or as soon as both ports are present), `false` if a route
+	 * between the same ports is added already, timestamped or not.
+	 *
+	 * Events go from the source to the destination without waking up any application thread and without
+	 * being copied to user space - the cheapest MIDI thru there is. The route is remembered: updateDeviceList()
+	 * connects it again after the device was unplugged and plugged back. Routes are removed when the enumerator
+	 * is destroyed. Only Backend::Sequencer supports routes.
+	 */
+	bool addRoute(const Route& route);
+
+	//! Disconnects and forgets the route added by addRoute(), returns `false` if there is no such route
+	bool removeRoute(const Route& route);
+
+	//! Returns routes added by addRoute()
+	std::list<Route> routes() const;
+
+	//! Returns `true` if the route is connected right now, i.e. both ports are present
+	bool isRouteConnected(const Route& route) const;
+
 private:
 	class Implementation;
-	std::unique_ptr<Implementation> _impl;
+	class RawMidiImplementation;
+	class LoopbackImplementation;
+
+	Backend                                 _backend;
+	std::unique_ptr<Implementation>         _impl;
+	std::unique_ptr<RawMidiImplementation>  _rawMidiImpl;
+	std::unique_ptr<LoopbackImplementation> _loopbackImpl;
 };
@@ -0,0 +1,229 @@
+#pragma once
+
+/*!
+ * \file MidiFile.h
+ * Contains MidiFile - memory mapped Standard MIDI File reader, and MidiFileEvent.
+ */
+
+#include "MidiMessage.h"
+#include "MidiTempoMap.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief The MidiFileEvent struct is a non-owning view of one event of a Standard MIDI File
+ * \class MidiFileEvent MidiFile.h <smidi/MidiFile.h>
+ *
+ * `data` points into the file mapping and is valid while the MidiFile is open. Running status is resolved, but
+ * the status byte is not stored in the file next to the data bytes, so it is a separate field.
+ */
+struct MidiFileEvent
+{
+	//! Kind of the event
+	enum Kind : unsigned char
+	{
+		Channel, //!< Channel message: `status` and 1 or 2 data bytes.
+		SysEx,   //!< System Exclusive: `status` is 0xF0, data is the rest of the message up to 0xF7 inclusive.
+		Escape,  //!< Escaped bytes (0xF7 event): data is sent as is, e.g. SysEx continuation or real time messages.
+		Meta     //!< Meta event: `metaType` tells the type, data is the payload.
+	};
+
+	//! Meta event type of Set Tempo
+	static const unsigned char kMetaTempo = 0x51;
+
+	//! Meta event type of End of Track
+	static const unsigned char kMetaEndOfTrack = 0x2F;
+
+	unsigned long long   tick;     //!< Absolute position in ticks.
+	unsigned long long   time;     //!< Absolute position in nanoseconds, tempo changes are taken into account.
+	const unsigned char* data;     //!< Data bytes, see Kind.
+	std::size_t          size;     //!< Number of data bytes.
+	unsigned int         track;    //!< Index of the track.
+	Kind                 kind;     //!< Kind of the event.
+	unsigned char        status;   //!< Status byte (0xFF for meta events).
+	unsigned char        metaType; //!< Type of meta event, 0 for other kinds.
+
+	//! Returns `true` for events that can be sent to a port (channel, SysEx and escaped messages)
+	bool isMessage() const;
+
+	//! Returns tempo of Set Tempo meta event in microseconds per quarter note, 0 for other events
+	unsigned int tempo() const;
+
+	/*!
+	 * \brief Writes the message into the MidiMessage, reusing its buffer
+	 * \param [out] message message with the timestamp set to `time`. Meta events produce an empty message.
+	 */
+	void copyTo(MidiMessage& message) const;
+
+	//! Returns the event as new MidiMessage, see copyTo()
+	MidiMessage toMessage() const;
+};
+
+/*!
+ * \brief The MidiFile class reads Standard MIDI Files (format 0, 1 and 2) without loading them
+ * \class MidiFile MidiFile.h <smidi/MidiFile.h>
+ * \sa MidiTempoMap
+ *
+ * The file is memory mapped, open() only finds the track chunks and reads the tempo changes. Events are decoded
+ * when iterated: the iterator keeps one decoding cursor per track and yields the next event of all tracks by
+ * tick (ties go to the lower track index), so the tracks are merged on the fly and nothing is allocated per event.
+ *
+ * For formats 0 and 1 the tempo changes of the first track apply to all tracks, in format 2 every track is
+ * an independent pattern with its own tempo changes.
+ *
+ * ~~~cpp
+ * MidiFile file;
+ * if (file.open("song.mid"))
+ * {
+ *     MidiMessage message;
+ *     for (const MidiFileEvent& event : file.events())
+ *     {
+ *         if (event.isMessage())
+ *         {
+ *             event.copyTo(message);
+ *             // message.timestamp() is the time in nanoseconds from the start of the song
+ *         }
+ *     }
+ * }
+ * ~~~
+ */
+class MidiFile
+{
+public:
+	/*!
+	 * \brief The TrackCursor class decodes events of one track
+	 */
+	class TrackCursor
+	{
+	public:
+		TrackCursor();
+		TrackCursor(const unsigned char* begin, const unsigned char* end, unsigned int track, const MidiTempoMap* tempoMap);
+
+		//! Decodes the next event, returns `false` at the end of the track or on malformed data
+		bool next(MidiFileEvent& event);
+
+	private:
+		const unsigned char* _position;
+		const unsigned char* _end;
+		const MidiTempoMap*  _tempoMap;
+		std::size_t          _tempoHint;
+		unsigned long long   _tick;
+		unsigned int         _track;
+		unsigned char        _runningStatus;
+	};
+
+	/*!
+	 * \brief The Iterator class yields events of several tracks ordered by tick
+	 */
+	class Iterator
+	{
+	public:
+		//! End iterator
+		Iterator();
+
+		const MidiFileEvent& operator*() const;
+		const MidiFileEvent* operator->() const;
+		Iterator& operator++();
+		bool operator==(const Iterator& other) const;
+		bool operator!=(const Iterator& other) const;
+
+	private:
+		friend class MidiFile;
+
+		struct HeapEntry
+		{
+			unsigned long long tick;
+			std::size_t        cursor;
+		};
+
+		explicit Iterator(std::vector<TrackCursor> cursors);
+		void siftDown(std::size_t index);
+
+	private:
+		std::vector<TrackCursor>   _cursors;
+		std::vector<MidiFileEvent> _events;   // next event of every cursor
+		std::vector<HeapEntry>     _heap;     // cursors with an event, the earliest on top
+		bool                       _isEnd;
+	};
+
+	/*!
+	 * \brief The EventRange class is the range of events for range-based for loops
+	 */
+	class EventRange
+	{
+	public:
+		Iterator begin() const;
+		Iterator end() const;
+
+	private:
+		friend class MidiFile;
+		EventRange(const MidiFile& file, std::size_t firstTrack, std::size_t lastTrack);
+
+	private:
+		const MidiFile& _file;
+		std::size_t     _firstTrack;
+		std::size_t     _lastTrack;
+	};
+
+public:
+	MidiFile();
+	~MidiFile();
+
+	MidiFile(const MidiFile&) = delete;
+	MidiFile& operator=(const MidiFile&) = delete;
+
+	/*!
+	 * \brief Maps the file and finds its tracks
+	 * \param [in] path path to the file.
+	 * \return `false` if the file can't be mapped or is not a Standard MIDI File
+	 */
+	bool open(const std::string& path);
+
+	/*!
+	 * \brief Reads the file from memory, the memory must stay valid until close()
+	 * \param [in] data file contents.
+	 * \param [in] size size of the contents.
+	 * \return `false` if the data is not a Standard MIDI File
+	 */
+	bool open(const unsigned char* data, std::size_t size);
+
+	//! Unmaps the file, events yielded before are not valid anymore
+	void close();
+
+	bool isOpen() const;
+
+	//! Returns format of the file: 0 (single track), 1 (simultaneous tracks) or 2 (independent tracks)
+	unsigned int format() const;
+
+	//! Returns number of track chunks
+	std::size_t trackCount() const;
+
+	//! Returns the tempo map of the track (the same map for all tracks unless the format is 2)
+	const MidiTempoMap& tempoMap(std::size_t track = 0) const;
+
+	//! Returns events of all tracks ordered by tick
+	EventRange events() const;
+
+	//! Returns events of the track
+	EventRange trackEvents(std::size_t track) const;
+
+private:
+	struct Track
+	{
+		const unsigned char* begin;
+		const unsigned char* end;
+	};
+
+	bool parse();
+	void readTempoChanges(std::size_t track, MidiTempoMap& tempoMap) const;
+	TrackCursor cursor(std::size_t track) const;
+
+private:
+	const unsigned char*      _data;
+	std::size_t               _size;
+	void*                     _mapping;
+	unsigned int              _format;
+	std::vector<Track>        _tracks;
+	std::vector<MidiTempoMap> _tempoMaps;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+/*!
+ * \file MidiFileRecorder.h
+ * Contains MidiFileRecorder - streaming recorder of input ports into a Standard MIDI File.
+ */
+
+#include "MidiClock.h"
+#include "MidiInPort.h"
+#include <chrono>
+#include <memory>
+#include <string>
+
+/*!
+ * \brief The MidiFileRecorder class records received messages into a Standard MIDI File
+ * \class MidiFileRecorder MidiFileRecorder.h <smidi/MidiFileRecorder.h>
+ * \sa MidiFile
+ *
+ * record() only copies the message into a preallocated lock-free ring, it never waits and never touches the file. A writer thread drains the ring, converts timestamps into ticks (constant tempo from
+ * Options) and appends the events to the only track of a format 0 file. The track length in the header is
+ * patched on every flush and on close(), so the file on disk is always readable up to the last flush, and memory
+ * use doesn't depend on the length of the session.
+ *
+ * Messages of all ports go to the same track in the order they are taken from the ring, a message with an
+ * earlier timestamp than the previous one is recorded at the time of the previous one. Use MidiMerger in front
+ * of the recorder when the inputs must be put in timestamp order first.
+ *
+ * The recorder doesn't touch message handlers of the ports, feed it from them: with handler() alone, or by
+ * calling record() from a handler that does other work too.
+ *
+ * ~~~cpp
+ * MidiFileRecorder recorder;
+ * keyboard->inputPorts().front()->setMessageHandler(recorder.handler());
+ * recorder.open("take1.mid");
+ * // ...
+ * recorder.close();
+ * ~~~
+ */
+class MidiFileRecorder
+{
+public:
+	/*!
+	 * \brief The Options struct describes the recorded file and buffering
+	 */
+	struct Options
+	{
+		unsigned int              ticksPerQuarterNote; //!< Time division of the file.
+		unsigned int              tempo;               //!< Tempo in microseconds per quarter note.
+		std::size_t               capacity;            //!< Capacity of the ring in messages.
+		std::chrono::milliseconds flushInterval;       //!< How often the file is written and its header patched.
+
+		//! Default options: 480 ticks per quarter note at 120 BPM, 8192 messages, 1 second flush interval
+		Options();
+	};
+
+	/*!
+	 * \brief The Counters struct contains counters of the current or the last recording
+	 */
+	struct Counters
+	{
+		unsigned long long recorded; //!< Messages written to the file.
+		unsigned long long dropped;  //!< Messages lost because the ring was full.
+		unsigned long long bytes;    //!< Size of the file written so far.
+	};
+
+public:
+	/*!
+	 * \brief Constructor
+	 * \param [in] options time division, tempo and buffering.
+	 * \param [in] clock time source, messages without timestamp are stamped with it.
+	 */
+	explicit MidiFileRecorder(const Options& options = Options(), std::shared_ptr<MidiClock> clock = MidiClock::system());
+
+	//! Destructor closes the file
+	~MidiFileRecorder();
+
+	MidiFileRecorder(const MidiFileRecorder&) = delete;
+	MidiFileRecorder& operator=(const MidiFileRecorder&) = delete;
+
+	/*!
+	 * \brief Records the message, can be called from any thread, doesn't block
+	 * \param [in] message the message, the current time of the clock is used if it doesn't have a timestamp.
+	 *
+	 * Messages outside of open() and close() are ignored.
+	 */
+	void record(const MidiMessage& message);
+
+	//! Returns handler which calls record(), for MidiInPort::setMessageHandler(), the recorder must outlive the port handler
+	MidiInPort::MessageHandler handler();
+
+	/*!
+	 * \brief Creates the file and starts recording, the current time of the clock is tick 0
+	 * \param [in] path path to the file, an existing file is overwritten.
+	 * \return `false` if the file can't be created or the recorder is already recording
+	 */
+	bool open(const std::string& path);
+
+	/*!
+	 * \brief Stops recording, writes the rest of the messages and completes the file
+	 * \return `false` if writing failed at some point
+	 */
+	bool close();
+
+	//! Returns `true` between open() and close()
+	bool isRecording() const;
+
+	//! Returns counters of the current or the last recording
+	Counters counters() const;
+
+private:
+	class Implementation;
+	std::unique_ptr<Implementation> _impl;
+};
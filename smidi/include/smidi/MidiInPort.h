@@ -5,19 +5,115 @@
  */
 
 #include "MidiPort.h"
+#include "MidiMessage.h"
+#include "MidiMessageDispatcher.h"
+#include "MidiMessageWaiter.h"
+#include <cstddef>
 
 /*!
  * \brief The MidiInPort class is the interface for the MIDI input ports
  * \class MidiInPort MidiInPort.h <smidi/MidiInPort.h>
  * \sa MidiOutPort
+ *
+ * Incoming messages are delivered to the handlers set with setMessageHandler(). By default handlers are invoked
+ * on the port's own MIDI input thread. Applications with their own event loop can switch the port to
+ * DispatchMode::CallerThread, wait for pollDescriptor() to become readable (poll/epoll/select) and call
+ * processPending() - then handlers are invoked on the caller's thread and no input thread is running at all.
+ * The message reference passed to the handler is only valid during the handler call.
+ *
+ * Single messages can also be awaited from a coroutine with receive() - a message that completes a waiter
+ * is not passed to the handlers.
  */
 
 class MidiInPort : public MidiPort
 {
+public:
+	//! Type of the incoming message handler
+	using MessageHandler = MidiMessageDispatcher::Handler;
+
+	/*!
+	 * \enum DispatchMode
+	 * Defines the thread incoming messages are decoded and dispatched on.
+	 */
+	enum class DispatchMode
+	{
+		InputThread,  //!< Port runs its own input thread (default).
+		CallerThread  //!< No input thread, application calls processPending() when pollDescriptor() is readable.
+	};
+
 public:
 	//! Trivial constructor
 	explicit MidiInPort() = default;
 
 	//! Trivial destructor
 	virtual ~MidiInPort() = default;
+
+	/*!
+	 * \brief Sets the handler for all incoming messages that have no type specific handler
+	 * \param [in] handler message handler, pass `nullptr` to remove it.
+	 */
+	virtual void setMessageHandler(MessageHandler handler) = 0;
+
+	/*!
+	 * \brief Sets the handler for incoming messages of the specified type
+	 * \param [in] type type of the messages to handle, e.g. MidiMessage::NoteOn (for all channels) or MidiMessage::MidiClock.
+	 * \param [in] handler message handler, pass `nullptr` to remove it.
+	 */
+	virtual void setMessageHandler(MidiMessage::Type type, MessageHandler handler) = 0;
+
+	//! Removes all message handlers
+	virtual void resetMessageHandlers() = 0;
+
+	/*!
+	 * \brief Changes the thread incoming messages are dispatched on
+	 * \param [in] mode new dispatch mode. Switching to DispatchMode::CallerThread stops the input thread.
+	 */
+	virtual void setDispatchMode(DispatchMode mode) = 0;
+
+	//! Returns current dispatch mode
+	virtual DispatchMode dispatchMode() const = 0;
+
+	/*!
+	 * \brief Returns file descriptor which becomes readable (POLLIN) when there are incoming events
+	 * \return file descriptor or -1 if the port is not open. The descriptor is owned by the port and must not be closed.
+	 */
+	virtual int pollDescriptor() const = 0;
+
+	/*!
+	 * \brief Decodes and dispatches all pending incoming events on the calling thread
+	 * \return number of messages passed to the handlers
+	 *
+	 * Never blocks. Does nothing (and returns 0) in DispatchMode::InputThread mode.
+	 * Waiters whose deadline has passed are completed by this call as well.
+	 */
+	virtual std::size_t processPending() = 0;
+
+	/*!
+	 * \brief Registers one-shot waiter for the incoming message
+	 * \param [in] waiter waiter to register, must stay alive until it's completed or removed.
+	 *
+	 * The first incoming message accepted by the waiter's filter completes it instead of being dispatched
+	 * to the handlers. Waiters are checked in the order they were added.
+	 */
+	virtual void addWaiter(MidiMessageWaiter& waiter) = 0;
+
+	/*!
+	 * \brief Removes the waiter which is not completed yet
+	 * \return `true` if the waiter was removed, `false` if it isn't registered (e.g. already completed)
+	 *
+	 * If the waiter is being completed on another thread the call blocks until its completion returns,
+	 * so the waiter can be destroyed right after it.
+	 */
+	virtual bool removeWaiter(MidiMessageWaiter& waiter) = 0;
+
+	//! Returns awaitable for the next incoming message
+	MidiReceiveAwaitable receive();
+
+	/*!
+	 * \brief Returns awaitable for the next incoming message accepted by the filter
+	 * \param [in] filter message filter, e.g. to wait for SysEx reply from particular device. It's called on the
+	 *             decoding thread with the waiters locked, so it must not call back into the port.
+	 * \param [in] timeout maximum time to wait. Awaitable returns empty message on timeout.
+	 */
+	MidiReceiveAwaitable receive(MidiMessageWaiter::Filter filter, MidiMessageWaiter::Clock::duration timeout);
 };
@@ -0,0 +1,120 @@
+#pragma once
+
+/*!
+ * \file MidiLog.h
+ * Contains MidiLog - asynchronous diagnostics output of the library.
+ */
+
+#include "MidiDelegate.h"
+#include <atomic>
+#include <chrono>
+
+/*!
+ * \brief The MidiLog class is the diagnostics output of the library.
+ * \class MidiLog MidiLog.h <smidi/MidiLog.h>
+ *
+ * Library diagnostics are produced on the MIDI input threads, on the send path and on the real-time sync thread,
+ * so writing them must never block. Records are formatted into a preallocated lock-free ring buffer right on
+ * the emitting thread (no heap allocation, no locks, no system calls) and passed to the sink by a background
+ * thread, which is started on the first use of the log and drains the ring every 10 ms. The emitting thread never
+ * wakes it up, so a record reaches the sink up to 10 ms later; flush() passes the pending records at once.
+ * When the ring is full records are dropped and counted, see droppedRecords().
+ *
+ * By default records are written to `std::cerr`. Applications can install their own sink with setSink(), it's
+ * always called on the background logging thread, without any lock of the log held.
+ *
+ * Every place that writes a record is rate limited separately (see setRateLimit()), so an error repeated for every
+ * MIDI event doesn't flood the output. Number of suppressed records is reported with the next record from the same place.
+ */
+class MidiLog
+{
+public:
+	/*!
+	 * \enum Level
+	 * Severity of the record
+	 */
+	enum class Level
+	{
+		Debug,   //!< Verbose information, e.g. port subscription changes
+		Info,    //!< Normal operation messages
+		Warning, //!< Recoverable problems
+		Error    //!< Operation failed
+	};
+
+	//! Sink type, receives level and zero-terminated record text
+	using Sink = MidiDelegate<void(Level level, const char* text)>;
+
+	//! Maximal length of the record text, longer records are truncated
+	constexpr static std::size_t kMaxRecordLength = 256;
+
+	/*!
+	 * \brief The RateLimit class keeps rate limiting state of a single place that writes records.
+	 * \class MidiLog::RateLimit MidiLog.h <smidi/MidiLog.h>
+	 */
+	class RateLimit
+	{
+	public:
+		//! Constructor, constant-initialized, so a static rate limit costs nothing on the first use
+		constexpr RateLimit()
+			: _intervalStart(0)
+			, _recordsInInterval(0)
+			, _suppressed(0)
+		{
+		}
+
+		/*!
+		 * \brief Checks whether the next record is allowed
+		 * \param [out] suppressed number of records suppressed since the last allowed one.
+		 * \return `true` if the record should be written
+		 */
+		bool allow(unsigned int& suppressed);
+
+	private:
+		std::atomic<unsigned long long> _intervalStart;
+		std::atomic<unsigned int>       _recordsInInterval;
+		std::atomic<unsigned int>       _suppressed;
+	};
+
+public:
+	MidiLog() = delete;
+
+	/*!
+	 * \brief Sets the sink records are passed to
+	 * \param [in] sink new sink, pass `nullptr` to restore the default `std::cerr` sink.
+	 */
+	static void setSink(Sink sink);
+
+	//! Sets minimal level of the records to write. Default is Level::Info.
+	static void setLevel(Level level);
+
+	//! Returns minimal level of the records to write
+	static Level level();
+
+	/*!
+	 * \brief Sets rate limit applied to every place that writes records
+	 * \param [in] recordsPerInterval maximal number of records per interval, 0 disables rate limiting.
+	 * \param [in] interval rate limiting interval.
+	 *
+	 * Default is 10 records per second.
+	 */
+	static void setRateLimit(unsigned int recordsPerInterval, std::chrono::milliseconds interval);
+
+	/*!
+	 * \brief Writes the record, printf-like
+	 *
+	 * Doesn't allocate and doesn't block, so it's safe to call from real-time threads.
+	 */
+	static void write(Level level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+	//! Rate limited version of write(), used by SMIDI_LOG macros
+	static void write(Level level, RateLimit& rateLimit, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+	//! Blocks until all records written so far are passed to the sink, does nothing when called by the sink
+	static void flush();
+
+	//! Returns number of records dropped because the ring buffer was full
+	static unsigned long long droppedRecords();
+
+	//! Returns text representation of the level
+	static const char* levelName(Level level);
+};
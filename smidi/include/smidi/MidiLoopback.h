@@ -0,0 +1,96 @@
+#pragma once
+
+/*!
+ * \file MidiLoopback.h
+ * Contains MidiLoopback - in-process pair of connected MIDI ports.
+ */
+
+#include "MidiClock.h"
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+class MidiDevice;
+class MidiInPort;
+class MidiOutPort;
+
+/*!
+ * \brief The MidiLoopback class is a pair of MIDI ports connected to each other without any driver
+ * \class MidiLoopback MidiLoopback.h <smidi/MidiLoopback.h>
+ * \sa MidiDeviceEnumerator::Backend::Loopback
+ *
+ * Everything sent to outputPort() is received by inputPort() of the same loopback. Messages go through
+ * a preallocated lock-free ring, so any number of threads can send while the input port dispatches, and
+ * nothing is allocated after the ring has been filled once. The ports behave like the driver backed ones:
+ * both dispatch modes, waiters, metrics and MidiSync (generated by a software clock) are supported. That makes
+ * the loopback the backend for tests and benchmarks on machines without sound hardware or ALSA sequencer.
+ *
+ * Time is taken from the MidiClock: with MidiSimulatedClock latency, jitter and MIDI Clock timing are exactly
+ * reproducible. Received messages are timestamped with their delivery time, i.e. send time plus latency plus
+ * jitter. Jitter never reorders messages: a message that is due earlier than its predecessor waits for it, as
+ * it would on a cable.
+ *
+ * ~~~cpp
+ * MidiLoopback::Options options;
+ * options.latency = std::chrono::microseconds(500);
+ * MidiLoopback loopback("Loopback", MidiClock::system(), options);
+ * loopback.inputPort()->setMessageHandler([](const MidiMessage& message) { ... });
+ * loopback.outputPort()->sendMessage({MidiMessage::NoteOn, 60, 100});
+ * ~~~
+ */
+class MidiLoopback
+{
+public:
+	/*!
+	 * \brief The Options struct describes the simulated connection
+	 */
+	struct Options
+	{
+		std::chrono::nanoseconds latency;  //!< Constant delay between sending and delivery.
+		std::chrono::nanoseconds jitter;   //!< Maximal random delay added to the latency, uniformly distributed.
+		unsigned long long       seed;     //!< Seed of the jitter, equal seeds give equal delays to the same message sequence.
+		std::size_t              capacity; //!< Number of messages in flight, messages sent to the full ring are lost (counted as overruns).
+
+		//! Default options: no latency, no jitter, 4096 messages
+		Options();
+	};
+
+public:
+	/*!
+	 * \brief Constructor
+	 * \param [in] name name of the device and its ports.
+	 * \param [in] clock time source, e.g. MidiSimulatedClock for deterministic tests.
+	 */
+	explicit MidiLoopback(const std::string& name, std::shared_ptr<MidiClock> clock = MidiClock::system());
+
+	/*!
+	 * \brief Constructor
+	 * \param [in] name name of the device and its ports.
+	 * \param [in] clock time source, e.g. MidiSimulatedClock for deterministic tests.
+	 * \param [in] options latency, jitter and capacity of the connection.
+	 */
+	MidiLoopback(const std::string& name, std::shared_ptr<MidiClock> clock, const Options& options);
+
+	//! Destructor, the ports stay usable as long as somebody holds them
+	~MidiLoopback();
+
+	//! Returns the name set in the constructor
+	const std::string& name() const;
+
+	//! Returns the device with one input and one output port, e.g. to pass it where MidiDevice is expected
+	std::shared_ptr<MidiDevice> device() const;
+
+	//! Returns the port receiving everything sent to outputPort()
+	std::shared_ptr<MidiInPort> inputPort() const;
+
+	//! Returns the port sending to inputPort()
+	std::shared_ptr<MidiOutPort> outputPort() const;
+
+	//! Returns the clock set in the constructor
+	std::shared_ptr<MidiClock> clock() const;
+
+private:
+	std::shared_ptr<MidiClock>  _clock;
+	std::shared_ptr<MidiDevice> _device;
+};
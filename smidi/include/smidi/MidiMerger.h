@@ -0,0 +1,135 @@
+#pragma once
+
+/*!
+ * \file MidiMerger.h
+ * Contains MidiMerger - merge of several input ports into one timestamp ordered stream.
+ */
+
+#include "MidiClock.h"
+#include "MidiDelegate.h"
+#include "MidiInPort.h"
+#include <chrono>
+#include <memory>
+
+/*!
+ * \brief The MidiMerger class merges messages of several MidiInPort objects into one stream ordered by timestamp
+ * \class MidiMerger MidiMerger.h <smidi/MidiMerger.h>
+ *
+ * Every input port hands its messages to its own single producer ring, so input threads never wait for each
+ * other or for the merging thread. The merging thread takes the oldest message of all rings (k-way merge on a
+ * heap of the ring heads) as soon as it is older than the reorder window: a message delivered by another port up
+ * to `reorderWindow` later is still put in front of it. Messages arriving later than that are counted as late
+ * and get the timestamp of the last merged message, so the stream never goes back in time.
+ *
+ * Merged messages go to the handler. Without a handler they are kept in the output ring, which the consumer
+ * empties with pop() when pollDescriptor() becomes readable.
+ *
+ * The merger doesn't touch message handlers of the ports, feed every input from its port: with handler() alone,
+ * or by calling push() from a handler that does other work too. Timestamps and the clock must be in the same time
+ * base: MidiClock::system() for device and virtual ports, the clock of the loopback for MidiLoopback ports.
+ *
+ * ~~~cpp
+ * MidiMerger merger(2);
+ * merger.setHandler([&recorder](std::size_t input, const MidiMessage& message) { recorder.record(message); });
+ * keyboard->inputPorts().front()->setMessageHandler(merger.handler(0));
+ * pads->inputPorts().front()->setMessageHandler(merger.handler(1));
+ * ~~~
+ */
+class MidiMerger
+{
+public:
+	//! Type of the handler of merged messages, `input` is the index of the input the message was pushed to
+	using Handler = MidiDelegate<void(std::size_t input, const MidiMessage& message)>;
+
+	/*!
+	 * \brief The Options struct describes buffering and threading of the merger
+	 */
+	struct Options
+	{
+		std::chrono::nanoseconds  reorderWindow;  //!< How long a message waits for older messages of other ports.
+		std::size_t               inputCapacity;  //!< Capacity of every input ring in messages.
+		std::size_t               outputCapacity; //!< Capacity of the output ring in messages.
+		MidiInPort::DispatchMode  dispatchMode;   //!< Merge on the own thread or in processPending().
+
+		//! Default options: 2 ms window, 1024 messages per input, 4096 messages of output, own thread
+		Options();
+	};
+
+	/*!
+	 * \brief The Counters struct contains message counters of the merger
+	 */
+	struct Counters
+	{
+		unsigned long long merged;        //!< Messages passed to the handler or the output ring.
+		unsigned long long late;          //!< Messages older than an already merged message.
+		unsigned long long inputDropped;  //!< Messages lost because an input ring was full.
+		unsigned long long outputDropped; //!< Messages lost because the output ring was full.
+	};
+
+public:
+	/*!
+	 * \brief Constructor
+	 * \param [in] inputs number of inputs to merge, each gets its ring.
+	 * \param [in] options reorder window, ring sizes and threading.
+	 * \param [in] clock time source the reorder window is measured with.
+	 */
+	explicit MidiMerger(std::size_t inputs, const Options& options = Options(), std::shared_ptr<MidiClock> clock = MidiClock::system());
+
+	//! Destructor stops merging, handlers returned by handler() drop the messages afterwards
+	~MidiMerger();
+
+	MidiMerger(const MidiMerger&) = delete;
+	MidiMerger& operator=(const MidiMerger&) = delete;
+
+	//! Returns number of inputs
+	std::size_t inputCount() const;
+
+	/*!
+	 * \brief Hands the message of the input over to the merge, doesn't block
+	 *
+	 * Like the port handlers it must not be called for the same input from several threads at once.
+	 * \param [in] input index of the input, messages of unknown inputs are ignored.
+	 * \param [in] message the message.
+	 */
+	void push(std::size_t input, const MidiMessage& message);
+
+	//! Returns handler which calls push() with the input index, for MidiInPort::setMessageHandler()
+	MidiInPort::MessageHandler handler(std::size_t input);
+
+	//! Sets the handler of merged messages, can be called from any thread. Empty handler enables the output ring.
+	void setHandler(Handler handler);
+
+	/*!
+	 * \brief Takes the next message from the output ring, consumer thread only
+	 * \param [out] message merged message.
+	 * \param [out] input index of the port the message came from, may be `nullptr`.
+	 * \return `false` if the ring is empty
+	 */
+	bool pop(MidiMessage& message, std::size_t* input = nullptr);
+
+	//! Returns descriptor which is readable while the output ring is not empty
+	int pollDescriptor() const;
+
+	/*!
+	 * \brief Merges messages that are older than the reorder window
+	 *
+	 * Only for MidiInPort::DispatchMode::CallerThread, the merging thread does it otherwise.
+	 * \return number of merged messages
+	 */
+	std::size_t processPending();
+
+	/*!
+	 * \brief Merges all received messages without waiting for the reorder window, e.g. when recording stops
+	 *
+	 * Only for MidiInPort::DispatchMode::CallerThread.
+	 * \return number of merged messages
+	 */
+	std::size_t flush();
+
+	//! Returns message counters
+	Counters counters() const;
+
+private:
+	class Implementation;
+	std::unique_ptr<Implementation> _impl;
+};
@@ -58,6 +58,12 @@ public:
 	//! Move ctor is defaulted since members also have trivial move ctors
 	MidiMessage(MidiMessage&&) = default;
 
+	//! Copy assignment is defaulted, it reuses already allocated buffer when it's big enough
+	MidiMessage& operator=(const MidiMessage&) = default;
+
+	//! Move assignment is defaulted since members also have trivial move assignment
+	MidiMessage& operator=(MidiMessage&&) = default;
+
 	/*!
 	 * \brief This constructor that accepts `std::vector` with message bytes
 	 * \param [in] newData vector with message data. Contents will be copied into internal buffer.
@@ -93,6 +99,9 @@ public:
 	* \brief Returns `true` if the message is of spceified type.
 	* \param [in] message type to check this message against.
 	* \sa MidiMessage::Type
+	*
+	* Channel is ignored for channel messages, System messages compare the whole status byte. MidiMessage::System is
+	* the same value as MidiMessage::SysEx, so it matches SysEx only.
 	*/
 	bool isActually(MidiMessage::Type type) const;
 
@@ -102,12 +111,17 @@ public:
 	//! Returns channel number for non-system messages. For System messages will return 0.
 	unsigned char channel() const;
 
-	//! Returns MIDI message timestamp (OS dependent)
+	/*!
+	* \brief Returns MIDI message timestamp
+	*
+	* Incoming messages are stamped with the monotonic time of their arrival in nanoseconds.
+	* \sa MidiTimestamp
+	*/
 	unsigned long long timestamp() const;
 
 	/*!
 	* \brief Sets new message timestamp
-	* \param [in] newTimestamp timestamp of the message. OS dependent value.
+	* \param [in] newTimestamp timestamp of the message, monotonic time in nanoseconds (see MidiTimestamp).
 	*/
 	void setTimestamp(unsigned long long newTimestamp);
 
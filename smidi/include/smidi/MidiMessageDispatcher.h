@@ -0,0 +1,76 @@
+#pragma once
+
+/*!
+ * \file MidiMessageDispatcher.h
+ * Contains MidiMessageDispatcher - per-message-type handler table.
+ */
+
+#include "MidiMessage.h"
+#include "MidiDelegate.h"
+#include <atomic>
+
+/*!
+ * \brief The MidiMessageDispatcher class routes MIDI messages to handlers registered per message type.
+ * \class MidiMessageDispatcher MidiMessageDispatcher.h <smidi/MidiMessageDispatcher.h>
+ *
+ * Handler lookup is done through a jump table indexed by the status byte, so the caller never has to branch
+ * on the message type itself. Channel messages are grouped by their type regardless of the channel,
+ * every System message type has its own slot. Messages without specific handler go to the default handler.
+ *
+ * Handlers can be (re)set from any thread while messages are being dispatched. Handler is always invoked
+ * outside of the internal lock, so it's allowed to change handlers from the handler itself.
+ */
+class MidiMessageDispatcher
+{
+public:
+	//! Type of the message handler
+	using Handler = MidiDelegate<void(const MidiMessage&)>;
+
+public:
+	//! Constructor
+	explicit MidiMessageDispatcher();
+
+	//! Trivial destructor
+	~MidiMessageDispatcher() = default;
+
+	MidiMessageDispatcher(const MidiMessageDispatcher&) = delete;
+	MidiMessageDispatcher& operator=(const MidiMessageDispatcher&) = delete;
+
+	/*!
+	 * \brief Sets the default handler which receives all messages that have no type specific handler
+	 * \param [in] handler message handler, pass `nullptr` to remove it.
+	 */
+	void setHandler(Handler handler);
+
+	/*!
+	 * \brief Sets the handler for the specified message type
+	 * \param [in] type type of the messages to handle. For channel messages channel nibble is ignored.
+	 * \param [in] handler message handler, pass `nullptr` to remove it.
+	 */
+	void setHandler(MidiMessage::Type type, Handler handler);
+
+	//! Removes all handlers including the default one
+	void resetHandlers();
+
+	/*!
+	 * \brief Passes the message to the corresponding handler
+	 * \param [in] message message to dispatch.
+	 * \return `true` if some handler received the message
+	 */
+	bool dispatch(const MidiMessage& message) const;
+
+private:
+	//! Number of channel message types (0x80..0xE0) plus all system status bytes (0xF0..0xFF)
+	constexpr static unsigned int kTypeSlots = 7 + 16;
+
+	//! Default handler slot
+	constexpr static unsigned int kDefaultSlot = kTypeSlots;
+
+	static unsigned int slotForStatus(unsigned char status);
+
+	Handler handlerForSlot(unsigned int slot) const;
+
+private:
+	Handler                   _handlers[kTypeSlots + 1];
+	mutable std::atomic_flag  _lock;
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+/*!
+ * \file MidiMessageWaiter.h
+ * Contains MidiMessageWaiter and MidiReceiveAwaitable used to wait for a single incoming message.
+ */
+
+#include "MidiMessage.h"
+#include "MidiDelegate.h"
+#include <chrono>
+
+class MidiInPort;
+
+/*!
+ * \brief The MidiMessageWaiter struct describes a one-shot request for an incoming message.
+ * \class MidiMessageWaiter MidiMessageWaiter.h <smidi/MidiMessageWaiter.h>
+ * \sa MidiInPort::addWaiter()
+ *
+ * The waiter is an intrusive list node - the port doesn't allocate anything to keep it, so the waiter object
+ * must stay alive until it's completed or removed. Completion is invoked on the thread that decodes incoming
+ * messages (input thread or processPending() caller) right from the decoding loop. Removing a waiter whose
+ * completion is in flight on another thread waits until the completion returns.
+ */
+struct MidiMessageWaiter
+{
+	//! Filter type, returns `true` if the message should complete the waiter
+	using Filter = MidiDelegate<bool(const MidiMessage&)>;
+
+	//! Completion callback type
+	using Completion = MidiDelegate<void()>;
+
+	//! Clock used for the deadlines
+	using Clock = std::chrono::steady_clock;
+
+	Filter            filter;      //!< Accepts any message if empty. Called with the port's waiter list locked, must not call into the port.
+	Clock::time_point deadline;    //!< Waiter is completed with empty message at this time. Clock::time_point::max() means no timeout.
+	Completion        completion;  //!< Called once when message is received, deadline has passed or the port is closed.
+	MidiMessage       message;     //!< Received message, stays empty on timeout.
+	bool              completed;   //!< Set before completion is invoked.
+	MidiMessageWaiter* next;       //!< Used by the port, don't touch.
+
+	//! Creates waiter without timeout that accepts any message
+	MidiMessageWaiter()
+	    : deadline(Clock::time_point::max())
+	    , completed(false)
+	    , next(nullptr)
+	{
+	}
+};
+
+/*!
+ * \brief The MidiReceiveAwaitable class allows to `co_await` incoming MIDI messages.
+ * \class MidiReceiveAwaitable MidiMessageWaiter.h <smidi/MidiMessageWaiter.h>
+ * \sa MidiInPort::receive()
+ *
+ * Implements the awaiter protocol, so it can be used from any C++20 coroutine while the library itself
+ * doesn't depend on the coroutine support. Suspended coroutine is resumed directly from the message decoding
+ * loop of the port, so it runs on the input thread (or on the processPending() caller thread).
+ *
+ * ~~~cpp
+ * MidiMessage reply = co_await port.receive(isMyReply, std::chrono::milliseconds(500));
+ * if (reply.isEmpty()) { // timeout }
+ * ~~~
+ */
+class MidiReceiveAwaitable
+{
+public:
+	/*!
+	 * \brief Constructor
+	 * \param [in] port port to receive the message from.
+	 * \param [in] filter message filter, empty filter accepts any message.
+	 * \param [in] deadline time to give up waiting.
+	 */
+	MidiReceiveAwaitable(MidiInPort& port, MidiMessageWaiter::Filter filter, MidiMessageWaiter::Clock::time_point deadline);
+
+	//! Moving is only allowed before the awaitable is awaited.
+	MidiReceiveAwaitable(MidiReceiveAwaitable&& other);
+
+	//! Removes the waiter from the port if the coroutine is destroyed while suspended
+	~MidiReceiveAwaitable();
+
+	MidiReceiveAwaitable(const MidiReceiveAwaitable&) = delete;
+	MidiReceiveAwaitable& operator=(const MidiReceiveAwaitable&) = delete;
+
+	//! Awaiter protocol: always suspends
+	bool await_ready() const noexcept
+	{
+		return false;
+	}
+
+	//! Awaiter protocol: registers the waiter in the port
+	template <typename CoroutineHandle>
+	void await_suspend(CoroutineHandle handle)
+	{
+		_waiter.completion = MidiMessageWaiter::Completion(&resumeCoroutine<CoroutineHandle>, handle.address());
+		_isRegistered = true;
+		// the coroutine may be resumed on the input thread before this call returns, so nothing is touched after it
+		registerWaiter();
+	}
+
+	//! Awaiter protocol: returns received message or empty message on timeout
+	MidiMessage await_resume();
+
+private:
+	template <typename CoroutineHandle>
+	static void resumeCoroutine(void* address)
+	{
+		CoroutineHandle::from_address(address).resume();
+	}
+
+	void registerWaiter();
+
+private:
+	MidiInPort&       _port;
+	MidiMessageWaiter _waiter;
+	bool              _isRegistered;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+/*!
+ * \file MidiMetrics.h
+ * Contains runtime metrics snapshots of MIDI ports and MIDI sync.
+ */
+
+#include "MidiMessage.h"
+#include <cstddef>
+
+/*!
+ * \brief The MidiPortMetrics struct is a snapshot of MIDI port counters.
+ * \class MidiPortMetrics MidiMetrics.h <smidi/MidiMetrics.h>
+ * \sa MidiPort::metrics()
+ *
+ * Counters are updated by the port with relaxed atomic operations, so taking the snapshot never blocks the MIDI
+ * threads. Every counter is read atomically, but the snapshot as a whole is not (counters updated while the snapshot
+ * is taken may be a message ahead of each other).
+ */
+struct MidiPortMetrics
+{
+	//! Number of message types: 7 channel message types plus every System status byte (0xF0..0xFF)
+	constexpr static std::size_t kMessageTypes = 7 + 16;
+
+	//! Number of latency histogram buckets
+	constexpr static std::size_t kLatencyBuckets = 32;
+
+	unsigned long long messages[kMessageTypes];                  //!< Number of messages per type, see typeIndex().
+	unsigned long long bytes[kMessageTypes];                     //!< Number of bytes per type, see typeIndex().
+	unsigned long long decodeFailures;                           //!< Incoming events which couldn't be decoded, bytes for raw MIDI.
+	unsigned long long encodeFailures;                           //!< Outgoing messages which couldn't be encoded.
+	unsigned long long sendFailures;                             //!< Outgoing messages rejected by the driver.
+	unsigned long long overruns;                                 //!< Driver buffer overruns (`-ENOSPC`), i.e. messages lost.
+	unsigned long long coalesced;                                //!< Output port only: controller values replaced by a newer one before they were sent.
+	unsigned long long latencyHistogram[kLatencyBuckets];        //!< Input port only: time from arrival to handler call, see latencyBucketUpperBound(). Empty for raw MIDI.
+
+	//! Returns index of the message type in messages and bytes arrays, or kMessageTypes for data bytes.
+	static std::size_t typeIndex(unsigned char status)
+	{
+		return (status < MidiMessage::NoteOff) ? kMessageTypes : ((status < MidiMessage::System) ? ((status >> 4) - 8) : (7 + (status & 0x0F)));
+	}
+
+	//! Returns exclusive upper bound of the latency bucket in nanoseconds. Bucket 0 is below 1 microsecond, each next one doubles.
+	static unsigned long long latencyBucketUpperBound(std::size_t bucket)
+	{
+		return 1000ULL << bucket;
+	}
+
+	//! Returns number of messages of the specified type
+	unsigned long long messagesOfType(MidiMessage::Type type) const
+	{
+		return messages[typeIndex(type)];
+	}
+
+	//! Returns number of bytes of the messages of the specified type
+	unsigned long long bytesOfType(MidiMessage::Type type) const
+	{
+		return bytes[typeIndex(type)];
+	}
+
+	//! Returns total number of messages
+	unsigned long long totalMessages() const
+	{
+		unsigned long long result = 0;
+		for (unsigned long long count : messages)
+		{
+			result += count;
+		}
+		return result;
+	}
+
+	/*!
+	 * \brief Returns latency percentile estimated from the histogram
+	 * \param [in] percentile value from 0.0 to 1.0, e.g. 0.99.
+	 * \return upper bound of the bucket containing the percentile (nanoseconds) or 0 if there is no data
+	 */
+	unsigned long long latencyPercentile(double percentile) const
+	{
+		unsigned long long total = 0;
+		for (unsigned long long count : latencyHistogram)
+		{
+			total += count;
+		}
+		unsigned long long result = 0;
+		if (total > 0)
+		{
+			const unsigned long long rank = static_cast<unsigned long long>(percentile * (total - 1));
+			unsigned long long accumulated = 0;
+			for (std::size_t bucket = 0; bucket < kLatencyBuckets; ++bucket)
+			{
+				accumulated += latencyHistogram[bucket];
+				if (accumulated > rank)
+				{
+					result = latencyBucketUpperBound(bucket);
+					break;
+				}
+			}
+		}
+		return result;
+	}
+};
+
+/*!
+ * \brief The MidiSyncMetrics struct is a snapshot of MIDI Clock generator counters.
+ * \class MidiSyncMetrics MidiMetrics.h <smidi/MidiMetrics.h>
+ * \sa MidiSync::metrics()
+ *
+ * MIDI Clocks are sent in batches of one beat (24 clocks). Period error is the difference between the time
+ * the batch was planned to be sent and the time it actually was sent, i.e. the jitter of the clock generator.
+ * The generator compensates accumulated lateness by temporarily raising the tempo - that's the phase correction.
+ */
+struct MidiSyncMetrics
+{
+	//! Number of jitter histogram buckets
+	constexpr static std::size_t kJitterBuckets = 32;
+
+	unsigned long long periods;                                  //!< Number of clock batches (beats) sent.
+	long long          lastPeriodError;                          //!< Lateness of the last batch in nanoseconds.
+	long long          maxPeriodError;                           //!< Maximal lateness in nanoseconds.
+	unsigned long long jitterHistogram[kJitterBuckets];          //!< Histogram of lateness, buckets as in MidiPortMetrics::latencyBucketUpperBound().
+	unsigned long long phaseCorrections;                         //!< Number of applied phase corrections.
+	long long          lastPhaseCorrection;                      //!< Last phase correction in nanoseconds.
+	long long          totalPhaseCorrection;                     //!< Sum of all phase corrections in nanoseconds.
+};
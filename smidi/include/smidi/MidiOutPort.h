@@ -8,6 +8,8 @@
 #include "MidiPort.h"
 #include "MidiMessage.h"
 #include "MidiSync.h"
+#include <chrono>
+#include <cstddef>
 
 /*!
  * \brief The MidiOutPort class is the interface for MIDI output ports.
@@ -17,6 +19,23 @@
 
 class MidiOutPort : public MidiPort
 {
+public:
+	/*!
+	 * \brief The Coalescing struct describes coalescing of continuous controllers, see setCoalescing()
+	 */
+	struct Coalescing
+	{
+		std::chrono::nanoseconds interval;       //!< Shortest time between two values of the same controller, 0 disables coalescing.
+		unsigned int             bytesPerSecond; //!< Estimated speed of the wire the values are paced to, 0 doesn't pace.
+
+		//! Default: disabled, paced to a 31.25 kbaud MIDI cable (3125 bytes per second) when enabled
+		Coalescing()
+			: interval(0)
+			, bytesPerSecond(3125)
+		{
+		}
+	};
+
 public:
 	explicit MidiOutPort() = default;
 	virtual ~MidiOutPort() = default;
@@ -27,6 +46,84 @@ public:
 	 */
 	virtual void sendMessage(const MidiMessage& message) = 0;
 
+	/*!
+	 * \brief Sends several MIDI messages in a row
+	 * \param [in] messages pointer to the first message.
+	 * \param [in] count number of messages.
+	 *
+	 * Messages are handed to the driver with a single flush (one system call for as many messages
+	 * as the output buffer holds), which is much cheaper than `count` sendMessage() calls.
+	 */
+	virtual void sendMessages(const MidiMessage* messages, std::size_t count) = 0;
+
+	/*!
+	 * \brief Hands MIDI messages over to be delivered at their timestamps
+	 * \param [in] messages pointer to the first message, timestamps are MidiTimestamp::now() based times of delivery.
+	 * \param [in] count number of messages, 0 only checks if the port can schedule.
+	 * \return `false` if the port can't schedule messages, nothing is sent then
+	 *
+	 * Sequencer ports put the messages on a kernel queue of their own, so they are delivered on time whatever
+	 * the sending thread is doing. Messages with timestamps in the past are delivered right away.
+	 * Ports without a queue (raw MIDI, loopback) return `false`, the caller has to time sendMessage() itself.
+	 */
+	virtual bool scheduleMessages(const MidiMessage* messages, std::size_t count) = 0;
+
+	//! Drops messages handed over by scheduleMessages() of this port which are not delivered yet, other ports of the same client keep theirs
+	virtual void cancelScheduledMessages() = 0;
+
+	/*!
+	 * \brief Enables running status on the outgoing byte stream
+	 * \param [in] enabled `true` to omit the status byte of channel messages that repeat the previous status.
+	 *
+	 * Saves up to a third of the bandwidth of a 31.25 kbaud MIDI cable on dense note or controller data.
+	 * Takes effect only for ports that write MIDI bytes themselves (MidiDeviceEnumerator::Backend::RawMidi),
+	 * the sequencer leaves the byte stream to the driver. Disabled by default.
+	 */
+	virtual void setRunningStatusEnabled(bool enabled) = 0;
+
+	//! Returns `true` if running status is enabled
+	virtual bool isRunningStatusEnabled() const = 0;
+
+	/*!
+	 * \brief Enables tracking of the notes the port has turned on
+	 * \param [in] enabled `false` to stop tracking, the notes tracked so far are forgotten.
+	 *
+	 * Every Note On and Note Off that is sent sets or clears a bit of the note, a few bit operations per note
+	 * message. A scheduled Note On sets the bit too, a scheduled Note Off leaves it as the event may yet be
+	 * cancelled. Enabled by default.
+	 */
+	virtual void setNoteTrackingEnabled(bool enabled) = 0;
+
+	//! Returns `true` if the notes are tracked
+	virtual bool isNoteTrackingEnabled() const = 0;
+
+	/*!
+	 * \brief Turns off hanging notes
+	 *
+	 * Sends Note Off of exactly the notes which are on as one sendMessages() batch, or All Notes Off on all
+	 * 16 channels if note tracking is disabled. With tracking enabled the port does it itself when it is closed
+	 * and when MidiSync::stopSync() stops its clock; call it when the input which feeds the port disappears
+	 * in the middle of a performance (MidiDeviceEnumerator::updateDeviceList() no longer lists the device).
+	 */
+	virtual void releaseNotes() = 0;
+
+	/*!
+	 * \brief Enables coalescing of continuous controllers, so a stream of updates can't delay the notes
+	 * \param [in] coalescing time slice and wire speed, the default Coalescing disables it.
+	 *
+	 * Control Change (but data entry, (N)RPN and channel mode controllers), Pitch Bend and Channel Pressure are
+	 * sent at most once per `interval` per channel and controller. Values which come sooner wait, and a newer value
+	 * replaces the waiting one (counted as MidiPortMetrics::coalesced), so the receiver gets the latest value
+	 * after at most one interval. Values also wait while the estimated occupancy of the wire is more than one
+	 * interval ahead. Notes, SysEx and all other messages are never delayed or dropped: the waiting values of
+	 * their channel (of all channels for System messages but real time) are sent right before them, so the
+	 * order of messages of a channel is kept. A port thread sends the values whose time has come.
+	 */
+	virtual void setCoalescing(const Coalescing& coalescing) = 0;
+
+	//! Returns the coalescing settings
+	virtual Coalescing coalescing() const = 0;
+
 	/*!
 	 * \brief Returns reference to the MidiSync which allows to control MIDI sync
 	 * \return reference to the MidiSync object
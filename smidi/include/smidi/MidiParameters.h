@@ -0,0 +1,209 @@
+#pragma once
+
+/*!
+ * \file MidiParameters.h
+ * Contains MidiParameterDecoder and MidiParameterEncoder - 14-bit controllers, RPN and NRPN as single events.
+ */
+
+#include "MidiDelegate.h"
+#include "MidiMessage.h"
+#include <chrono>
+#include <cstddef>
+
+/*!
+ * \brief The MidiParameterEvent struct is a complete high resolution parameter change
+ */
+struct MidiParameterEvent
+{
+	//! Kind of the parameter
+	enum Type
+	{
+		Controller, //!< Controller 0-31 with its LSB controller 32-63.
+		Rpn,        //!< Registered parameter, selected by controllers 101 and 100.
+		Nrpn        //!< Non-registered parameter, selected by controllers 99 and 98.
+	};
+
+	Type               type;      //!< Kind of the parameter.
+	unsigned char      channel;   //!< Channel 0-15.
+	unsigned int       number;    //!< Controller 0-31, or the 14-bit parameter number of (N)RPN.
+	unsigned int       value;     //!< 14-bit value, MSB * 128 + LSB.
+	bool               isFine;    //!< `false` if only the MSB was received and the LSB is taken as 0.
+	unsigned long long timestamp; //!< Timestamp of the message which completed the event.
+};
+
+/*!
+ * \brief The MidiParameterDecoder class assembles 14-bit controllers, RPN and NRPN from Control Change messages
+ * \class MidiParameterDecoder MidiParameters.h <smidi/MidiParameters.h>
+ * \sa MidiParameterEncoder
+ *
+ * A high resolution controller arrives as two messages (MSB, then LSB controller + 32), a (N)RPN as up to four
+ * (parameter number MSB and LSB, data entry MSB and LSB). The decoder keeps the state of every channel in fixed
+ * arrays and calls the handler with one MidiParameterEvent per completed change, so it never allocates.
+ *
+ * As in the MIDI 1.0 specification a received MSB resets the LSB, and an LSB alone changes only the fine part
+ * of the last MSB. The parameter number stays selected until another one is selected or the null RPN (127, 127).
+ * When the LSB follows the MSB depends on the sender, Options::partialUpdate chooses between latency and
+ * doubled events. Data Increment and Decrement are not assembled.
+ *
+ * Feed it from one thread, e.g. the input port handler:
+ *
+ * ~~~cpp
+ * MidiParameterDecoder decoder([](const MidiParameterEvent& event) { ... });
+ * keyboard->setMessageHandler([&decoder, &synth](const MidiMessage& message)
+ * {
+ *     if (!decoder.process(message))
+ *     {
+ *         synth.play(message);
+ *     }
+ * });
+ * ~~~
+ */
+class MidiParameterDecoder
+{
+public:
+	//! Type of the function which receives the events
+	using Handler = MidiDelegate<void(const MidiParameterEvent& event)>;
+
+	//! What is done with an MSB before its LSB arrives
+	enum class PartialUpdate
+	{
+		Immediate, //!< The MSB is an event right away (isFine is `false`) and the LSB is another one.
+		WaitForLsb //!< The MSB waits for the LSB up to Options::timeout, then it is an event on its own.
+	};
+
+	/*!
+	 * \brief The Options struct describes which controllers are paired and how the pairs are waited for
+	 */
+	struct Options
+	{
+		unsigned int             highResolutionControllers; //!< Bit `n` pairs controller `n` (0-31) with `n + 32`.
+		PartialUpdate            partialUpdate;             //!< Handling of the MSB before the LSB.
+		std::chrono::nanoseconds timeout;                   //!< How long the MSB waits for the LSB with PartialUpdate::WaitForLsb.
+
+		//! Default options: controllers 1-31 but the data entry (6) are paired, MSB waits 10 ms for the LSB
+		Options();
+	};
+
+public:
+	/*!
+	 * \brief Constructor
+	 * \param [in] handler called with every event from process() and flush().
+	 * \param [in] options pairing and waiting rules.
+	 */
+	explicit MidiParameterDecoder(Handler handler, const Options& options = Options());
+
+	/*!
+	 * \brief Takes the message
+	 * \param [in] message any message, its timestamp times the waiting for the LSB.
+	 * \return `true` if the message is a part of a high resolution parameter and the handler got (or will get) it
+	 *
+	 * Messages which return `false` (notes, 7-bit controllers, data entry without a selected parameter) are
+	 * for the caller to handle. A waiting MSB becomes an event when another message of its channel arrives or
+	 * a message of any channel is more than Options::timeout later.
+	 */
+	bool process(const MidiMessage& message);
+
+	/*!
+	 * \brief Completes the MSBs which have waited longer than Options::timeout
+	 * \param [in] now current time on the clock of the message timestamps.
+	 *
+	 * Call it periodically when the input may stop right after an MSB.
+	 */
+	void flush(unsigned long long now);
+
+	//! Completes all waiting MSBs
+	void flush();
+
+	//! Forgets the state of all channels, waiting MSBs are dropped
+	void reset();
+
+private:
+	static const unsigned char kNone = 0xFF;
+	static const unsigned char kDataEntry = 32;
+
+	struct Channel
+	{
+		unsigned char      msb[32];
+		unsigned char      lsb[32];
+		unsigned char      rpn[2];        // MSB and LSB of the parameter numbers
+		unsigned char      nrpn[2];
+		unsigned char      dataMsb;
+		unsigned char      dataLsb;
+		unsigned char      pending;       // controller of the MSB waiting for its LSB, kDataEntry or kNone
+		bool               isNrpn;        // which of the parameter numbers was selected last
+		unsigned long long pendingTime;
+	};
+
+	bool processControlChange(unsigned char channel, unsigned char controller, unsigned char value, unsigned long long timestamp);
+	static void selectParameter(Channel& state, unsigned char controller, unsigned char value);
+	static bool hasParameter(const Channel& state);
+	void receiveMsb(unsigned char channel, unsigned char index, unsigned long long timestamp);
+	void clearPending(Channel& state);
+	void completePending(unsigned char channel);
+	void emit(unsigned char channel, unsigned char index, bool isFine, unsigned long long timestamp);
+
+private:
+	Handler      _handler;
+	Options      _options;
+	Channel      _channels[16];
+	unsigned int _pendingCount;
+};
+
+/*!
+ * \brief The MidiParameterEncoder class turns high resolution parameter changes into Control Change messages
+ * \class MidiParameterEncoder MidiParameters.h <smidi/MidiParameters.h>
+ * \sa MidiParameterDecoder
+ *
+ * The encoder remembers what it has sent on every channel, so each change is the shortest sequence the receiver
+ * understands: the parameter number only when another parameter is selected (only its changed byte when the kind
+ * stays), the MSB only when it changes or the parameter was just selected, then the LSB. A change to the value
+ * the receiver already has is no message at all. The encoder must see everything that changes these controllers
+ * on the port, call reset() when the receiver may have lost the state (reconnected, System Reset).
+ *
+ * ~~~cpp
+ * MidiParameterEncoder encoder;
+ * MidiMessage messages[MidiParameterEncoder::kMaxMessages];
+ * const std::size_t count = encoder.encode({MidiParameterEvent::Rpn, 0, 0, 12 * 128, true, 0}, messages);
+ * synth->sendMessages(messages, count);
+ * ~~~
+ */
+class MidiParameterEncoder
+{
+public:
+	//! The longest sequence encode() writes
+	static const std::size_t kMaxMessages = 4;
+
+public:
+	//! Constructor, nothing is known about the receiver
+	MidiParameterEncoder();
+
+	/*!
+	 * \brief Writes the messages of the change
+	 * \param [in] event the change, `isFine` `false` sends only the MSB (the LSB of the value is ignored).
+	 * \param [out] messages at least kMaxMessages messages, their buffers are reused.
+	 * \return number of messages written, 0 if the receiver already has the value
+	 *
+	 * The messages get the timestamp of the event.
+	 */
+	std::size_t encode(const MidiParameterEvent& event, MidiMessage* messages);
+
+	//! Forgets what was sent, the next change of every parameter is sent in full
+	void reset();
+
+private:
+	static const unsigned char kNone = 0xFF;
+
+	struct Channel
+	{
+		unsigned char msb[32];
+		unsigned char lsb[32];
+		unsigned char rpn[2];
+		unsigned char nrpn[2];
+		unsigned char dataMsb;
+		unsigned char dataLsb;
+		unsigned char selected; // kNone, MidiParameterEvent::Rpn or MidiParameterEvent::Nrpn
+	};
+
+private:
+	Channel _channels[16];
+};
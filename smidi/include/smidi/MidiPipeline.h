@@ -0,0 +1,396 @@
+#pragma once
+
+/*!
+ * \file MidiPipeline.h
+ * Contains MidiPipeline - compile time composition of message transform stages, and the stages.
+ */
+
+#include "MidiMessage.h"
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*!
+ * \brief The MidiPipeline class applies transform stages to MIDI message bytes in place
+ * \class MidiPipeline MidiPipeline.h <smidi/MidiPipeline.h>
+ * \sa MidiRouter
+ *
+ * A stage is any copyable callable `bool(unsigned char* bytes, std::size_t size) const` which changes the bytes
+ * in place and returns `false` to drop the message. Stages are template parameters, so the compiler inlines them
+ * into a single function: there are no virtual calls or function pointers between the stages, and the stages
+ * below replace per-value branches with 128-entry lookup tables. Stages never change the message size, so the
+ * pipeline never allocates.
+ *
+ * ~~~cpp
+ * const auto pipeline = makeMidiPipeline(MidiTypeFilter(MidiTypeFilter::Accept, {MidiMessage::NoteOn, MidiMessage::NoteOff}),
+ *                                        MidiChannelMap().map(0, 9),
+ *                                        MidiTranspose(-12),
+ *                                        MidiVelocityCurve(MidiCurve::gamma(0.7)));
+ * ~~~
+ */
+template <typename... Stages>
+class MidiPipeline
+{
+public:
+	//! Constructor
+	explicit MidiPipeline(Stages... stages)
+		: _stages(std::move(stages)...)
+	{
+	}
+
+	/*!
+	 * \brief Runs the message through all stages
+	 * \param [in,out] bytes message bytes, changed in place.
+	 * \param [in] size number of bytes.
+	 * \return `false` if some stage dropped the message (following stages are not run)
+	 */
+	bool operator()(unsigned char* bytes, std::size_t size) const
+	{
+		return apply<0>(bytes, size);
+	}
+
+	//! Runs the message through all stages, see operator()(unsigned char*, std::size_t)
+	bool operator()(MidiMessage& message) const
+	{
+		return !message.isEmpty() && apply<0>(static_cast<unsigned char*>(message), message.data().size());
+	}
+
+private:
+	template <std::size_t Index>
+	typename std::enable_if<(Index < sizeof...(Stages)), bool>::type apply(unsigned char* bytes, std::size_t size) const
+	{
+		return std::get<Index>(_stages)(bytes, size) && apply<Index + 1>(bytes, size);
+	}
+
+	template <std::size_t Index>
+	typename std::enable_if<(Index == sizeof...(Stages)), bool>::type apply(unsigned char*, std::size_t) const
+	{
+		return true;
+	}
+
+private:
+	std::tuple<Stages...> _stages;
+};
+
+//! Creates MidiPipeline of the stages, the type is deduced
+template <typename... Stages>
+MidiPipeline<Stages...> makeMidiPipeline(Stages... stages)
+{
+	return MidiPipeline<Stages...>(std::move(stages)...);
+}
+
+/*!
+ * \brief The MidiCurve class is a 128-entry lookup table of 7-bit values
+ * \class MidiCurve MidiPipeline.h <smidi/MidiPipeline.h>
+ */
+class MidiCurve
+{
+public:
+	//! Identity curve
+	MidiCurve()
+	{
+		for (unsigned int i = 0; i < 128; ++i)
+		{
+			_values[i] = static_cast<unsigned char>(i);
+		}
+	}
+
+	//! Creates the curve from a function `int(int value)`, results are clamped to 0..127
+	template <typename Function>
+	static MidiCurve fromFunction(Function function)
+	{
+		MidiCurve result;
+		for (int i = 0; i < 128; ++i)
+		{
+			const int value = function(i);
+			result._values[i] = static_cast<unsigned char>(value < 0 ? 0 : (value > 127 ? 127 : value));
+		}
+		return result;
+	}
+
+	//! Power curve: exponent below 1 makes soft playing louder, above 1 makes it quieter
+	static MidiCurve gamma(double exponent)
+	{
+		return fromFunction([exponent](int value) { return static_cast<int>(std::lround(127.0 * std::pow(value / 127.0, exponent))); });
+	}
+
+	//! Maps 0..127 linearly onto minimum..maximum
+	static MidiCurve linear(int minimum, int maximum)
+	{
+		return fromFunction([minimum, maximum](int value) { return minimum + ((maximum - minimum) * value + 63) / 127; });
+	}
+
+	//! Maps everything to the value
+	static MidiCurve fixed(int value)
+	{
+		return fromFunction([value](int) { return value; });
+	}
+
+	//! Returns the value the input maps to
+	unsigned char operator[](unsigned char value) const
+	{
+		return _values[value & 0x7F];
+	}
+
+private:
+	unsigned char _values[128];
+};
+
+/*!
+ * \brief The MidiTypeFilter stage passes or drops messages by type
+ * \class MidiTypeFilter MidiPipeline.h <smidi/MidiPipeline.h>
+ *
+ * The decision is one lookup in a table indexed by the status byte.
+ */
+class MidiTypeFilter
+{
+public:
+	//! Meaning of the message types passed to the constructor
+	enum Mode
+	{
+		Accept, //!< Only listed types pass.
+		Reject  //!< Listed types are dropped.
+	};
+
+	/*!
+	 * \brief Constructor
+	 * \param [in] mode whether listed types pass or are dropped.
+	 * \param [in] types message types, for channel messages all channels are affected.
+	 */
+	MidiTypeFilter(Mode mode, std::initializer_list<MidiMessage::Type> types)
+	{
+		for (unsigned int status = 0; status < 0x100; ++status)
+		{
+			_passes[status] = (mode == Reject);
+		}
+		for (MidiMessage::Type type : types)
+		{
+			const unsigned int first = static_cast<unsigned int>(type);
+			const unsigned int last = (first < MidiMessage::System) ? (first | 0x0F) : first;
+			for (unsigned int status = first; status <= last; ++status)
+			{
+				_passes[status] = (mode == Accept);
+			}
+		}
+	}
+
+	bool operator()(unsigned char* bytes, std::size_t) const
+	{
+		return _passes[bytes[0]];
+	}
+
+private:
+	bool _passes[0x100];
+};
+
+/*!
+ * \brief The MidiChannelMap stage moves channel messages to other channels or drops them
+ * \class MidiChannelMap MidiPipeline.h <smidi/MidiPipeline.h>
+ *
+ * Channels are 0-based (0..15). System messages pass unchanged.
+ */
+class MidiChannelMap
+{
+	static const unsigned char kDrop = 0xFF;
+
+public:
+	//! Identity map
+	MidiChannelMap()
+	{
+		for (unsigned char channel = 0; channel < 16; ++channel)
+		{
+			_channels[channel] = channel;
+		}
+	}
+
+	//! Messages of the channel `from` go to the channel `to`
+	MidiChannelMap& map(unsigned char from, unsigned char to)
+	{
+		_channels[from & 0x0F] = to & 0x0F;
+		return *this;
+	}
+
+	//! Messages of the channel are dropped
+	MidiChannelMap& drop(unsigned char channel)
+	{
+		_channels[channel & 0x0F] = kDrop;
+		return *this;
+	}
+
+	//! Messages of all channels go to the channel
+	static MidiChannelMap all(unsigned char to)
+	{
+		MidiChannelMap result;
+		for (unsigned char channel = 0; channel < 16; ++channel)
+		{
+			result.map(channel, to);
+		}
+		return result;
+	}
+
+	bool operator()(unsigned char* bytes, std::size_t) const
+	{
+		bool result = true;
+		const unsigned char status = bytes[0];
+		if (status < MidiMessage::System)
+		{
+			const unsigned char channel = _channels[status & 0x0F];
+			result = (channel != kDrop);
+			bytes[0] = static_cast<unsigned char>((status & 0xF0) | (channel & 0x0F));
+		}
+		return result;
+	}
+
+private:
+	unsigned char _channels[16];
+};
+
+/*!
+ * \brief The MidiTranspose stage shifts notes of Note On, Note Off and After Touch messages
+ * \class MidiTranspose MidiPipeline.h <smidi/MidiPipeline.h>
+ *
+ * Notes shifted out of 0..127 are dropped.
+ */
+class MidiTranspose
+{
+	static const unsigned char kDrop = 0xFF;
+
+public:
+	//! Constructor, shift in semitones
+	explicit MidiTranspose(int semitones)
+	{
+		for (int note = 0; note < 128; ++note)
+		{
+			const int shifted = note + semitones;
+			_notes[note] = (shifted >= 0 && shifted < 128) ? static_cast<unsigned char>(shifted) : kDrop;
+		}
+	}
+
+	bool operator()(unsigned char* bytes, std::size_t size) const
+	{
+		bool result = true;
+		// Note Off (0x8n), Note On (0x9n) and After Touch (0xAn)
+		if (bytes[0] < MidiMessage::ControlChange && size > 1)
+		{
+			const unsigned char note = _notes[bytes[1] & 0x7F];
+			result = (note != kDrop);
+			bytes[1] = note & 0x7F;
+		}
+		return result;
+	}
+
+private:
+	unsigned char _notes[128];
+};
+
+/*!
+ * \brief The MidiVelocityCurve stage changes velocity of Note On messages
+ * \class MidiVelocityCurve MidiPipeline.h <smidi/MidiPipeline.h>
+ *
+ * Velocity 0 (Note Off) stays 0 and other velocities never become 0, so the curve can't turn notes off.
+ */
+class MidiVelocityCurve
+{
+public:
+	//! Constructor
+	explicit MidiVelocityCurve(const MidiCurve& curve)
+	{
+		_velocities[0] = 0;
+		for (unsigned int velocity = 1; velocity < 128; ++velocity)
+		{
+			const unsigned char value = curve[static_cast<unsigned char>(velocity)];
+			_velocities[velocity] = (value == 0) ? 1 : value;
+		}
+	}
+
+	bool operator()(unsigned char* bytes, std::size_t size) const
+	{
+		if ((bytes[0] & 0xF0) == MidiMessage::NoteOn && size > 2)
+		{
+			bytes[2] = _velocities[bytes[2] & 0x7F];
+		}
+		return true;
+	}
+
+private:
+	unsigned char _velocities[128];
+};
+
+/*!
+ * \brief The MidiControllerMap stage renumbers or drops Control Change messages
+ * \class MidiControllerMap MidiPipeline.h <smidi/MidiPipeline.h>
+ */
+class MidiControllerMap
+{
+	static const unsigned char kDrop = 0xFF;
+
+public:
+	//! Identity map
+	MidiControllerMap()
+	{
+		for (unsigned int controller = 0; controller < 128; ++controller)
+		{
+			_controllers[controller] = static_cast<unsigned char>(controller);
+		}
+	}
+
+	//! Controller `from` becomes controller `to`
+	MidiControllerMap& map(unsigned char from, unsigned char to)
+	{
+		_controllers[from & 0x7F] = to & 0x7F;
+		return *this;
+	}
+
+	//! Controller is dropped
+	MidiControllerMap& drop(unsigned char controller)
+	{
+		_controllers[controller & 0x7F] = kDrop;
+		return *this;
+	}
+
+	bool operator()(unsigned char* bytes, std::size_t size) const
+	{
+		bool result = true;
+		if ((bytes[0] & 0xF0) == MidiMessage::ControlChange && size > 1)
+		{
+			const unsigned char controller = _controllers[bytes[1] & 0x7F];
+			result = (controller != kDrop);
+			bytes[1] = controller & 0x7F;
+		}
+		return result;
+	}
+
+private:
+	unsigned char _controllers[128];
+};
+
+/*!
+ * \brief The MidiControllerCurve stage changes values of one controller
+ * \class MidiControllerCurve MidiPipeline.h <smidi/MidiPipeline.h>
+ */
+class MidiControllerCurve
+{
+public:
+	//! Constructor
+	MidiControllerCurve(unsigned char controller, const MidiCurve& curve)
+		: _controller(controller & 0x7F)
+		, _curve(curve)
+	{
+	}
+
+	bool operator()(unsigned char* bytes, std::size_t size) const
+	{
+		if ((bytes[0] & 0xF0) == MidiMessage::ControlChange && size > 2 && bytes[1] == _controller)
+		{
+			bytes[2] = _curve[bytes[2]];
+		}
+		return true;
+	}
+
+private:
+	unsigned char _controller;
+	MidiCurve     _curve;
+};
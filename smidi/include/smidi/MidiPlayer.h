@@ -0,0 +1,158 @@
+#pragma once
+
+/*!
+ * \file MidiPlayer.h
+ * Contains MidiPlayer - playback of Standard MIDI Files and other event sources to an output port.
+ */
+
+#include "MidiClock.h"
+#include "MidiFile.h"
+#include "MidiOutPort.h"
+#include "MidiSync.h"
+#include "MidiTempoMap.h"
+#include <chrono>
+#include <memory>
+
+/*!
+ * \brief The MidiPlayer class plays events ordered by tick to the output port
+ * \class MidiPlayer MidiPlayer.h <smidi/MidiPlayer.h>
+ * \sa MidiFile, MidiTempoMap
+ *
+ * The player thread converts ticks to time with the tempo map and keeps the next `lookahead` of events handed
+ * over to the port with MidiOutPort::scheduleMessages(). Sequencer ports deliver them from a kernel queue,
+ * so the timing doesn't depend on the player thread being woken up on time, and the thread only runs a few
+ * times per lookahead. Ports without a queue (and any port with a clock other than MidiClock::system())
+ * get every message with sendMessage() at its time from the player thread instead.
+ *
+ * Stopping and locating drop the messages which are still queued and send Note Off for every note sounding at
+ * that moment, also those whose Note Off was among the dropped messages. Jumping back at the loop end queues
+ * Note Off for the notes still on at the loop end, so no note hangs.
+ *
+ * ~~~cpp
+ * MidiFile file;
+ * if (file.open("song.mid"))
+ * {
+ *     MidiPlayer player(outputPort);
+ *     player.load(file);
+ *     player.setLoop(0, 4 * 4 * file.tempoMap().ticksPerQuarterNote()); // the first four bars
+ *     player.play();
+ * }
+ * ~~~
+ */
+class MidiPlayer
+{
+public:
+	/*!
+	 * \brief The Source class is the interface of event sources, e.g. generated or edited sequences
+	 */
+	class Source
+	{
+	public:
+		virtual ~Source() = default;
+
+		//! Moves to the first event with tick not less than the tick
+		virtual void seek(unsigned long long tick) = 0;
+
+		/*!
+		 * \brief Yields the next event, ticks must not decrease
+		 * \param [out] event the event, its data must stay valid until the next call. `time` is not used.
+		 * \return `false` at the end of the source
+		 */
+		virtual bool next(MidiFileEvent& event) = 0;
+	};
+
+	//! Player options
+	struct Options
+	{
+		Options();
+
+		//! How far ahead of their time messages are handed over to the port queue
+		std::chrono::milliseconds lookahead;
+
+		/*!
+		 * MidiSync that follows the player: it is started with the tempo at the play position, follows the
+		 * tempo changes and stops with the player. Playback is delayed by MidiSync::syncInitialLatencyForTempo(),
+		 * so the first note comes with the first MIDI Clock. `nullptr` (default) for no sync.
+		 */
+		MidiSync* sync;
+	};
+
+	//! Player counters
+	struct Counters
+	{
+		unsigned long long messages;    //!< Messages handed over to the port.
+		unsigned long long late;        //!< Messages handed over after their time.
+		unsigned long long maxLateness; //!< Largest lateness of late messages in nanoseconds.
+		unsigned long long loops;       //!< Jumps from the loop end back to its start.
+	};
+
+public:
+	/*!
+	 * \brief Constructor
+	 * \param [in] port output port, it is kept alive by the player.
+	 * \param [in] options lookahead and sync.
+	 * \param [in] clock time source, only MidiClock::system() time can be scheduled on the port queue.
+	 */
+	explicit MidiPlayer(std::shared_ptr<MidiOutPort> port, const Options& options = Options(), std::shared_ptr<MidiClock> clock = MidiClock::system());
+	~MidiPlayer();
+
+	MidiPlayer(const MidiPlayer&) = delete;
+	MidiPlayer& operator=(const MidiPlayer&) = delete;
+
+	/*!
+	 * \brief Loads events of all tracks of the file, stops playback and moves to the start
+	 * \param [in] file open file, it must stay open while it is loaded.
+	 * \return `false` if the file is not open
+	 *
+	 * The tempo map of the first track is used for all tracks, also for format 2 files.
+	 */
+	bool load(const MidiFile& file);
+
+	/*!
+	 * \brief Loads events of the source, stops playback and moves to the start
+	 * \param [in] source events, tempo meta events are only passed to the sync.
+	 * \param [in] tempoMap conversion of the ticks of the source to time.
+	 */
+	void load(std::unique_ptr<Source> source, const MidiTempoMap& tempoMap);
+
+	//! Starts playback from the current position
+	void play();
+
+	//! Stops playback, the position stays where the playback is
+	void stop();
+
+	/*!
+	 * \brief Moves the play position
+	 * \param [in] tick new position, the playback goes on from there if the player is playing.
+	 */
+	void locate(unsigned long long tick);
+
+	/*!
+	 * \brief Plays the part between the ticks over and over
+	 * \param [in] startTick the first tick of the loop.
+	 * \param [in] endTick the tick after the loop, events at it belong to the next pass.
+	 * \return `false` if the loop is empty
+	 *
+	 * Takes effect when the playback reaches the loop end, which may lie after the last event. Playback started
+	 * after the loop end plays on to the end of the source.
+	 */
+	bool setLoop(unsigned long long startTick, unsigned long long endTick);
+
+	//! Plays on after the loop end
+	void clearLoop();
+
+	//! Returns `true` until stop() or the end of the source
+	bool isPlaying() const;
+
+	//! Returns `true` if messages are scheduled on the port queue rather than sent by the player thread
+	bool isQueueScheduling() const;
+
+	//! Returns the tick that is playing now
+	unsigned long long position() const;
+
+	Counters counters() const;
+
+private:
+	class Implementation;
+	std::unique_ptr<Implementation> _impl;
+};
@@ -5,6 +5,7 @@
  * Contains interface for MIDI ports classes
  */
 
+#include "MidiMetrics.h"
 #include <string>
 
 
@@ -41,4 +42,11 @@ public:
 	 * Stopped device can't send or receive MIDI.
 	 */
 	virtual void stop() = 0;
+
+	/*!
+	 * \brief Returns snapshot of the port runtime counters
+	 *
+	 * Can be called from any thread at any time, it never blocks MIDI input or output.
+	 */
+	virtual MidiPortMetrics metrics() const = 0;
 };
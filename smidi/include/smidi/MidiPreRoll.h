@@ -0,0 +1,124 @@
+#pragma once
+
+/*!
+ * \file MidiPreRoll.h
+ * Contains MidiPreRoll - always-on in-memory record of the last minutes of input ("retroactive record").
+ */
+
+#include "MidiClock.h"
+#include "MidiInPort.h"
+#include "MidiMessage.h"
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief The MidiPreRoll class keeps the latest messages of input ports, so playing can be saved after the fact
+ * \class MidiPreRoll MidiPreRoll.h <smidi/MidiPreRoll.h>
+ * \sa MidiFileRecorder, MidiCapture
+ *
+ * Every port has its own ring of compact 16 byte events: the timestamp and up to 3 message bytes inline. Longer
+ * messages (SysEx) go to a byte arena of the port and the event refers to them. Both are allocated in the
+ * constructor and never grow: when a ring or an arena is full the oldest events are overwritten.
+ *
+ * The input thread of a port is the only writer of its ring. It doesn't take locks and doesn't use atomic
+ * read-modify-write instructions, so recording costs a few nanoseconds per message. snapshot() copies the
+ * events from any thread while recording goes on, and then throws away those the writer overwrote in the meantime.
+ *
+ * The pre-roll doesn't touch message handlers of the ports: record() is called from the handler of the port
+ * (handler() when there is nothing else to do there), the port index is up to the application.
+ *
+ * ~~~cpp
+ * MidiPreRoll preRoll(1);
+ * keyboard->setMessageHandler(preRoll.handler(0));
+ * // ... "save what I just played"
+ * preRoll.saveSnapshot("idea.mid", std::chrono::minutes(5));
+ * ~~~
+ */
+class MidiPreRoll
+{
+public:
+	/*!
+	 * \brief The Options struct describes the memory of every port
+	 */
+	struct Options
+	{
+		std::size_t capacity;    //!< Events kept per port, rounded up to the power of two.
+		std::size_t sysExMemory; //!< Bytes of SysEx kept per port, rounded up to the power of two, at most 1 GiB.
+
+		//! Default options: 256K events (4 MiB) and 1 MiB of SysEx per port
+		Options();
+	};
+
+	/*!
+	 * \brief The Event struct is a message taken by snapshot()
+	 */
+	struct Event
+	{
+		std::size_t port;    //!< Index of the port given to record().
+		MidiMessage message; //!< The message with its timestamp.
+	};
+
+	/*!
+	 * \brief The Counters struct contains message counters of all ports
+	 */
+	struct Counters
+	{
+		unsigned long long recorded; //!< Messages recorded since construction, also the overwritten ones.
+		unsigned long long dropped;  //!< SysEx messages larger than the SysEx memory of the port.
+	};
+
+public:
+	/*!
+	 * \brief Constructor, allocates all the memory the pre-roll uses and starts recording
+	 * \param [in] ports number of ports, record() takes indexes from 0 to `ports` - 1.
+	 * \param [in] options memory of every port.
+	 * \param [in] clock time source, messages without timestamp are stamped with it and snapshot() counts back from its time.
+	 */
+	explicit MidiPreRoll(std::size_t ports, const Options& options = Options(), std::shared_ptr<MidiClock> clock = MidiClock::system());
+
+	~MidiPreRoll();
+
+	MidiPreRoll(const MidiPreRoll&) = delete;
+	MidiPreRoll& operator=(const MidiPreRoll&) = delete;
+
+	/*!
+	 * \brief Records the message of the port, doesn't block
+	 *
+	 * Like the port handlers it must not be called for the same port from several threads at once.
+	 * \param [in] port index of the port, messages of unknown ports are ignored.
+	 * \param [in] message the message.
+	 */
+	void record(std::size_t port, const MidiMessage& message);
+
+	//! Returns handler which calls record() with the port index, for MidiInPort::setMessageHandler(), the pre-roll must outlive the port handler
+	MidiInPort::MessageHandler handler(std::size_t port);
+
+	/*!
+	 * \brief Returns the messages of all ports of the last `length`, ordered by timestamp
+	 *
+	 * Can be called from any thread, recording goes on meanwhile. Messages older than what the memory holds are
+	 * not there: the result may start later than `length` ago.
+	 * \param [in] length how far back from the current time of the clock.
+	 */
+	std::vector<Event> snapshot(std::chrono::nanoseconds length) const;
+
+	/*!
+	 * \brief Saves snapshot() into a format 0 Standard MIDI File, the first message is at tick 0
+	 * \param [in] path path to the file, an existing file is overwritten.
+	 * \param [in] length how far back from the current time of the clock.
+	 * \return `false` if the file couldn't be written
+	 *
+	 * The file has 480 ticks per quarter note at 120 BPM, messages of all ports go to the only track.
+	 */
+	bool saveSnapshot(const std::string& path, std::chrono::nanoseconds length) const;
+
+	//! Returns message counters
+	Counters counters() const;
+
+private:
+	class Implementation;
+	std::unique_ptr<Implementation> _impl;
+};
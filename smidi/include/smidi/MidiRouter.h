@@ -0,0 +1,166 @@
+#pragma once
+
+/*!
+ * \file MidiRouter.h
+ * Contains MidiRouter - in-process router of messages from input ports to output ports.
+ */
+
+#include "MidiPipeline.h"
+#include "MidiInPort.h"
+#include "MidiOutPort.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+/*!
+ * \brief The MidiRouter class forwards messages from MidiInPort objects to MidiOutPort objects through MidiPipeline
+ * \class MidiRouter MidiRouter.h <smidi/MidiRouter.h>
+ * \sa MidiPipeline, MidiDeviceEnumerator::addRoute()
+ *
+ * The router doesn't touch message handlers of the ports, feed it from them: with handler() alone, or by calling
+ * the handler it returns from a handler that does other work too. An input may feed any number of routes and an
+ * output may be fed by any number of routes.
+ *
+ * Messages are routed by the thread that dispatches them from the input port. The routes of an input are
+ * a copy-on-write list, so routing takes no lock; adding and removing routes copies the list. Every route keeps its
+ * own copy of the message for the pipeline to change, after the first messages routing doesn't allocate memory.
+ *
+ * Unlike MidiDeviceEnumerator::addRoute() the messages pass through the application, so they can be transformed,
+ * and any port kinds can be connected (loopback, virtual, device ports).
+ *
+ * ~~~cpp
+ * MidiRouter router;
+ * const MidiRouter::RouteId id = router.addRoute(keyboard, synth, makeMidiPipeline(MidiChannelMap::all(9), MidiTranspose(12)));
+ * keyboard->setMessageHandler(router.handler(keyboard));
+ * ~~~
+ */
+class MidiRouter
+{
+public:
+	//! Route identifier, 0 is never used
+	using RouteId = unsigned int;
+
+	/*!
+	 * \brief The RouteMetrics struct contains message counters of the route
+	 */
+	struct RouteMetrics
+	{
+		unsigned long long forwarded; //!< Number of messages sent to the output port.
+		unsigned long long dropped;   //!< Number of messages dropped by the pipeline.
+	};
+
+public:
+	MidiRouter();
+
+	//! Destructor removes all routes, handlers returned by handler() forward nothing afterwards
+	~MidiRouter();
+
+	MidiRouter(const MidiRouter&) = delete;
+	MidiRouter& operator=(const MidiRouter&) = delete;
+
+	/*!
+	 * \brief Adds the route which forwards messages unchanged
+	 * \param [in] input input port, messages from its handler() go to the route.
+	 * \param [in] output output port.
+	 * \return identifier of the route or 0 if one of the ports is null
+	 */
+	RouteId addRoute(const std::shared_ptr<MidiInPort>& input, const std::shared_ptr<MidiOutPort>& output);
+
+	/*!
+	 * \brief Adds the route which forwards messages through the pipeline
+	 * \param [in] input input port, messages from its handler() go to the route.
+	 * \param [in] output output port.
+	 * \param [in] pipeline MidiPipeline or any other stage. Messages it drops are not sent.
+	 * \return identifier of the route or 0 if one of the ports is null
+	 */
+	template <typename Pipeline>
+	RouteId addRoute(const std::shared_ptr<MidiInPort>& input, const std::shared_ptr<MidiOutPort>& output, Pipeline pipeline)
+	{
+		std::unique_ptr<Route> route;
+		if (output)
+		{
+			route.reset(new PipelineRoute<Pipeline>(output, std::move(pipeline)));
+		}
+		return addRoute(input, std::move(route));
+	}
+
+	/*!
+	 * \brief Removes the route
+	 *
+	 * When the call returns the route doesn't process messages anymore, so it waits for the messages being routed
+	 * from its input and must not be called by the output port of the route.
+	 * \return `false` if there is no such route
+	 */
+	bool removeRoute(RouteId id);
+
+	/*!
+	 * \brief Returns handler which forwards messages of the input port to its routes, for MidiInPort::setMessageHandler()
+	 *
+	 * Routes added to the input later get the messages as well. The handler may outlive the router, it forwards
+	 * nothing then.
+	 */
+	MidiInPort::MessageHandler handler(const std::shared_ptr<MidiInPort>& input);
+
+	//! Removes all routes
+	void clear();
+
+	//! Returns number of routes
+	std::size_t routeCount() const;
+
+	//! Returns message counters of the route, zeros if there is no such route
+	RouteMetrics metrics(RouteId id) const;
+
+private:
+	class Route
+	{
+	public:
+		Route();
+		virtual ~Route() = default;
+
+		//! Called by the dispatching thread, never concurrently for the same route
+		virtual bool process(const MidiMessage& message) = 0;
+
+		std::atomic<unsigned long long> forwarded;
+		std::atomic<unsigned long long> dropped;
+	};
+
+	template <typename Pipeline>
+	class PipelineRoute : public Route
+	{
+	public:
+		PipelineRoute(const std::shared_ptr<MidiOutPort>& output, Pipeline pipeline)
+			: _output(output)
+			, _pipeline(std::move(pipeline))
+		{
+		}
+
+		bool process(const MidiMessage& message) override
+		{
+			// the copy reuses the buffer of the previous message
+			_message = message;
+			const bool result = !_message.isEmpty() && _pipeline(static_cast<unsigned char*>(_message), _message.data().size());
+			if (result)
+			{
+				_output->sendMessage(_message);
+			}
+			return result;
+		}
+
+	private:
+		std::shared_ptr<MidiOutPort> _output;
+		Pipeline                     _pipeline;
+		MidiMessage                  _message;
+	};
+
+	class Input;
+
+	RouteId addRoute(const std::shared_ptr<MidiInPort>& input, std::unique_ptr<Route> route);
+	//! Returns routes of the input port, created on first use, must be called under the lock
+	const std::shared_ptr<Input>& input(const std::shared_ptr<MidiInPort>& port);
+
+private:
+	mutable std::mutex                                  _mutex;
+	std::map<const MidiInPort*, std::shared_ptr<Input>> _inputs;
+	RouteId                                             _nextRouteId;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+/*!
+ * \file MidiStreamParser.h
+ * Contains MidiStreamParser - parser of raw MIDI byte stream.
+ */
+
+#include "MidiMessage.h"
+#include "MidiDelegate.h"
+#include <cstddef>
+#include <vector>
+
+/*!
+ * \brief The MidiStreamParser class assembles MidiMessage objects from raw MIDI bytes (MIDI 1.0 wire protocol).
+ * \class MidiStreamParser MidiStreamParser.h <smidi/MidiStreamParser.h>
+ *
+ * Bytes may come in chunks of any size, a message split between chunks is completed by the next parse() call.
+ * The parser supports:
+ * - running status (data bytes without status byte reuse the last channel message status),
+ * - System Real Time messages interleaved anywhere, even inside other messages and SysEx,
+ * - SysEx of any length up to the limit set in the constructor (longer SysEx is dropped).
+ *
+ * Messages are passed to the handler as soon as the last byte is parsed. The message reference is only valid during
+ * the handler call. After the first messages the parser doesn't allocate memory.
+ *
+ * SysEx payload and runs of orphan data bytes are not looked at byte by byte: the next status byte (high bit set)
+ * is searched with SIMD instructions and the whole run is copied or dropped at once.
+ */
+class MidiStreamParser
+{
+public:
+	//! Type of the handler of parsed messages
+	using Handler = MidiDelegate<void(const MidiMessage& message)>;
+
+	//! Default limit of SysEx size in bytes
+	constexpr static std::size_t kDefaultMaxSysExSize = 64 * 1024;
+
+	/*!
+	 * \enum ScanMode
+	 * Defines how runs of data bytes (SysEx payload, bytes without status) are skipped.
+	 */
+	enum class ScanMode
+	{
+		Vector, //!< SIMD search of the next status byte (AVX2, SSE2 or NEON, whichever the library is built for).
+		Scalar  //!< Byte by byte, reference implementation.
+	};
+
+public:
+	/*!
+	 * \brief Constructor
+	 * \param [in] maxSysExSize maximal size of SysEx message including 0xF0 and 0xF7 bytes.
+	 * \param [in] scanMode search of status bytes, both modes produce exactly the same messages.
+	 */
+	explicit MidiStreamParser(std::size_t maxSysExSize = kDefaultMaxSysExSize, ScanMode scanMode = ScanMode::Vector);
+
+	//! Sets the handler of parsed messages
+	void setHandler(Handler handler);
+
+	/*!
+	 * \brief Parses next chunk of the stream
+	 * \param [in] data pointer to the bytes.
+	 * \param [in] size number of bytes.
+	 * \param [in] timestamp timestamp of the chunk, messages get the timestamp of the chunk their first byte came with.
+	 * \return number of messages passed to the handler
+	 */
+	std::size_t parse(const unsigned char* data, std::size_t size, unsigned long long timestamp);
+
+	//! Forgets incomplete message, SysEx and running status (e.g. after the device was reconnected)
+	void reset();
+
+	/*!
+	 * \brief Returns number of bytes which didn't make it into any message
+	 *
+	 * Data bytes without status, undefined status bytes, interrupted or too long SysEx are counted.
+	 */
+	unsigned long long droppedBytes() const;
+
+	//! Returns number of data bytes that follow the status byte, or -1 for SysEx and undefined status bytes
+	static int dataBytesFor(unsigned char status);
+
+	//! Returns the name of the instruction set used by ScanMode::Vector ("AVX2", "SSE2", "NEON" or "none")
+	static const char* vectorExtension();
+
+private:
+	using FindStatusByte = std::size_t (*)(const unsigned char* data, std::size_t size);
+
+	void emit(unsigned long long timestamp);
+	void appendSysEx(const unsigned char* data, std::size_t size);
+	void dropSysEx();
+
+private:
+	FindStatusByte             _findStatusByte;
+	Handler                    _handler;
+	MidiMessage                _message;
+	std::vector<unsigned char> _sysEx;
+	std::size_t                _maxSysExSize;
+	unsigned long long         _sysExTimestamp;
+	unsigned long long         _messageTimestamp;
+	unsigned long long         _droppedBytes;
+	unsigned char              _runningStatus;
+	unsigned char              _status;
+	unsigned char              _data[2];
+	int                        _expectedDataBytes;
+	int                        _receivedDataBytes;
+	bool                       _inSysEx;
+	bool                       _sysExOverflow;
+};
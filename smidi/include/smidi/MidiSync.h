@@ -5,6 +5,7 @@
  * Contains MidiSync interface
  */
 
+#include "MidiMetrics.h"
 #include <memory>
 #include <chrono>
 
@@ -36,4 +37,7 @@ public:
 
 	//! Returns the delay between syncStart() call and first the actual MIDI Clock event
 	virtual std::chrono::microseconds syncInitialLatencyForTempo(double bpm) const = 0;
+
+	//! Returns snapshot of the clock generator counters (jitter and phase corrections), can be called from any thread
+	virtual MidiSyncMetrics metrics() const = 0;
 };
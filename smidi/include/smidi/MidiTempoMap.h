@@ -0,0 +1,91 @@
+#pragma once
+
+/*!
+ * \file MidiTempoMap.h
+ * Contains MidiTempoMap - conversion between MIDI ticks and time.
+ */
+
+#include <cstddef>
+#include <vector>
+
+/*!
+ * \brief The MidiTempoMap class converts ticks of a Standard MIDI File to nanoseconds and back
+ * \class MidiTempoMap MidiTempoMap.h <smidi/MidiTempoMap.h>
+ * \sa MidiFile
+ *
+ * With metrical time division (ticks per quarter note) the map is a list of tempo changes, before the first
+ * change the tempo is 120 BPM. With SMPTE time division ticks have constant length and tempo changes are ignored.
+ *
+ * Sequential conversions (e.g. while iterating events) should pass the same `hint` variable to every call,
+ * then the conversion doesn't search the list of changes.
+ */
+class MidiTempoMap
+{
+public:
+	//! Tempo before the first tempo change: 500000 microseconds per quarter note (120 BPM)
+	static const unsigned int kDefaultTempo = 500000;
+
+	/*!
+	 * \brief Constructor for metrical time
+	 * \param [in] ticksPerQuarterNote resolution, 0 is replaced with 96.
+	 */
+	explicit MidiTempoMap(unsigned int ticksPerQuarterNote = 480);
+
+	/*!
+	 * \brief Creates map for SMPTE time
+	 * \param [in] framesPerSecond 24, 25, 29 (means 29.97 drop frame) or 30.
+	 * \param [in] ticksPerFrame resolution of the frame.
+	 */
+	static MidiTempoMap smpte(unsigned int framesPerSecond, unsigned int ticksPerFrame);
+
+	//! Returns ticks per quarter note, 0 for SMPTE time
+	unsigned int ticksPerQuarterNote() const;
+
+	//! Returns `true` if tempo changes are ignored
+	bool isSmpte() const;
+
+	/*!
+	 * \brief Adds the tempo change
+	 * \param [in] tick position of the change, not less than the position of the previous change.
+	 * \param [in] microsecondsPerQuarterNote new tempo, as in the Set Tempo meta event.
+	 *
+	 * A change at the tick of the previous change replaces it.
+	 */
+	void addTempo(unsigned long long tick, unsigned int microsecondsPerQuarterNote);
+
+	//! Removes all tempo changes
+	void clear();
+
+	//! Returns number of tempo changes
+	std::size_t size() const;
+
+	//! Returns tempo in microseconds per quarter note at the tick
+	unsigned int tempoAt(unsigned long long tick) const;
+
+	//! Returns time of the tick in nanoseconds
+	unsigned long long timeAt(unsigned long long tick) const;
+
+	//! Returns time of the tick in nanoseconds, `hint` speeds up calls with non-decreasing ticks (start with 0)
+	unsigned long long timeAt(unsigned long long tick, std::size_t& hint) const;
+
+	//! Returns the last tick which is not later than the time in nanoseconds
+	unsigned long long tickAt(unsigned long long time) const;
+
+private:
+	struct Change
+	{
+		unsigned long long tick;
+		unsigned long long time;
+		unsigned int       tempo;
+	};
+
+	std::size_t changeAt(unsigned long long tick) const;
+	unsigned long long timeFrom(const Change& change, unsigned long long tick) const;
+
+private:
+	std::vector<Change> _changes;
+	unsigned int        _ticksPerQuarterNote;
+	// SMPTE ticks last _smpteNumerator / _smpteDenominator nanoseconds
+	unsigned long long  _smpteNumerator;
+	unsigned long long  _smpteDenominator;
+};
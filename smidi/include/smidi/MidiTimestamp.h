@@ -0,0 +1,63 @@
+#pragma once
+
+/*!
+ * \file MidiTimestamp.h
+ * Contains MidiTimestamp - conversions for MidiMessage timestamps.
+ */
+
+#include <chrono>
+#include <ctime>
+
+/*!
+ * \brief The MidiTimestamp class converts MidiMessage timestamps to and from other clocks.
+ * \class MidiTimestamp MidiTimestamp.h <smidi/MidiTimestamp.h>
+ *
+ * Timestamps of the incoming messages are nanoseconds of the monotonic system clock (`CLOCK_MONOTONIC` on Linux)
+ * taken when the event arrived to the kernel, not when the application woke up. Monotonic clock doesn't jump when
+ * the wall-clock time is adjusted, and it is the same clock most audio APIs use for their timestamps
+ * (e.g. ALSA PCM `htstamp` with `SND_PCM_TSTAMP_TYPE_MONOTONIC`, JACK time), so MIDI and audio can be correlated directly.
+ *
+ * ~~~cpp
+ * // sample offset of the MIDI event inside the audio period that started at periodTimestamp
+ * const long long frame = MidiTimestamp::framesBetween(periodTimestamp, message.timestamp(), 48000.0);
+ * ~~~
+ */
+class MidiTimestamp
+{
+public:
+	//! Standard clock with the same epoch as timestamps (`std::chrono::steady_clock` is `CLOCK_MONOTONIC` on Linux)
+	using Clock = std::chrono::steady_clock;
+
+	//! Returns current monotonic time in nanoseconds
+	static unsigned long long now();
+
+	//! Converts timestamp to the standard time point
+	static Clock::time_point toTimePoint(unsigned long long timestamp);
+
+	//! Converts standard time point to the timestamp
+	static unsigned long long fromTimePoint(const Clock::time_point& timePoint);
+
+	//! Converts timestamp to `timespec` (e.g. for `clock_nanosleep()` with `CLOCK_MONOTONIC`)
+	static timespec toTimespec(unsigned long long timestamp);
+
+	//! Converts monotonic `timespec` (e.g. audio driver timestamp) to the timestamp
+	static unsigned long long fromTimespec(const timespec& time);
+
+	/*!
+	 * \brief Returns number of audio frames between two timestamps
+	 * \param [in] from reference timestamp, e.g. the time the audio period started.
+	 * \param [in] to timestamp to convert, e.g. MidiMessage::timestamp().
+	 * \param [in] sampleRate audio sample rate in Hz.
+	 * \return frame offset, negative if `to` is earlier than `from`
+	 */
+	static long long framesBetween(unsigned long long from, unsigned long long to, double sampleRate);
+
+	/*!
+	 * \brief Returns timestamp of the audio frame
+	 * \param [in] frame frame to convert.
+	 * \param [in] referenceFrame frame which time is known (e.g. first frame of the period).
+	 * \param [in] referenceTimestamp time of the referenceFrame.
+	 * \param [in] sampleRate audio sample rate in Hz.
+	 */
+	static unsigned long long fromFrame(long long frame, long long referenceFrame, unsigned long long referenceTimestamp, double sampleRate);
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+/*!
+ * \file MidiVirtualClient.h
+ * Contains MidiVirtualClient - application owned MIDI ports other programs connect to.
+ */
+
+#include <list>
+#include <memory>
+#include <string>
+
+class MidiPort;
+class MidiInPort;
+class MidiOutPort;
+
+/*!
+ * \brief The MidiVirtualClient class publishes MIDI ports of the application
+ * \class MidiVirtualClient MidiVirtualClient.h <smidi/MidiVirtualClient.h>
+ *
+ * MidiDeviceEnumerator attaches to ports that already exist. MidiVirtualClient is a sequencer client of its own
+ * (named in the constructor) with input and output ports that other programs (DAWs, synths, `aconnect`) see and
+ * connect to, so the application can work as a MIDI processor without any hardware.
+ *
+ * Created ports behave like device ports: input ports support handlers, waiters and both dispatch modes,
+ * output ports support batched output and MidiSync. All input ports of the client share one input thread
+ * (or one poll descriptor in MidiInPort::DispatchMode::CallerThread mode), so the dispatch mode is common for
+ * the client: changing it on one input port changes it for all of them.
+ *
+ * ~~~cpp
+ * MidiVirtualClient client("My MIDI Processor");
+ * std::shared_ptr<MidiInPort> input = client.createInputPort("in");
+ * std::shared_ptr<MidiOutPort> output = client.createOutputPort("out");
+ * input->setMessageHandler([&output](const MidiMessage& message) { output->sendMessage(message); });
+ * client.connect(*output, "Midi Through:0");
+ * ~~~
+ *
+ * \note Ports must not outlive the client.
+ */
+class MidiVirtualClient
+{
+public:
+	/*!
+	 * \enum Capability
+	 * Defines what other programs can do with the port, values can be combined.
+	 */
+	enum Capability : unsigned int
+	{
+		Subscribable = 1 << 0, //!< Other programs can connect to the port themselves, otherwise only connect() does.
+		Hidden       = 1 << 1  //!< Port is not listed to other programs (e.g. internal test ports).
+	};
+
+	//! Default capabilities of the created ports
+	static const unsigned int kDefaultCapabilities = Subscribable;
+
+public:
+	/*!
+	 * \brief Constructor
+	 * \param [in] name client name other programs see.
+	 */
+	explicit MidiVirtualClient(const std::string& name);
+
+	//! Destructor
+	~MidiVirtualClient();
+
+	MidiVirtualClient(const MidiVirtualClient&) = delete;
+	MidiVirtualClient& operator=(const MidiVirtualClient&) = delete;
+
+	//! Returns `true` if the client is registered with the sequencer
+	bool isValid() const;
+
+	//! Returns the client name
+	const std::string& name() const;
+
+	/*!
+	 * \brief Returns the sequencer address of the port ("client:port"), as accepted by connect() and `aconnect`
+	 * \param [in] port port created by this client.
+	 * \return address or empty string if the port doesn't belong to the client
+	 */
+	std::string address(const MidiPort& port) const;
+
+	/*!
+	 * \brief Creates input port other programs send MIDI to
+	 * \param [in] name port name.
+	 * \param [in] capabilities combination of Capability values.
+	 * \return created port or `nullptr` on error
+	 */
+	std::shared_ptr<MidiInPort> createInputPort(const std::string& name, unsigned int capabilities = kDefaultCapabilities);
+
+	/*!
+	 * \brief Creates output port other programs receive MIDI from
+	 * \param [in] name port name.
+	 * \param [in] capabilities combination of Capability values.
+	 * \return created port or `nullptr` on error
+	 */
+	std::shared_ptr<MidiOutPort> createOutputPort(const std::string& name, unsigned int capabilities = kDefaultCapabilities);
+
+	//! Changes capabilities of the port created by this client
+	bool setCapabilities(const MidiPort& port, unsigned int capabilities);
+
+	/*!
+	 * \brief Connects the port to other port
+	 * \param [in] port port created by this client.
+	 * \param [in] address other port as "client:port", client may be a name (e.g. "Midi Through:0").
+	 * \return `true` on success
+	 *
+	 * Input port receives from the other port, output port sends to it.
+	 */
+	bool connect(const MidiPort& port, const std::string& address);
+
+	//! Removes connection made by connect() or by other program
+	bool disconnect(const MidiPort& port, const std::string& address);
+
+	//! Returns addresses ("client:port") of all ports connected to the port
+	std::list<std::string> connections(const MidiPort& port) const;
+
+public:
+	//! Forward declaration of internal implementation class
+	class Implementation;
+
+private:
+	std::unique_ptr<Implementation> _impl;
+};
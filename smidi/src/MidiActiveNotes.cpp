@@ -0,0 +1,87 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiActiveNotes.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiActiveNotes.h"
+
+namespace
+{
+	const unsigned char kAllSoundOff = 120;
+	const unsigned char kAllNotesOff = 123;
+}
+
+MidiActiveNotes::MidiActiveNotes()
+	: _enabled(true)
+{
+	forget();
+}
+
+void MidiActiveNotes::setEnabled(bool enabled)
+{
+	_enabled = enabled;
+	if (!enabled)
+	{
+		forget();
+	}
+}
+
+bool MidiActiveNotes::isEnabled() const
+{
+	return _enabled;
+}
+
+std::vector<MidiMessage> MidiActiveNotes::takeReleaseMessages()
+{
+	std::vector<MidiMessage> result;
+	for (unsigned int channel = 0; channel < kChannels; ++channel)
+	{
+		const unsigned char status = static_cast<unsigned char>(MidiMessage::NoteOff | channel);
+		if (_enabled)
+		{
+			for (unsigned int word = 0; word < kWordsPerChannel; ++word)
+			{
+				// a note turned on meanwhile is either taken here or stays for the next release
+				unsigned long long bits = _notes[channel][word].exchange(0, std::memory_order_relaxed);
+				while (bits != 0)
+				{
+					const unsigned char note = static_cast<unsigned char>(word * 64 + static_cast<unsigned int>(__builtin_ctzll(bits)));
+					result.push_back(MidiMessage({status, note, 0}));
+					bits &= bits - 1;
+				}
+			}
+		}
+		else
+		{
+			result.push_back(MidiMessage({static_cast<unsigned char>(MidiMessage::ControlChange | channel), kAllNotesOff, 0}));
+		}
+	}
+	return result;
+}
+
+void MidiActiveNotes::trackChannelMode(unsigned int channel, unsigned char controller)
+{
+	// All Sound Off, All Notes Off and the mode changes (Omni, Mono, Poly) end every note of the channel
+	if (controller == kAllSoundOff || controller >= kAllNotesOff)
+	{
+		for (std::atomic<unsigned long long>& word : _notes[channel])
+		{
+			word.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+void MidiActiveNotes::forget()
+{
+	for (std::atomic<unsigned long long>(&channel)[kWordsPerChannel] : _notes)
+	{
+		for (std::atomic<unsigned long long>& word : channel)
+		{
+			word.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+//! \endcond
@@ -0,0 +1,95 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiActiveNotes.h
+ * \warning This file is not a part of library public interface!
+ * Contains tracker of the notes an output port has turned on
+ */
+
+#include "../include/smidi/MidiMessage.h"
+#include <atomic>
+#include <vector>
+
+/*!
+ * \brief The MidiActiveNotes class remembers which notes of an output port are on
+ * \class MidiActiveNotes MidiActiveNotes.h "MidiActiveNotes.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Every channel has 128 bits in two words. A sent Note On sets the bit of the note, Note Off (or Note On with
+ * velocity 0) clears it, with a relaxed atomic `or`/`and`, so ports which are written from several threads need
+ * no lock for it. Channel mode messages that turn notes off and System Reset clear the bits of the notes they end.
+ * A scheduled message may still be cancelled before it is delivered, so it only ever sets bits: a note whose
+ * scheduled Note Off was delivered gets one redundant Note Off on release, a cancelled one is not left hanging.
+ */
+class MidiActiveNotes
+{
+	static const unsigned int kChannels = 16;
+	static const unsigned int kWordsPerChannel = 2;
+
+public:
+	//! Tracking is enabled and no note is on
+	MidiActiveNotes();
+
+	//! Disabling forgets the notes tracked so far
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+
+	//! Follows the message sent to the port
+	void track(const MidiMessage& message)
+	{
+		const MidiMessage::data_type& bytes = message.data();
+		if (bytes.size() >= 3 && _enabled.load(std::memory_order_relaxed))
+		{
+			const unsigned char type = bytes[0] & 0xF0;
+			if (type == MidiMessage::NoteOn || type == MidiMessage::NoteOff)
+			{
+				std::atomic<unsigned long long>& word = _notes[bytes[0] & 0x0F][(bytes[1] & 0x7F) / 64];
+				const unsigned long long bit = 1ULL << (bytes[1] % 64);
+				if (type == MidiMessage::NoteOn && bytes[2] != 0)
+				{
+					word.fetch_or(bit, std::memory_order_relaxed);
+				}
+				else
+				{
+					word.fetch_and(~bit, std::memory_order_relaxed);
+				}
+			}
+			else if (type == MidiMessage::ControlChange)
+			{
+				trackChannelMode(bytes[0] & 0x0F, bytes[1]);
+			}
+		}
+		else if (bytes.size() == 1 && bytes[0] == MidiMessage::Reset)
+		{
+			forget();
+		}
+	}
+
+	//! Follows the message scheduled on the port, only a Note On is remembered
+	void trackScheduled(const MidiMessage& message)
+	{
+		const MidiMessage::data_type& bytes = message.data();
+		if (bytes.size() >= 3 && (bytes[0] & 0xF0) == MidiMessage::NoteOn && bytes[2] != 0 && _enabled.load(std::memory_order_relaxed))
+		{
+			_notes[bytes[0] & 0x0F][(bytes[1] & 0x7F) / 64].fetch_or(1ULL << (bytes[1] % 64), std::memory_order_relaxed);
+		}
+	}
+
+	/*!
+	 * Returns Note Off of every note that is on and forgets them, or All Notes Off of every channel
+	 * if tracking is disabled
+	 */
+	std::vector<MidiMessage> takeReleaseMessages();
+
+private:
+	void trackChannelMode(unsigned int channel, unsigned char controller);
+	void forget();
+
+private:
+	std::atomic<bool>               _enabled;
+	std::atomic<unsigned long long> _notes[kChannels][kWordsPerChannel];
+};
+
+//! \endcond
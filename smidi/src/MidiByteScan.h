@@ -0,0 +1,99 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiByteScan.h
+ * \warning This file is not a part of library public interface!
+ * Contains search of MIDI status bytes in raw byte stream, vectorized where the target supports it
+ */
+
+#include <cstddef>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#include <cstdint>
+#endif
+
+namespace MidiByteScan
+{
+	//! Returns index of the first byte with the high bit set, or `size` if there is none
+	inline std::size_t findStatusByteScalar(const unsigned char* data, std::size_t size)
+	{
+		std::size_t i = 0;
+		while (i < size && (data[i] & 0x80) == 0)
+		{
+			++i;
+		}
+		return i;
+	}
+
+#if defined(__AVX2__)
+	const char* const kVectorExtension = "AVX2";
+
+	//! Vectorized findStatusByteScalar(), movemask collects the high bits of 32 bytes at once
+	inline std::size_t findStatusByteVector(const unsigned char* data, std::size_t size)
+	{
+		std::size_t i = 0;
+		for (; i + 32 <= size; i += 32)
+		{
+			const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+			const unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(chunk));
+			if (mask != 0)
+			{
+				return i + static_cast<std::size_t>(__builtin_ctz(mask));
+			}
+		}
+		return i + findStatusByteScalar(data + i, size - i);
+	}
+#elif defined(__SSE2__)
+	const char* const kVectorExtension = "SSE2";
+
+	//! Vectorized findStatusByteScalar(), movemask collects the high bits of 16 bytes at once
+	inline std::size_t findStatusByteVector(const unsigned char* data, std::size_t size)
+	{
+		std::size_t i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(chunk));
+			if (mask != 0)
+			{
+				return i + static_cast<std::size_t>(__builtin_ctz(mask));
+			}
+		}
+		return i + findStatusByteScalar(data + i, size - i);
+	}
+#elif defined(__ARM_NEON)
+	const char* const kVectorExtension = "NEON";
+
+	//! Vectorized findStatusByteScalar(), there is no movemask so 16 bytes are narrowed to a 64 bit mask (4 bits per byte)
+	inline std::size_t findStatusByteVector(const unsigned char* data, std::size_t size)
+	{
+		std::size_t i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			const int8x16_t chunk = vreinterpretq_s8_u8(vld1q_u8(data + i));
+			const uint8x16_t highBits = vreinterpretq_u8_s8(vshrq_n_s8(chunk, 7));
+			const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(highBits), 4);
+			const std::uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+			if (mask != 0)
+			{
+				return i + static_cast<std::size_t>(__builtin_ctzll(mask) / 4);
+			}
+		}
+		return i + findStatusByteScalar(data + i, size - i);
+	}
+#else
+	const char* const kVectorExtension = "none";
+
+	inline std::size_t findStatusByteVector(const unsigned char* data, std::size_t size)
+	{
+		return findStatusByteScalar(data, size);
+	}
+#endif
+}
+
+//! \endcond
@@ -0,0 +1,412 @@
+/*!
+ * \file MidiCapture.cpp
+ * Contains implementation of MidiCapture class.
+ */
+
+#include "../include/smidi/MidiCapture.h"
+#include "MidiCaptureFormat.h"
+#include "MidiLogging.h"
+#include "MidiRingBuffer.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	const std::size_t kDefaultFileSize = 16 * 1024 * 1024;
+	const std::size_t kDefaultBlockSize = 64 * 1024;
+	const std::size_t kDefaultCapacity = 8192;
+	const std::size_t kMaxBlockSize = 0x7FFFFFFF;
+	const int kInvalidDescriptor = -1;
+
+	struct Entry
+	{
+		MidiMessage        message;
+		unsigned long long time;
+		std::size_t        port;
+	};
+}
+
+class MidiCapture::Implementation
+{
+public:
+	Implementation(const Options& options, std::shared_ptr<MidiClock> clock);
+	~Implementation();
+
+	std::size_t addPort(const std::string& name);
+	bool open(const std::string& path);
+	bool close();
+	bool isCapturing() const;
+	void capture(std::size_t port, const MidiMessage& message);
+	Counters counters() const;
+
+private:
+	bool map(const std::string& path, std::size_t size);
+	bool writeHeader();
+	void writerThread();
+	void drain();
+	void appendRecord(const Entry& entry);
+	void startBlock(unsigned long long time);
+
+private:
+	MidiRingBuffer<Entry>            _ring;
+	const std::shared_ptr<MidiClock> _clock;
+	std::atomic<bool>                _capturing;
+	std::atomic<unsigned long long>  _dropped;
+	std::vector<std::string>         _portNames;
+	const Options                    _options;
+	unsigned char*                   _mapping;
+	std::size_t                      _mappingSize;
+	std::size_t                      _blockSize;
+	std::size_t                      _blockCount;
+	std::size_t                      _blockIndex;
+	unsigned char*                   _block;
+	std::size_t                      _used;
+	std::size_t                      _records;
+	unsigned long long               _sequence;
+	unsigned long long               _previousTime;
+	std::atomic<unsigned long long>  _captured;
+	std::atomic<unsigned long long>  _overwritten;
+	std::atomic<unsigned long long>  _bytes;
+	std::mutex                       _mutex;
+	std::condition_variable          _condition;
+	bool                             _stop;
+	std::thread                      _thread;
+};
+
+MidiCapture::Implementation::Implementation(const Options& options, std::shared_ptr<MidiClock> clock)
+	: _ring(options.capacity)
+	, _clock(std::move(clock))
+	, _capturing(false)
+	, _dropped(0)
+	, _options(options)
+	, _mapping(nullptr)
+	, _mappingSize(0)
+	, _blockSize(std::min(std::max(options.blockSize, MidiCaptureFormat::kMinBlockSize), kMaxBlockSize))
+	, _blockCount(0)
+	, _blockIndex(0)
+	, _block(nullptr)
+	, _used(0)
+	, _records(0)
+	, _sequence(0)
+	, _previousTime(0)
+	, _captured(0)
+	, _overwritten(0)
+	, _bytes(0)
+	, _stop(false)
+{
+}
+
+MidiCapture::Implementation::~Implementation()
+{
+	close();
+}
+
+std::size_t MidiCapture::Implementation::addPort(const std::string& name)
+{
+	if (isCapturing())
+	{
+		SMIDI_LOG_WARNING("Port %s is added to running capture, its name is only stored by the next open()", name.c_str());
+	}
+	_portNames.push_back(name);
+	return _portNames.size() - 1;
+}
+
+bool MidiCapture::Implementation::open(const std::string& path)
+{
+	bool result = false;
+	if (!isCapturing())
+	{
+		_blockCount = (_options.fileSize > MidiCaptureFormat::kHeaderSize) ? (_options.fileSize - MidiCaptureFormat::kHeaderSize) / _blockSize : 0;
+		if (_blockCount >= 2)
+		{
+			result = map(path, MidiCaptureFormat::kHeaderSize + _blockCount * _blockSize) && writeHeader();
+		}
+		else
+		{
+			SMIDI_LOG_ERROR("Capture file of %zu bytes doesn't have room for two blocks of %zu bytes", _options.fileSize, _blockSize);
+		}
+
+		if (result)
+		{
+			// messages left from the previous capture don't belong to this one
+			while (_ring.front())
+			{
+				_ring.popFront();
+			}
+			_dropped = 0;
+			_captured = 0;
+			_overwritten = 0;
+			_bytes = 0;
+			_blockIndex = 0;
+			_block = nullptr;
+			_sequence = 0;
+
+			_stop = false;
+			_thread = std::thread(&MidiCapture::Implementation::writerThread, this);
+			_capturing.store(true, std::memory_order_release);
+		}
+		else if (_mapping)
+		{
+			munmap(_mapping, _mappingSize);
+			_mapping = nullptr;
+		}
+	}
+	return result;
+}
+
+bool MidiCapture::Implementation::close()
+{
+	bool result = false;
+	if (isCapturing())
+	{
+		_capturing.store(false, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_condition.notify_one();
+		if (_thread.joinable())
+		{
+			_thread.join();
+		}
+		drain();
+
+		// dirty pages are written back by the kernel after unmapping as well, there is nothing to wait for
+		munmap(_mapping, _mappingSize);
+		_mapping = nullptr;
+		_block = nullptr;
+		result = true;
+	}
+	return result;
+}
+
+bool MidiCapture::Implementation::isCapturing() const
+{
+	return _mapping != nullptr;
+}
+
+void MidiCapture::Implementation::capture(std::size_t port, const MidiMessage& message)
+{
+	if (_capturing.load(std::memory_order_acquire) && !message.isEmpty())
+	{
+		const unsigned long long time = (message.timestamp() != 0) ? message.timestamp() : _clock->now();
+		if (!_ring.push([&message, time, port](Entry& entry) { entry.message = message; entry.time = time; entry.port = port; }))
+		{
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+MidiCapture::Counters MidiCapture::Implementation::counters() const
+{
+	return Counters{_captured.load(std::memory_order_relaxed), _dropped.load(std::memory_order_relaxed),
+	                _overwritten.load(std::memory_order_relaxed), _bytes.load(std::memory_order_relaxed)};
+}
+
+bool MidiCapture::Implementation::map(const std::string& path, std::size_t size)
+{
+	bool result = false;
+	const int descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (descriptor != kInvalidDescriptor)
+	{
+		// the space is allocated now, a full disk must not turn into SIGBUS in the middle of the show
+		const int error = (ftruncate(descriptor, static_cast<off_t>(size)) == 0) ? posix_fallocate(descriptor, 0, static_cast<off_t>(size)) : errno;
+		if (error == 0)
+		{
+			void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+			if (mapping != MAP_FAILED)
+			{
+				_mapping = static_cast<unsigned char*>(mapping);
+				_mappingSize = size;
+				result = true;
+			}
+			else
+			{
+				SMIDI_LOG_ERROR("Couldn't map capture file %s because: %s", path.c_str(), std::strerror(errno));
+			}
+		}
+		else
+		{
+			SMIDI_LOG_ERROR("Couldn't allocate %zu bytes for capture file %s because: %s", size, path.c_str(), std::strerror(error));
+		}
+		// the mapping stays valid without the descriptor
+		::close(descriptor);
+	}
+	else
+	{
+		SMIDI_LOG_ERROR("Couldn't create capture file %s because: %s", path.c_str(), std::strerror(errno));
+	}
+	return result;
+}
+
+bool MidiCapture::Implementation::writeHeader()
+{
+	std::memcpy(_mapping, MidiCaptureFormat::kMagic, sizeof(MidiCaptureFormat::kMagic));
+	MidiCaptureFormat::store(_mapping + 8, MidiCaptureFormat::kVersion, 4);
+	MidiCaptureFormat::store(_mapping + 12, _blockSize, 4);
+	MidiCaptureFormat::store(_mapping + 16, _blockCount, 4);
+	MidiCaptureFormat::store(_mapping + 20, _portNames.size(), 4);
+
+	bool result = true;
+	std::size_t offset = MidiCaptureFormat::kNamesOffset;
+	for (const std::string& name : _portNames)
+	{
+		result = result && (offset + 2 + name.size() <= MidiCaptureFormat::kHeaderSize);
+		if (result)
+		{
+			MidiCaptureFormat::store(_mapping + offset, name.size(), 2);
+			std::memcpy(_mapping + offset + 2, name.data(), name.size());
+			offset += 2 + name.size();
+		}
+	}
+	if (!result)
+	{
+		SMIDI_LOG_ERROR("Names of %zu ports don't fit capture file header of %zu bytes", _portNames.size(), MidiCaptureFormat::kHeaderSize);
+	}
+	return result;
+}
+
+void MidiCapture::Implementation::writerThread()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_stop)
+	{
+		lock.unlock();
+		drain();
+		lock.lock();
+		_condition.wait_for(lock, _options.drainInterval, [this]() { return _stop; });
+	}
+}
+
+void MidiCapture::Implementation::drain()
+{
+	Entry* entry = nullptr;
+	while ((entry = _ring.front()) != nullptr)
+	{
+		appendRecord(*entry);
+		_ring.popFront();
+	}
+}
+
+void MidiCapture::Implementation::appendRecord(const Entry& entry)
+{
+	const MidiMessage::data_type& bytes = entry.message.data();
+	const std::size_t capacity = _blockSize - MidiCaptureFormat::kBlockHeaderSize;
+	if (MidiCaptureFormat::kMaxRecordHeaderSize + bytes.size() <= capacity)
+	{
+		if (!_block || _used + MidiCaptureFormat::kMaxRecordHeaderSize + bytes.size() > capacity)
+		{
+			startBlock(entry.time);
+		}
+
+		unsigned char* record = _block + MidiCaptureFormat::kBlockHeaderSize + _used;
+		std::size_t size = MidiCaptureFormat::storeVarint(record, MidiCaptureFormat::zigzag(entry.time, _previousTime));
+		size += MidiCaptureFormat::storeVarint(record + size, entry.port);
+		size += MidiCaptureFormat::storeVarint(record + size, bytes.size());
+		std::copy(bytes.begin(), bytes.end(), record + size);
+		size += bytes.size();
+		_previousTime = entry.time;
+		_used += size;
+		++_records;
+
+		// the record is complete in the mapping before the block says it is there, a crash can't leave half of it
+		std::atomic_signal_fence(std::memory_order_release);
+		MidiCaptureFormat::store(_block + MidiCaptureFormat::kBlockUsedOffset, _used, 4);
+		MidiCaptureFormat::store(_block + MidiCaptureFormat::kBlockRecordsOffset, _records, 4);
+
+		_captured.fetch_add(1, std::memory_order_relaxed);
+		_bytes.fetch_add(size, std::memory_order_relaxed);
+	}
+	else
+	{
+		SMIDI_LOG_DEBUG("Message of %zu bytes doesn't fit capture block of %zu bytes, dropped", bytes.size(), _blockSize);
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void MidiCapture::Implementation::startBlock(unsigned long long time)
+{
+	if (_block)
+	{
+		_blockIndex = (_blockIndex + 1) % _blockCount;
+	}
+	_block = _mapping + MidiCaptureFormat::kHeaderSize + _blockIndex * _blockSize;
+	if (MidiCaptureFormat::load(_block + MidiCaptureFormat::kBlockSequenceOffset, 8) != 0)
+	{
+		_overwritten.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// the block is marked unused while its header is rewritten
+	MidiCaptureFormat::store(_block + MidiCaptureFormat::kBlockSequenceOffset, 0, 8);
+	std::atomic_signal_fence(std::memory_order_release);
+	MidiCaptureFormat::store(_block + MidiCaptureFormat::kBlockTimeOffset, time, 8);
+	MidiCaptureFormat::store(_block + MidiCaptureFormat::kBlockUsedOffset, 0, 4);
+	MidiCaptureFormat::store(_block + MidiCaptureFormat::kBlockRecordsOffset, 0, 4);
+	std::atomic_signal_fence(std::memory_order_release);
+	MidiCaptureFormat::store(_block + MidiCaptureFormat::kBlockSequenceOffset, ++_sequence, 8);
+
+	_used = 0;
+	_records = 0;
+	_previousTime = time;
+}
+
+MidiCapture::Options::Options()
+	: fileSize(kDefaultFileSize)
+	, blockSize(kDefaultBlockSize)
+	, capacity(kDefaultCapacity)
+	, drainInterval(10)
+{
+}
+
+MidiCapture::MidiCapture(const Options& options, std::shared_ptr<MidiClock> clock)
+	: _impl(new Implementation(options, std::move(clock)))
+{
+}
+
+MidiCapture::~MidiCapture()
+{
+}
+
+std::size_t MidiCapture::addPort(const std::string& name)
+{
+	return _impl->addPort(name);
+}
+
+bool MidiCapture::open(const std::string& path)
+{
+	return _impl->open(path);
+}
+
+bool MidiCapture::close()
+{
+	return _impl->close();
+}
+
+bool MidiCapture::isCapturing() const
+{
+	return _impl->isCapturing();
+}
+
+void MidiCapture::capture(std::size_t port, const MidiMessage& message)
+{
+	_impl->capture(port, message);
+}
+
+MidiInPort::MessageHandler MidiCapture::handler(std::size_t port)
+{
+	Implementation* implementation = _impl.get();
+	return [implementation, port](const MidiMessage& message) { implementation->capture(port, message); };
+}
+
+MidiCapture::Counters MidiCapture::counters() const
+{
+	return _impl->counters();
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiCaptureFormat.h
+ * \warning This file is not a part of library public interface!
+ * Contains layout of MidiCapture files and encoding of their fields
+ */
+
+#include <cstddef>
+
+/*!
+ * File layout, all integers are little-endian:
+ *
+ * | Offset                   | Size        | Contents                                                      |
+ * |--------------------------|-------------|---------------------------------------------------------------|
+ * | 0                        | 8           | "SMIDICAP"                                                    |
+ * | 8                        | 4           | version                                                       |
+ * | 12                       | 4           | block size                                                    |
+ * | 16                       | 4           | block count                                                   |
+ * | 20                       | 4           | port count, followed by the names (2 bytes length and bytes)  |
+ * | kHeaderSize + i * block  | block size  | block i                                                       |
+ *
+ * Block: sequence (8 bytes, 0 - never written, the oldest block has the lowest), time of the first record (8),
+ * bytes of records used (4), number of records (4), records. Record: zigzag varint of the timestamp delta from
+ * the previous record (the first one from the block time), varint port, varint size, bytes.
+ */
+namespace MidiCaptureFormat
+{
+	const unsigned char kMagic[8] = {'S', 'M', 'I', 'D', 'I', 'C', 'A', 'P'};
+	const unsigned int kVersion = 1;
+	const std::size_t kHeaderSize = 4096;
+	const std::size_t kNamesOffset = 24;
+
+	const std::size_t kBlockSequenceOffset = 0;
+	const std::size_t kBlockTimeOffset = 8;
+	const std::size_t kBlockUsedOffset = 16;
+	const std::size_t kBlockRecordsOffset = 20;
+	const std::size_t kBlockHeaderSize = 24;
+	const std::size_t kMinBlockSize = 256;
+
+	//! Delta, port and size varints together take no more than this
+	const std::size_t kMaxRecordHeaderSize = 30;
+
+	inline void store(unsigned char* destination, unsigned long long value, std::size_t size)
+	{
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			destination[i] = static_cast<unsigned char>(value >> (8 * i));
+		}
+	}
+
+	inline unsigned long long load(const unsigned char* source, std::size_t size)
+	{
+		unsigned long long result = 0;
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			result |= static_cast<unsigned long long>(source[i]) << (8 * i);
+		}
+		return result;
+	}
+
+	//! Writes LEB128 varint, returns number of bytes written (at most 10)
+	inline std::size_t storeVarint(unsigned char* destination, unsigned long long value)
+	{
+		std::size_t size = 0;
+		while (value >= 0x80)
+		{
+			destination[size++] = static_cast<unsigned char>(value | 0x80);
+			value >>= 7;
+		}
+		destination[size++] = static_cast<unsigned char>(value);
+		return size;
+	}
+
+	//! Reads LEB128 varint, returns `false` if it is truncated or too long
+	inline bool loadVarint(const unsigned char*& position, const unsigned char* end, unsigned long long& value)
+	{
+		value = 0;
+		unsigned int shift = 0;
+		bool complete = false;
+		while (!complete && position < end && shift < 64)
+		{
+			const unsigned char byte = *position++;
+			value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+			complete = (byte & 0x80) == 0;
+			shift += 7;
+		}
+		return complete;
+	}
+
+	//! Maps signed deltas to unsigned, small magnitudes of both signs to small values
+	inline unsigned long long zigzag(unsigned long long time, unsigned long long previous)
+	{
+		const long long delta = static_cast<long long>(time - previous);
+		return (static_cast<unsigned long long>(delta) << 1) ^ static_cast<unsigned long long>(delta >> 63);
+	}
+
+	//! Reverse of zigzag(), returns the time
+	inline unsigned long long unzigzag(unsigned long long value, unsigned long long previous)
+	{
+		return previous + ((value >> 1) ^ (~(value & 1) + 1));
+	}
+}
+
+//! \endcond
@@ -0,0 +1,208 @@
+/*!
+ * \file MidiCaptureReader.cpp
+ * Contains implementation of MidiCaptureReader class and MidiCaptureRecord struct.
+ */
+
+#include "../include/smidi/MidiCapture.h"
+#include "MidiCaptureFormat.h"
+#include "MidiLogging.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+namespace
+{
+	const int kInvalidDescriptor = -1;
+}
+
+void MidiCaptureRecord::copyTo(MidiMessage& message) const
+{
+	message.resizeBuffer(size);
+	std::copy(data, data + size, static_cast<unsigned char*>(message));
+	message.setTimestamp(timestamp);
+}
+
+MidiMessage MidiCaptureRecord::toMessage() const
+{
+	MidiMessage result;
+	copyTo(result);
+	return result;
+}
+
+MidiCaptureReader::MidiCaptureReader()
+	: _data(nullptr)
+	, _size(0)
+	, _mapping(nullptr)
+	, _block(0)
+	, _position(nullptr)
+	, _time(0)
+{
+}
+
+MidiCaptureReader::~MidiCaptureReader()
+{
+	close();
+}
+
+bool MidiCaptureReader::open(const std::string& path)
+{
+	close();
+
+	const int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor != kInvalidDescriptor)
+	{
+		struct stat status = {};
+		if (fstat(descriptor, &status) == 0 && status.st_size > 0)
+		{
+			// shared, so a file that is still being captured into is seen as it is now
+			void* mapping = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, descriptor, 0);
+			if (mapping != MAP_FAILED)
+			{
+				_mapping = mapping;
+				_data = static_cast<const unsigned char*>(mapping);
+				_size = static_cast<std::size_t>(status.st_size);
+			}
+			else
+			{
+				SMIDI_LOG_ERROR("Couldn't map capture file %s because: %s", path.c_str(), std::strerror(errno));
+			}
+		}
+		else
+		{
+			SMIDI_LOG_ERROR("Capture file %s is empty or can't be read", path.c_str());
+		}
+		// the mapping stays valid without the descriptor
+		::close(descriptor);
+	}
+	else
+	{
+		SMIDI_LOG_ERROR("Couldn't open capture file %s because: %s", path.c_str(), std::strerror(errno));
+	}
+
+	const bool result = _data && parse();
+	if (!result)
+	{
+		close();
+	}
+	return result;
+}
+
+void MidiCaptureReader::close()
+{
+	if (_mapping)
+	{
+		munmap(_mapping, _size);
+		_mapping = nullptr;
+	}
+	_data = nullptr;
+	_size = 0;
+	_portNames.clear();
+	_blocks.clear();
+	rewind();
+}
+
+bool MidiCaptureReader::isOpen() const
+{
+	return _data != nullptr;
+}
+
+const std::vector<std::string>& MidiCaptureReader::portNames() const
+{
+	return _portNames;
+}
+
+bool MidiCaptureReader::next(MidiCaptureRecord& record)
+{
+	bool result = false;
+	while (!result && _block < _blocks.size())
+	{
+		const Block& block = _blocks[_block];
+		const unsigned char* position = _position;
+		unsigned long long delta = 0;
+		unsigned long long port = 0;
+		unsigned long long size = 0;
+		result = MidiCaptureFormat::loadVarint(position, block.end, delta) && MidiCaptureFormat::loadVarint(position, block.end, port)
+		         && MidiCaptureFormat::loadVarint(position, block.end, size) && size > 0 && size <= static_cast<unsigned long long>(block.end - position);
+		if (result)
+		{
+			_time = MidiCaptureFormat::unzigzag(delta, _time);
+			record.timestamp = _time;
+			record.data = position;
+			record.size = static_cast<std::size_t>(size);
+			record.port = static_cast<std::size_t>(port);
+			_position = position + size;
+		}
+		else
+		{
+			// the end of the block, or the block was being overwritten when it was read
+			++_block;
+			_position = (_block < _blocks.size()) ? _blocks[_block].begin : nullptr;
+			_time = (_block < _blocks.size()) ? _blocks[_block].baseTime : 0;
+		}
+	}
+	return result;
+}
+
+void MidiCaptureReader::rewind()
+{
+	_block = 0;
+	_position = _blocks.empty() ? nullptr : _blocks.front().begin;
+	_time = _blocks.empty() ? 0 : _blocks.front().baseTime;
+}
+
+bool MidiCaptureReader::parse()
+{
+	bool result = _size >= MidiCaptureFormat::kHeaderSize && std::equal(std::begin(MidiCaptureFormat::kMagic), std::end(MidiCaptureFormat::kMagic), _data)
+	              && MidiCaptureFormat::load(_data + 8, 4) == MidiCaptureFormat::kVersion;
+	const std::size_t blockSize = result ? static_cast<std::size_t>(MidiCaptureFormat::load(_data + 12, 4)) : 0;
+	const std::size_t blockCount = result ? static_cast<std::size_t>(MidiCaptureFormat::load(_data + 16, 4)) : 0;
+	const std::size_t portCount = result ? static_cast<std::size_t>(MidiCaptureFormat::load(_data + 20, 4)) : 0;
+	result = result && blockSize >= MidiCaptureFormat::kMinBlockSize && blockCount <= (_size - MidiCaptureFormat::kHeaderSize) / blockSize;
+
+	std::size_t offset = MidiCaptureFormat::kNamesOffset;
+	for (std::size_t i = 0; result && i < portCount; ++i)
+	{
+		result = offset + 2 <= MidiCaptureFormat::kHeaderSize;
+		const std::size_t length = result ? static_cast<std::size_t>(MidiCaptureFormat::load(_data + offset, 2)) : 0;
+		result = result && offset + 2 + length <= MidiCaptureFormat::kHeaderSize;
+		if (result)
+		{
+			_portNames.emplace_back(reinterpret_cast<const char*>(_data + offset + 2), length);
+			offset += 2 + length;
+		}
+	}
+
+	if (result)
+	{
+		std::vector<std::pair<unsigned long long, std::size_t>> sequences;
+		for (std::size_t i = 0; i < blockCount; ++i)
+		{
+			const unsigned long long sequence = MidiCaptureFormat::load(_data + MidiCaptureFormat::kHeaderSize + i * blockSize + MidiCaptureFormat::kBlockSequenceOffset, 8);
+			if (sequence != 0)
+			{
+				sequences.emplace_back(sequence, i);
+			}
+		}
+		std::sort(sequences.begin(), sequences.end());
+
+		for (const std::pair<unsigned long long, std::size_t>& sequence : sequences)
+		{
+			const unsigned char* block = _data + MidiCaptureFormat::kHeaderSize + sequence.second * blockSize;
+			const std::size_t used = static_cast<std::size_t>(MidiCaptureFormat::load(block + MidiCaptureFormat::kBlockUsedOffset, 4));
+			const unsigned char* begin = block + MidiCaptureFormat::kBlockHeaderSize;
+			_blocks.push_back(Block{begin, begin + std::min(used, blockSize - MidiCaptureFormat::kBlockHeaderSize), MidiCaptureFormat::load(block + MidiCaptureFormat::kBlockTimeOffset, 8)});
+		}
+		rewind();
+	}
+	else
+	{
+		SMIDI_LOG_ERROR("Not a capture file or unsupported version");
+	}
+	return result;
+}
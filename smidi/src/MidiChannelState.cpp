@@ -0,0 +1,418 @@
+/*!
+ * \file MidiChannelState.cpp
+ * Contains implementation of MidiChannelState class.
+ */
+
+#include "../include/smidi/MidiChannelState.h"
+#include <atomic>
+#include <thread>
+
+namespace
+{
+	const std::size_t kTableSize = MidiChannelState::kChannels * 128;
+	const std::size_t kTableWords = kTableSize / 8;
+	const unsigned long long kAllUnknown = ~0ULL;
+	const unsigned long long kChannelUnknown = 0xFFFFFFFFULL;
+	const unsigned int kPitchBendCenter = 8192;
+
+	// controllers of Reset All Controllers (RP-015) and the values they are reset to
+	const unsigned char kResetControllers[][2] = {{1, 0}, {11, 127}, {64, 0}, {65, 0}, {66, 0}, {67, 0}, {98, 127}, {99, 127}, {100, 127}, {101, 127}};
+
+	const unsigned char kBankSelect = 0;
+	const unsigned char kBankSelectLsb = 32;
+	const unsigned char kFirstChannelMode = 120;
+	const unsigned char kResetAllControllers = 121;
+	const unsigned char kLocalControl = 122;
+
+	//! Controllers restoreMessages() doesn't replay: data entry and increments act on the selected (N)RPN
+	bool isRestorable(unsigned int number)
+	{
+		return number != kBankSelect && number != kBankSelectLsb && number != 6 && number != 38 && (number < 96 || number > 101) && number < kFirstChannelMode;
+	}
+
+	/*!
+	 * Table of 2048 bytes packed in 64-bit words, so a snapshot is 256 loads. Only one thread writes, a byte
+	 * is updated with a load and a store of its word instead of a read-modify-write instruction.
+	 */
+	class ByteTable
+	{
+	public:
+		explicit ByteTable(unsigned long long initial)
+		{
+			fill(initial);
+		}
+
+		void fill(unsigned long long word)
+		{
+			for (std::atomic<unsigned long long>& item : _words)
+			{
+				item.store(word, std::memory_order_relaxed);
+			}
+		}
+
+		void fillChannel(unsigned int channel, unsigned long long word)
+		{
+			for (std::size_t i = 0; i < 128 / 8; ++i)
+			{
+				_words[channel * 128 / 8 + i].store(word, std::memory_order_relaxed);
+			}
+		}
+
+		unsigned char get(unsigned int channel, unsigned int number) const
+		{
+			const std::size_t index = (channel & 0x0F) * 128 + (number & 0x7F);
+			return static_cast<unsigned char>(_words[index / 8].load(std::memory_order_relaxed) >> (8 * (index % 8)));
+		}
+
+		void set(unsigned int channel, unsigned int number, unsigned char value)
+		{
+			const std::size_t index = channel * 128 + number;
+			std::atomic<unsigned long long>& word = _words[index / 8];
+			const unsigned int shift = 8 * (index % 8);
+			word.store((word.load(std::memory_order_relaxed) & ~(0xFFULL << shift)) | (static_cast<unsigned long long>(value) << shift), std::memory_order_relaxed);
+		}
+
+		void copyTo(unsigned char* bytes) const
+		{
+			for (std::size_t i = 0; i < kTableWords; ++i)
+			{
+				const unsigned long long word = _words[i].load(std::memory_order_relaxed);
+				for (std::size_t j = 0; j < 8; ++j)
+				{
+					bytes[i * 8 + j] = static_cast<unsigned char>(word >> (8 * j));
+				}
+			}
+		}
+
+	private:
+		std::atomic<unsigned long long> _words[kTableWords];
+	};
+}
+
+const unsigned char MidiChannelState::kUnknown;
+const unsigned int MidiChannelState::kUnknownPitchBend;
+const unsigned int MidiChannelState::kChannels;
+
+class MidiChannelState::Implementation
+{
+public:
+	Implementation();
+
+	void process(const MidiMessage& message);
+	void reset();
+
+	unsigned char controller(unsigned int channel, unsigned int number) const;
+	unsigned char noteVelocity(unsigned int channel, unsigned int note) const;
+	unsigned char polyPressure(unsigned int channel, unsigned int note) const;
+	unsigned char program(unsigned int channel) const;
+	unsigned char channelPressure(unsigned int channel) const;
+	unsigned int pitchBend(unsigned int channel) const;
+	Snapshot snapshot() const;
+
+private:
+	unsigned int beginChange();
+	void apply(unsigned char status, unsigned char first, unsigned char second);
+	void resetControllers(unsigned int channel);
+	void setChannel(unsigned int channel, unsigned int shift, unsigned long long mask, unsigned long long value);
+	unsigned long long channelWord(unsigned int channel) const;
+
+private:
+	// odd while a writer is in the middle of a change
+	std::atomic<unsigned int>       _sequence;
+	ByteTable                       _controllers;
+	ByteTable                       _notes;
+	ByteTable                       _polyPressure;
+	// program in byte 0, pressure in byte 1, pitch bend in bytes 2 and 3
+	std::atomic<unsigned long long> _channels[kChannels];
+};
+
+MidiChannelState::Implementation::Implementation()
+	: _sequence(0)
+	, _controllers(kAllUnknown)
+	, _notes(0)
+	, _polyPressure(kAllUnknown)
+{
+	for (std::atomic<unsigned long long>& channel : _channels)
+	{
+		channel.store(kChannelUnknown, std::memory_order_relaxed);
+	}
+}
+
+void MidiChannelState::Implementation::process(const MidiMessage& message)
+{
+	const MidiMessage::data_type& bytes = message.data();
+	const unsigned char status = bytes.empty() ? 0 : bytes.front();
+	const unsigned char type = status & 0xF0;
+	const std::size_t size = (type == MidiMessage::ProgramChange || type == MidiMessage::ChannelPressure) ? 2 : 3;
+	const bool isChannelMessage = (status >= MidiMessage::NoteOff && status < MidiMessage::System && bytes.size() >= size);
+	if (isChannelMessage || status == MidiMessage::Reset)
+	{
+		const unsigned int sequence = beginChange();
+		if (isChannelMessage)
+		{
+			apply(status, bytes[1] & 0x7F, (size == 3) ? bytes[2] & 0x7F : 0);
+		}
+		else
+		{
+			// System Reset puts the receivers into their power-up state, whatever it is
+			_controllers.fill(kAllUnknown);
+			_notes.fill(0);
+			_polyPressure.fill(kAllUnknown);
+			for (std::atomic<unsigned long long>& channel : _channels)
+			{
+				channel.store(kChannelUnknown, std::memory_order_relaxed);
+			}
+		}
+		_sequence.store(sequence + 2, std::memory_order_release);
+	}
+}
+
+void MidiChannelState::Implementation::reset()
+{
+	process(MidiMessage({MidiMessage::Reset}));
+}
+
+unsigned char MidiChannelState::Implementation::controller(unsigned int channel, unsigned int number) const
+{
+	return _controllers.get(channel, number);
+}
+
+unsigned char MidiChannelState::Implementation::noteVelocity(unsigned int channel, unsigned int note) const
+{
+	return _notes.get(channel, note);
+}
+
+unsigned char MidiChannelState::Implementation::polyPressure(unsigned int channel, unsigned int note) const
+{
+	return _polyPressure.get(channel, note);
+}
+
+unsigned char MidiChannelState::Implementation::program(unsigned int channel) const
+{
+	return static_cast<unsigned char>(channelWord(channel));
+}
+
+unsigned char MidiChannelState::Implementation::channelPressure(unsigned int channel) const
+{
+	return static_cast<unsigned char>(channelWord(channel) >> 8);
+}
+
+unsigned int MidiChannelState::Implementation::pitchBend(unsigned int channel) const
+{
+	return static_cast<unsigned int>((channelWord(channel) >> 16) & 0xFFFF);
+}
+
+MidiChannelState::Snapshot MidiChannelState::Implementation::snapshot() const
+{
+	Snapshot result;
+	unsigned int before = 0;
+	unsigned int after = 0;
+	do
+	{
+		before = _sequence.load(std::memory_order_acquire);
+		_controllers.copyTo(&result.controllers[0][0]);
+		_notes.copyTo(&result.notes[0][0]);
+		_polyPressure.copyTo(&result.polyPressure[0][0]);
+		for (unsigned int channel = 0; channel < kChannels; ++channel)
+		{
+			const unsigned long long word = _channels[channel].load(std::memory_order_relaxed);
+			result.programs[channel] = static_cast<unsigned char>(word);
+			result.pressures[channel] = static_cast<unsigned char>(word >> 8);
+			result.pitchBends[channel] = static_cast<unsigned short>(word >> 16);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = _sequence.load(std::memory_order_relaxed);
+	}
+	while ((before & 1) != 0 || before != after);
+	return result;
+}
+
+unsigned int MidiChannelState::Implementation::beginChange()
+{
+	// reset() may come from another thread than the feeding one, making the sequence odd is the writers' lock:
+	// uncontended it costs one compare and swap, the feeding thread waits only while a reset is in progress
+	unsigned int sequence = _sequence.load(std::memory_order_relaxed);
+	while ((sequence & 1) != 0 || !_sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed))
+	{
+		std::this_thread::yield();
+		sequence = _sequence.load(std::memory_order_relaxed);
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	return sequence;
+}
+
+void MidiChannelState::Implementation::apply(unsigned char status, unsigned char first, unsigned char second)
+{
+	const unsigned int channel = status & 0x0F;
+	switch (status & 0xF0)
+	{
+	case MidiMessage::NoteOff:
+		_notes.set(channel, first, 0);
+		break;
+	case MidiMessage::NoteOn:
+		_notes.set(channel, first, second);
+		break;
+	case MidiMessage::AfterTouch:
+		_polyPressure.set(channel, first, second);
+		break;
+	case MidiMessage::ControlChange:
+		if (first < kFirstChannelMode)
+		{
+			_controllers.set(channel, first, second);
+		}
+		else if (first == kResetAllControllers)
+		{
+			resetControllers(channel);
+		}
+		else if (first != kLocalControl)
+		{
+			// All Sound Off, All Notes Off and the mode changes release all notes
+			_notes.fillChannel(channel, 0);
+		}
+		break;
+	case MidiMessage::ProgramChange:
+		setChannel(channel, 0, 0xFF, first);
+		break;
+	case MidiMessage::ChannelPressure:
+		setChannel(channel, 8, 0xFF, first);
+		break;
+	case MidiMessage::PitchWheel:
+		setChannel(channel, 16, 0xFFFF, first | (second << 7));
+		break;
+	}
+}
+
+void MidiChannelState::Implementation::resetControllers(unsigned int channel)
+{
+	for (const unsigned char (&controller)[2] : kResetControllers)
+	{
+		_controllers.set(channel, controller[0], controller[1]);
+	}
+	_polyPressure.fillChannel(channel, 0);
+	setChannel(channel, 8, 0xFF, 0);
+	setChannel(channel, 16, 0xFFFF, kPitchBendCenter);
+}
+
+void MidiChannelState::Implementation::setChannel(unsigned int channel, unsigned int shift, unsigned long long mask, unsigned long long value)
+{
+	std::atomic<unsigned long long>& word = _channels[channel];
+	word.store((word.load(std::memory_order_relaxed) & ~(mask << shift)) | (value << shift), std::memory_order_relaxed);
+}
+
+unsigned long long MidiChannelState::Implementation::channelWord(unsigned int channel) const
+{
+	return _channels[channel & 0x0F].load(std::memory_order_relaxed);
+}
+
+std::vector<MidiMessage> MidiChannelState::Snapshot::restoreMessages(bool includeNotes) const
+{
+	std::vector<MidiMessage> result;
+	for (unsigned int channel = 0; channel < kChannels; ++channel)
+	{
+		const unsigned char control = static_cast<unsigned char>(MidiMessage::ControlChange | channel);
+		// the bank is selected before the program change that uses it
+		for (unsigned char number : {kBankSelect, kBankSelectLsb})
+		{
+			if (controllers[channel][number] != kUnknown)
+			{
+				result.push_back(MidiMessage({control, number, controllers[channel][number]}));
+			}
+		}
+		if (programs[channel] != kUnknown)
+		{
+			result.push_back(MidiMessage({static_cast<unsigned char>(MidiMessage::ProgramChange | channel), programs[channel]}));
+		}
+		for (unsigned int number = 0; number < 128; ++number)
+		{
+			if (controllers[channel][number] != kUnknown && isRestorable(number))
+			{
+				result.push_back(MidiMessage({control, static_cast<unsigned char>(number), controllers[channel][number]}));
+			}
+		}
+		if (pitchBends[channel] != kUnknownPitchBend)
+		{
+			result.push_back(MidiMessage({static_cast<unsigned char>(MidiMessage::PitchWheel | channel), static_cast<unsigned char>(pitchBends[channel] & 0x7F), static_cast<unsigned char>(pitchBends[channel] >> 7)}));
+		}
+		if (pressures[channel] != kUnknown)
+		{
+			result.push_back(MidiMessage({static_cast<unsigned char>(MidiMessage::ChannelPressure | channel), pressures[channel]}));
+		}
+		for (unsigned int note = 0; includeNotes && note < 128; ++note)
+		{
+			if (notes[channel][note] != 0)
+			{
+				result.push_back(MidiMessage({static_cast<unsigned char>(MidiMessage::NoteOn | channel), static_cast<unsigned char>(note), notes[channel][note]}));
+				if (polyPressure[channel][note] != kUnknown)
+				{
+					result.push_back(MidiMessage({static_cast<unsigned char>(MidiMessage::AfterTouch | channel), static_cast<unsigned char>(note), polyPressure[channel][note]}));
+				}
+			}
+		}
+	}
+	return result;
+}
+
+MidiChannelState::MidiChannelState()
+	: _impl(new Implementation())
+{
+}
+
+MidiChannelState::~MidiChannelState()
+{
+}
+
+void MidiChannelState::process(const MidiMessage& message)
+{
+	_impl->process(message);
+}
+
+MidiInPort::MessageHandler MidiChannelState::handler()
+{
+	Implementation* implementation = _impl.get();
+	return [implementation](const MidiMessage& message) { implementation->process(message); };
+}
+
+void MidiChannelState::reset()
+{
+	_impl->reset();
+}
+
+unsigned char MidiChannelState::controller(unsigned int channel, unsigned int number) const
+{
+	return _impl->controller(channel, number);
+}
+
+unsigned char MidiChannelState::noteVelocity(unsigned int channel, unsigned int note) const
+{
+	return _impl->noteVelocity(channel, note);
+}
+
+unsigned char MidiChannelState::polyPressure(unsigned int channel, unsigned int note) const
+{
+	return _impl->polyPressure(channel, note);
+}
+
+unsigned char MidiChannelState::program(unsigned int channel) const
+{
+	return _impl->program(channel);
+}
+
+unsigned char MidiChannelState::channelPressure(unsigned int channel) const
+{
+	return _impl->channelPressure(channel);
+}
+
+unsigned int MidiChannelState::pitchBend(unsigned int channel) const
+{
+	return _impl->pitchBend(channel);
+}
+
+MidiChannelState::Snapshot MidiChannelState::snapshot() const
+{
+	return _impl->snapshot();
+}
+
+std::vector<MidiMessage> MidiChannelState::restoreMessages(bool includeNotes) const
+{
+	return snapshot().restoreMessages(includeNotes);
+}
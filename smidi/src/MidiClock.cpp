@@ -0,0 +1,89 @@
+/*!
+ * \file MidiClock.cpp
+ * Contains implementation of MidiClock and MidiSimulatedClock classes.
+ */
+
+#include "../include/smidi/MidiClock.h"
+#include "../include/smidi/MidiTimestamp.h"
+#include <cerrno>
+#include <chrono>
+#include <time.h>
+
+namespace
+{
+	// sleeping threads of the manual clock check for commands (e.g. stop) at least this often
+	const std::chrono::milliseconds kManualSleepSlice(10);
+
+	class MidiSystemClock : public MidiClock
+	{
+	public:
+		virtual unsigned long long now() const override
+		{
+			return MidiTimestamp::now();
+		}
+
+		virtual void sleepUntil(unsigned long long time) override
+		{
+			const timespec wakeUpTime = MidiTimestamp::toTimespec(time);
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeUpTime, nullptr) == EINTR)
+			{
+			}
+		}
+	};
+}
+
+std::shared_ptr<MidiClock> MidiClock::system()
+{
+	static const std::shared_ptr<MidiClock> clock = std::make_shared<MidiSystemClock>();
+	return clock;
+}
+
+MidiSimulatedClock::MidiSimulatedClock(Mode mode, unsigned long long startTime)
+	: _mode(mode)
+	, _now(startTime)
+{
+}
+
+unsigned long long MidiSimulatedClock::now() const
+{
+	return _now;
+}
+
+void MidiSimulatedClock::sleepUntil(unsigned long long time)
+{
+	if (_mode == Mode::Instant)
+	{
+		advanceTo(time);
+	}
+	else
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_advanced.wait_for(lock, kManualSleepSlice, [this, time]() { return _now >= time; });
+	}
+}
+
+MidiSimulatedClock::Mode MidiSimulatedClock::mode() const
+{
+	return _mode;
+}
+
+void MidiSimulatedClock::advance(unsigned long long interval)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_now += interval;
+	}
+	_advanced.notify_all();
+}
+
+void MidiSimulatedClock::advanceTo(unsigned long long time)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (time > _now)
+		{
+			_now = time;
+		}
+	}
+	_advanced.notify_all();
+}
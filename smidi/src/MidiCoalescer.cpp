@@ -0,0 +1,295 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiCoalescer.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiCoalescer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const unsigned long long kNanosecondsInASecond = 1000000000ULL;
+	const unsigned char kDataEntryMsb = 6;
+	const unsigned char kDataEntryLsb = 38;
+	const unsigned char kDataIncrement = 96;
+	const unsigned char kRpnMsb = 101;
+	const unsigned char kFirstChannelMode = 120;
+	const unsigned int kLsbOffset = 32;
+}
+
+MidiCoalescer::MidiCoalescer(Sender sender, MidiPortCounters& counters, std::shared_ptr<MidiClock> clock)
+	: _sender(std::move(sender))
+	, _counters(counters)
+	, _clock(std::move(clock))
+	, _isEnabled(false)
+	, _exit(false)
+	, _nanosecondsPerByte(0)
+	, _wireFreeTime(0)
+	, _pendingCount(0)
+	, _batchSize(0)
+{
+	std::memset(_slots, 0, sizeof(_slots));
+	std::memset(_pending, 0, sizeof(_pending));
+}
+
+MidiCoalescer::~MidiCoalescer()
+{
+	close();
+}
+
+void MidiCoalescer::setCoalescing(const MidiOutPort::Coalescing& coalescing)
+{
+	if (coalescing.interval.count() > 0)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_coalescing = coalescing;
+		_nanosecondsPerByte = (coalescing.bytesPerSecond > 0) ? kNanosecondsInASecond / coalescing.bytesPerSecond : 0;
+		_batch.reserve(kChannels * kSlotsPerChannel);
+		_isEnabled = true;
+		if (!_thread.joinable())
+		{
+			_exit = false;
+			_thread = std::thread(&MidiCoalescer::flusherThread, this);
+		}
+	}
+	else
+	{
+		close();
+		std::lock_guard<std::mutex> lock(_mutex);
+		_coalescing = coalescing;
+	}
+}
+
+MidiOutPort::Coalescing MidiCoalescer::coalescing() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _coalescing;
+}
+
+void MidiCoalescer::send(const MidiMessage* messages, std::size_t count)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	const unsigned long long now = _clock->now();
+	const unsigned long long interval = static_cast<unsigned long long>(_coalescing.interval.count());
+	const unsigned int pendingCount = _pendingCount;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const MidiMessage::data_type& bytes = messages[i].data();
+		// a sender which saw coalescing enabled just before close() gets everything through
+		const unsigned int slot = _isEnabled ? slotOf(bytes) : kNoSlot;
+		if (slot == kNoSlot)
+		{
+			// the waiting values go first, so the receiver sees the messages of a channel in order
+			const unsigned char status = bytes.empty() ? 0 : bytes.front();
+			if (status >= MidiMessage::NoteOff && status < MidiMessage::System)
+			{
+				appendPending(status & 0x0F, now, false);
+			}
+			else if (status >= MidiMessage::System && (status < MidiMessage::MidiClock || status == MidiMessage::Reset))
+			{
+				for (unsigned int channel = 0; channel < kChannels; ++channel)
+				{
+					appendPending(channel, now, false);
+				}
+			}
+			appendMessage(bytes.size(), now) = messages[i];
+		}
+		else
+		{
+			const unsigned int channel = bytes[0] & 0x0F;
+			Slot& state = _slots[channel][slot];
+			const bool waitsForMsb = (slot >= kLsbOffset && slot < 2 * kLsbOffset && _slots[channel][slot - kLsbOffset].isPending);
+			if (!state.isPending && !waitsForMsb && now >= state.lastSent + interval && backlog(now) < interval)
+			{
+				appendMessage(bytes.size(), now) = messages[i];
+				state.lastSent = now;
+			}
+			else
+			{
+				if (state.isPending)
+				{
+					_counters.countCoalesced();
+				}
+				else
+				{
+					state.isPending = true;
+					++_pending[channel];
+					++_pendingCount;
+				}
+				std::copy(bytes.begin(), bytes.end(), state.bytes);
+				state.size = static_cast<unsigned char>(bytes.size());
+			}
+		}
+	}
+	sendBatch();
+
+	if (pendingCount == 0 && _pendingCount > 0)
+	{
+		_condition.notify_one();
+	}
+}
+
+void MidiCoalescer::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_isEnabled = false;
+		_exit = true;
+		const unsigned long long now = _clock->now();
+		for (unsigned int channel = 0; channel < kChannels; ++channel)
+		{
+			appendPending(channel, now, false);
+		}
+		sendBatch();
+	}
+	_condition.notify_one();
+	if (_thread.joinable())
+	{
+		_thread.join();
+	}
+}
+
+void MidiCoalescer::reopen()
+{
+	const MidiOutPort::Coalescing settings = coalescing();
+	if (settings.interval.count() > 0)
+	{
+		setCoalescing(settings);
+	}
+}
+
+unsigned int MidiCoalescer::slotOf(const MidiMessage::data_type& bytes)
+{
+	unsigned int result = kNoSlot;
+	const unsigned char type = bytes.empty() ? 0 : (bytes[0] & 0xF0);
+	if (type == MidiMessage::ControlChange && bytes.size() == 3)
+	{
+		// data entry and (N)RPN numbers only mean something in their sequence, mode messages are commands
+		const unsigned char controller = bytes[1] & 0x7F;
+		const bool isSequence = (controller == kDataEntryMsb || controller == kDataEntryLsb || (controller >= kDataIncrement && controller <= kRpnMsb));
+		if (!isSequence && controller < kFirstChannelMode)
+		{
+			result = controller;
+		}
+	}
+	else if (type == MidiMessage::PitchWheel && bytes.size() == 3)
+	{
+		result = kPitchBendSlot;
+	}
+	else if (type == MidiMessage::ChannelPressure && bytes.size() == 2)
+	{
+		result = kChannelPressureSlot;
+	}
+	return result;
+}
+
+unsigned long long MidiCoalescer::backlog(unsigned long long now) const
+{
+	return (_wireFreeTime > now) ? _wireFreeTime - now : 0;
+}
+
+MidiMessage& MidiCoalescer::appendMessage(std::size_t size, unsigned long long now)
+{
+	// the wire is busy with the earlier messages, this one takes its place after them
+	_wireFreeTime = std::max(_wireFreeTime, now) + size * _nanosecondsPerByte;
+	if (_batchSize == _batch.size())
+	{
+		_batch.emplace_back();
+	}
+	return _batch[_batchSize++];
+}
+
+void MidiCoalescer::appendPending(unsigned int channel, unsigned long long now, bool onlyDue)
+{
+	const unsigned long long interval = static_cast<unsigned long long>(_coalescing.interval.count());
+	// slots go in ascending order, so the MSB of a 14-bit controller is sent before its LSB
+	for (unsigned int slot = 0; slot < kSlotsPerChannel && _pending[channel] > 0; ++slot)
+	{
+		Slot& state = _slots[channel][slot];
+		const bool waitsForMsb = (slot >= kLsbOffset && slot < 2 * kLsbOffset && _slots[channel][slot - kLsbOffset].isPending);
+		if (state.isPending && (!onlyDue || (!waitsForMsb && now >= state.lastSent + interval && backlog(now) < interval)))
+		{
+			MidiMessage& message = appendMessage(state.size, now);
+			message.resizeBuffer(state.size);
+			std::copy(state.bytes, state.bytes + state.size, static_cast<unsigned char*>(message));
+			message.setTimestamp(now);
+			state.isPending = false;
+			state.lastSent = now;
+			--_pending[channel];
+			--_pendingCount;
+		}
+	}
+}
+
+void MidiCoalescer::sendBatch()
+{
+	if (_batchSize > 0)
+	{
+		_sender(_batch.data(), _batchSize);
+		_batchSize = 0;
+	}
+}
+
+unsigned long long MidiCoalescer::nextDueTime(unsigned long long now) const
+{
+	const unsigned long long interval = static_cast<unsigned long long>(_coalescing.interval.count());
+	unsigned long long result = now + interval;
+	for (unsigned int channel = 0; channel < kChannels; ++channel)
+	{
+		for (unsigned int slot = 0; slot < kSlotsPerChannel && _pending[channel] > 0; ++slot)
+		{
+			if (_slots[channel][slot].isPending)
+			{
+				result = std::min(result, _slots[channel][slot].lastSent + interval);
+			}
+		}
+	}
+	if (backlog(now) >= interval)
+	{
+		result = std::max(result, _wireFreeTime - interval);
+	}
+	// the thread checks for exit at least once per interval
+	return std::max(std::min(result, now + interval), now + 1);
+}
+
+void MidiCoalescer::flusherThread()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_exit)
+	{
+		if (_pendingCount == 0)
+		{
+			_condition.wait(lock, [this]() { return _exit || _pendingCount > 0; });
+		}
+		else
+		{
+			const unsigned long long now = _clock->now();
+			for (unsigned int channel = 0; channel < kChannels; ++channel)
+			{
+				appendPending(channel, now, true);
+			}
+			sendBatch();
+
+			if (_pendingCount > 0)
+			{
+				const unsigned long long dueTime = nextDueTime(now);
+				if (_clock == MidiClock::system())
+				{
+					// close() wakes the thread up right away
+					_condition.wait_for(lock, std::chrono::nanoseconds(dueTime > now ? dueTime - now : 0), [this]() { return _exit; });
+				}
+				else
+				{
+					lock.unlock();
+					_clock->sleepUntil(dueTime);
+					lock.lock();
+				}
+			}
+		}
+	}
+}
+
+//! \endcond
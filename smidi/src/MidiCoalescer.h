@@ -0,0 +1,103 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiCoalescer.h
+ * \warning This file is not a part of library public interface!
+ * Contains coalescing stage of output ports
+ */
+
+#include "../include/smidi/MidiClock.h"
+#include "../include/smidi/MidiDelegate.h"
+#include "../include/smidi/MidiOutPort.h"
+#include "MidiMetricsCounters.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * \brief The MidiCoalescer class holds back continuous controller values sent too often, see MidiOutPort::setCoalescing()
+ * \class MidiCoalescer MidiCoalescer.h "MidiCoalescer.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Every channel has a slot per controller, Pitch Bend and Channel Pressure with the time its value was last sent
+ * and the value waiting to be sent. Messages pass to the sender with the mutex held, so the flusher thread and
+ * the sending threads never reorder them. The occupancy of the wire is estimated from the bytes sent so far.
+ * When coalescing is disabled send() is not to be called, the port sends directly.
+ */
+class MidiCoalescer
+{
+	static const unsigned int kChannels = 16;
+	static const unsigned int kPitchBendSlot = 128;
+	static const unsigned int kChannelPressureSlot = 129;
+	static const unsigned int kSlotsPerChannel = 130;
+	static const unsigned int kNoSlot = kSlotsPerChannel;
+
+public:
+	//! Type of the function which writes messages to the port
+	using Sender = MidiDelegate<void(const MidiMessage* messages, std::size_t count)>;
+
+	MidiCoalescer(Sender sender, MidiPortCounters& counters, std::shared_ptr<MidiClock> clock);
+	~MidiCoalescer();
+
+	//! Starts or stops coalescing, the values waiting when it stops are sent
+	void setCoalescing(const MidiOutPort::Coalescing& coalescing);
+	MidiOutPort::Coalescing coalescing() const;
+
+	//! Returns `true` if send() is to be used instead of sending directly
+	bool isEnabled() const
+	{
+		return _isEnabled.load(std::memory_order_relaxed);
+	}
+
+	//! Sends the messages or holds back the values sent too often
+	void send(const MidiMessage* messages, std::size_t count);
+
+	//! Sends the waiting values and stops the flusher thread, must be called before the port the sender writes to is closed
+	void close();
+
+	//! Starts coalescing again with the settings it had before close(), for a port that is opened again
+	void reopen();
+
+private:
+	struct Slot
+	{
+		unsigned long long lastSent;
+		unsigned char      bytes[3];
+		unsigned char      size;
+		bool               isPending;
+	};
+
+	static unsigned int slotOf(const MidiMessage::data_type& bytes);
+
+	unsigned long long backlog(unsigned long long now) const;
+	MidiMessage& appendMessage(std::size_t size, unsigned long long now);
+	void appendPending(unsigned int channel, unsigned long long now, bool onlyDue);
+	void sendBatch();
+	unsigned long long nextDueTime(unsigned long long now) const;
+	void flusherThread();
+
+private:
+	Sender                     _sender;
+	MidiPortCounters&          _counters;
+	std::shared_ptr<MidiClock> _clock;
+	mutable std::mutex         _mutex;
+	std::condition_variable    _condition;
+	std::thread                _thread;
+	std::atomic<bool>          _isEnabled;
+	bool                       _exit;
+	MidiOutPort::Coalescing    _coalescing;
+	unsigned long long         _nanosecondsPerByte;
+	unsigned long long         _wireFreeTime;
+	Slot                       _slots[kChannels][kSlotsPerChannel];
+	unsigned int               _pending[kChannels]; // number of waiting values per channel
+	unsigned int               _pendingCount;
+	std::vector<MidiMessage>   _batch;
+	std::size_t                _batchSize;
+};
+
+//! \endcond
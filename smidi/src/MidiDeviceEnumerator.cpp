@@ -4,36 +4,115 @@
 
 #include "../include/smidi/MidiDeviceEnumerator.h"
 #include "../include/smidi/MidiDevice.h"
+#include "loopback/MidiLoopbackEnumeratorImpl.h"
+#include "MidiLogging.h"
 
 #ifdef __linux__
 
 #ifdef SMIDI_USE_ALSA
 #include "linux/alsa/MidiDeviceEnumeratorImpl.h"
+#include "linux/rawmidi/MidiRawMidiEnumeratorImpl.h"
 #endif
 
 #endif
 
+const char* const MidiDeviceEnumerator::kLoopbackDeviceName = "Loopback";
 
-MidiDeviceEnumerator::MidiDeviceEnumerator()
-    : _impl(new Implementation())
+MidiDeviceEnumerator::MidiDeviceEnumerator(Backend backend)
+    : _backend(backend)
 {
+	switch (_backend)
+	{
+	case Backend::RawMidi:
+		_rawMidiImpl.reset(new RawMidiImplementation());
+		break;
+	case Backend::Loopback:
+		_loopbackImpl.reset(new LoopbackImplementation());
+		break;
+	default:
+		_impl.reset(new Implementation());
+		break;
+	}
 }
 
 MidiDeviceEnumerator::~MidiDeviceEnumerator()
 {
 }
 
+MidiDeviceEnumerator::Backend MidiDeviceEnumerator::backend() const
+{
+	return _backend;
+}
+
 std::list<std::string> MidiDeviceEnumerator::deviceNames() const
 {
-	return _impl->deviceNames();
+	std::list<std::string> result;
+	if (_loopbackImpl)
+	{
+		result = _loopbackImpl->deviceNames();
+	}
+	else
+	{
+		result = _rawMidiImpl ? _rawMidiImpl->deviceNames() : _impl->deviceNames();
+	}
+	return result;
 }
 
 std::shared_ptr<MidiDevice> MidiDeviceEnumerator::createDevice(const std::string& name) const
 {
-	return _impl->createDevice(name);
+	std::shared_ptr<MidiDevice> result;
+	if (_loopbackImpl)
+	{
+		result = _loopbackImpl->createDevice(name);
+	}
+	else
+	{
+		result = _rawMidiImpl ? _rawMidiImpl->createDevice(name) : _impl->createDevice(name);
+	}
+	return result;
 }
 
 void MidiDeviceEnumerator::updateDeviceList()
 {
-	_impl->updateDeviceList();
+	if (_loopbackImpl)
+	{
+		_loopbackImpl->updateDeviceList();
+	}
+	else if (_rawMidiImpl)
+	{
+		_rawMidiImpl->updateDeviceList();
+	}
+	else
+	{
+		_impl->updateDeviceList();
+	}
+}
+
+bool MidiDeviceEnumerator::addRoute(const Route& route)
+{
+	bool result = false;
+	if (_impl)
+	{
+		result = _impl->addRoute(route);
+	}
+	else
+	{
+		SMIDI_LOG_WARNING("Routes are only supported by the sequencer backend");
+	}
+	return result;
+}
+
+bool MidiDeviceEnumerator::removeRoute(const Route& route)
+{
+	return _impl ? _impl->removeRoute(route) : false;
+}
+
+std::list<MidiDeviceEnumerator::Route> MidiDeviceEnumerator::routes() const
+{
+	return _impl ? _impl->routes() : std::list<Route>();
+}
+
+bool MidiDeviceEnumerator::isRouteConnected(const Route& route) const
+{
+	return _impl ? _impl->isRouteConnected(route) : false;
 }
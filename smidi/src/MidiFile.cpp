@@ -0,0 +1,492 @@
+/*!
+ * \file MidiFile.cpp
+ * Contains implementation of MidiFile class.
+ */
+
+#include "../include/smidi/MidiFile.h"
+#include "MidiLogging.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace
+{
+	const std::size_t kHeaderSize = 14;
+	const std::size_t kChunkHeaderSize = 8;
+	const std::size_t kHeaderDataSize = 6;
+	const unsigned char kMetaStatus = 0xFF;
+	const int kInvalidDescriptor = -1;
+
+	unsigned int readUint16(const unsigned char* data)
+	{
+		return (static_cast<unsigned int>(data[0]) << 8) | data[1];
+	}
+
+	unsigned long long readUint32(const unsigned char* data)
+	{
+		return (static_cast<unsigned long long>(data[0]) << 24) | (static_cast<unsigned long long>(data[1]) << 16) | (static_cast<unsigned long long>(data[2]) << 8) | data[3];
+	}
+
+	// variable length quantity: 7 bits per byte, most significant first, at most 4 bytes
+	bool readVariableLength(const unsigned char*& position, const unsigned char* end, unsigned long long& value)
+	{
+		bool complete = false;
+		value = 0;
+		for (int i = 0; i < 4 && position < end && !complete; ++i)
+		{
+			const unsigned char byte = *position++;
+			value = (value << 7) | (byte & 0x7F);
+			complete = (byte & 0x80) == 0;
+		}
+		return complete;
+	}
+}
+
+bool MidiFileEvent::isMessage() const
+{
+	return kind != Meta;
+}
+
+unsigned int MidiFileEvent::tempo() const
+{
+	unsigned int result = 0;
+	if (kind == Meta && metaType == kMetaTempo && size >= 3)
+	{
+		result = (static_cast<unsigned int>(data[0]) << 16) | (static_cast<unsigned int>(data[1]) << 8) | data[2];
+	}
+	return result;
+}
+
+void MidiFileEvent::copyTo(MidiMessage& message) const
+{
+	switch (kind)
+	{
+	case Channel:
+	case SysEx:
+		message.resizeBuffer(1 + size);
+		static_cast<unsigned char*>(message)[0] = status;
+		std::copy(data, data + size, static_cast<unsigned char*>(message) + 1);
+		break;
+	case Escape:
+		message.resizeBuffer(size);
+		std::copy(data, data + size, static_cast<unsigned char*>(message));
+		break;
+	case Meta:
+		message.resizeBuffer(0);
+		break;
+	}
+	message.setTimestamp(time);
+}
+
+MidiMessage MidiFileEvent::toMessage() const
+{
+	MidiMessage result;
+	copyTo(result);
+	return result;
+}
+
+MidiFile::TrackCursor::TrackCursor()
+	: TrackCursor(nullptr, nullptr, 0, nullptr)
+{
+}
+
+MidiFile::TrackCursor::TrackCursor(const unsigned char* begin, const unsigned char* end, unsigned int track, const MidiTempoMap* tempoMap)
+	: _position(begin)
+	, _end(end)
+	, _tempoMap(tempoMap)
+	, _tempoHint(0)
+	, _tick(0)
+	, _track(track)
+	, _runningStatus(0)
+{
+}
+
+bool MidiFile::TrackCursor::next(MidiFileEvent& event)
+{
+	unsigned long long delta = 0;
+	bool result = (_position < _end) && readVariableLength(_position, _end, delta) && (_position < _end);
+	const bool hasEvent = result;
+
+	unsigned char status = 0;
+	unsigned long long size = 0;
+	event.metaType = 0;
+	if (result)
+	{
+		status = *_position;
+		if (status & 0x80)
+		{
+			++_position;
+		}
+		else
+		{
+			// running status, the byte is the first data byte
+			status = _runningStatus;
+		}
+
+		if (status >= 0x80 && status < MidiMessage::System)
+		{
+			_runningStatus = status;
+			const unsigned char type = status & 0xF0;
+			size = (type == MidiMessage::ProgramChange || type == MidiMessage::ChannelPressure) ? 1 : 2;
+			event.kind = MidiFileEvent::Channel;
+		}
+		else if (status == MidiMessage::SysEx || status == MidiMessage::SysExEnd)
+		{
+			// SysEx and meta events cancel running status
+			_runningStatus = 0;
+			result = readVariableLength(_position, _end, size);
+			event.kind = (status == MidiMessage::SysEx) ? MidiFileEvent::SysEx : MidiFileEvent::Escape;
+		}
+		else if (status == kMetaStatus)
+		{
+			_runningStatus = 0;
+			result = (_position < _end);
+			if (result)
+			{
+				event.metaType = *_position++;
+				result = readVariableLength(_position, _end, size);
+			}
+			event.kind = MidiFileEvent::Meta;
+		}
+		else
+		{
+			// data byte without running status or a status byte that can't be in a file
+			result = false;
+		}
+		result = result && (size <= static_cast<unsigned long long>(_end - _position));
+	}
+
+	if (result)
+	{
+		_tick += delta;
+		event.tick = _tick;
+		event.time = _tempoMap ? _tempoMap->timeAt(_tick, _tempoHint) : 0;
+		event.data = _position;
+		event.size = static_cast<std::size_t>(size);
+		event.track = _track;
+		event.status = status;
+		_position += size;
+
+		if (event.kind == MidiFileEvent::Meta && event.metaType == MidiFileEvent::kMetaEndOfTrack)
+		{
+			_position = _end;
+		}
+	}
+	else
+	{
+		if (hasEvent || _position != _end)
+		{
+			SMIDI_LOG_WARNING("Malformed event in track %u at tick %llu, the rest of the track is skipped", _track, _tick);
+		}
+		_position = _end;
+	}
+	return result;
+}
+
+MidiFile::Iterator::Iterator()
+	: _isEnd(true)
+{
+}
+
+MidiFile::Iterator::Iterator(std::vector<MidiFile::TrackCursor> cursors)
+	: _cursors(std::move(cursors))
+	, _events(_cursors.size())
+	, _isEnd(false)
+{
+	_heap.reserve(_cursors.size());
+	for (std::size_t cursor = 0; cursor < _cursors.size(); ++cursor)
+	{
+		if (_cursors[cursor].next(_events[cursor]))
+		{
+			_heap.push_back(HeapEntry{_events[cursor].tick, cursor});
+		}
+	}
+	for (std::size_t index = _heap.size() / 2; index > 0; --index)
+	{
+		siftDown(index - 1);
+	}
+	_isEnd = _heap.empty();
+}
+
+const MidiFileEvent& MidiFile::Iterator::operator*() const
+{
+	return _events[_heap.front().cursor];
+}
+
+const MidiFileEvent* MidiFile::Iterator::operator->() const
+{
+	return &_events[_heap.front().cursor];
+}
+
+MidiFile::Iterator& MidiFile::Iterator::operator++()
+{
+	if (!_isEnd)
+	{
+		// the next event of the same track replaces the top, usually it stays there or sinks by a few levels
+		const std::size_t cursor = _heap.front().cursor;
+		if (_cursors[cursor].next(_events[cursor]))
+		{
+			_heap.front().tick = _events[cursor].tick;
+		}
+		else
+		{
+			_heap.front() = _heap.back();
+			_heap.pop_back();
+		}
+		siftDown(0);
+		_isEnd = _heap.empty();
+	}
+	return *this;
+}
+
+bool MidiFile::Iterator::operator==(const MidiFile::Iterator& other) const
+{
+	return _isEnd == other._isEnd && (_isEnd || this == &other);
+}
+
+bool MidiFile::Iterator::operator!=(const MidiFile::Iterator& other) const
+{
+	return !operator==(other);
+}
+
+void MidiFile::Iterator::siftDown(std::size_t index)
+{
+	// the earliest tick on top, the same ticks are taken in the order of cursors (i.e. tracks)
+	const auto isEarlier = [](const HeapEntry& a, const HeapEntry& b) { return a.tick < b.tick || (a.tick == b.tick && a.cursor < b.cursor); };
+	const std::size_t size = _heap.size();
+	const HeapEntry entry = (index < size) ? _heap[index] : HeapEntry{0, 0};
+	std::size_t child = 2 * index + 1;
+	while (child < size)
+	{
+		if (child + 1 < size && isEarlier(_heap[child + 1], _heap[child]))
+		{
+			++child;
+		}
+		if (!isEarlier(_heap[child], entry))
+		{
+			break;
+		}
+		_heap[index] = _heap[child];
+		index = child;
+		child = 2 * index + 1;
+	}
+	if (index < size)
+	{
+		_heap[index] = entry;
+	}
+}
+
+MidiFile::EventRange::EventRange(const MidiFile& file, std::size_t firstTrack, std::size_t lastTrack)
+	: _file(file)
+	, _firstTrack(firstTrack)
+	, _lastTrack(lastTrack)
+{
+}
+
+MidiFile::Iterator MidiFile::EventRange::begin() const
+{
+	std::vector<TrackCursor> cursors;
+	cursors.reserve(_lastTrack - _firstTrack);
+	for (std::size_t track = _firstTrack; track < _lastTrack; ++track)
+	{
+		cursors.push_back(_file.cursor(track));
+	}
+	return Iterator(std::move(cursors));
+}
+
+MidiFile::Iterator MidiFile::EventRange::end() const
+{
+	return Iterator();
+}
+
+MidiFile::MidiFile()
+	: _data(nullptr)
+	, _size(0)
+	, _mapping(nullptr)
+	, _format(0)
+	, _tempoMaps(1)
+{
+}
+
+MidiFile::~MidiFile()
+{
+	close();
+}
+
+bool MidiFile::open(const std::string& path)
+{
+	close();
+
+	const int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor != kInvalidDescriptor)
+	{
+		struct stat status = {};
+		if (fstat(descriptor, &status) == 0 && status.st_size > 0)
+		{
+			void* mapping = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+			if (mapping != MAP_FAILED)
+			{
+				_mapping = mapping;
+				_data = static_cast<const unsigned char*>(mapping);
+				_size = static_cast<std::size_t>(status.st_size);
+			}
+			else
+			{
+				SMIDI_LOG_ERROR("Couldn't map MIDI file %s because: %s", path.c_str(), std::strerror(errno));
+			}
+		}
+		else
+		{
+			SMIDI_LOG_ERROR("MIDI file %s is empty or can't be read", path.c_str());
+		}
+		// the mapping stays valid without the descriptor
+		::close(descriptor);
+	}
+	else
+	{
+		SMIDI_LOG_ERROR("Couldn't open MIDI file %s because: %s", path.c_str(), std::strerror(errno));
+	}
+
+	const bool result = _data && parse();
+	if (!result)
+	{
+		close();
+	}
+	return result;
+}
+
+bool MidiFile::open(const unsigned char* data, std::size_t size)
+{
+	close();
+	_data = data;
+	_size = size;
+	const bool result = _data && parse();
+	if (!result)
+	{
+		close();
+	}
+	return result;
+}
+
+void MidiFile::close()
+{
+	if (_mapping)
+	{
+		munmap(_mapping, _size);
+		_mapping = nullptr;
+	}
+	_data = nullptr;
+	_size = 0;
+	_format = 0;
+	_tracks.clear();
+	_tempoMaps.assign(1, MidiTempoMap());
+}
+
+bool MidiFile::isOpen() const
+{
+	return _data != nullptr;
+}
+
+unsigned int MidiFile::format() const
+{
+	return _format;
+}
+
+std::size_t MidiFile::trackCount() const
+{
+	return _tracks.size();
+}
+
+const MidiTempoMap& MidiFile::tempoMap(std::size_t track) const
+{
+	return (_format == 2 && track < _tempoMaps.size()) ? _tempoMaps[track] : _tempoMaps.front();
+}
+
+MidiFile::EventRange MidiFile::events() const
+{
+	return EventRange(*this, 0, _tracks.size());
+}
+
+MidiFile::EventRange MidiFile::trackEvents(std::size_t track) const
+{
+	return (track < _tracks.size()) ? EventRange(*this, track, track + 1) : EventRange(*this, 0, 0);
+}
+
+bool MidiFile::parse()
+{
+	bool result = (_size >= kHeaderSize && std::memcmp(_data, "MThd", 4) == 0 && readUint32(_data + 4) >= kHeaderDataSize);
+	if (!result)
+	{
+		SMIDI_LOG_ERROR("Not a Standard MIDI File: MThd chunk is missing");
+	}
+	else if ((_format = readUint16(_data + 8)) > 2)
+	{
+		SMIDI_LOG_ERROR("Unsupported Standard MIDI File format %u", _format);
+		result = false;
+	}
+	else
+	{
+		const unsigned int declaredTracks = readUint16(_data + 10);
+		const unsigned int division = readUint16(_data + 12);
+
+		// chunks of unknown types are skipped, as the specification requires
+		std::size_t offset = kChunkHeaderSize + readUint32(_data + 4);
+		while (offset + kChunkHeaderSize <= _size)
+		{
+			const unsigned char* chunk = _data + offset;
+			const unsigned long long length = readUint32(chunk + 4);
+			const std::size_t available = _size - offset - kChunkHeaderSize;
+			if (std::memcmp(chunk, "MTrk", 4) == 0)
+			{
+				if (length > available)
+				{
+					SMIDI_LOG_WARNING("Track %u is truncated", static_cast<unsigned int>(_tracks.size()));
+				}
+				const unsigned char* begin = chunk + kChunkHeaderSize;
+				_tracks.push_back(Track{begin, begin + std::min<unsigned long long>(length, available)});
+			}
+			offset += kChunkHeaderSize + static_cast<std::size_t>(std::min<unsigned long long>(length, available));
+		}
+		if (_tracks.size() != declaredTracks)
+		{
+			SMIDI_LOG_WARNING("MIDI file declares %u tracks, found %u", declaredTracks, static_cast<unsigned int>(_tracks.size()));
+		}
+
+		// negative upper byte is SMPTE format (-24, -25, -29 or -30), the lower byte is ticks per frame
+		const MidiTempoMap emptyMap = (division & 0x8000) ? MidiTempoMap::smpte(static_cast<unsigned int>(-static_cast<signed char>(division >> 8)), division & 0xFF)
+		                                                  : MidiTempoMap(division);
+		const std::size_t tempoTracks = (_format == 2) ? _tracks.size() : std::min<std::size_t>(_tracks.size(), 1);
+		_tempoMaps.assign(std::max<std::size_t>(tempoTracks, 1), emptyMap);
+		for (std::size_t track = 0; track < tempoTracks; ++track)
+		{
+			readTempoChanges(track, _tempoMaps[track]);
+		}
+	}
+	return result;
+}
+
+void MidiFile::readTempoChanges(std::size_t track, MidiTempoMap& tempoMap) const
+{
+	if (!tempoMap.isSmpte())
+	{
+		TrackCursor tempoCursor(_tracks[track].begin, _tracks[track].end, static_cast<unsigned int>(track), nullptr);
+		MidiFileEvent event;
+		while (tempoCursor.next(event))
+		{
+			const unsigned int tempo = event.tempo();
+			if (tempo != 0)
+			{
+				tempoMap.addTempo(event.tick, tempo);
+			}
+		}
+	}
+}
+
+MidiFile::TrackCursor MidiFile::cursor(std::size_t track) const
+{
+	return TrackCursor(_tracks[track].begin, _tracks[track].end, static_cast<unsigned int>(track), &tempoMap(track));
+}
@@ -0,0 +1,222 @@
+/*!
+ * \file MidiFileRecorder.cpp
+ * Contains implementation of MidiFileRecorder class.
+ */
+
+#include "../include/smidi/MidiFileRecorder.h"
+#include "../include/smidi/MidiTempoMap.h"
+#include "MidiRingBuffer.h"
+#include "MidiSmfWriter.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	const unsigned int kDefaultTicksPerQuarterNote = 480;
+	const std::size_t kDefaultCapacity = 8192;
+	const std::chrono::milliseconds kDrainInterval(10);
+
+	struct Entry
+	{
+		MidiMessage        message;
+		unsigned long long time;
+	};
+
+}
+
+class MidiFileRecorder::Implementation
+{
+public:
+	Implementation(const Options& options, std::shared_ptr<MidiClock> clock);
+	~Implementation();
+
+	void record(const MidiMessage& message);
+	bool open(const std::string& path);
+	bool close();
+	bool isRecording() const;
+	Counters counters() const;
+
+private:
+	void writerThread();
+	void drain();
+
+private:
+	MidiRingBuffer<Entry>            _ring;
+	const std::shared_ptr<MidiClock> _clock;
+	std::atomic<bool>                _isRecording;
+	std::atomic<unsigned long long>  _dropped;
+	const Options                    _options;
+	MidiSmfWriter                    _writer;
+	unsigned long long               _startTime;
+	std::atomic<unsigned long long>  _recorded;
+	std::mutex                       _mutex;
+	std::condition_variable          _condition;
+	bool                             _stop;
+	std::thread                      _thread;
+};
+
+MidiFileRecorder::Implementation::Implementation(const Options& options, std::shared_ptr<MidiClock> clock)
+	: _ring(options.capacity)
+	, _clock(std::move(clock))
+	, _isRecording(false)
+	, _dropped(0)
+	, _options(options)
+	, _writer(options.ticksPerQuarterNote, options.tempo)
+	, _startTime(0)
+	, _recorded(0)
+	, _stop(false)
+{
+}
+
+MidiFileRecorder::Implementation::~Implementation()
+{
+	close();
+}
+
+void MidiFileRecorder::Implementation::record(const MidiMessage& message)
+{
+	if (_isRecording.load(std::memory_order_acquire) && !message.isEmpty())
+	{
+		const unsigned long long time = (message.timestamp() != 0) ? message.timestamp() : _clock->now();
+		if (!_ring.push([&message, time](Entry& entry) { entry.message = message; entry.time = time; }))
+		{
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+bool MidiFileRecorder::Implementation::open(const std::string& path)
+{
+	bool result = false;
+	if (!isRecording())
+	{
+		result = _writer.open(path);
+		if (result)
+		{
+			// messages left from the previous recording don't belong to this one
+			while (_ring.front())
+			{
+				_ring.popFront();
+			}
+			_dropped = 0;
+			_recorded = 0;
+
+			_startTime = _clock->now();
+			_stop = false;
+			_thread = std::thread(&MidiFileRecorder::Implementation::writerThread, this);
+			_isRecording.store(true, std::memory_order_release);
+		}
+	}
+	return result;
+}
+
+bool MidiFileRecorder::Implementation::close()
+{
+	bool result = false;
+	if (isRecording())
+	{
+		_isRecording.store(false, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_condition.notify_one();
+		if (_thread.joinable())
+		{
+			_thread.join();
+		}
+
+		drain();
+		result = _writer.close();
+	}
+	return result;
+}
+
+bool MidiFileRecorder::Implementation::isRecording() const
+{
+	return _writer.isOpen();
+}
+
+MidiFileRecorder::Counters MidiFileRecorder::Implementation::counters() const
+{
+	return Counters{_recorded.load(std::memory_order_relaxed), _dropped.load(std::memory_order_relaxed), _writer.bytes()};
+}
+
+void MidiFileRecorder::Implementation::writerThread()
+{
+	std::chrono::steady_clock::time_point nextFlush = std::chrono::steady_clock::now() + _options.flushInterval;
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_stop)
+	{
+		lock.unlock();
+		drain();
+		if (std::chrono::steady_clock::now() >= nextFlush)
+		{
+			_writer.flush();
+			nextFlush = std::chrono::steady_clock::now() + _options.flushInterval;
+		}
+		lock.lock();
+		_condition.wait_for(lock, kDrainInterval, [this]() { return _stop; });
+	}
+}
+
+void MidiFileRecorder::Implementation::drain()
+{
+	Entry* entry = nullptr;
+	while ((entry = _ring.front()) != nullptr)
+	{
+		_writer.append((entry->time > _startTime) ? entry->time - _startTime : 0, entry->message);
+		_recorded.fetch_add(1, std::memory_order_relaxed);
+		_ring.popFront();
+	}
+}
+
+MidiFileRecorder::Options::Options()
+	: ticksPerQuarterNote(kDefaultTicksPerQuarterNote)
+	, tempo(MidiTempoMap::kDefaultTempo)
+	, capacity(kDefaultCapacity)
+	, flushInterval(1000)
+{
+}
+
+MidiFileRecorder::MidiFileRecorder(const Options& options, std::shared_ptr<MidiClock> clock)
+	: _impl(new Implementation(options, std::move(clock)))
+{
+}
+
+MidiFileRecorder::~MidiFileRecorder()
+{
+}
+
+void MidiFileRecorder::record(const MidiMessage& message)
+{
+	_impl->record(message);
+}
+
+MidiInPort::MessageHandler MidiFileRecorder::handler()
+{
+	Implementation* implementation = _impl.get();
+	return [implementation](const MidiMessage& message) { implementation->record(message); };
+}
+
+bool MidiFileRecorder::open(const std::string& path)
+{
+	return _impl->open(path);
+}
+
+bool MidiFileRecorder::close()
+{
+	return _impl->close();
+}
+
+bool MidiFileRecorder::isRecording() const
+{
+	return _impl->isRecording();
+}
+
+MidiFileRecorder::Counters MidiFileRecorder::counters() const
+{
+	return _impl->counters();
+}
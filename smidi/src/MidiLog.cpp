@@ -0,0 +1,310 @@
+/*!
+ * \file MidiLog.cpp
+ * Contains implementation of MidiLog class.
+ */
+
+#include "../include/smidi/MidiLog.h"
+#include "../include/smidi/MidiTimestamp.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	const std::size_t kRecordCount = 256; // must be a power of two
+	const std::chrono::milliseconds kDrainInterval(10);
+
+	/*!
+	 * Bounded multi-producer single-consumer ring of preallocated records (Vyukov's sequence-per-cell scheme).
+	 * Producers claim a cell with a single CAS and never wait for the consumer nor wake it up: the consumer
+	 * drains the ring every kDrainInterval, and sooner only when flush() asks for it.
+	 */
+	class LogRing
+	{
+	public:
+		std::atomic<int>                 level;              // minimal MidiLog::Level
+		std::atomic<unsigned int>        recordsPerInterval; // 0 disables rate limiting
+		std::atomic<unsigned long long>  rateLimitInterval;  // nanoseconds
+
+	public:
+		LogRing()
+			: level(static_cast<int>(MidiLog::Level::Info))
+			, recordsPerInterval(10)
+			, rateLimitInterval(1000000000ULL)
+			, _enqueuePosition(0)
+			, _dequeuePosition(0)
+			, _dropped(0)
+			, _running(true)
+			, _isDrainRequested(false)
+		{
+			for (std::size_t i = 0; i < kRecordCount; ++i)
+			{
+				_records[i].sequence.store(i, std::memory_order_relaxed);
+			}
+			_thread = std::thread(&LogRing::run, this);
+		}
+
+		~LogRing()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_threadMutex);
+				_running = false;
+			}
+			_wakeUp.notify_one();
+			_thread.join();
+			drain();
+		}
+
+		void push(MidiLog::Level level, unsigned int suppressed, const char* format, va_list arguments)
+		{
+			std::size_t position = _enqueuePosition.load(std::memory_order_relaxed);
+			Record* record = nullptr;
+			for (;;)
+			{
+				record = &_records[position & (kRecordCount - 1)];
+				const std::size_t sequence = record->sequence.load(std::memory_order_acquire);
+				const long long difference = static_cast<long long>(sequence) - static_cast<long long>(position);
+				if (difference == 0)
+				{
+					if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (difference < 0)
+				{
+					_dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				else
+				{
+					position = _enqueuePosition.load(std::memory_order_relaxed);
+				}
+			}
+
+			record->level = level;
+			int length = std::vsnprintf(record->text, MidiLog::kMaxRecordLength, format, arguments);
+			if (suppressed > 0 && length >= 0 && static_cast<std::size_t>(length) < MidiLog::kMaxRecordLength)
+			{
+				std::snprintf(record->text + length, MidiLog::kMaxRecordLength - length, " (%u similar records suppressed)", suppressed);
+			}
+			record->sequence.store(position + 1, std::memory_order_release);
+		}
+
+		void setSink(MidiLog::Sink sink)
+		{
+			std::lock_guard<std::mutex> lock(_sinkMutex);
+			_sink = std::move(sink);
+		}
+
+		void flush()
+		{
+			// a sink which flushes would wait for itself
+			if (std::this_thread::get_id() != _thread.get_id())
+			{
+				const std::size_t target = _enqueuePosition.load(std::memory_order_acquire);
+				std::unique_lock<std::mutex> lock(_threadMutex);
+				_isDrainRequested = true;
+				_wakeUp.notify_one();
+				_drained.wait(lock, [this, target]() { return _dequeuePosition.load(std::memory_order_acquire) >= target || !_running; });
+			}
+			std::cerr.flush();
+		}
+
+		unsigned long long dropped() const
+		{
+			return _dropped.load(std::memory_order_relaxed);
+		}
+
+	private:
+		struct Record
+		{
+			std::atomic<std::size_t> sequence;
+			MidiLog::Level           level;
+			char                     text[MidiLog::kMaxRecordLength];
+		};
+
+		void run()
+		{
+			std::unique_lock<std::mutex> lock(_threadMutex);
+			while (_running)
+			{
+				lock.unlock();
+				drain();
+				lock.lock();
+
+				_drained.notify_all();
+				_wakeUp.wait_for(lock, kDrainInterval, [this]() { return _isDrainRequested || !_running; });
+				_isDrainRequested = false;
+			}
+			_drained.notify_all();
+		}
+
+		void drain()
+		{
+			// the sink is called without the lock, so it may replace itself
+			MidiLog::Sink sink;
+			{
+				std::lock_guard<std::mutex> lock(_sinkMutex);
+				sink = _sink;
+			}
+
+			std::size_t position = _dequeuePosition.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				Record& record = _records[position & (kRecordCount - 1)];
+				if (record.sequence.load(std::memory_order_acquire) != position + 1)
+				{
+					break;
+				}
+				if (sink)
+				{
+					sink(record.level, record.text);
+				}
+				else
+				{
+					std::cerr << "smidi " << MidiLog::levelName(record.level) << ": " << record.text << '\n';
+				}
+				record.sequence.store(position + kRecordCount, std::memory_order_release);
+				++position;
+				_dequeuePosition.store(position, std::memory_order_release);
+			}
+		}
+
+	private:
+		Record                           _records[kRecordCount];
+		std::atomic<std::size_t>         _enqueuePosition;
+		std::atomic<std::size_t>         _dequeuePosition;
+		std::atomic<unsigned long long>  _dropped;
+		std::mutex                       _threadMutex;
+		std::condition_variable          _wakeUp;
+		std::condition_variable          _drained;
+		bool                             _running;
+		bool                             _isDrainRequested;
+		std::mutex                       _sinkMutex;
+		MidiLog::Sink                    _sink;
+		std::thread                      _thread;
+	};
+
+	// constructed with the thread on first use, so it exists whenever a static object of the application logs
+	LogRing& logRing()
+	{
+		static LogRing ring;
+		return ring;
+	}
+
+	void writeRecord(MidiLog::Level level, unsigned int suppressed, const char* format, va_list arguments)
+	{
+		LogRing& ring = logRing();
+		if (static_cast<int>(level) >= ring.level.load(std::memory_order_relaxed))
+		{
+			ring.push(level, suppressed, format, arguments);
+		}
+	}
+}
+
+bool MidiLog::RateLimit::allow(unsigned int& suppressed)
+{
+	LogRing& ring = logRing();
+	const unsigned int recordsPerInterval = ring.recordsPerInterval.load(std::memory_order_relaxed);
+	suppressed = 0;
+	if (recordsPerInterval == 0)
+	{
+		return true;
+	}
+
+	const unsigned long long now = MidiTimestamp::now();
+	unsigned long long intervalStart = _intervalStart.load(std::memory_order_relaxed);
+	if (now - intervalStart >= ring.rateLimitInterval.load(std::memory_order_relaxed))
+	{
+		if (_intervalStart.compare_exchange_strong(intervalStart, now, std::memory_order_relaxed))
+		{
+			_recordsInInterval.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	if (_recordsInInterval.fetch_add(1, std::memory_order_relaxed) < recordsPerInterval)
+	{
+		suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+		return true;
+	}
+	_suppressed.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void MidiLog::setSink(MidiLog::Sink sink)
+{
+	logRing().setSink(std::move(sink));
+}
+
+void MidiLog::setLevel(MidiLog::Level level)
+{
+	logRing().level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+MidiLog::Level MidiLog::level()
+{
+	return static_cast<Level>(logRing().level.load(std::memory_order_relaxed));
+}
+
+void MidiLog::setRateLimit(unsigned int recordsPerInterval, std::chrono::milliseconds interval)
+{
+	LogRing& ring = logRing();
+	ring.recordsPerInterval.store(recordsPerInterval, std::memory_order_relaxed);
+	ring.rateLimitInterval.store(static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count()), std::memory_order_relaxed);
+}
+
+void MidiLog::write(MidiLog::Level level, const char* format, ...)
+{
+	va_list arguments;
+	va_start(arguments, format);
+	writeRecord(level, 0, format, arguments);
+	va_end(arguments);
+}
+
+void MidiLog::write(MidiLog::Level level, MidiLog::RateLimit& rateLimit, const char* format, ...)
+{
+	if (static_cast<int>(level) < logRing().level.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+	unsigned int suppressed = 0;
+	if (rateLimit.allow(suppressed))
+	{
+		va_list arguments;
+		va_start(arguments, format);
+		writeRecord(level, suppressed, format, arguments);
+		va_end(arguments);
+	}
+}
+
+void MidiLog::flush()
+{
+	logRing().flush();
+}
+
+unsigned long long MidiLog::droppedRecords()
+{
+	return logRing().dropped();
+}
+
+const char* MidiLog::levelName(MidiLog::Level level)
+{
+	switch (level)
+	{
+	case Level::Debug:
+		return "debug";
+	case Level::Info:
+		return "info";
+	case Level::Warning:
+		return "warning";
+	case Level::Error:
+		return "error";
+	}
+	return "unknown";
+}
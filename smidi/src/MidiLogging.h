@@ -0,0 +1,29 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiLogging.h
+ * \warning This file is not a part of library public interface!
+ * Contains macros the library uses to write MidiLog records
+ */
+
+#include "../include/smidi/MidiLog.h"
+
+/*!
+ * Writes rate limited MidiLog record. Every use of the macro has its own rate limit, constant-initialized,
+ * so the first use has no initialization guard. Doesn't allocate and doesn't block, so it may be used on real-time paths.
+ */
+#define SMIDI_LOG(level, ...) \
+	do \
+	{ \
+		static MidiLog::RateLimit smidiLogRateLimit; \
+		MidiLog::write(level, smidiLogRateLimit, __VA_ARGS__); \
+	} while (false)
+
+#define SMIDI_LOG_DEBUG(...)   SMIDI_LOG(MidiLog::Level::Debug, __VA_ARGS__)   //!< Writes MidiLog::Level::Debug record
+#define SMIDI_LOG_INFO(...)    SMIDI_LOG(MidiLog::Level::Info, __VA_ARGS__)    //!< Writes MidiLog::Level::Info record
+#define SMIDI_LOG_WARNING(...) SMIDI_LOG(MidiLog::Level::Warning, __VA_ARGS__) //!< Writes MidiLog::Level::Warning record
+#define SMIDI_LOG_ERROR(...)   SMIDI_LOG(MidiLog::Level::Error, __VA_ARGS__)   //!< Writes MidiLog::Level::Error record
+
+//! \endcond
@@ -0,0 +1,65 @@
+/*!
+ * \file MidiLoopback.cpp
+ * Contains implementation of MidiLoopback class.
+ */
+
+#include "../include/smidi/MidiLoopback.h"
+#include "../include/smidi/MidiDevice.h"
+#include "loopback/MidiLoopbackPorts.h"
+
+namespace
+{
+	const std::size_t kDefaultCapacity = 4096;
+}
+
+MidiLoopback::Options::Options()
+	: latency(0)
+	, jitter(0)
+	, seed(0)
+	, capacity(kDefaultCapacity)
+{
+}
+
+MidiLoopback::MidiLoopback(const std::string& name, std::shared_ptr<MidiClock> clock)
+	: MidiLoopback(name, std::move(clock), Options())
+{
+}
+
+MidiLoopback::MidiLoopback(const std::string& name, std::shared_ptr<MidiClock> clock, const Options& options)
+	: _clock(std::move(clock))
+{
+	// ports own the channel, so they outlive the loopback object if somebody holds them
+	std::shared_ptr<MidiLoopbackChannel> channel = std::make_shared<MidiLoopbackChannel>(_clock, options);
+	MidiDevice::InputPortContainer inputPorts{std::make_shared<MidiLoopbackInPort>(name, channel)};
+	MidiDevice::OutputPortContainer outputPorts{std::make_shared<MidiLoopbackOutPort>(name, channel, _clock)};
+	_device = std::make_shared<MidiDevice>(name, inputPorts, outputPorts);
+}
+
+MidiLoopback::~MidiLoopback()
+{
+}
+
+const std::string& MidiLoopback::name() const
+{
+	return _device->name();
+}
+
+std::shared_ptr<MidiDevice> MidiLoopback::device() const
+{
+	return _device;
+}
+
+std::shared_ptr<MidiInPort> MidiLoopback::inputPort() const
+{
+	return _device->inputPorts().front();
+}
+
+std::shared_ptr<MidiOutPort> MidiLoopback::outputPort() const
+{
+	return _device->outputPorts().front();
+}
+
+std::shared_ptr<MidiClock> MidiLoopback::clock() const
+{
+	return _clock;
+}
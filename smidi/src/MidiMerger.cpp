@@ -0,0 +1,470 @@
+/*!
+ * \file MidiMerger.cpp
+ * Contains implementation of MidiMerger class.
+ */
+
+#include "../include/smidi/MidiMerger.h"
+#include "MidiLogging.h"
+#include "MidiSpscRing.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const std::size_t kDefaultInputCapacity = 1024;
+	const std::size_t kDefaultOutputCapacity = 4096;
+	const int kInvalidDescriptor = -1;
+
+	// while messages wait for the reorder window the merging thread never sleeps longer, so it notices exit in time
+	const unsigned long long kMaxSleepInNanoseconds = 1000000;
+
+	//! Wakes up the merging thread which waits for input with all rings empty
+	struct WakeUp
+	{
+		WakeUp()
+			: isWaiting(false)
+		{
+		}
+
+		std::mutex              mutex;
+		std::condition_variable condition;
+		std::atomic<bool>       isWaiting;
+	};
+
+	//! Ring of one input port, filled by the thread that dispatches messages of the port
+	struct InputRing
+	{
+		InputRing(std::size_t capacity, std::shared_ptr<WakeUp> wakeUp)
+			: ring(capacity)
+			, dropped(0)
+			, wakeUp(std::move(wakeUp))
+		{
+		}
+
+		void push(const MidiMessage& message)
+		{
+			if (ring.push([&message](MidiMessage& item) { item = message; }))
+			{
+				// pairs with the fence of the merging thread, either it sees the message or the message sees it waiting
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (wakeUp->isWaiting.load(std::memory_order_relaxed))
+				{
+					std::lock_guard<std::mutex> lock(wakeUp->mutex);
+					wakeUp->condition.notify_one();
+				}
+			}
+			else
+			{
+				dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		MidiSpscRing<MidiMessage>       ring;
+		std::atomic<unsigned long long> dropped;
+		std::shared_ptr<WakeUp>         wakeUp;
+	};
+
+	struct OutputEntry
+	{
+		MidiMessage message;
+		std::size_t input;
+	};
+
+	//! Oldest message of the input ring, equal timestamps are taken in the order of inputs
+	struct Head
+	{
+		bool operator>(const Head& other) const
+		{
+			return timestamp > other.timestamp || (timestamp == other.timestamp && input > other.input);
+		}
+
+		unsigned long long timestamp;
+		std::size_t        input;
+	};
+}
+
+class MidiMerger::Implementation
+{
+public:
+	Implementation(std::size_t inputs, const Options& options, std::shared_ptr<MidiClock> clock);
+	~Implementation();
+
+	std::size_t inputCount() const;
+	void push(std::size_t input, const MidiMessage& message);
+	MidiInPort::MessageHandler handler(std::size_t input);
+	void setHandler(Handler handler);
+	bool pop(MidiMessage& message, std::size_t* input);
+	int pollDescriptor() const;
+	std::size_t merge(bool all);
+	Counters counters() const;
+	MidiInPort::DispatchMode dispatchMode() const;
+
+private:
+	void mergingThread();
+	bool hasInput();
+	void signal();
+	void clearSignal();
+
+private:
+	std::shared_ptr<MidiClock>               _clock;
+	const unsigned long long                 _reorderWindow;
+	const MidiInPort::DispatchMode           _dispatchMode;
+	std::vector<std::shared_ptr<InputRing>>  _inputs;
+	std::shared_ptr<WakeUp>                  _wakeUp;
+	std::vector<char>                        _inHeap;
+	std::vector<Head>                        _heap;
+	MidiSpscRing<OutputEntry>                _output;
+	std::mutex                               _handlerMutex;
+	Handler                                  _handler;
+	int                                      _eventfd;
+	unsigned long long                       _lastTimestamp;
+	unsigned long long                       _nextMergeTime;
+	std::atomic<unsigned long long>          _merged;
+	std::atomic<unsigned long long>          _late;
+	std::atomic<unsigned long long>          _outputDropped;
+	std::atomic<bool>                        _run;
+	std::thread                              _thread;
+};
+
+MidiMerger::Implementation::Implementation(std::size_t inputs, const Options& options, std::shared_ptr<MidiClock> clock)
+	: _clock(std::move(clock))
+	, _reorderWindow(static_cast<unsigned long long>(std::max<std::chrono::nanoseconds::rep>(0, options.reorderWindow.count())))
+	, _dispatchMode(options.dispatchMode)
+	, _wakeUp(std::make_shared<WakeUp>())
+	, _inHeap(inputs, 0)
+	, _output(options.outputCapacity)
+	, _eventfd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+	, _lastTimestamp(0)
+	, _nextMergeTime(0)
+	, _merged(0)
+	, _late(0)
+	, _outputDropped(0)
+	, _run(false)
+{
+	if (_eventfd == kInvalidDescriptor)
+	{
+		SMIDI_LOG_ERROR("Couldn't create eventfd for merger because: %s", std::strerror(errno));
+	}
+
+	// the heap never holds more than one message per input, so it never reallocates
+	_heap.reserve(inputs);
+	for (std::size_t i = 0; i < inputs; ++i)
+	{
+		_inputs.push_back(std::make_shared<InputRing>(options.inputCapacity, _wakeUp));
+	}
+
+	if (_dispatchMode == MidiInPort::DispatchMode::InputThread)
+	{
+		_run = true;
+		_thread = std::thread(&MidiMerger::Implementation::mergingThread, this);
+		if (!_thread.joinable())
+		{
+			_run = false;
+			SMIDI_LOG_ERROR("Couldn't start merging thread");
+		}
+	}
+}
+
+MidiMerger::Implementation::~Implementation()
+{
+	if (_run)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_wakeUp->mutex);
+			_run = false;
+		}
+		_wakeUp->condition.notify_one();
+		_thread.join();
+	}
+
+	if (_eventfd != kInvalidDescriptor)
+	{
+		::close(_eventfd);
+	}
+}
+
+std::size_t MidiMerger::Implementation::inputCount() const
+{
+	return _inputs.size();
+}
+
+void MidiMerger::Implementation::push(std::size_t input, const MidiMessage& message)
+{
+	if (input < _inputs.size())
+	{
+		_inputs[input]->push(message);
+	}
+}
+
+MidiInPort::MessageHandler MidiMerger::Implementation::handler(std::size_t input)
+{
+	MidiInPort::MessageHandler result;
+	if (input < _inputs.size())
+	{
+		// the handler holds the ring, so a message dispatched while the merger is destroyed has where to go
+		const std::shared_ptr<InputRing> ring = _inputs[input];
+		result = [ring](const MidiMessage& message) { ring->push(message); };
+	}
+	return result;
+}
+
+void MidiMerger::Implementation::setHandler(MidiMerger::Handler handler)
+{
+	std::lock_guard<std::mutex> lock(_handlerMutex);
+	_handler = std::move(handler);
+}
+
+bool MidiMerger::Implementation::pop(MidiMessage& message, std::size_t* input)
+{
+	OutputEntry* entry = _output.front();
+	if (entry)
+	{
+		message = entry->message;
+		if (input)
+		{
+			*input = entry->input;
+		}
+		_output.popFront();
+
+		// the merging thread signals after pushing, so a message pushed after the check keeps the descriptor readable
+		if (!_output.front())
+		{
+			clearSignal();
+			if (_output.front())
+			{
+				signal();
+			}
+		}
+	}
+	return entry != nullptr;
+}
+
+int MidiMerger::Implementation::pollDescriptor() const
+{
+	return _eventfd;
+}
+
+std::size_t MidiMerger::Implementation::merge(bool all)
+{
+	const unsigned long long now = _clock->now();
+	const unsigned long long deadline = all ? std::numeric_limits<unsigned long long>::max() : (now > _reorderWindow ? now - _reorderWindow : 0);
+
+	// heads of the rings that were empty on the previous pass
+	for (std::size_t input = 0; input < _inputs.size(); ++input)
+	{
+		const MidiMessage* message = nullptr;
+		if (!_inHeap[input] && (message = _inputs[input]->ring.front()) != nullptr)
+		{
+			_heap.push_back(Head{message->timestamp(), input});
+			std::push_heap(_heap.begin(), _heap.end(), std::greater<Head>());
+			_inHeap[input] = 1;
+		}
+	}
+
+	Handler handler;
+	{
+		std::lock_guard<std::mutex> lock(_handlerMutex);
+		handler = _handler;
+	}
+
+	std::size_t mergedMessages = 0;
+	bool outputPushed = false;
+	while (!_heap.empty() && _heap.front().timestamp <= deadline)
+	{
+		std::pop_heap(_heap.begin(), _heap.end(), std::greater<Head>());
+		const std::size_t input = _heap.back().input;
+		_heap.pop_back();
+
+		MidiSpscRing<MidiMessage>& ring = _inputs[input]->ring;
+		MidiMessage& message = *ring.front();
+		if (message.timestamp() < _lastTimestamp)
+		{
+			// arrived after the reorder window, the stream doesn't go back in time
+			_late.fetch_add(1, std::memory_order_relaxed);
+			message.setTimestamp(_lastTimestamp);
+		}
+		_lastTimestamp = message.timestamp();
+
+		if (handler)
+		{
+			handler(input, message);
+		}
+		else if (_output.push([&message, input](OutputEntry& entry) { entry.message = message; entry.input = input; }))
+		{
+			outputPushed = true;
+		}
+		else
+		{
+			_outputDropped.fetch_add(1, std::memory_order_relaxed);
+		}
+		ring.popFront();
+		++mergedMessages;
+
+		const MidiMessage* next = ring.front();
+		if (next)
+		{
+			_heap.push_back(Head{next->timestamp(), input});
+			std::push_heap(_heap.begin(), _heap.end(), std::greater<Head>());
+		}
+		else
+		{
+			_inHeap[input] = 0;
+		}
+	}
+
+	if (outputPushed)
+	{
+		signal();
+	}
+	_merged.fetch_add(mergedMessages, std::memory_order_relaxed);
+
+	_nextMergeTime = now + kMaxSleepInNanoseconds;
+	if (!_heap.empty())
+	{
+		_nextMergeTime = std::min(_nextMergeTime, std::max(now, _heap.front().timestamp + _reorderWindow));
+	}
+	return mergedMessages;
+}
+
+MidiMerger::Counters MidiMerger::Implementation::counters() const
+{
+	unsigned long long inputDropped = 0;
+	for (const std::shared_ptr<InputRing>& input : _inputs)
+	{
+		inputDropped += input->dropped.load(std::memory_order_relaxed);
+	}
+	return Counters{_merged.load(std::memory_order_relaxed), _late.load(std::memory_order_relaxed), inputDropped, _outputDropped.load(std::memory_order_relaxed)};
+}
+
+MidiInPort::DispatchMode MidiMerger::Implementation::dispatchMode() const
+{
+	return _dispatchMode;
+}
+
+void MidiMerger::Implementation::mergingThread()
+{
+	while (_run)
+	{
+		merge(false);
+		if (_heap.empty())
+		{
+			// every ring is empty, nothing is due until a port delivers a message
+			std::unique_lock<std::mutex> lock(_wakeUp->mutex);
+			_wakeUp->isWaiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (_run && !hasInput())
+			{
+				_wakeUp->condition.wait(lock);
+			}
+			_wakeUp->isWaiting.store(false, std::memory_order_relaxed);
+		}
+		else
+		{
+			_clock->sleepUntil(_nextMergeTime);
+		}
+	}
+}
+
+bool MidiMerger::Implementation::hasInput()
+{
+	bool result = false;
+	for (std::size_t input = 0; input < _inputs.size() && !result; ++input)
+	{
+		result = (_inputs[input]->ring.front() != nullptr);
+	}
+	return result;
+}
+
+void MidiMerger::Implementation::signal()
+{
+	const eventfd_t value = 1;
+	::write(_eventfd, &value, sizeof(value));
+}
+
+void MidiMerger::Implementation::clearSignal()
+{
+	eventfd_t value = 0;
+	::read(_eventfd, &value, sizeof(value));
+}
+
+MidiMerger::Options::Options()
+	: reorderWindow(std::chrono::milliseconds(2))
+	, inputCapacity(kDefaultInputCapacity)
+	, outputCapacity(kDefaultOutputCapacity)
+	, dispatchMode(MidiInPort::DispatchMode::InputThread)
+{
+}
+
+MidiMerger::MidiMerger(std::size_t inputs, const Options& options, std::shared_ptr<MidiClock> clock)
+	: _impl(new Implementation(inputs, options, std::move(clock)))
+{
+}
+
+MidiMerger::~MidiMerger()
+{
+}
+
+std::size_t MidiMerger::inputCount() const
+{
+	return _impl->inputCount();
+}
+
+void MidiMerger::push(std::size_t input, const MidiMessage& message)
+{
+	_impl->push(input, message);
+}
+
+MidiInPort::MessageHandler MidiMerger::handler(std::size_t input)
+{
+	return _impl->handler(input);
+}
+
+void MidiMerger::setHandler(MidiMerger::Handler handler)
+{
+	_impl->setHandler(std::move(handler));
+}
+
+bool MidiMerger::pop(MidiMessage& message, std::size_t* input)
+{
+	return _impl->pop(message, input);
+}
+
+int MidiMerger::pollDescriptor() const
+{
+	return _impl->pollDescriptor();
+}
+
+std::size_t MidiMerger::processPending()
+{
+	std::size_t result = 0;
+	if (_impl->dispatchMode() == MidiInPort::DispatchMode::CallerThread)
+	{
+		result = _impl->merge(false);
+	}
+	return result;
+}
+
+std::size_t MidiMerger::flush()
+{
+	std::size_t result = 0;
+	if (_impl->dispatchMode() == MidiInPort::DispatchMode::CallerThread)
+	{
+		result = _impl->merge(true);
+	}
+	return result;
+}
+
+MidiMerger::Counters MidiMerger::counters() const
+{
+	return _impl->counters();
+}
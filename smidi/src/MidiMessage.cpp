@@ -42,7 +42,22 @@ bool MidiMessage::isEmpty() const
 
 bool MidiMessage::isActually(MidiMessage::Type type) const
 {
-	return isEmpty() ? false : ((_data.front() & type) == type);
+	bool result = false;
+	if (!isEmpty())
+	{
+		const unsigned char status = _data.front();
+		if (type < System)
+		{
+			// channel message: channel nibble is ignored
+			result = (status & 0xF0) == type;
+		}
+		else
+		{
+			// System is the SysEx status byte too, so it matches SysEx only
+			result = status == type;
+		}
+	}
+	return result;
 }
 
 bool MidiMessage::isCompleteSysEx() const
@@ -54,7 +69,7 @@ unsigned char MidiMessage::channel() const
 {
 	bool emt = isEmpty();
 	bool syst = isActually(System);
-	return (isEmpty() || isActually(System)) ? 0 : (_data.front() & 0x0F);
+	return (isEmpty() || _data.front() >= System) ? 0 : (_data.front() & 0x0F);
 }
 
 unsigned long long MidiMessage::timestamp() const
@@ -0,0 +1,95 @@
+/*!
+ * \file MidiMessageDispatcher.cpp
+ * Contains implementation of MidiMessageDispatcher class.
+ */
+
+#include "../include/smidi/MidiMessageDispatcher.h"
+
+namespace
+{
+	//! Maps every status byte to the handler slot index. Data bytes are mapped to the default slot.
+	struct StatusSlotTable
+	{
+		StatusSlotTable(unsigned char defaultSlot)
+		{
+			for (unsigned int status = 0; status < 0x100; ++status)
+			{
+				if (status < MidiMessage::NoteOff)
+				{
+					slots[status] = defaultSlot;
+				}
+				else if (status < MidiMessage::System)
+				{
+					slots[status] = static_cast<unsigned char>((status >> 4) - (MidiMessage::NoteOff >> 4));
+				}
+				else
+				{
+					slots[status] = static_cast<unsigned char>(7 + (status & 0x0F));
+				}
+			}
+		}
+
+		unsigned char slots[0x100];
+	};
+}
+
+MidiMessageDispatcher::MidiMessageDispatcher()
+    : _handlers{}
+{
+	_lock.clear();
+}
+
+void MidiMessageDispatcher::setHandler(MidiMessageDispatcher::Handler handler)
+{
+	while (_lock.test_and_set(std::memory_order_acquire));
+	_handlers[kDefaultSlot] = handler;
+	_lock.clear(std::memory_order_release);
+}
+
+void MidiMessageDispatcher::setHandler(MidiMessage::Type type, MidiMessageDispatcher::Handler handler)
+{
+	const unsigned int slot = slotForStatus(type);
+	while (_lock.test_and_set(std::memory_order_acquire));
+	_handlers[slot] = handler;
+	_lock.clear(std::memory_order_release);
+}
+
+void MidiMessageDispatcher::resetHandlers()
+{
+	while (_lock.test_and_set(std::memory_order_acquire));
+	for (Handler& handler : _handlers)
+	{
+		handler = nullptr;
+	}
+	_lock.clear(std::memory_order_release);
+}
+
+bool MidiMessageDispatcher::dispatch(const MidiMessage& message) const
+{
+	bool result = false;
+	if (!message.isEmpty())
+	{
+		const Handler handler = handlerForSlot(slotForStatus(message.data().front()));
+		if (handler)
+		{
+			handler(message);
+			result = true;
+		}
+	}
+	return result;
+}
+
+unsigned int MidiMessageDispatcher::slotForStatus(unsigned char status)
+{
+	static const StatusSlotTable table(kDefaultSlot);
+	return table.slots[status];
+}
+
+MidiMessageDispatcher::Handler MidiMessageDispatcher::handlerForSlot(unsigned int slot) const
+{
+	// the handler is copied under the lock and invoked outside of it
+	while (_lock.test_and_set(std::memory_order_acquire));
+	const Handler handler = _handlers[slot] ? _handlers[slot] : _handlers[kDefaultSlot];
+	_lock.clear(std::memory_order_release);
+	return handler;
+}
@@ -0,0 +1,52 @@
+/*!
+ * \file MidiMessageWaiter.cpp
+ * Contains implementation of MidiReceiveAwaitable class and MidiInPort::receive() methods.
+ */
+
+#include "../include/smidi/MidiMessageWaiter.h"
+#include "../include/smidi/MidiInPort.h"
+
+MidiReceiveAwaitable::MidiReceiveAwaitable(MidiInPort& port, MidiMessageWaiter::Filter filter, MidiMessageWaiter::Clock::time_point deadline)
+    : _port(port)
+    , _isRegistered(false)
+{
+	_waiter.filter = filter;
+	_waiter.deadline = deadline;
+}
+
+MidiReceiveAwaitable::MidiReceiveAwaitable(MidiReceiveAwaitable&& other)
+    : _port(other._port)
+    , _isRegistered(false)
+{
+	_waiter.filter = other._waiter.filter;
+	_waiter.deadline = other._waiter.deadline;
+}
+
+MidiReceiveAwaitable::~MidiReceiveAwaitable()
+{
+	if (_isRegistered)
+	{
+		// does nothing if the waiter has been completed already
+		_port.removeWaiter(_waiter);
+	}
+}
+
+MidiMessage MidiReceiveAwaitable::await_resume()
+{
+	return std::move(_waiter.message);
+}
+
+void MidiReceiveAwaitable::registerWaiter()
+{
+	_port.addWaiter(_waiter);
+}
+
+MidiReceiveAwaitable MidiInPort::receive()
+{
+	return MidiReceiveAwaitable(*this, nullptr, MidiMessageWaiter::Clock::time_point::max());
+}
+
+MidiReceiveAwaitable MidiInPort::receive(MidiMessageWaiter::Filter filter, MidiMessageWaiter::Clock::duration timeout)
+{
+	return MidiReceiveAwaitable(*this, filter, MidiMessageWaiter::Clock::now() + timeout);
+}
@@ -0,0 +1,187 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiMessageWaiterList.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiMessageWaiterList.h"
+#include <algorithm>
+
+MidiMessageWaiterList::MidiMessageWaiterList()
+	: _waiters(nullptr)
+	, _completingWaiter(nullptr)
+	, _hasWaiters(false)
+{
+}
+
+void MidiMessageWaiterList::add(MidiMessageWaiter& waiter)
+{
+	waiter.completed = false;
+	waiter.next = nullptr;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	MidiMessageWaiter** tail = &_waiters;
+	while (*tail)
+	{
+		tail = &(*tail)->next;
+	}
+	*tail = &waiter;
+	_hasWaiters = true;
+}
+
+bool MidiMessageWaiterList::remove(MidiMessageWaiter& waiter)
+{
+	bool result = false;
+	std::unique_lock<std::mutex> lock(_mutex);
+	for (MidiMessageWaiter** current = &_waiters; *current; current = &(*current)->next)
+	{
+		if (*current == &waiter)
+		{
+			*current = waiter.next;
+			waiter.next = nullptr;
+			result = true;
+			break;
+		}
+	}
+	_hasWaiters = (_waiters != nullptr);
+
+	// the completing thread writes into the waiter, so it can't be destroyed before that's over;
+	// the completion itself may destroy it, then there's nothing to wait for
+	if (!result && _completingWaiter == &waiter && _completingThread != std::this_thread::get_id())
+	{
+		_completionFinished.wait(lock, [this, &waiter]() { return _completingWaiter != &waiter; });
+	}
+	return result;
+}
+
+bool MidiMessageWaiterList::isEmpty() const
+{
+	return !_hasWaiters;
+}
+
+bool MidiMessageWaiterList::complete(const MidiMessage& message)
+{
+	MidiMessageWaiter* completedWaiter = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (MidiMessageWaiter** current = &_waiters; *current; current = &(*current)->next)
+		{
+			MidiMessageWaiter* waiter = *current;
+			if (!waiter->filter || waiter->filter(message))
+			{
+				claim(current);
+				completedWaiter = waiter;
+				break;
+			}
+		}
+	}
+
+	// completion is invoked outside of the lock, so resumed coroutine can wait for the next message
+	if (completedWaiter)
+	{
+		completedWaiter->message = message;
+		completedWaiter->completed = true;
+		finishCompletion(*completedWaiter);
+	}
+	return completedWaiter != nullptr;
+}
+
+void MidiMessageWaiterList::completeExpired(bool completeAll)
+{
+	if (_hasWaiters)
+	{
+		const MidiMessageWaiter::Clock::time_point now = MidiMessageWaiter::Clock::now();
+
+		// completions may add new waiters behind the present ones, those are left for the next call
+		std::size_t candidates = 0;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (const MidiMessageWaiter* waiter = _waiters; waiter; waiter = waiter->next)
+			{
+				++candidates;
+			}
+		}
+
+		MidiMessageWaiter* expiredWaiter = nullptr;
+		do
+		{
+			expiredWaiter = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				std::size_t index = 0;
+				for (MidiMessageWaiter** current = &_waiters; *current && index < candidates; current = &(*current)->next, ++index)
+				{
+					if (completeAll || (*current)->deadline <= now)
+					{
+						expiredWaiter = *current;
+						claim(current);
+						--candidates;
+						break;
+					}
+				}
+			}
+
+			if (expiredWaiter)
+			{
+				expiredWaiter->message.resizeBuffer(0);
+				expiredWaiter->completed = true;
+				finishCompletion(*expiredWaiter);
+			}
+		}
+		while (expiredWaiter);
+	}
+}
+
+int MidiMessageWaiterList::timeoutToNextDeadline()
+{
+	int timeoutInMilliseconds = -1; // infinite
+	if (_hasWaiters)
+	{
+		MidiMessageWaiter::Clock::time_point nextDeadline = MidiMessageWaiter::Clock::time_point::max();
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (const MidiMessageWaiter* waiter = _waiters; waiter; waiter = waiter->next)
+			{
+				nextDeadline = std::min(nextDeadline, waiter->deadline);
+			}
+		}
+		if (nextDeadline != MidiMessageWaiter::Clock::time_point::max())
+		{
+			const MidiMessageWaiter::Clock::duration timeLeft = nextDeadline - MidiMessageWaiter::Clock::now();
+			// round up, otherwise poll() returns just before the deadline
+			const std::chrono::milliseconds timeLeftInMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(timeLeft + std::chrono::milliseconds(1) - MidiMessageWaiter::Clock::duration(1));
+			timeoutInMilliseconds = static_cast<int>(std::max<std::chrono::milliseconds::rep>(0, timeLeftInMilliseconds.count()));
+		}
+	}
+	return timeoutInMilliseconds;
+}
+
+void MidiMessageWaiterList::claim(MidiMessageWaiter** link)
+{
+	MidiMessageWaiter* waiter = *link;
+	*link = waiter->next;
+	waiter->next = nullptr;
+	_completingWaiter = waiter;
+	_completingThread = std::this_thread::get_id();
+	_hasWaiters = (_waiters != nullptr);
+}
+
+void MidiMessageWaiterList::finishCompletion(MidiMessageWaiter& waiter)
+{
+	// the completion may destroy the waiter, e.g. a resumed coroutine which runs to its end
+	const MidiMessageWaiter::Completion completion = waiter.completion;
+	if (completion)
+	{
+		completion();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_completingWaiter = nullptr;
+		_completingThread = std::thread::id();
+	}
+	_completionFinished.notify_all();
+}
+
+//! \endcond
@@ -0,0 +1,64 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiMessageWaiterList.h
+ * \warning This file is not a part of library public interface!
+ * Contains list of MidiMessageWaiter objects registered on the input port
+ */
+
+#include "../include/smidi/MidiMessageWaiter.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*!
+ * \brief The MidiMessageWaiterList class keeps waiters of the input port
+ * \class MidiMessageWaiterList MidiMessageWaiterList.h "MidiMessageWaiterList.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Waiters are added and removed by any thread, completed by the thread that dispatches incoming messages
+ * (one at a time). Completions are invoked outside of the lock, so a resumed coroutine can register the next
+ * waiter right away. The waiter being completed is claimed under the lock, and remove() called for it from
+ * another thread waits until its completion returns, so the waiter is never destroyed while it's written.
+ * Filters are called under the lock, so they must not call back into the port.
+ */
+class MidiMessageWaiterList
+{
+public:
+	MidiMessageWaiterList();
+
+	void add(MidiMessageWaiter& waiter);
+	bool remove(MidiMessageWaiter& waiter);
+
+	//! Lock-free check used on every incoming message
+	bool isEmpty() const;
+
+	//! Completes the first waiter that accepts the message, returns `false` if there is no such waiter
+	bool complete(const MidiMessage& message);
+
+	//! Completes waiters with empty message if their deadline has passed (or all of them)
+	void completeExpired(bool completeAll);
+
+	//! Returns poll() timeout in milliseconds until the nearest deadline, -1 if there is no deadline
+	int timeoutToNextDeadline();
+
+private:
+	//! Unlinks the waiter and claims it for completion, must be called under the lock
+	void claim(MidiMessageWaiter** link);
+
+	//! Invokes the completion of the claimed waiter and releases the claim, the waiter isn't touched afterwards
+	void finishCompletion(MidiMessageWaiter& waiter);
+
+private:
+	std::mutex              _mutex;
+	std::condition_variable _completionFinished;
+	MidiMessageWaiter*      _waiters;
+	MidiMessageWaiter*      _completingWaiter; // claimed, its completion is in flight
+	std::thread::id         _completingThread;
+	std::atomic<bool>       _hasWaiters;
+};
+
+//! \endcond
@@ -0,0 +1,156 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiMetricsCounters.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiMetricsCounters.h"
+#include <cstdlib>
+
+MidiPortCounters::MidiPortCounters()
+{
+	for (std::size_t type = 0; type < MidiPortMetrics::kMessageTypes; ++type)
+	{
+		_messages[type].store(0, std::memory_order_relaxed);
+		_bytes[type].store(0, std::memory_order_relaxed);
+	}
+	for (Counter& bucket : _latencyHistogram)
+	{
+		bucket.store(0, std::memory_order_relaxed);
+	}
+	_decodeFailures.store(0, std::memory_order_relaxed);
+	_encodeFailures.store(0, std::memory_order_relaxed);
+	_sendFailures.store(0, std::memory_order_relaxed);
+	_overruns.store(0, std::memory_order_relaxed);
+	_coalesced.store(0, std::memory_order_relaxed);
+}
+
+void MidiPortCounters::countMessage(const MidiMessage& message)
+{
+	if (!message.isEmpty())
+	{
+		const std::size_t type = MidiPortMetrics::typeIndex(message.data().front());
+		if (type < MidiPortMetrics::kMessageTypes)
+		{
+			increment(_messages[type]);
+			increment(_bytes[type], message.size());
+		}
+	}
+}
+
+void MidiPortCounters::countLatency(unsigned long long latencyInNanoseconds)
+{
+	increment(_latencyHistogram[bucketFor(latencyInNanoseconds)]);
+}
+
+void MidiPortCounters::countDecodeFailure(unsigned long long count)
+{
+	increment(_decodeFailures, count);
+}
+
+void MidiPortCounters::countEncodeFailure()
+{
+	increment(_encodeFailures);
+}
+
+void MidiPortCounters::countSendFailure()
+{
+	increment(_sendFailures);
+}
+
+void MidiPortCounters::countOverrun()
+{
+	increment(_overruns);
+}
+
+void MidiPortCounters::countCoalesced()
+{
+	increment(_coalesced);
+}
+
+MidiPortMetrics MidiPortCounters::snapshot() const
+{
+	MidiPortMetrics result = {};
+	for (std::size_t type = 0; type < MidiPortMetrics::kMessageTypes; ++type)
+	{
+		result.messages[type] = _messages[type].load(std::memory_order_relaxed);
+		result.bytes[type] = _bytes[type].load(std::memory_order_relaxed);
+	}
+	for (std::size_t bucket = 0; bucket < MidiPortMetrics::kLatencyBuckets; ++bucket)
+	{
+		result.latencyHistogram[bucket] = _latencyHistogram[bucket].load(std::memory_order_relaxed);
+	}
+	result.decodeFailures = _decodeFailures.load(std::memory_order_relaxed);
+	result.encodeFailures = _encodeFailures.load(std::memory_order_relaxed);
+	result.sendFailures = _sendFailures.load(std::memory_order_relaxed);
+	result.overruns = _overruns.load(std::memory_order_relaxed);
+	result.coalesced = _coalesced.load(std::memory_order_relaxed);
+	return result;
+}
+
+std::size_t MidiPortCounters::bucketFor(unsigned long long nanoseconds)
+{
+	// bucket 0 is below 1 us, bucket N covers [2^(N-1), 2^N) us
+	const unsigned long long microseconds = nanoseconds / 1000;
+	const std::size_t bucket = (microseconds == 0) ? 0 : static_cast<std::size_t>(64 - __builtin_clzll(microseconds));
+	return (bucket < MidiPortMetrics::kLatencyBuckets) ? bucket : (MidiPortMetrics::kLatencyBuckets - 1);
+}
+
+void MidiPortCounters::increment(MidiPortCounters::Counter& counter, unsigned long long value)
+{
+	counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+MidiSyncCounters::MidiSyncCounters()
+    : _periods(0)
+    , _lastPeriodError(0)
+    , _maxPeriodError(0)
+    , _phaseCorrections(0)
+    , _lastPhaseCorrection(0)
+    , _totalPhaseCorrection(0)
+{
+	for (std::atomic<unsigned long long>& bucket : _jitterHistogram)
+	{
+		bucket.store(0, std::memory_order_relaxed);
+	}
+}
+
+void MidiSyncCounters::countPeriod(long long errorInNanoseconds)
+{
+	// single writer, so plain load/store pairs are enough
+	_periods.store(_periods.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	_lastPeriodError.store(errorInNanoseconds, std::memory_order_relaxed);
+	if (errorInNanoseconds > _maxPeriodError.load(std::memory_order_relaxed))
+	{
+		_maxPeriodError.store(errorInNanoseconds, std::memory_order_relaxed);
+	}
+
+	std::atomic<unsigned long long>& bucket = _jitterHistogram[MidiPortCounters::bucketFor(static_cast<unsigned long long>(std::llabs(errorInNanoseconds)))];
+	bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void MidiSyncCounters::countPhaseCorrection(long long correctionInNanoseconds)
+{
+	_phaseCorrections.store(_phaseCorrections.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	_lastPhaseCorrection.store(correctionInNanoseconds, std::memory_order_relaxed);
+	_totalPhaseCorrection.store(_totalPhaseCorrection.load(std::memory_order_relaxed) + correctionInNanoseconds, std::memory_order_relaxed);
+}
+
+MidiSyncMetrics MidiSyncCounters::snapshot() const
+{
+	MidiSyncMetrics result = {};
+	result.periods = _periods.load(std::memory_order_relaxed);
+	result.lastPeriodError = _lastPeriodError.load(std::memory_order_relaxed);
+	result.maxPeriodError = _maxPeriodError.load(std::memory_order_relaxed);
+	for (std::size_t bucket = 0; bucket < MidiSyncMetrics::kJitterBuckets; ++bucket)
+	{
+		result.jitterHistogram[bucket] = _jitterHistogram[bucket].load(std::memory_order_relaxed);
+	}
+	result.phaseCorrections = _phaseCorrections.load(std::memory_order_relaxed);
+	result.lastPhaseCorrection = _lastPhaseCorrection.load(std::memory_order_relaxed);
+	result.totalPhaseCorrection = _totalPhaseCorrection.load(std::memory_order_relaxed);
+	return result;
+}
+
+//! \endcond
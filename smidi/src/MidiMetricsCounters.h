@@ -0,0 +1,81 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiMetricsCounters.h
+ * \warning This file is not a part of library public interface!
+ * Contains lock-free counters behind MidiPortMetrics and MidiSyncMetrics snapshots
+ */
+
+#include "../include/smidi/MidiMetrics.h"
+#include <atomic>
+
+/*!
+ * \brief The MidiPortCounters class collects MidiPortMetrics
+ * \class MidiPortCounters MidiMetricsCounters.h "MidiMetricsCounters.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * All updates are relaxed atomic increments, so they cost a few cycles and never wait for the readers.
+ */
+class MidiPortCounters
+{
+public:
+	MidiPortCounters();
+
+	void countMessage(const MidiMessage& message);
+	void countLatency(unsigned long long latencyInNanoseconds);
+	void countDecodeFailure(unsigned long long count = 1);
+	void countEncodeFailure();
+	void countSendFailure();
+	void countOverrun();
+	void countCoalesced();
+
+	MidiPortMetrics snapshot() const;
+
+	static std::size_t bucketFor(unsigned long long nanoseconds);
+
+private:
+	using Counter = std::atomic<unsigned long long>;
+
+	static void increment(Counter& counter, unsigned long long value = 1);
+
+private:
+	Counter _messages[MidiPortMetrics::kMessageTypes];
+	Counter _bytes[MidiPortMetrics::kMessageTypes];
+	Counter _decodeFailures;
+	Counter _encodeFailures;
+	Counter _sendFailures;
+	Counter _overruns;
+	Counter _coalesced;
+	Counter _latencyHistogram[MidiPortMetrics::kLatencyBuckets];
+};
+
+/*!
+ * \brief The MidiSyncCounters class collects MidiSyncMetrics
+ * \class MidiSyncCounters MidiMetricsCounters.h "MidiMetricsCounters.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Updated only from the sync thread.
+ */
+class MidiSyncCounters
+{
+public:
+	MidiSyncCounters();
+
+	void countPeriod(long long errorInNanoseconds);
+	void countPhaseCorrection(long long correctionInNanoseconds);
+
+	MidiSyncMetrics snapshot() const;
+
+private:
+	std::atomic<unsigned long long> _periods;
+	std::atomic<long long>          _lastPeriodError;
+	std::atomic<long long>          _maxPeriodError;
+	std::atomic<unsigned long long> _jitterHistogram[MidiSyncMetrics::kJitterBuckets];
+	std::atomic<unsigned long long> _phaseCorrections;
+	std::atomic<long long>          _lastPhaseCorrection;
+	std::atomic<long long>          _totalPhaseCorrection;
+};
+
+//! \endcond
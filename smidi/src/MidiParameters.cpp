@@ -0,0 +1,334 @@
+/*!
+ * \file MidiParameters.cpp
+ * Contains implementation of MidiParameterDecoder and MidiParameterEncoder classes.
+ */
+
+#include "../include/smidi/MidiParameters.h"
+#include <cstring>
+
+namespace
+{
+	const unsigned char kDataEntryMsb = 6;
+	const unsigned char kDataEntryLsb = 38;
+	const unsigned char kNrpnLsb = 98;
+	const unsigned char kNrpnMsb = 99;
+	const unsigned char kRpnLsb = 100;
+	const unsigned char kRpnMsb = 101;
+	const unsigned char kNullParameter = 127;
+	const unsigned char kLsbOffset = 32;
+
+	void writeControlChange(MidiMessage& message, unsigned char channel, unsigned char controller, unsigned char value, unsigned long long timestamp)
+	{
+		message.resizeBuffer(3);
+		unsigned char* bytes = message;
+		bytes[0] = static_cast<unsigned char>(MidiMessage::ControlChange | channel);
+		bytes[1] = controller;
+		bytes[2] = value;
+		message.setTimestamp(timestamp);
+	}
+}
+
+const unsigned char MidiParameterDecoder::kNone;
+const unsigned char MidiParameterDecoder::kDataEntry;
+const std::size_t MidiParameterEncoder::kMaxMessages;
+const unsigned char MidiParameterEncoder::kNone;
+
+MidiParameterDecoder::Options::Options()
+	: highResolutionControllers(0xFFFFFFFEu & ~(1u << kDataEntryMsb))
+	, partialUpdate(PartialUpdate::WaitForLsb)
+	, timeout(std::chrono::milliseconds(10))
+{
+}
+
+MidiParameterDecoder::MidiParameterDecoder(Handler handler, const Options& options)
+	: _handler(handler)
+	, _options(options)
+	, _pendingCount(0)
+{
+	reset();
+}
+
+bool MidiParameterDecoder::process(const MidiMessage& message)
+{
+	bool result = false;
+	const MidiMessage::data_type& bytes = message.data();
+	const unsigned long long timestamp = message.timestamp();
+
+	if (_pendingCount > 0)
+	{
+		flush(timestamp);
+	}
+
+	if (bytes.size() == 3 && (bytes[0] & 0xF0) == MidiMessage::ControlChange)
+	{
+		const unsigned char channel = bytes[0] & 0x0F;
+		const unsigned char controller = bytes[1] & 0x7F;
+		const Channel& state = _channels[channel];
+
+		// anything but the LSB of the waiting MSB completes it as it is
+		const bool completesPending = (state.pending == kDataEntry) ? controller == kDataEntryLsb : controller == state.pending + kLsbOffset;
+		if (state.pending != kNone && !completesPending)
+		{
+			completePending(channel);
+		}
+		result = processControlChange(channel, controller, bytes[2] & 0x7F, timestamp);
+	}
+	else if (!bytes.empty() && bytes[0] >= MidiMessage::NoteOff && bytes[0] < MidiMessage::System)
+	{
+		completePending(bytes[0] & 0x0F);
+	}
+	else if (bytes.size() == 1 && bytes[0] == MidiMessage::Reset)
+	{
+		reset();
+	}
+	return result;
+}
+
+void MidiParameterDecoder::flush(unsigned long long now)
+{
+	const unsigned long long timeout = static_cast<unsigned long long>(_options.timeout.count());
+	for (unsigned char channel = 0; channel < 16 && _pendingCount > 0; ++channel)
+	{
+		if (_channels[channel].pending != kNone && now > _channels[channel].pendingTime + timeout)
+		{
+			completePending(channel);
+		}
+	}
+}
+
+void MidiParameterDecoder::flush()
+{
+	for (unsigned char channel = 0; channel < 16 && _pendingCount > 0; ++channel)
+	{
+		completePending(channel);
+	}
+}
+
+void MidiParameterDecoder::reset()
+{
+	for (Channel& state : _channels)
+	{
+		std::memset(state.msb, kNone, sizeof(state.msb));
+		std::memset(state.lsb, 0, sizeof(state.lsb));
+		std::memset(state.rpn, kNone, sizeof(state.rpn));
+		std::memset(state.nrpn, kNone, sizeof(state.nrpn));
+		state.dataMsb = kNone;
+		state.dataLsb = 0;
+		state.pending = kNone;
+		state.isNrpn = false;
+		state.pendingTime = 0;
+	}
+	_pendingCount = 0;
+}
+
+bool MidiParameterDecoder::processControlChange(unsigned char channel, unsigned char controller, unsigned char value, unsigned long long timestamp)
+{
+	bool result = false;
+	Channel& state = _channels[channel];
+	if (controller == kDataEntryMsb || controller == kDataEntryLsb)
+	{
+		if (hasParameter(state) && controller == kDataEntryMsb)
+		{
+			state.dataMsb = value;
+			state.dataLsb = 0;
+			receiveMsb(channel, kDataEntry, timestamp);
+			result = true;
+		}
+		else if (hasParameter(state) && state.dataMsb != kNone)
+		{
+			clearPending(state);
+			state.dataLsb = value;
+			emit(channel, kDataEntry, true, timestamp);
+			result = true;
+		}
+	}
+	else if (controller >= kNrpnLsb && controller <= kRpnMsb)
+	{
+		selectParameter(state, controller, value);
+		result = true;
+	}
+	else if (controller < kLsbOffset && (_options.highResolutionControllers & (1u << controller)) != 0)
+	{
+		state.msb[controller] = value;
+		state.lsb[controller] = 0;
+		receiveMsb(channel, controller, timestamp);
+		result = true;
+	}
+	else if (controller >= kLsbOffset && controller < 2 * kLsbOffset && (_options.highResolutionControllers & (1u << (controller - kLsbOffset))) != 0)
+	{
+		// an LSB without any MSB before it has no meaning as a 14-bit value
+		const unsigned char index = controller - kLsbOffset;
+		if (state.msb[index] != kNone)
+		{
+			clearPending(state);
+			state.lsb[index] = value;
+			emit(channel, index, true, timestamp);
+			result = true;
+		}
+	}
+
+	return result;
+}
+
+void MidiParameterDecoder::selectParameter(Channel& state, unsigned char controller, unsigned char value)
+{
+	const bool isNrpn = (controller == kNrpnMsb || controller == kNrpnLsb);
+	unsigned char* number = isNrpn ? state.nrpn : state.rpn;
+	const std::size_t index = (controller == kNrpnMsb || controller == kRpnMsb) ? 0 : 1;
+	if (number[index] != value || state.isNrpn != isNrpn)
+	{
+		// the value of the previous parameter means nothing for the new one
+		state.dataMsb = kNone;
+		state.dataLsb = 0;
+	}
+	number[index] = value;
+	state.isNrpn = isNrpn;
+}
+
+bool MidiParameterDecoder::hasParameter(const Channel& state)
+{
+	const unsigned char* number = state.isNrpn ? state.nrpn : state.rpn;
+	return number[0] != kNone && number[1] != kNone && !(number[0] == kNullParameter && number[1] == kNullParameter);
+}
+
+void MidiParameterDecoder::receiveMsb(unsigned char channel, unsigned char index, unsigned long long timestamp)
+{
+	if (_options.partialUpdate == PartialUpdate::Immediate)
+	{
+		emit(channel, index, false, timestamp);
+	}
+	else
+	{
+		Channel& state = _channels[channel];
+		state.pending = index;
+		state.pendingTime = timestamp;
+		++_pendingCount;
+	}
+}
+
+void MidiParameterDecoder::clearPending(Channel& state)
+{
+	if (state.pending != kNone)
+	{
+		state.pending = kNone;
+		--_pendingCount;
+	}
+}
+
+void MidiParameterDecoder::completePending(unsigned char channel)
+{
+	Channel& state = _channels[channel];
+	if (state.pending != kNone)
+	{
+		const unsigned char index = state.pending;
+		clearPending(state);
+		emit(channel, index, false, state.pendingTime);
+	}
+}
+
+void MidiParameterDecoder::emit(unsigned char channel, unsigned char index, bool isFine, unsigned long long timestamp)
+{
+	const Channel& state = _channels[channel];
+	MidiParameterEvent event;
+	event.channel = channel;
+	event.isFine = isFine;
+	event.timestamp = timestamp;
+	if (index == kDataEntry)
+	{
+		const unsigned char* number = state.isNrpn ? state.nrpn : state.rpn;
+		event.type = state.isNrpn ? MidiParameterEvent::Nrpn : MidiParameterEvent::Rpn;
+		event.number = number[0] * 128u + number[1];
+		event.value = state.dataMsb * 128u + (isFine ? state.dataLsb : 0u);
+	}
+	else
+	{
+		event.type = MidiParameterEvent::Controller;
+		event.number = index;
+		event.value = state.msb[index] * 128u + (isFine ? state.lsb[index] : 0u);
+	}
+
+	if (_handler)
+	{
+		_handler(event);
+	}
+}
+
+MidiParameterEncoder::MidiParameterEncoder()
+{
+	reset();
+}
+
+std::size_t MidiParameterEncoder::encode(const MidiParameterEvent& event, MidiMessage* messages)
+{
+	std::size_t result = 0;
+	const unsigned char channel = event.channel & 0x0F;
+	const unsigned char msb = static_cast<unsigned char>((event.value >> 7) & 0x7F);
+	const unsigned char lsb = event.isFine ? static_cast<unsigned char>(event.value & 0x7F) : 0;
+	Channel& state = _channels[channel];
+
+	unsigned char* sentMsb = nullptr;
+	unsigned char* sentLsb = nullptr;
+	unsigned char msbController = kDataEntryMsb;
+	if (event.type == MidiParameterEvent::Controller)
+	{
+		const unsigned char controller = static_cast<unsigned char>(event.number % kLsbOffset);
+		sentMsb = &state.msb[controller];
+		sentLsb = &state.lsb[controller];
+		msbController = controller;
+	}
+	else
+	{
+		// the parameter number goes first, only its bytes the receiver doesn't have yet
+		const bool isNrpn = (event.type == MidiParameterEvent::Nrpn);
+		unsigned char* sentNumber = isNrpn ? state.nrpn : state.rpn;
+		const unsigned char number[2] = {static_cast<unsigned char>((event.number >> 7) & 0x7F), static_cast<unsigned char>(event.number & 0x7F)};
+		const unsigned char selected = static_cast<unsigned char>(event.type);
+		const bool isSameKind = (state.selected == selected);
+		for (std::size_t i = 0; i < 2; ++i)
+		{
+			if (!isSameKind || sentNumber[i] != number[i])
+			{
+				const unsigned char controller = isNrpn ? (i == 0 ? kNrpnMsb : kNrpnLsb) : (i == 0 ? kRpnMsb : kRpnLsb);
+				writeControlChange(messages[result++], channel, controller, number[i], event.timestamp);
+				sentNumber[i] = number[i];
+			}
+		}
+		if (result > 0)
+		{
+			state.selected = selected;
+			state.dataMsb = kNone;
+			state.dataLsb = kNone;
+		}
+		sentMsb = &state.dataMsb;
+		sentLsb = &state.dataLsb;
+	}
+
+	// the MSB resets the LSB of the receiver, so an unchanged MSB is only sent to clear the fine part
+	const bool sendsMsb = (*sentMsb != msb) || (!event.isFine && *sentLsb != 0);
+	if (sendsMsb)
+	{
+		writeControlChange(messages[result++], channel, msbController, msb, event.timestamp);
+		*sentMsb = msb;
+		*sentLsb = 0;
+	}
+	if (event.isFine && (sendsMsb || *sentLsb != lsb))
+	{
+		writeControlChange(messages[result++], channel, static_cast<unsigned char>(msbController + kLsbOffset), lsb, event.timestamp);
+		*sentLsb = lsb;
+	}
+	return result;
+}
+
+void MidiParameterEncoder::reset()
+{
+	for (Channel& state : _channels)
+	{
+		std::memset(state.msb, kNone, sizeof(state.msb));
+		std::memset(state.lsb, kNone, sizeof(state.lsb));
+		std::memset(state.rpn, kNone, sizeof(state.rpn));
+		std::memset(state.nrpn, kNone, sizeof(state.nrpn));
+		state.dataMsb = kNone;
+		state.dataLsb = kNone;
+		state.selected = kNone;
+	}
+}
@@ -0,0 +1,706 @@
+/*!
+ * \file MidiPlayer.cpp
+ * Contains implementation of MidiPlayer class.
+ */
+
+#include "../include/smidi/MidiPlayer.h"
+#include "MidiLogging.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+
+namespace
+{
+	const unsigned int kNumberOfChannels = 16;
+	const unsigned int kNumberOfNotes = 128;
+	const std::size_t kMaxBatchSize = 256;
+	const std::chrono::milliseconds kDefaultLookahead(100);
+	const unsigned long long kNever = std::numeric_limits<unsigned long long>::max();
+
+	// messages handed over later than that are counted as late
+	const unsigned long long kLateThresholdInNanoseconds = 1000000;
+
+	// sleeping on a simulated clock can't be interrupted by commands, so it is done in steps
+	const unsigned long long kMaxSleepInNanoseconds = 10000000;
+
+	double bpmForTempo(unsigned int microsecondsPerQuarterNote)
+	{
+		return 60e6 / std::max(microsecondsPerQuarterNote, 1u);
+	}
+
+	//! Events of all tracks of the file merged by tick
+	class FileSource : public MidiPlayer::Source
+	{
+	public:
+		explicit FileSource(const MidiFile& file)
+			: _file(file)
+			, _iterator(file.events().begin())
+		{
+		}
+
+		virtual void seek(unsigned long long tick) override
+		{
+			_iterator = _file.events().begin();
+			while (_iterator != _end && _iterator->tick < tick)
+			{
+				++_iterator;
+			}
+		}
+
+		virtual bool next(MidiFileEvent& event) override
+		{
+			const bool result = (_iterator != _end);
+			if (result)
+			{
+				event = *_iterator;
+				++_iterator;
+			}
+			return result;
+		}
+
+	private:
+		const MidiFile&    _file;
+		MidiFile::Iterator _iterator;
+		MidiFile::Iterator _end;
+	};
+}
+
+MidiPlayer::Options::Options()
+	: lookahead(kDefaultLookahead)
+	, sync(nullptr)
+{
+}
+
+class MidiPlayer::Implementation
+{
+public:
+	Implementation(std::shared_ptr<MidiOutPort> port, const Options& options, std::shared_ptr<MidiClock> clock);
+	~Implementation();
+
+	void load(std::unique_ptr<Source> source, const MidiTempoMap& tempoMap);
+	void play();
+	void stop();
+	void locate(unsigned long long tick);
+	bool setLoop(unsigned long long startTick, unsigned long long endTick);
+	void clearLoop();
+	bool isPlaying() const;
+	bool isQueueScheduling() const;
+	unsigned long long position() const;
+	Counters counters() const;
+
+private:
+	//! Part of the playback with the same tick to time mapping, a new one starts with every jump
+	struct Pass
+	{
+		unsigned long long startTime;
+		unsigned long long startTick;
+		long long          origin;    // clock time of tick 0
+	};
+
+	//! Times of a note handed over to the port, it sounds from `on` until `off` (kNever while its Note Off is not)
+	struct NoteTimes
+	{
+		unsigned long long on;
+		unsigned long long off;
+	};
+
+	void playerThread();
+	void restart(unsigned long long now);
+	void fetch();
+	void jumpToLoopStart();
+	void collect(unsigned long long now, unsigned long long horizon);
+	void finish();
+	void output(std::unique_lock<std::mutex>& lock, bool immediately);
+	void wait(std::unique_lock<std::mutex>& lock, unsigned long long now, unsigned long long wakeTime);
+
+	MidiMessage& appendMessage();
+	void trackNote(const MidiMessage& message, unsigned long long now);
+	void releaseNotes(unsigned long long time);
+	void releaseSoundingNotes(unsigned long long now);
+	void appendNoteOff(std::size_t note, unsigned long long time);
+	unsigned long long clockTime(unsigned long long tick);
+	unsigned long long playedTick(unsigned long long now) const;
+	void stopPlayback();
+
+private:
+	std::shared_ptr<MidiOutPort>                             _port;
+	std::shared_ptr<MidiClock>                               _clock;
+	const unsigned long long                                 _lookahead;
+	MidiSync* const                                          _sync;
+	const bool                                               _queueScheduling;
+	mutable std::mutex                                       _mutex;
+	std::condition_variable                                  _condition;
+	std::unique_ptr<Source>                                  _source;
+	MidiTempoMap                                             _tempoMap;
+	std::size_t                                              _tempoHint;
+	MidiFileEvent                                            _event;
+	unsigned long long                                       _eventTime;
+	std::deque<Pass>                                         _passes;
+	std::deque<std::pair<unsigned long long, unsigned int>>  _tempoChanges; // time and tempo for the sync
+	std::vector<MidiMessage>                                 _batch;
+	std::size_t                                              _batchSize;
+	std::vector<NoteTimes>                                   _notes;
+	unsigned long long                                       _position;
+	unsigned long long                                       _loopStart;
+	unsigned long long                                       _loopEnd;
+	unsigned long long                                       _lastTick;
+	unsigned long long                                       _lastTime;
+	bool                                                     _hasEvent;
+	bool                                                     _atLoopEnd;
+	bool                                                     _playing;
+	bool                                                     _restart;
+	bool                                                     _cancel;
+	bool                                                     _exit;
+	bool                                                     _syncStarted;
+	std::atomic<unsigned long long>                          _messages;
+	std::atomic<unsigned long long>                          _late;
+	std::atomic<unsigned long long>                          _maxLateness;
+	std::atomic<unsigned long long>                          _loops;
+	std::thread                                              _thread;
+};
+
+MidiPlayer::Implementation::Implementation(std::shared_ptr<MidiOutPort> port, const Options& options, std::shared_ptr<MidiClock> clock)
+	: _port(std::move(port))
+	, _clock(std::move(clock))
+	, _lookahead(static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::max(options.lookahead, std::chrono::milliseconds(1))).count()))
+	, _sync(options.sync)
+	, _queueScheduling(_clock == MidiClock::system() && _port && _port->scheduleMessages(nullptr, 0))
+	, _tempoHint(0)
+	, _event()
+	, _eventTime(0)
+	, _batch(kMaxBatchSize + kNumberOfChannels * kNumberOfNotes)
+	, _batchSize(0)
+	, _notes(kNumberOfChannels * kNumberOfNotes, NoteTimes{kNever, 0})
+	, _position(0)
+	, _loopStart(0)
+	, _loopEnd(0)
+	, _lastTick(0)
+	, _lastTime(0)
+	, _hasEvent(false)
+	, _atLoopEnd(false)
+	, _playing(false)
+	, _restart(false)
+	, _cancel(false)
+	, _exit(false)
+	, _syncStarted(false)
+	, _messages(0)
+	, _late(0)
+	, _maxLateness(0)
+	, _loops(0)
+	, _thread(&MidiPlayer::Implementation::playerThread, this)
+{
+}
+
+MidiPlayer::Implementation::~Implementation()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		stopPlayback();
+		_exit = true;
+	}
+	_condition.notify_one();
+	_thread.join();
+}
+
+void MidiPlayer::Implementation::load(std::unique_ptr<Source> source, const MidiTempoMap& tempoMap)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	stopPlayback();
+	_source = std::move(source);
+	_tempoMap = tempoMap;
+	_tempoHint = 0;
+	_hasEvent = false;
+	_position = 0;
+	_condition.notify_one();
+}
+
+void MidiPlayer::Implementation::play()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_playing && _source && _port)
+	{
+		_playing = true;
+		_restart = true;
+	}
+	_condition.notify_one();
+}
+
+void MidiPlayer::Implementation::stop()
+{
+	// the notification is under the lock, the player may be destroyed as soon as isPlaying() returns `false`
+	std::lock_guard<std::mutex> lock(_mutex);
+	stopPlayback();
+	_condition.notify_one();
+}
+
+void MidiPlayer::Implementation::locate(unsigned long long tick)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_position = tick;
+	if (_playing)
+	{
+		_cancel = true;
+		_restart = true;
+	}
+	_condition.notify_one();
+}
+
+bool MidiPlayer::Implementation::setLoop(unsigned long long startTick, unsigned long long endTick)
+{
+	const bool result = startTick < endTick;
+	if (result)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_loopStart = startTick;
+		_loopEnd = endTick;
+	}
+	return result;
+}
+
+void MidiPlayer::Implementation::clearLoop()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_loopStart = 0;
+	_loopEnd = 0;
+}
+
+bool MidiPlayer::Implementation::isPlaying() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _playing;
+}
+
+bool MidiPlayer::Implementation::isQueueScheduling() const
+{
+	return _queueScheduling;
+}
+
+unsigned long long MidiPlayer::Implementation::position() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return (_playing && !_restart) ? playedTick(_clock->now()) : _position;
+}
+
+MidiPlayer::Counters MidiPlayer::Implementation::counters() const
+{
+	Counters result = {};
+	result.messages = _messages.load(std::memory_order_relaxed);
+	result.late = _late.load(std::memory_order_relaxed);
+	result.maxLateness = _maxLateness.load(std::memory_order_relaxed);
+	result.loops = _loops.load(std::memory_order_relaxed);
+	return result;
+}
+
+void MidiPlayer::Implementation::stopPlayback()
+{
+	if (_playing)
+	{
+		_position = _restart ? _position : playedTick(_clock->now());
+		_playing = false;
+		_restart = false;
+		_cancel = true;
+	}
+}
+
+void MidiPlayer::Implementation::playerThread()
+{
+	// queued messages don't need it, but software scheduling is much more regular with real time priority
+	if (_clock == MidiClock::system() && !_queueScheduling)
+	{
+		sched_param parameters = {};
+		parameters.sched_priority = sched_get_priority_min(SCHED_FIFO);
+		const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+		if (error != 0)
+		{
+			SMIDI_LOG_DEBUG("Player thread runs without real time priority: %s", std::strerror(error));
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true)
+	{
+		if (_cancel)
+		{
+			_cancel = false;
+			_tempoChanges.clear();
+			// queued messages are dropped first, what sounds after that is known from the note times
+			lock.unlock();
+			_port->cancelScheduledMessages();
+			lock.lock();
+			releaseSoundingNotes(_clock->now());
+			output(lock, true);
+			if (!_playing && _syncStarted)
+			{
+				_sync->stopSync();
+				_syncStarted = false;
+			}
+			continue;
+		}
+
+		if (_exit)
+		{
+			break;
+		}
+
+		if (!_playing)
+		{
+			_condition.wait(lock, [this]() { return _exit || _cancel || _playing; });
+			continue;
+		}
+
+		const unsigned long long now = _clock->now();
+		if (_restart)
+		{
+			_restart = false;
+			restart(now);
+		}
+
+		while (!_tempoChanges.empty() && _tempoChanges.front().first <= now)
+		{
+			_sync->changeSyncBpm(bpmForTempo(_tempoChanges.front().second));
+			_tempoChanges.pop_front();
+		}
+		while (_passes.size() > 1 && _passes[1].startTime <= now)
+		{
+			_passes.pop_front();
+		}
+
+		collect(now, _queueScheduling ? now + _lookahead : now);
+		if (_batchSize > 0)
+		{
+			output(lock, false);
+		}
+		else if (!_hasEvent && !_atLoopEnd && now >= _lastTime)
+		{
+			finish();
+			output(lock, false);
+		}
+		else
+		{
+			// the port queue is refilled when a half of the lookahead is left
+			unsigned long long wakeTime = _lastTime;
+			if (_hasEvent || _atLoopEnd)
+			{
+				wakeTime = _queueScheduling ? _eventTime - std::min(_eventTime, _lookahead / 2) : _eventTime;
+			}
+			if (!_tempoChanges.empty())
+			{
+				wakeTime = std::min(wakeTime, _tempoChanges.front().first);
+			}
+			if (_passes.size() > 1)
+			{
+				wakeTime = std::min(wakeTime, _passes[1].startTime);
+			}
+			wait(lock, now, wakeTime);
+		}
+	}
+}
+
+void MidiPlayer::Implementation::restart(unsigned long long now)
+{
+	unsigned long long startDelay = 0;
+	if (_sync)
+	{
+		const double bpm = bpmForTempo(_tempoMap.tempoAt(_position));
+		_sync->startSync(bpm);
+		_syncStarted = true;
+		startDelay = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(_sync->syncInitialLatencyForTempo(bpm)).count());
+	}
+
+	Pass pass = {};
+	pass.startTime = now;
+	pass.startTick = _position;
+	pass.origin = static_cast<long long>(now + startDelay) - static_cast<long long>(_tempoMap.timeAt(_position));
+	_passes.clear();
+	_passes.push_back(pass);
+	_tempoChanges.clear();
+	_lastTick = _position;
+	_lastTime = now;
+
+	_source->seek(_position);
+	_tempoHint = 0;
+	fetch();
+}
+
+void MidiPlayer::Implementation::fetch()
+{
+	_hasEvent = _source->next(_event);
+
+	// the loop is only taken if the pass started before its end
+	const bool loopEnabled = _loopStart < _loopEnd && _passes.back().startTick < _loopEnd;
+	_atLoopEnd = loopEnabled && (!_hasEvent || _event.tick >= _loopEnd);
+	if (_atLoopEnd)
+	{
+		_eventTime = clockTime(_loopEnd);
+	}
+	else if (_hasEvent)
+	{
+		_eventTime = clockTime(_event.tick);
+	}
+}
+
+void MidiPlayer::Implementation::jumpToLoopStart()
+{
+	// notes started in the loop would hang over the jump
+	releaseNotes(_eventTime);
+
+	Pass pass = {};
+	pass.startTime = _eventTime;
+	pass.startTick = _loopStart;
+	pass.origin = _passes.back().origin + static_cast<long long>(_tempoMap.timeAt(_loopEnd)) - static_cast<long long>(_tempoMap.timeAt(_loopStart));
+	_passes.push_back(pass);
+	_loops.fetch_add(1, std::memory_order_relaxed);
+	_lastTime = std::max(_lastTime, _eventTime);
+
+	_source->seek(_loopStart);
+	_tempoHint = 0;
+	fetch();
+}
+
+void MidiPlayer::Implementation::collect(unsigned long long now, unsigned long long horizon)
+{
+	while (_batchSize < kMaxBatchSize && (_hasEvent || _atLoopEnd) && _eventTime <= horizon)
+	{
+		if (_atLoopEnd)
+		{
+			jumpToLoopStart();
+			continue;
+		}
+
+		if (_event.isMessage())
+		{
+			MidiMessage& message = appendMessage();
+			_event.copyTo(message);
+			message.setTimestamp(_eventTime);
+			trackNote(message, now);
+
+			if (_eventTime + kLateThresholdInNanoseconds < now)
+			{
+				const unsigned long long lateness = now - _eventTime;
+				_late.fetch_add(1, std::memory_order_relaxed);
+				if (lateness > _maxLateness.load(std::memory_order_relaxed))
+				{
+					_maxLateness.store(lateness, std::memory_order_relaxed);
+				}
+			}
+			_lastTick = _event.tick;
+			_lastTime = std::max(_lastTime, _eventTime);
+		}
+		else if (_sync && _event.kind == MidiFileEvent::Meta && _event.metaType == MidiFileEvent::kMetaTempo)
+		{
+			_tempoChanges.emplace_back(_eventTime, _event.tempo());
+		}
+		fetch();
+	}
+}
+
+void MidiPlayer::Implementation::finish()
+{
+	releaseNotes(_lastTime);
+	_position = _lastTick;
+	_playing = false;
+	if (_syncStarted)
+	{
+		_sync->stopSync();
+		_syncStarted = false;
+	}
+}
+
+void MidiPlayer::Implementation::output(std::unique_lock<std::mutex>& lock, bool immediately)
+{
+	// the batch belongs to the player thread, the lock only guards the state changed by the commands
+	const std::size_t size = _batchSize;
+	lock.unlock();
+	if (immediately || !_queueScheduling)
+	{
+		_port->sendMessages(_batch.data(), size);
+	}
+	else
+	{
+		_port->scheduleMessages(_batch.data(), size);
+	}
+	_messages.fetch_add(size, std::memory_order_relaxed);
+	lock.lock();
+	_batchSize = 0;
+}
+
+void MidiPlayer::Implementation::wait(std::unique_lock<std::mutex>& lock, unsigned long long now, unsigned long long wakeTime)
+{
+	if (wakeTime > now)
+	{
+		if (_clock == MidiClock::system())
+		{
+			// commands wake the thread up right away
+			_condition.wait_for(lock, std::chrono::nanoseconds(wakeTime - now));
+		}
+		else
+		{
+			lock.unlock();
+			_clock->sleepUntil(std::min(wakeTime, now + kMaxSleepInNanoseconds));
+			lock.lock();
+		}
+	}
+}
+
+MidiMessage& MidiPlayer::Implementation::appendMessage()
+{
+	// the batch is allocated for the largest batch plus Note Off of every note, messages reuse their buffers
+	return _batch[_batchSize++];
+}
+
+void MidiPlayer::Implementation::trackNote(const MidiMessage& message, unsigned long long now)
+{
+	// queued messages are delivered later, so a note only counts as released once its Note Off time has passed
+	const MidiMessage::data_type& bytes = message.data();
+	if (bytes.size() == 3)
+	{
+		const unsigned char type = bytes[0] & 0xF0;
+		NoteTimes& times = _notes[(bytes[0] & 0x0F) * kNumberOfNotes + (bytes[1] & 0x7F)];
+		if (type == MidiMessage::NoteOn && bytes[2] != 0)
+		{
+			// a retriggered note whose Note Off is still queued is taken as sounding since its first start
+			if (times.off <= now)
+			{
+				times.on = message.timestamp();
+			}
+			times.off = kNever;
+		}
+		else if ((type == MidiMessage::NoteOff || type == MidiMessage::NoteOn) && times.off == kNever)
+		{
+			times.off = message.timestamp();
+		}
+	}
+}
+
+void MidiPlayer::Implementation::releaseNotes(unsigned long long time)
+{
+	for (std::size_t note = 0; note < _notes.size(); ++note)
+	{
+		if (_notes[note].off == kNever)
+		{
+			appendNoteOff(note, time);
+			_notes[note].off = time;
+		}
+	}
+}
+
+void MidiPlayer::Implementation::releaseSoundingNotes(unsigned long long now)
+{
+	// queued Note On and Note Off are gone, only the notes started and not released yet sound
+	for (std::size_t note = 0; note < _notes.size(); ++note)
+	{
+		if (_notes[note].on <= now && now < _notes[note].off)
+		{
+			appendNoteOff(note, now);
+		}
+		_notes[note] = NoteTimes{kNever, 0};
+	}
+}
+
+void MidiPlayer::Implementation::appendNoteOff(std::size_t note, unsigned long long time)
+{
+	MidiMessage& message = appendMessage();
+	message.resizeBuffer(3);
+	unsigned char* bytes = message;
+	bytes[0] = static_cast<unsigned char>(MidiMessage::NoteOff | (note / kNumberOfNotes));
+	bytes[1] = static_cast<unsigned char>(note % kNumberOfNotes);
+	bytes[2] = 0;
+	message.setTimestamp(time);
+}
+
+unsigned long long MidiPlayer::Implementation::clockTime(unsigned long long tick)
+{
+	const long long time = _passes.back().origin + static_cast<long long>(_tempoMap.timeAt(tick, _tempoHint));
+	return static_cast<unsigned long long>(std::max(time, 0LL));
+}
+
+unsigned long long MidiPlayer::Implementation::playedTick(unsigned long long now) const
+{
+	// passes which start later are already queued, but not playing yet
+	std::size_t index = 0;
+	while (index + 1 < _passes.size() && _passes[index + 1].startTime <= now)
+	{
+		++index;
+	}
+	const Pass& pass = _passes[index];
+	const long long songTime = static_cast<long long>(now) - pass.origin;
+	const unsigned long long tick = songTime > 0 ? _tempoMap.tickAt(static_cast<unsigned long long>(songTime)) : 0;
+	return std::max(tick, pass.startTick);
+}
+
+MidiPlayer::MidiPlayer(std::shared_ptr<MidiOutPort> port, const Options& options, std::shared_ptr<MidiClock> clock)
+	: _impl(new Implementation(std::move(port), options, std::move(clock)))
+{
+}
+
+MidiPlayer::~MidiPlayer()
+{
+}
+
+bool MidiPlayer::load(const MidiFile& file)
+{
+	const bool result = file.isOpen();
+	if (result)
+	{
+		_impl->load(std::unique_ptr<Source>(new FileSource(file)), file.tempoMap(0));
+	}
+	return result;
+}
+
+void MidiPlayer::load(std::unique_ptr<Source> source, const MidiTempoMap& tempoMap)
+{
+	_impl->load(std::move(source), tempoMap);
+}
+
+void MidiPlayer::play()
+{
+	_impl->play();
+}
+
+void MidiPlayer::stop()
+{
+	_impl->stop();
+}
+
+void MidiPlayer::locate(unsigned long long tick)
+{
+	_impl->locate(tick);
+}
+
+bool MidiPlayer::setLoop(unsigned long long startTick, unsigned long long endTick)
+{
+	return _impl->setLoop(startTick, endTick);
+}
+
+void MidiPlayer::clearLoop()
+{
+	_impl->clearLoop();
+}
+
+bool MidiPlayer::isPlaying() const
+{
+	return _impl->isPlaying();
+}
+
+bool MidiPlayer::isQueueScheduling() const
+{
+	return _impl->isQueueScheduling();
+}
+
+unsigned long long MidiPlayer::position() const
+{
+	return _impl->position();
+}
+
+MidiPlayer::Counters MidiPlayer::counters() const
+{
+	return _impl->counters();
+}
@@ -0,0 +1,312 @@
+/*!
+ * \file MidiPreRoll.cpp
+ * Contains implementation of MidiPreRoll class.
+ */
+
+#include "../include/smidi/MidiPreRoll.h"
+#include "../include/smidi/MidiTempoMap.h"
+#include "MidiSmfWriter.h"
+#include "MidiUtilities.h"
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+	const std::size_t kDefaultCapacity = 256 * 1024;
+	const std::size_t kDefaultSysExMemory = 1024 * 1024;
+	const std::size_t kMaxSysExMemory = 1024 * 1024 * 1024;
+	const std::size_t kInlineSize = 3;
+	const unsigned int kTicksPerQuarterNote = 480;
+
+	/*!
+	 * Ring of one port, written by the input thread of the port only and overwritten when full.
+	 *
+	 * The writer announces the slot (and the SysEx bytes) it is about to overwrite before it writes them, the way
+	 * a seqlock does: a reader that copied a slot and then sees the announcement knows the copy may be torn.
+	 * Slots and SysEx bytes are relaxed atomics, so the copies race only on paper and cost plain moves.
+	 */
+	class PortRing
+	{
+		struct Slot
+		{
+			std::atomic<unsigned long long> time;
+			std::atomic<unsigned long long> word; // size in the low half, inline bytes or SysEx position in the high half
+		};
+
+		struct Copy
+		{
+			unsigned long long index;
+			unsigned long long time;
+			unsigned long long sysExPosition;
+			MidiMessage        message;
+		};
+
+	public:
+		PortRing(std::size_t capacity, std::size_t sysExMemory)
+			: _capacity(MidiUtilities::roundUpToPowerOfTwo(capacity))
+			, _mask(_capacity - 1)
+			, _slots(new Slot[_capacity]())
+			, _sysExSize(MidiUtilities::roundUpToPowerOfTwo(std::min(sysExMemory, kMaxSysExMemory)))
+			, _sysExMask(_sysExSize - 1)
+			, _sysEx(new std::atomic<unsigned char>[_sysExSize]())
+			, _reserved(0)
+			, _sysExReserved(0)
+			, _committed(0)
+			, _dropped(0)
+		{
+		}
+
+		void record(const MidiMessage& message, unsigned long long time)
+		{
+			const MidiMessage::data_type& bytes = message.data();
+			const std::size_t size = bytes.size();
+			unsigned long long word = size;
+			bool isStored = (size <= kInlineSize);
+			if (isStored)
+			{
+				for (std::size_t i = 0; i < size; ++i)
+				{
+					word |= static_cast<unsigned long long>(bytes[i]) << (32 + 8 * i);
+				}
+			}
+			else if (size <= _sysExSize)
+			{
+				const unsigned long long position = _sysExReserved.load(std::memory_order_relaxed);
+				_sysExReserved.store(position + size, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				for (std::size_t i = 0; i < size; ++i)
+				{
+					_sysEx[(position + i) & _sysExMask].store(bytes[i], std::memory_order_relaxed);
+				}
+				// the SysEx memory is at most 1 GiB, the low half of the position is enough to find it again
+				word |= (position & 0xFFFFFFFFULL) << 32;
+				isStored = true;
+			}
+
+			if (isStored)
+			{
+				// only this thread writes the counters, plain loads and stores instead of read-modify-write
+				const unsigned long long index = _reserved.load(std::memory_order_relaxed);
+				_reserved.store(index + 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				Slot& slot = _slots[index & _mask];
+				slot.time.store(time, std::memory_order_relaxed);
+				slot.word.store(word, std::memory_order_relaxed);
+				_committed.store(index + 1, std::memory_order_release);
+			}
+			else
+			{
+				_dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+		}
+
+		void collect(std::size_t port, unsigned long long since, std::vector<MidiPreRoll::Event>& events) const
+		{
+			const unsigned long long committed = _committed.load(std::memory_order_acquire);
+			const unsigned long long sysExEnd = _sysExReserved.load(std::memory_order_relaxed);
+			const unsigned long long oldest = (committed > _capacity) ? committed - _capacity : 0;
+
+			// from the newest back to the first one older than the window
+			std::vector<Copy> copies;
+			unsigned long long sysExLimit = sysExEnd;
+			bool isSysExLost = false;
+			for (unsigned long long index = committed; index > oldest; --index)
+			{
+				const Slot& slot = _slots[(index - 1) & _mask];
+				const unsigned long long time = slot.time.load(std::memory_order_relaxed);
+				if (time < since)
+				{
+					break;
+				}
+				const unsigned long long word = slot.word.load(std::memory_order_relaxed);
+				const std::size_t size = static_cast<std::size_t>(word & 0xFFFFFFFFULL);
+				if (size <= kInlineSize)
+				{
+					copies.push_back(Copy{index - 1, time, 0, MidiMessage()});
+					copies.back().message.resizeBuffer(size);
+					unsigned char* data = static_cast<unsigned char*>(copies.back().message);
+					for (std::size_t i = 0; i < size; ++i)
+					{
+						data[i] = static_cast<unsigned char>(word >> (32 + 8 * i));
+					}
+				}
+				else
+				{
+					// SysEx of older events ends where the newer one starts, once the bytes of one are gone
+					// (or the low half of the position wrapped) all the older ones are gone as well
+					const unsigned int low = static_cast<unsigned int>(word >> 32);
+					const unsigned long long position = sysExEnd - static_cast<unsigned int>(static_cast<unsigned int>(sysExEnd) - low);
+					isSysExLost = isSysExLost || position + size > sysExLimit || sysExEnd - position > _sysExSize;
+					if (!isSysExLost)
+					{
+						sysExLimit = position;
+						copies.push_back(Copy{index - 1, time, position, MidiMessage()});
+						copies.back().message.resizeBuffer(size);
+						unsigned char* data = static_cast<unsigned char*>(copies.back().message);
+						for (std::size_t i = 0; i < size; ++i)
+						{
+							data[i] = _sysEx[(position + i) & _sysExMask].load(std::memory_order_relaxed);
+						}
+					}
+				}
+			}
+
+			// whatever the writer has started to overwrite since the copy was made is not trusted
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const unsigned long long reserved = _reserved.load(std::memory_order_relaxed);
+			const unsigned long long sysExReserved = _sysExReserved.load(std::memory_order_relaxed);
+			for (std::vector<Copy>::reverse_iterator copy = copies.rbegin(); copy != copies.rend(); ++copy)
+			{
+				const bool isSysEx = copy->message.data().size() > kInlineSize;
+				if (copy->index + _capacity >= reserved && (!isSysEx || copy->sysExPosition + _sysExSize >= sysExReserved))
+				{
+					copy->message.setTimestamp(copy->time);
+					events.push_back(MidiPreRoll::Event{port, std::move(copy->message)});
+				}
+			}
+		}
+
+		unsigned long long recorded() const
+		{
+			return _committed.load(std::memory_order_relaxed);
+		}
+
+		unsigned long long dropped() const
+		{
+			return _dropped.load(std::memory_order_relaxed);
+		}
+
+	private:
+		const std::size_t                             _capacity;
+		const std::size_t                             _mask;
+		std::unique_ptr<Slot[]>                       _slots;
+		const std::size_t                             _sysExSize;
+		const std::size_t                             _sysExMask;
+		std::unique_ptr<std::atomic<unsigned char>[]> _sysEx;
+		std::atomic<unsigned long long>               _reserved;
+		std::atomic<unsigned long long>               _sysExReserved;
+		std::atomic<unsigned long long>               _committed;
+		std::atomic<unsigned long long>               _dropped;
+	};
+}
+
+class MidiPreRoll::Implementation
+{
+public:
+	Implementation(std::size_t ports, const Options& options, std::shared_ptr<MidiClock> clock);
+
+	void record(std::size_t port, const MidiMessage& message);
+	std::vector<Event> snapshot(std::chrono::nanoseconds length) const;
+	bool saveSnapshot(const std::string& path, std::chrono::nanoseconds length) const;
+	Counters counters() const;
+
+private:
+	std::vector<std::unique_ptr<PortRing>> _rings; // fixed at construction, so record() of one port never races with another
+	const std::shared_ptr<MidiClock>       _clock;
+};
+
+MidiPreRoll::Implementation::Implementation(std::size_t ports, const Options& options, std::shared_ptr<MidiClock> clock)
+	: _clock(std::move(clock))
+{
+	for (std::size_t i = 0; i < ports; ++i)
+	{
+		_rings.emplace_back(new PortRing(options.capacity, options.sysExMemory));
+	}
+}
+
+void MidiPreRoll::Implementation::record(std::size_t port, const MidiMessage& message)
+{
+	if (port < _rings.size() && !message.isEmpty())
+	{
+		_rings[port]->record(message, (message.timestamp() != 0) ? message.timestamp() : _clock->now());
+	}
+}
+
+std::vector<MidiPreRoll::Event> MidiPreRoll::Implementation::snapshot(std::chrono::nanoseconds length) const
+{
+	const unsigned long long now = _clock->now();
+	const unsigned long long span = static_cast<unsigned long long>(std::max(length.count(), static_cast<std::chrono::nanoseconds::rep>(0)));
+	const unsigned long long since = (now > span) ? now - span : 0;
+
+	std::vector<Event> result;
+	for (std::size_t port = 0; port < _rings.size(); ++port)
+	{
+		_rings[port]->collect(port, since, result);
+	}
+	// every port is in order already, equal timestamps keep the order of the ports
+	std::stable_sort(result.begin(), result.end(), [](const Event& left, const Event& right)
+	{
+		return left.message.timestamp() < right.message.timestamp();
+	});
+	return result;
+}
+
+bool MidiPreRoll::Implementation::saveSnapshot(const std::string& path, std::chrono::nanoseconds length) const
+{
+	const std::vector<Event> events = snapshot(length);
+	const unsigned long long startTime = events.empty() ? 0 : events.front().message.timestamp();
+
+	MidiSmfWriter writer(kTicksPerQuarterNote, MidiTempoMap::kDefaultTempo);
+	bool result = writer.open(path);
+	if (result)
+	{
+		for (const Event& event : events)
+		{
+			writer.append(event.message.timestamp() - startTime, event.message);
+		}
+		result = writer.close();
+	}
+	return result;
+}
+
+MidiPreRoll::Counters MidiPreRoll::Implementation::counters() const
+{
+	Counters result = {0, 0};
+	for (const std::unique_ptr<PortRing>& ring : _rings)
+	{
+		result.recorded += ring->recorded();
+		result.dropped += ring->dropped();
+	}
+	return result;
+}
+
+MidiPreRoll::Options::Options()
+	: capacity(kDefaultCapacity)
+	, sysExMemory(kDefaultSysExMemory)
+{
+}
+
+MidiPreRoll::MidiPreRoll(std::size_t ports, const Options& options, std::shared_ptr<MidiClock> clock)
+	: _impl(new Implementation(ports, options, std::move(clock)))
+{
+}
+
+MidiPreRoll::~MidiPreRoll()
+{
+}
+
+void MidiPreRoll::record(std::size_t port, const MidiMessage& message)
+{
+	_impl->record(port, message);
+}
+
+MidiInPort::MessageHandler MidiPreRoll::handler(std::size_t port)
+{
+	Implementation* implementation = _impl.get();
+	return [implementation, port](const MidiMessage& message) { implementation->record(port, message); };
+}
+
+std::vector<MidiPreRoll::Event> MidiPreRoll::snapshot(std::chrono::nanoseconds length) const
+{
+	return _impl->snapshot(length);
+}
+
+bool MidiPreRoll::saveSnapshot(const std::string& path, std::chrono::nanoseconds length) const
+{
+	return _impl->saveSnapshot(path, length);
+}
+
+MidiPreRoll::Counters MidiPreRoll::counters() const
+{
+	return _impl->counters();
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiRingBuffer.h
+ * \warning This file is not a part of library public interface!
+ * Contains bounded lock-free queue with many producers and one consumer
+ */
+
+#include "MidiUtilities.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/*!
+ * \brief The MidiRingBuffer class is a bounded lock-free queue for many producers and a single consumer
+ * \class MidiRingBuffer MidiRingBuffer.h "MidiRingBuffer.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Every cell carries a sequence number which tells whose turn it is (D. Vyukov's bounded queue), so producers
+ * only contend on one atomic increment and never wait for each other to finish writing. Items are filled and
+ * read in place: cells are allocated once, so e.g. MidiMessage buffers are reused and never reallocated after
+ * the first round.
+ */
+template <typename Item>
+class MidiRingBuffer
+{
+	struct Cell
+	{
+		std::atomic<std::size_t> sequence;
+		Item                     item;
+	};
+
+public:
+	//! Capacity is rounded up to the power of two
+	explicit MidiRingBuffer(std::size_t capacity)
+		: _capacity(MidiUtilities::roundUpToPowerOfTwo(capacity))
+		, _mask(_capacity - 1)
+		, _cells(new Cell[_capacity])
+		, _enqueuePosition(0)
+		, _padding{}
+		, _dequeuePosition(0)
+	{
+		for (std::size_t i = 0; i < _capacity; ++i)
+		{
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	std::size_t capacity() const
+	{
+		return _capacity;
+	}
+
+	/*!
+	 * \brief Appends the item, can be called from any thread
+	 * \param [in] fill function `void(Item&)` which writes the item in place.
+	 * \return `false` if the queue is full
+	 */
+	template <typename Fill>
+	bool push(Fill&& fill)
+	{
+		std::size_t position = _enqueuePosition.load(std::memory_order_relaxed);
+		Cell* cell = nullptr;
+		while (true)
+		{
+			cell = &_cells[position & _mask];
+			const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+			if (difference == 0)
+			{
+				if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				// the consumer hasn't freed the cell of the previous round yet
+				return false;
+			}
+			else
+			{
+				position = _enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		fill(cell->item);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	//! Returns the oldest item or `nullptr` if the queue is empty, consumer thread only
+	Item* front()
+	{
+		Cell& cell = _cells[_dequeuePosition & _mask];
+		const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		return (sequence == _dequeuePosition + 1) ? &cell.item : nullptr;
+	}
+
+	//! Releases the item returned by front(), consumer thread only
+	void popFront()
+	{
+		Cell& cell = _cells[_dequeuePosition & _mask];
+		cell.sequence.store(_dequeuePosition + _capacity, std::memory_order_release);
+		++_dequeuePosition;
+	}
+
+private:
+	const std::size_t        _capacity;
+	const std::size_t        _mask;
+	std::unique_ptr<Cell[]>  _cells;
+	std::atomic<std::size_t> _enqueuePosition;
+	// producers and the consumer update their positions on different cache lines
+	char                     _padding[64];
+	std::size_t              _dequeuePosition;
+};
+
+//! \endcond
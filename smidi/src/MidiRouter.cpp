@@ -0,0 +1,194 @@
+/*!
+ * \file MidiRouter.cpp
+ * Contains implementation of MidiRouter class.
+ */
+
+#include "../include/smidi/MidiRouter.h"
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*!
+ * \brief Routes of one input port
+ *
+ * The dispatching thread reads the current list without a lock. The router replaces the list under its mutex and
+ * frees the previous one when no dispatching thread reads it anymore. Handlers hold a shared pointer to the object,
+ * so a handler invoked after the router is gone finds no routes instead of a destroyed object.
+ */
+class MidiRouter::Input
+{
+public:
+	using RouteList = std::vector<std::pair<RouteId, std::shared_ptr<Route>>>;
+
+	explicit Input(const std::shared_ptr<MidiInPort>& port)
+		: port(port)
+		, _routes(new RouteList())
+		, _readers(0)
+	{
+	}
+
+	~Input()
+	{
+		delete _routes.load(std::memory_order_relaxed);
+	}
+
+	void dispatch(const MidiMessage& message)
+	{
+		// pairs with publish(): either it sees the reader or the reader sees the new list
+		_readers.fetch_add(1, std::memory_order_seq_cst);
+		const RouteList* routes = _routes.load(std::memory_order_seq_cst);
+		for (const std::pair<RouteId, std::shared_ptr<Route>>& route : *routes)
+		{
+			if (route.second->process(message))
+			{
+				route.second->forwarded.fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				route.second->dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		_readers.fetch_sub(1, std::memory_order_release);
+	}
+
+	//! Returns the current list, must be called under the router lock
+	const RouteList& routes() const
+	{
+		return *_routes.load(std::memory_order_relaxed);
+	}
+
+	//! Replaces the list, must be called under the router lock. Returns when no thread routes through the old one.
+	void publish(std::unique_ptr<RouteList> routes)
+	{
+		std::unique_ptr<const RouteList> previous(_routes.exchange(routes.release(), std::memory_order_seq_cst));
+		while (_readers.load(std::memory_order_acquire) != 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	//! Tells the port apart from a later one at the same address
+	std::weak_ptr<MidiInPort> port;
+
+private:
+	std::atomic<const RouteList*> _routes;
+	std::atomic<unsigned int>     _readers;
+};
+
+MidiRouter::Route::Route()
+	: forwarded(0)
+	, dropped(0)
+{
+}
+
+MidiRouter::MidiRouter()
+	: _nextRouteId(1)
+{
+}
+
+MidiRouter::~MidiRouter()
+{
+	clear();
+}
+
+MidiRouter::RouteId MidiRouter::addRoute(const std::shared_ptr<MidiInPort>& input, const std::shared_ptr<MidiOutPort>& output)
+{
+	return addRoute(input, output, MidiPipeline<>());
+}
+
+MidiRouter::RouteId MidiRouter::addRoute(const std::shared_ptr<MidiInPort>& input, std::unique_ptr<Route> route)
+{
+	RouteId result = 0;
+	if (input && route)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		result = _nextRouteId++;
+
+		const std::shared_ptr<Input>& routes = this->input(input);
+		std::unique_ptr<Input::RouteList> updated(new Input::RouteList(routes->routes()));
+		updated->emplace_back(result, std::shared_ptr<Route>(std::move(route)));
+		routes->publish(std::move(updated));
+	}
+	return result;
+}
+
+bool MidiRouter::removeRoute(MidiRouter::RouteId id)
+{
+	bool result = false;
+	std::lock_guard<std::mutex> lock(_mutex);
+	const auto hasRoute = [id](const std::pair<RouteId, std::shared_ptr<Route>>& route) { return route.first == id; };
+	for (std::pair<const MidiInPort* const, std::shared_ptr<Input>>& input : _inputs)
+	{
+		const Input::RouteList& routes = input.second->routes();
+		if (std::find_if(routes.begin(), routes.end(), hasRoute) != routes.end())
+		{
+			std::unique_ptr<Input::RouteList> updated(new Input::RouteList(routes));
+			updated->erase(std::remove_if(updated->begin(), updated->end(), hasRoute), updated->end());
+			input.second->publish(std::move(updated));
+			result = true;
+			break;
+		}
+	}
+	return result;
+}
+
+MidiInPort::MessageHandler MidiRouter::handler(const std::shared_ptr<MidiInPort>& input)
+{
+	MidiInPort::MessageHandler result;
+	if (input)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		const std::shared_ptr<Input> routes = this->input(input);
+		result = [routes](const MidiMessage& message) { routes->dispatch(message); };
+	}
+	return result;
+}
+
+void MidiRouter::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (std::pair<const MidiInPort* const, std::shared_ptr<Input>>& input : _inputs)
+	{
+		input.second->publish(std::unique_ptr<Input::RouteList>(new Input::RouteList()));
+	}
+}
+
+std::size_t MidiRouter::routeCount() const
+{
+	std::size_t result = 0;
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (const std::pair<const MidiInPort* const, std::shared_ptr<Input>>& input : _inputs)
+	{
+		result += input.second->routes().size();
+	}
+	return result;
+}
+
+MidiRouter::RouteMetrics MidiRouter::metrics(MidiRouter::RouteId id) const
+{
+	RouteMetrics result = {0, 0};
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (const std::pair<const MidiInPort* const, std::shared_ptr<Input>>& input : _inputs)
+	{
+		for (const std::pair<RouteId, std::shared_ptr<Route>>& route : input.second->routes())
+		{
+			if (route.first == id)
+			{
+				result.forwarded = route.second->forwarded.load(std::memory_order_relaxed);
+				result.dropped = route.second->dropped.load(std::memory_order_relaxed);
+			}
+		}
+	}
+	return result;
+}
+
+const std::shared_ptr<MidiRouter::Input>& MidiRouter::input(const std::shared_ptr<MidiInPort>& port)
+{
+	std::shared_ptr<Input>& result = _inputs[port.get()];
+	if (!result || result->port.expired())
+	{
+		result = std::make_shared<Input>(port);
+	}
+	return result;
+}
@@ -0,0 +1,174 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiSmfWriter.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiSmfWriter.h"
+#include "MidiLogging.h"
+#include "MidiUtilities.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace
+{
+	const std::size_t kWriteBufferSize = 64 * 1024;
+	const std::size_t kTrackLengthOffset = 18;
+	const int kInvalidDescriptor = -1;
+}
+
+MidiSmfWriter::MidiSmfWriter(unsigned int ticksPerQuarterNote, unsigned int tempo)
+	: _tempoMap(ticksPerQuarterNote)
+	, _descriptor(kInvalidDescriptor)
+	, _lastTick(0)
+	, _trackLength(0)
+	, _runningStatus(0)
+	, _failed(false)
+	, _bytes(0)
+{
+	if (tempo != MidiTempoMap::kDefaultTempo)
+	{
+		_tempoMap.addTempo(0, tempo);
+	}
+	// one buffer for the whole file, it is written out before it grows
+	_buffer.reserve(kWriteBufferSize + 1024);
+}
+
+MidiSmfWriter::~MidiSmfWriter()
+{
+	close();
+}
+
+bool MidiSmfWriter::open(const std::string& path)
+{
+	bool result = false;
+	if (!isOpen())
+	{
+		_descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		result = (_descriptor != kInvalidDescriptor);
+		if (result)
+		{
+			_bytes = 0;
+			_failed = false;
+			_lastTick = 0;
+			_runningStatus = 0;
+
+			// header, track chunk with unknown length and the tempo at tick 0
+			const unsigned int division = _tempoMap.ticksPerQuarterNote();
+			const unsigned int tempo = _tempoMap.tempoAt(0);
+			_buffer.assign({'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1});
+			_buffer.push_back(static_cast<unsigned char>(division >> 8));
+			_buffer.push_back(static_cast<unsigned char>(division));
+			_buffer.insert(_buffer.end(), {'M', 'T', 'r', 'k', 0, 0, 0, 0});
+			_buffer.insert(_buffer.end(), {0x00, 0xFF, 0x51, 0x03});
+			_buffer.insert(_buffer.end(), {static_cast<unsigned char>(tempo >> 16), static_cast<unsigned char>(tempo >> 8), static_cast<unsigned char>(tempo)});
+			_trackLength = 7;
+			flush();
+		}
+		else
+		{
+			SMIDI_LOG_ERROR("Couldn't create MIDI file %s because: %s", path.c_str(), std::strerror(errno));
+		}
+	}
+	return result;
+}
+
+void MidiSmfWriter::append(unsigned long long time, const MidiMessage& message)
+{
+	const std::size_t initialSize = _buffer.size();
+	const unsigned long long tick = std::max(_lastTick, _tempoMap.tickAt(time));
+	MidiUtilities::appendVariableLength(_buffer, tick - _lastTick);
+	_lastTick = tick;
+
+	const MidiMessage::data_type& bytes = message.data();
+	const unsigned char status = bytes.front();
+	if (status < MidiMessage::System)
+	{
+		// running status, the same as devices send
+		if (status != _runningStatus)
+		{
+			_buffer.push_back(status);
+			_runningStatus = status;
+		}
+		_buffer.insert(_buffer.end(), bytes.begin() + 1, bytes.end());
+	}
+	else
+	{
+		const bool isSysEx = (status == MidiMessage::SysEx);
+		_buffer.push_back(isSysEx ? MidiMessage::SysEx : MidiMessage::SysExEnd);
+		MidiUtilities::appendVariableLength(_buffer, isSysEx ? bytes.size() - 1 : bytes.size());
+		_buffer.insert(_buffer.end(), bytes.begin() + (isSysEx ? 1 : 0), bytes.end());
+		_runningStatus = 0;
+	}
+	_trackLength += _buffer.size() - initialSize;
+
+	if (_buffer.size() >= kWriteBufferSize)
+	{
+		flush();
+	}
+}
+
+void MidiSmfWriter::flush()
+{
+	std::size_t written = 0;
+	while (!_failed && written < _buffer.size())
+	{
+		const ssize_t result = ::write(_descriptor, _buffer.data() + written, _buffer.size() - written);
+		if (result > 0)
+		{
+			written += static_cast<std::size_t>(result);
+		}
+		else if (result == 0)
+		{
+			// errno is not set by a write that makes no progress, it can't be retried either
+			SMIDI_LOG_ERROR("Couldn't write MIDI file because nothing was written, the file is lost from here");
+			_failed = true;
+		}
+		else if (errno != EINTR)
+		{
+			SMIDI_LOG_ERROR("Couldn't write MIDI file because: %s, the file is lost from here", std::strerror(errno));
+			_failed = true;
+		}
+	}
+	_bytes.fetch_add(written, std::memory_order_relaxed);
+	_buffer.clear();
+
+	// the header always tells the length of what is on disk, so the file is readable even if the process dies
+	if (!_failed)
+	{
+		const unsigned char length[4] = {static_cast<unsigned char>(_trackLength >> 24), static_cast<unsigned char>(_trackLength >> 16),
+		                                 static_cast<unsigned char>(_trackLength >> 8), static_cast<unsigned char>(_trackLength)};
+		if (::pwrite(_descriptor, length, sizeof(length), kTrackLengthOffset) != static_cast<ssize_t>(sizeof(length)))
+		{
+			SMIDI_LOG_ERROR("Couldn't update MIDI file header because: %s", std::strerror(errno));
+			_failed = true;
+		}
+	}
+}
+
+bool MidiSmfWriter::close()
+{
+	bool result = false;
+	if (isOpen())
+	{
+		_buffer.insert(_buffer.end(), {0x00, 0xFF, 0x2F, 0x00});
+		_trackLength += 4;
+		flush();
+
+		result = !_failed;
+		::close(_descriptor);
+		_descriptor = kInvalidDescriptor;
+	}
+	return result;
+}
+
+bool MidiSmfWriter::isOpen() const
+{
+	return _descriptor != kInvalidDescriptor;
+}
+
+//! \endcond
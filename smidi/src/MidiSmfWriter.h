@@ -0,0 +1,67 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiSmfWriter.h
+ * \warning This file is not a part of library public interface!
+ * Contains writer of single track Standard MIDI Files
+ */
+
+#include "../include/smidi/MidiMessage.h"
+#include "../include/smidi/MidiTempoMap.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief The MidiSmfWriter class writes messages into the only track of a format 0 file
+ * \class MidiSmfWriter MidiSmfWriter.h "MidiSmfWriter.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Events are buffered and written out when the buffer fills up or on flush(), the track length in the header is
+ * patched on every write, so the file on disk is always readable up to the last write. Channel messages use
+ * running status, SysEx is stored without the leading 0xF0, other system messages as escaped bytes.
+ * Only bytes() may be called from another thread.
+ */
+class MidiSmfWriter
+{
+public:
+	MidiSmfWriter(unsigned int ticksPerQuarterNote, unsigned int tempo);
+	~MidiSmfWriter();
+
+	MidiSmfWriter(const MidiSmfWriter&) = delete;
+	MidiSmfWriter& operator=(const MidiSmfWriter&) = delete;
+
+	//! Creates the file, writes the header and the tempo at tick 0
+	bool open(const std::string& path);
+
+	//! Appends the message at `time` nanoseconds after tick 0, a time before the previous event is the time of that event
+	void append(unsigned long long time, const MidiMessage& message);
+
+	//! Writes buffered events and patches the track length
+	void flush();
+
+	//! Ends the track, writes it and closes the file, returns `false` if writing failed at some point
+	bool close();
+
+	bool isOpen() const;
+
+	//! Returns size of the file written so far
+	unsigned long long bytes() const
+	{
+		return _bytes.load(std::memory_order_relaxed);
+	}
+
+private:
+	MidiTempoMap                    _tempoMap;
+	std::vector<unsigned char>      _buffer;
+	int                             _descriptor;
+	unsigned long long              _lastTick;
+	unsigned long long              _trackLength;
+	unsigned char                   _runningStatus;
+	bool                            _failed;
+	std::atomic<unsigned long long> _bytes;
+};
+
+//! \endcond
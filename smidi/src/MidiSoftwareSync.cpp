@@ -0,0 +1,200 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiSoftwareSync.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiSoftwareSync.h"
+#include "MidiLogging.h"
+#include <cstring>
+#include <pthread.h>
+
+MidiSoftwareSync::MidiSoftwareSync(Sender sender, std::shared_ptr<MidiClock> clock)
+	: _sender(std::move(sender))
+	, _clock(std::move(clock))
+	, _command(Command::None)
+	, _periodInNanoseconds(periodForTempo(120.0))
+	, _syncIsStarted(false)
+	, _songPositionMessage({MidiMessage::SongPosition, 0, 0})
+{
+	_realTimeMessage.resizeBuffer(1);
+}
+
+MidiSoftwareSync::~MidiSoftwareSync()
+{
+	close();
+}
+
+void MidiSoftwareSync::close()
+{
+	if (_thread.joinable())
+	{
+		sendCommand(Command::Exit);
+		_thread.join();
+	}
+	_syncIsStarted = false;
+}
+
+void MidiSoftwareSync::startSync(double bpm)
+{
+	changeSyncBpm(bpm);
+	if (!_thread.joinable())
+	{
+		_thread = std::thread(&MidiSoftwareSync::syncThread, this);
+	}
+	sendCommand(Command::Start);
+	_syncIsStarted = true;
+}
+
+void MidiSoftwareSync::stopSync()
+{
+	if (_syncIsStarted)
+	{
+		sendCommand(Command::Stop);
+		_syncIsStarted = false;
+	}
+}
+
+void MidiSoftwareSync::resumeSync()
+{
+	if (!_syncIsStarted && _thread.joinable())
+	{
+		sendCommand(Command::Resume);
+		_syncIsStarted = true;
+	}
+}
+
+void MidiSoftwareSync::changeSyncBpm(double bpm)
+{
+	if (bpm > 0.0)
+	{
+		_periodInNanoseconds = periodForTempo(bpm);
+	}
+	else
+	{
+		SMIDI_LOG_WARNING("Invalid sync tempo: %f", bpm);
+	}
+}
+
+bool MidiSoftwareSync::isSyncStarted() const
+{
+	return _syncIsStarted;
+}
+
+std::chrono::microseconds MidiSoftwareSync::syncInitialLatencyForTempo(double) const
+{
+	// the first clock follows Start right away
+	return std::chrono::microseconds(0);
+}
+
+MidiSyncMetrics MidiSoftwareSync::metrics() const
+{
+	return _counters.snapshot();
+}
+
+void MidiSoftwareSync::sendCommand(MidiSoftwareSync::Command command)
+{
+	{
+		std::lock_guard<std::mutex> lock(_commandMutex);
+		_command = command;
+	}
+	_commandCondition.notify_one();
+}
+
+long long MidiSoftwareSync::periodForTempo(double bpm)
+{
+	return static_cast<long long>(kNanosecondsInAMinute / (bpm * kPPQN));
+}
+
+void MidiSoftwareSync::syncThread()
+{
+	// clocks are much more regular with real time priority, but it's not an error to run without it
+	if (_clock == MidiClock::system())
+	{
+		sched_param parameters = {};
+		parameters.sched_priority = sched_get_priority_min(SCHED_FIFO);
+		const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+		if (error != 0)
+		{
+			SMIDI_LOG_DEBUG("Sync thread runs without real time priority: %s", std::strerror(error));
+		}
+	}
+
+	unsigned char* const realTimeStatus = _realTimeMessage;
+	bool running = false;
+	long long deadline = 0;
+	while (true)
+	{
+		Command command = Command::None;
+		{
+			std::unique_lock<std::mutex> lock(_commandMutex);
+			if (!running)
+			{
+				_commandCondition.wait(lock, [this]() { return _command != Command::None; });
+			}
+			command = _command;
+			_command = Command::None;
+		}
+
+		if (command == Command::Exit)
+		{
+			break;
+		}
+		else if (command == Command::Start)
+		{
+			// Song Position Pointer 0 + Start, the receiver starts playing on the next clock
+			_songPositionMessage.setTimestamp(_clock->now());
+			_sender(_songPositionMessage);
+			realTimeStatus[0] = MidiMessage::MidiStart;
+			_realTimeMessage.setTimestamp(_clock->now());
+			_sender(_realTimeMessage);
+			running = true;
+			deadline = static_cast<long long>(_clock->now());
+		}
+		else if (command == Command::Resume)
+		{
+			realTimeStatus[0] = MidiMessage::MidiContinue;
+			_realTimeMessage.setTimestamp(_clock->now());
+			_sender(_realTimeMessage);
+			running = true;
+			deadline = static_cast<long long>(_clock->now());
+		}
+		else if (command == Command::Stop)
+		{
+			realTimeStatus[0] = MidiMessage::MidiStop;
+			_realTimeMessage.setTimestamp(_clock->now());
+			_sender(_realTimeMessage);
+			running = false;
+		}
+
+		if (running)
+		{
+			const long long now = static_cast<long long>(_clock->now());
+			if (now >= deadline)
+			{
+				const long long period = _periodInNanoseconds;
+				const long long lateness = now - deadline;
+				_counters.countPeriod(lateness);
+				if (lateness > period)
+				{
+					// we're behind by more than a clock, catching up would send a burst of clocks
+					_counters.countPhaseCorrection(lateness);
+					deadline = now;
+				}
+
+				realTimeStatus[0] = MidiMessage::MidiClock;
+				_realTimeMessage.setTimestamp(static_cast<unsigned long long>(now));
+				_sender(_realTimeMessage);
+				deadline += period;
+			}
+			else
+			{
+				// may return early, commands are checked on every wake up
+				_clock->sleepUntil(static_cast<unsigned long long>(deadline));
+			}
+		}
+	}
+}
+
+//! \endcond
@@ -0,0 +1,82 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiSoftwareSync.h
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "../include/smidi/MidiSync.h"
+#include "../include/smidi/MidiClock.h"
+#include "../include/smidi/MidiDelegate.h"
+#include "MidiMetricsCounters.h"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+/*!
+ * \brief The MidiSoftwareSync class generates MIDI Clock with its own thread for ports without sequencer queue
+ * \class MidiSoftwareSync MidiSoftwareSync.h "MidiSoftwareSync.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * The sync thread sleeps until absolute deadlines of the MidiClock and sends each clock itself. Deadlines don't
+ * accumulate the wake up latency, the clock only drifts if the thread falls behind by more than a whole period -
+ * then the phase is reset and counted. Start, stop and resume take effect at the next clock.
+ *
+ * With MidiSimulatedClock the generator runs on virtual time, so its output is exactly periodic.
+ */
+class MidiSoftwareSync : public MidiSync
+{
+	static const unsigned int kPPQN = 24;
+	static const long long kNanosecondsInAMinute = 60000000000LL;
+
+	enum class Command
+	{
+		None,
+		Start,
+		Resume,
+		Stop,
+		Exit
+	};
+
+public:
+	//! Type of the function which sends sync messages to the port
+	using Sender = MidiDelegate<void(const MidiMessage& message)>;
+
+	MidiSoftwareSync(Sender sender, std::shared_ptr<MidiClock> clock);
+	virtual ~MidiSoftwareSync();
+
+	//! Stops the sync thread, must be called before the port the sender writes to is closed
+	void close();
+
+	virtual void startSync(double bpm) override;
+	virtual void stopSync() override;
+	virtual void resumeSync() override;
+	virtual void changeSyncBpm(double bpm) override;
+	virtual bool isSyncStarted() const override;
+	virtual std::chrono::microseconds syncInitialLatencyForTempo(double bpm) const override;
+	virtual MidiSyncMetrics metrics() const override;
+
+private:
+	void sendCommand(Command command);
+	void syncThread();
+
+	static long long periodForTempo(double bpm);
+
+private:
+	Sender                     _sender;
+	std::shared_ptr<MidiClock> _clock;
+	std::thread                _thread;
+	std::mutex                 _commandMutex;
+	std::condition_variable    _commandCondition;
+	Command                    _command;
+	std::atomic<long long>     _periodInNanoseconds;
+	std::atomic<bool>          _syncIsStarted;
+	MidiSyncCounters           _counters;
+	MidiMessage                _songPositionMessage;
+	MidiMessage                _realTimeMessage;
+};
+
+//! \endcond
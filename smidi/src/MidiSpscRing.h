@@ -0,0 +1,104 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiSpscRing.h
+ * \warning This file is not a part of library public interface!
+ * Contains bounded lock-free queue with one producer and one consumer
+ */
+
+#include "MidiUtilities.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/*!
+ * \brief The MidiSpscRing class is a bounded lock-free queue for a single producer and a single consumer
+ * \class MidiSpscRing MidiSpscRing.h "MidiSpscRing.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Cheaper than MidiRingBuffer when there is only one producer: no compare-and-swap, and each side keeps a cached
+ * copy of the other side's position, so the shared positions are only read when the cached one says the queue
+ * looks full (producer) or empty (consumer). Items are filled and read in place, like in MidiRingBuffer.
+ */
+template <typename Item>
+class MidiSpscRing
+{
+public:
+	//! Capacity is rounded up to the power of two
+	explicit MidiSpscRing(std::size_t capacity)
+		: _capacity(MidiUtilities::roundUpToPowerOfTwo(capacity))
+		, _mask(_capacity - 1)
+		, _items(new Item[_capacity])
+		, _tail(0)
+		, _cachedHead(0)
+		, _padding{}
+		, _head(0)
+		, _cachedTail(0)
+	{
+	}
+
+	std::size_t capacity() const
+	{
+		return _capacity;
+	}
+
+	/*!
+	 * \brief Appends the item, producer thread only
+	 * \param [in] fill function `void(Item&)` which writes the item in place.
+	 * \return `false` if the queue is full
+	 */
+	template <typename Fill>
+	bool push(Fill&& fill)
+	{
+		const std::size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _cachedHead == _capacity)
+		{
+			_cachedHead = _head.load(std::memory_order_acquire);
+			if (tail - _cachedHead == _capacity)
+			{
+				return false;
+			}
+		}
+		fill(_items[tail & _mask]);
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//! Returns the oldest item or `nullptr` if the queue is empty, consumer thread only
+	Item* front()
+	{
+		const std::size_t head = _head.load(std::memory_order_relaxed);
+		if (head == _cachedTail)
+		{
+			_cachedTail = _tail.load(std::memory_order_acquire);
+			if (head == _cachedTail)
+			{
+				return nullptr;
+			}
+		}
+		return &_items[head & _mask];
+	}
+
+	//! Releases the item returned by front(), consumer thread only
+	void popFront()
+	{
+		_head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+private:
+	const std::size_t        _capacity;
+	const std::size_t        _mask;
+	std::unique_ptr<Item[]>  _items;
+	// producer side
+	std::atomic<std::size_t> _tail;
+	std::size_t              _cachedHead;
+	// the producer and the consumer update their positions on different cache lines
+	char                     _padding[64];
+	// consumer side
+	std::atomic<std::size_t> _head;
+	std::size_t              _cachedTail;
+};
+
+//! \endcond
@@ -0,0 +1,266 @@
+/*!
+ * \file MidiStreamParser.cpp
+ * Contains implementation of MidiStreamParser class.
+ */
+
+#include "../include/smidi/MidiStreamParser.h"
+#include "MidiByteScan.h"
+#include <algorithm>
+
+namespace
+{
+	const unsigned char kFirstRealTimeStatus = 0xF8;
+	const unsigned char kUndefinedRealTime1 = 0xF9;
+	const unsigned char kUndefinedRealTime2 = 0xFD;
+}
+
+MidiStreamParser::MidiStreamParser(std::size_t maxSysExSize, ScanMode scanMode)
+	: _findStatusByte(scanMode == ScanMode::Vector ? &MidiByteScan::findStatusByteVector : &MidiByteScan::findStatusByteScalar)
+	, _maxSysExSize(std::max<std::size_t>(maxSysExSize, 2))
+	, _sysExTimestamp(0)
+	, _messageTimestamp(0)
+	, _droppedBytes(0)
+	, _runningStatus(0)
+	, _status(0)
+	, _data{0, 0}
+	, _expectedDataBytes(0)
+	, _receivedDataBytes(0)
+	, _inSysEx(false)
+	, _sysExOverflow(false)
+{
+	_message.resizeBuffer(3);
+}
+
+void MidiStreamParser::setHandler(MidiStreamParser::Handler handler)
+{
+	_handler = std::move(handler);
+}
+
+std::size_t MidiStreamParser::parse(const unsigned char* data, std::size_t size, unsigned long long timestamp)
+{
+	std::size_t numberOfMessages = 0;
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		const unsigned char byte = data[i];
+
+		if (byte >= kFirstRealTimeStatus)
+		{
+			// real time messages may appear anywhere and don't affect the parser state
+			if (byte == kUndefinedRealTime1 || byte == kUndefinedRealTime2)
+			{
+				++_droppedBytes;
+			}
+			else
+			{
+				_message.resizeBuffer(1);
+				static_cast<unsigned char*>(_message)[0] = byte;
+				emit(timestamp);
+				++numberOfMessages;
+			}
+			continue;
+		}
+
+		if (byte & 0x80)
+		{
+			if (_inSysEx)
+			{
+				if (byte == MidiMessage::SysExEnd && !_sysExOverflow)
+				{
+					_sysEx.push_back(byte);
+					_message.resizeBuffer(_sysEx.size());
+					std::copy(_sysEx.begin(), _sysEx.end(), static_cast<unsigned char*>(_message));
+					emit(_sysExTimestamp);
+					++numberOfMessages;
+					_inSysEx = false;
+					_sysEx.clear();
+					continue;
+				}
+				// any other status byte interrupts SysEx
+				dropSysEx();
+				if (byte == MidiMessage::SysExEnd)
+				{
+					++_droppedBytes;
+					continue;
+				}
+			}
+
+			// incomplete message is lost
+			if (_status != 0)
+			{
+				_droppedBytes += 1 + _receivedDataBytes;
+				_status = 0;
+			}
+
+			if (byte == MidiMessage::SysEx)
+			{
+				_inSysEx = true;
+				_sysExOverflow = false;
+				_sysExTimestamp = timestamp;
+				_sysEx.clear();
+				_sysEx.push_back(byte);
+				_runningStatus = 0;
+				continue;
+			}
+
+			const int dataBytes = dataBytesFor(byte);
+			if (byte >= MidiMessage::System)
+			{
+				// System Common messages cancel running status
+				_runningStatus = 0;
+			}
+			else
+			{
+				_runningStatus = byte;
+			}
+
+			if (dataBytes < 0)
+			{
+				++_droppedBytes;
+			}
+			else if (dataBytes == 0)
+			{
+				_message.resizeBuffer(1);
+				static_cast<unsigned char*>(_message)[0] = byte;
+				emit(timestamp);
+				++numberOfMessages;
+			}
+			else
+			{
+				_status = byte;
+				_expectedDataBytes = dataBytes;
+				_receivedDataBytes = 0;
+				_messageTimestamp = timestamp;
+			}
+			continue;
+		}
+
+		// data byte
+		if (_inSysEx)
+		{
+			// the whole run of payload bytes up to the next status byte is taken at once
+			const std::size_t runSize = 1 + _findStatusByte(data + i + 1, size - i - 1);
+			appendSysEx(data + i, runSize);
+			i += runSize - 1;
+			continue;
+		}
+
+		if (_status == 0)
+		{
+			if (_runningStatus == 0)
+			{
+				// data bytes without status are useless until the next status byte
+				const std::size_t runSize = 1 + _findStatusByte(data + i + 1, size - i - 1);
+				_droppedBytes += runSize;
+				i += runSize - 1;
+				continue;
+			}
+			_status = _runningStatus;
+			_expectedDataBytes = dataBytesFor(_status);
+			_receivedDataBytes = 0;
+			_messageTimestamp = timestamp;
+		}
+
+		_data[_receivedDataBytes++] = byte;
+		if (_receivedDataBytes == _expectedDataBytes)
+		{
+			const std::size_t messageSize = static_cast<std::size_t>(1 + _expectedDataBytes);
+			_message.resizeBuffer(messageSize);
+			unsigned char* bytes = _message;
+			bytes[0] = _status;
+			bytes[1] = _data[0];
+			if (messageSize == 3)
+			{
+				bytes[2] = _data[1];
+			}
+			_status = 0;
+			emit(_messageTimestamp);
+			++numberOfMessages;
+		}
+	}
+	return numberOfMessages;
+}
+
+void MidiStreamParser::reset()
+{
+	_inSysEx = false;
+	_sysExOverflow = false;
+	_sysEx.clear();
+	_runningStatus = 0;
+	_status = 0;
+	_receivedDataBytes = 0;
+}
+
+unsigned long long MidiStreamParser::droppedBytes() const
+{
+	return _droppedBytes;
+}
+
+int MidiStreamParser::dataBytesFor(unsigned char status)
+{
+	int result = -1;
+	if (status >= 0x80 && status < MidiMessage::System)
+	{
+		const unsigned char type = status & 0xF0;
+		result = (type == MidiMessage::ProgramChange || type == MidiMessage::ChannelPressure) ? 1 : 2;
+	}
+	else
+	{
+		switch (status)
+		{
+		case MidiMessage::MTCQuarter:
+		case MidiMessage::SongSelect:
+			result = 1;
+			break;
+		case MidiMessage::SongPosition:
+			result = 2;
+			break;
+		case MidiMessage::TuneRequest:
+		case MidiMessage::MidiClock:
+		case MidiMessage::MidiStart:
+		case MidiMessage::MidiContinue:
+		case MidiMessage::MidiStop:
+		case MidiMessage::ActiveSense:
+		case MidiMessage::Reset:
+			result = 0;
+			break;
+		default:
+			break;
+		}
+	}
+	return result;
+}
+
+const char* MidiStreamParser::vectorExtension()
+{
+	return MidiByteScan::kVectorExtension;
+}
+
+void MidiStreamParser::emit(unsigned long long timestamp)
+{
+	_message.setTimestamp(timestamp);
+	if (_handler)
+	{
+		_handler(_message);
+	}
+}
+
+void MidiStreamParser::appendSysEx(const unsigned char* data, std::size_t size)
+{
+	// one byte is left for 0xF7
+	const std::size_t space = (_sysEx.size() + 1 < _maxSysExSize) ? _maxSysExSize - 1 - _sysEx.size() : 0;
+	const std::size_t accepted = std::min(size, space);
+	_sysEx.insert(_sysEx.end(), data, data + accepted);
+	if (accepted < size)
+	{
+		_sysExOverflow = true;
+		_droppedBytes += size - accepted;
+	}
+}
+
+void MidiStreamParser::dropSysEx()
+{
+	_droppedBytes += _sysEx.size();
+	_inSysEx = false;
+	_sysExOverflow = false;
+	_sysEx.clear();
+}
@@ -0,0 +1,98 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiSyncCompensator.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiSyncCompensator.h"
+
+namespace
+{
+	const double kNanosecondsInAMinute = 60e9;
+}
+
+MidiSyncCompensator::MidiSyncCompensator(double bpm)
+	: _bpm(bpm)
+	, _queueBpm(bpm)
+	, _period(0)
+	, _plannedTime(0)
+	, _compensation(0)
+	, _first(true)
+{
+	reset(bpm);
+}
+
+void MidiSyncCompensator::reset(double bpm)
+{
+	_bpm = bpm;
+	_queueBpm = bpm;
+	_period = static_cast<long long>(kNanosecondsInAMinute / bpm);
+	_plannedTime = 0;
+	_compensation = 0;
+	_first = true;
+}
+
+MidiSyncCompensator::Beat MidiSyncCompensator::nextBeat(unsigned long long now)
+{
+	Beat beat = {};
+	beat.sendTime = now;
+	beat.bpm = _bpm;
+	beat.first = _first;
+
+	if (_first)
+	{
+		// either initial cycle or reset was made
+		_first = false;
+		_plannedTime = now;
+	}
+	else
+	{
+		beat.lateness = static_cast<long long>(now - _plannedTime);
+		if (beat.lateness > 0)
+		{
+			// "we are late", so we add this value to overall compensation
+			_compensation += beat.lateness;
+		}
+		else if (beat.lateness < 0)
+		{
+			// "we are early" and we will send next beat as planned
+			beat.sendTime = _plannedTime;
+		}
+
+		if (_compensation * 2 > _period)
+		{
+			// too late to catch up smoothly, the clock phase starts over from now
+			beat.phaseCorrection = _compensation;
+			_compensation = 0;
+			_plannedTime = now;
+		}
+		else if (_compensation > kCompensationThreshold)
+		{
+			// a bit faster tempo, so the last clock of this beat comes when the next beat is planned
+			beat.bpm = kNanosecondsInAMinute / static_cast<double>(_period - _compensation);
+			beat.phaseCorrection = _compensation;
+			_compensation = 0;
+		}
+	}
+
+	// the tempo is restored for the beat after the compensated one
+	beat.tempoChanged = (beat.bpm != _queueBpm);
+	_queueBpm = beat.bpm;
+
+	// next planned sending time
+	_plannedTime += static_cast<unsigned long long>(_period);
+	return beat;
+}
+
+unsigned long long MidiSyncCompensator::plannedTime() const
+{
+	return _plannedTime;
+}
+
+long long MidiSyncCompensator::period() const
+{
+	return _period;
+}
+
+//! \endcond
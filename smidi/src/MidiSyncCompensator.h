@@ -0,0 +1,68 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiSyncCompensator.h
+ * \warning This file is not a part of library public interface!
+ * Contains phase compensation of the sequencer queue based MIDI Clock generator
+ */
+
+/*!
+ * \brief The MidiSyncCompensator class decides when and at which tempo the next beat of MIDI Clocks is queued
+ * \class MidiSyncCompensator MidiSyncCompensator.h "MidiSyncCompensator.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * The sync thread queues one beat (24 clocks) at a time and sleeps until the next beat is planned. When it wakes
+ * up late, the clocks of the next beat would start late as well, so the lateness is accumulated and the next beat
+ * is queued at a slightly faster tempo: its last clock then ends exactly where it was planned, and the tempo is
+ * restored for the beat after it. Lateness of more than half a beat can't be caught up without a burst of clocks,
+ * then the phase is reset to the wake up time instead.
+ *
+ * The class only does arithmetic on nanosecond timestamps, so recorded or synthetic lateness traces can be fed
+ * into it without a sequencer, a sync thread or a real clock.
+ */
+class MidiSyncCompensator
+{
+public:
+	//! Accumulated lateness below this is left for the next beats
+	static const long long kCompensationThreshold = 5000;
+
+	/*!
+	 * \brief The Beat struct tells the sync thread what to do with the next beat
+	 */
+	struct Beat
+	{
+		unsigned long long sendTime;        //!< Time to queue the beat at: the wake up time, or the planned time if woken up early.
+		double             bpm;             //!< Queue tempo for the beat.
+		bool               tempoChanged;    //!< Queue tempo has to be set to bpm before queueing.
+		bool               first;           //!< First beat after start, restart or tempo change: there is no lateness yet.
+		long long          lateness;        //!< Wake up time minus planned time, negative if early.
+		long long          phaseCorrection; //!< Lateness compensated by this beat (or dropped by the phase reset), 0 if none.
+	};
+
+public:
+	explicit MidiSyncCompensator(double bpm = 120.0);
+
+	//! Starts over after the queue has been (re)started at nominal tempo, the next beat is the first one
+	void reset(double bpm);
+
+	//! Returns the beat to queue for the thread that woke up at `now`
+	Beat nextBeat(unsigned long long now);
+
+	//! Returns the time the beat after the last returned one is planned for
+	unsigned long long plannedTime() const;
+
+	//! Returns nominal beat duration in nanoseconds
+	long long period() const;
+
+private:
+	double             _bpm;
+	double             _queueBpm;
+	long long          _period;
+	unsigned long long _plannedTime;
+	long long          _compensation;
+	bool               _first;
+};
+
+//! \endcond
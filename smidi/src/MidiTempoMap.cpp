@@ -0,0 +1,147 @@
+/*!
+ * \file MidiTempoMap.cpp
+ * Contains implementation of MidiTempoMap class.
+ */
+
+#include "../include/smidi/MidiTempoMap.h"
+#include <algorithm>
+
+namespace
+{
+	const unsigned int kFallbackTicksPerQuarterNote = 96;
+	const unsigned long long kNanosecondsPerMicrosecond = 1000;
+	const unsigned long long kNanosecondsPerSecond = 1000000000;
+
+	// a * b / c without overflow of a * b for b * c below 2^64
+	unsigned long long multiplyDivide(unsigned long long a, unsigned long long b, unsigned long long c)
+	{
+		// one division while the product fits, it does for any realistic tick distance
+		unsigned long long product = 0;
+		return !__builtin_mul_overflow(a, b, &product) ? product / c : (a / c) * b + (a % c) * b / c;
+	}
+}
+
+MidiTempoMap::MidiTempoMap(unsigned int ticksPerQuarterNote)
+	: _ticksPerQuarterNote(ticksPerQuarterNote != 0 ? ticksPerQuarterNote : kFallbackTicksPerQuarterNote)
+	, _smpteNumerator(0)
+	, _smpteDenominator(0)
+{
+	clear();
+}
+
+MidiTempoMap MidiTempoMap::smpte(unsigned int framesPerSecond, unsigned int ticksPerFrame)
+{
+	MidiTempoMap result;
+	result._ticksPerQuarterNote = 0;
+	// 29 is 30 drop frame, i.e. 29.97 frames per second
+	const bool dropFrame = (framesPerSecond == 29);
+	result._smpteNumerator = dropFrame ? kNanosecondsPerSecond * 100 : kNanosecondsPerSecond;
+	result._smpteDenominator = std::max<unsigned long long>(1, (dropFrame ? 2997ULL : framesPerSecond) * std::max(1u, ticksPerFrame));
+	return result;
+}
+
+unsigned int MidiTempoMap::ticksPerQuarterNote() const
+{
+	return _ticksPerQuarterNote;
+}
+
+bool MidiTempoMap::isSmpte() const
+{
+	return _ticksPerQuarterNote == 0;
+}
+
+void MidiTempoMap::addTempo(unsigned long long tick, unsigned int microsecondsPerQuarterNote)
+{
+	if (!isSmpte() && microsecondsPerQuarterNote != 0)
+	{
+		Change& last = _changes.back();
+		if (tick <= last.tick)
+		{
+			last.tempo = microsecondsPerQuarterNote;
+		}
+		else
+		{
+			_changes.push_back(Change{tick, timeFrom(last, tick), microsecondsPerQuarterNote});
+		}
+	}
+}
+
+void MidiTempoMap::clear()
+{
+	// the first change is always there, so every tick has a change to count from
+	_changes.assign(1, Change{0, 0, kDefaultTempo});
+}
+
+std::size_t MidiTempoMap::size() const
+{
+	return _changes.size() - 1;
+}
+
+unsigned int MidiTempoMap::tempoAt(unsigned long long tick) const
+{
+	return _changes[changeAt(tick)].tempo;
+}
+
+unsigned long long MidiTempoMap::timeAt(unsigned long long tick) const
+{
+	unsigned long long result = 0;
+	if (isSmpte())
+	{
+		result = multiplyDivide(tick, _smpteNumerator, _smpteDenominator);
+	}
+	else
+	{
+		result = timeFrom(_changes[changeAt(tick)], tick);
+	}
+	return result;
+}
+
+unsigned long long MidiTempoMap::timeAt(unsigned long long tick, std::size_t& hint) const
+{
+	unsigned long long result = 0;
+	if (isSmpte())
+	{
+		result = multiplyDivide(tick, _smpteNumerator, _smpteDenominator);
+	}
+	else
+	{
+		if (hint >= _changes.size() || _changes[hint].tick > tick)
+		{
+			hint = changeAt(tick);
+		}
+		while (hint + 1 < _changes.size() && _changes[hint + 1].tick <= tick)
+		{
+			++hint;
+		}
+		result = timeFrom(_changes[hint], tick);
+	}
+	return result;
+}
+
+unsigned long long MidiTempoMap::tickAt(unsigned long long time) const
+{
+	unsigned long long result = 0;
+	if (isSmpte())
+	{
+		result = multiplyDivide(time, _smpteDenominator, _smpteNumerator);
+	}
+	else
+	{
+		const auto next = std::upper_bound(_changes.begin(), _changes.end(), time, [](unsigned long long value, const Change& change) { return value < change.time; });
+		const Change& change = *(next - 1);
+		const unsigned long long nanosecondsPerQuarterNote = change.tempo * kNanosecondsPerMicrosecond;
+		result = change.tick + multiplyDivide(time - change.time, _ticksPerQuarterNote, nanosecondsPerQuarterNote);
+	}
+	return result;
+}
+
+std::size_t MidiTempoMap::changeAt(unsigned long long tick) const
+{
+	const auto next = std::upper_bound(_changes.begin(), _changes.end(), tick, [](unsigned long long value, const Change& change) { return value < change.tick; });
+	return static_cast<std::size_t>(next - _changes.begin()) - 1;
+}
+
+unsigned long long MidiTempoMap::timeFrom(const MidiTempoMap::Change& change, unsigned long long tick) const
+{
+	return change.time + multiplyDivide(tick - change.tick, change.tempo * kNanosecondsPerMicrosecond, _ticksPerQuarterNote);
+}
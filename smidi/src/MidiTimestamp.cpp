@@ -0,0 +1,55 @@
+/*!
+ * \file MidiTimestamp.cpp
+ * Contains implementation of MidiTimestamp class.
+ */
+
+#include "../include/smidi/MidiTimestamp.h"
+#include <cmath>
+#include <time.h>
+
+namespace
+{
+	const unsigned long long kNanosecondsInSecond = 1000000000ULL;
+}
+
+unsigned long long MidiTimestamp::now()
+{
+	timespec currentTime = {};
+	clock_gettime(CLOCK_MONOTONIC, &currentTime);
+	return fromTimespec(currentTime);
+}
+
+MidiTimestamp::Clock::time_point MidiTimestamp::toTimePoint(unsigned long long timestamp)
+{
+	return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(timestamp)));
+}
+
+unsigned long long MidiTimestamp::fromTimePoint(const MidiTimestamp::Clock::time_point& timePoint)
+{
+	return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint.time_since_epoch()).count());
+}
+
+timespec MidiTimestamp::toTimespec(unsigned long long timestamp)
+{
+	timespec result = {};
+	result.tv_sec = static_cast<time_t>(timestamp / kNanosecondsInSecond);
+	result.tv_nsec = static_cast<long>(timestamp % kNanosecondsInSecond);
+	return result;
+}
+
+unsigned long long MidiTimestamp::fromTimespec(const timespec& time)
+{
+	return static_cast<unsigned long long>(time.tv_sec) * kNanosecondsInSecond + static_cast<unsigned long long>(time.tv_nsec);
+}
+
+long long MidiTimestamp::framesBetween(unsigned long long from, unsigned long long to, double sampleRate)
+{
+	const long long delta = static_cast<long long>(to - from);
+	return static_cast<long long>(std::floor(static_cast<double>(delta) * sampleRate / kNanosecondsInSecond));
+}
+
+unsigned long long MidiTimestamp::fromFrame(long long frame, long long referenceFrame, unsigned long long referenceTimestamp, double sampleRate)
+{
+	const double delta = static_cast<double>(frame - referenceFrame) * kNanosecondsInSecond / sampleRate;
+	return referenceTimestamp + static_cast<long long>(std::llround(delta));
+}
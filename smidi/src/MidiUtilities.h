@@ -0,0 +1,46 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiUtilities.h
+ * \warning This file is not a part of library public interface!
+ * Contains small helpers shared by the rings and the Standard MIDI File writers
+ */
+
+#include <cstddef>
+#include <vector>
+
+namespace MidiUtilities
+{
+	//! Returns the smallest power of two not less than `value`, at least 2
+	inline std::size_t roundUpToPowerOfTwo(std::size_t value)
+	{
+		std::size_t result = 2;
+		while (result < value)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+
+	//! Appends Standard MIDI File variable-length quantity, the most significant group first
+	inline void appendVariableLength(std::vector<unsigned char>& bytes, unsigned long long value)
+	{
+		unsigned char groups[10];
+		std::size_t count = 0;
+		do
+		{
+			groups[count++] = static_cast<unsigned char>(value & 0x7F);
+			value >>= 7;
+		}
+		while (value != 0);
+		while (count > 1)
+		{
+			bytes.push_back(groups[--count] | 0x80);
+		}
+		bytes.push_back(groups[0]);
+	}
+}
+
+//! \endcond
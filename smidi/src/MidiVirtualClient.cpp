@@ -0,0 +1,69 @@
+/*!
+ * \file MidiVirtualClient.cpp
+ */
+
+#include "../include/smidi/MidiVirtualClient.h"
+#include "../include/smidi/MidiInPort.h"
+#include "../include/smidi/MidiOutPort.h"
+
+#ifdef __linux__
+
+#ifdef SMIDI_USE_ALSA
+#include "linux/alsa/MidiVirtualClientImpl.h"
+#endif
+
+#endif
+
+MidiVirtualClient::MidiVirtualClient(const std::string& name)
+    : _impl(new Implementation(name))
+{
+}
+
+MidiVirtualClient::~MidiVirtualClient()
+{
+}
+
+bool MidiVirtualClient::isValid() const
+{
+	return _impl->isValid();
+}
+
+const std::string& MidiVirtualClient::name() const
+{
+	return _impl->name();
+}
+
+std::string MidiVirtualClient::address(const MidiPort& port) const
+{
+	return _impl->address(port);
+}
+
+std::shared_ptr<MidiInPort> MidiVirtualClient::createInputPort(const std::string& name, unsigned int capabilities)
+{
+	return _impl->createInputPort(name, capabilities);
+}
+
+std::shared_ptr<MidiOutPort> MidiVirtualClient::createOutputPort(const std::string& name, unsigned int capabilities)
+{
+	return _impl->createOutputPort(name, capabilities);
+}
+
+bool MidiVirtualClient::setCapabilities(const MidiPort& port, unsigned int capabilities)
+{
+	return _impl->setCapabilities(port, capabilities);
+}
+
+bool MidiVirtualClient::connect(const MidiPort& port, const std::string& address)
+{
+	return _impl->connect(port, address);
+}
+
+bool MidiVirtualClient::disconnect(const MidiPort& port, const std::string& address)
+{
+	return _impl->disconnect(port, address);
+}
+
+std::list<std::string> MidiVirtualClient::connections(const MidiPort& port) const
+{
+	return _impl->connections(port);
+}
@@ -32,4 +32,54 @@ void MidiInPortLinux::stop()
 	_impl->stop();
 }
 
+MidiPortMetrics MidiInPortLinux::metrics() const
+{
+	return _impl->metrics();
+}
+
+void MidiInPortLinux::setMessageHandler(MessageHandler handler)
+{
+	_impl->dispatcher().setHandler(handler);
+}
+
+void MidiInPortLinux::setMessageHandler(MidiMessage::Type type, MessageHandler handler)
+{
+	_impl->dispatcher().setHandler(type, handler);
+}
+
+void MidiInPortLinux::resetMessageHandlers()
+{
+	_impl->dispatcher().resetHandlers();
+}
+
+void MidiInPortLinux::setDispatchMode(DispatchMode mode)
+{
+	_impl->setDispatchMode(mode);
+}
+
+MidiInPort::DispatchMode MidiInPortLinux::dispatchMode() const
+{
+	return _impl->dispatchMode();
+}
+
+int MidiInPortLinux::pollDescriptor() const
+{
+	return _impl->pollDescriptor();
+}
+
+std::size_t MidiInPortLinux::processPending()
+{
+	return _impl->processPending();
+}
+
+void MidiInPortLinux::addWaiter(MidiMessageWaiter& waiter)
+{
+	_impl->addWaiter(waiter);
+}
+
+bool MidiInPortLinux::removeWaiter(MidiMessageWaiter& waiter)
+{
+	return _impl->removeWaiter(waiter);
+}
+
 //! \endcond
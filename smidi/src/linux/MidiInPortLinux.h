@@ -38,6 +38,20 @@ public:
 	virtual void start() override;
 	virtual void stop() override;
 
+	virtual MidiPortMetrics metrics() const override;
+
+	virtual void setMessageHandler(MessageHandler handler) override;
+	virtual void setMessageHandler(MidiMessage::Type type, MessageHandler handler) override;
+	virtual void resetMessageHandlers() override;
+
+	virtual void setDispatchMode(DispatchMode mode) override;
+	virtual DispatchMode dispatchMode() const override;
+	virtual int pollDescriptor() const override;
+	virtual std::size_t processPending() override;
+
+	virtual void addWaiter(MidiMessageWaiter& waiter) override;
+	virtual bool removeWaiter(MidiMessageWaiter& waiter) override;
+
 private:
 	std::unique_ptr<Implementation> _impl;
 };
@@ -39,6 +39,11 @@ void MidiOutPortLinux::stop()
 	_impl->stop();
 }
 
+MidiPortMetrics MidiOutPortLinux::metrics() const
+{
+	return _impl->metrics();
+}
+
 void MidiOutPortLinux::sendMessage(const MidiMessage& message)
 {
 	if (_impl->isOpen())
@@ -47,6 +52,59 @@ void MidiOutPortLinux::sendMessage(const MidiMessage& message)
 	}
 }
 
+void MidiOutPortLinux::sendMessages(const MidiMessage* messages, std::size_t count)
+{
+	_impl->sendMessages(messages, count);
+}
+
+bool MidiOutPortLinux::scheduleMessages(const MidiMessage* messages, std::size_t count)
+{
+	return _impl->isOpen() && _impl->scheduleMessages(messages, count);
+}
+
+void MidiOutPortLinux::cancelScheduledMessages()
+{
+	_impl->cancelScheduledMessages();
+}
+
+void MidiOutPortLinux::setRunningStatusEnabled(bool enabled)
+{
+	_impl->setRunningStatusEnabled(enabled);
+}
+
+bool MidiOutPortLinux::isRunningStatusEnabled() const
+{
+	return _impl->isRunningStatusEnabled();
+}
+
+void MidiOutPortLinux::setNoteTrackingEnabled(bool enabled)
+{
+	_impl->setNoteTrackingEnabled(enabled);
+}
+
+bool MidiOutPortLinux::isNoteTrackingEnabled() const
+{
+	return _impl->isNoteTrackingEnabled();
+}
+
+void MidiOutPortLinux::releaseNotes()
+{
+	if (_impl->isOpen())
+	{
+		_impl->releaseNotes();
+	}
+}
+
+void MidiOutPortLinux::setCoalescing(const Coalescing& coalescing)
+{
+	_impl->setCoalescing(coalescing);
+}
+
+MidiOutPort::Coalescing MidiOutPortLinux::coalescing() const
+{
+	return _impl->coalescing();
+}
+
 MidiSync& MidiOutPortLinux::sync()
 {
 	return _impl->sync();
@@ -32,7 +32,22 @@ public:
 	virtual void start() override;
 	virtual void stop() override;
 
+	virtual MidiPortMetrics metrics() const override;
+
 	virtual void sendMessage(const MidiMessage& message) override;
+	virtual void sendMessages(const MidiMessage* messages, std::size_t count) override;
+	virtual bool scheduleMessages(const MidiMessage* messages, std::size_t count) override;
+	virtual void cancelScheduledMessages() override;
+
+	virtual void setRunningStatusEnabled(bool enabled) override;
+	virtual bool isRunningStatusEnabled() const override;
+
+	virtual void setNoteTrackingEnabled(bool enabled) override;
+	virtual bool isNoteTrackingEnabled() const override;
+	virtual void releaseNotes() override;
+
+	virtual void setCoalescing(const Coalescing& coalescing) override;
+	virtual Coalescing coalescing() const override;
 
 	virtual MidiSync& sync() override;
 
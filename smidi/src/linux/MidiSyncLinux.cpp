@@ -60,4 +60,9 @@ std::chrono::microseconds MidiSyncLinux::syncInitialLatencyForTempo(double bpm)
 	return _impl->syncInitialLatencyForTempo(bpm);
 }
 
+MidiSyncMetrics MidiSyncLinux::metrics() const
+{
+	return _impl ? _impl->metrics() : MidiSyncMetrics{};
+}
+
 //! \endcond
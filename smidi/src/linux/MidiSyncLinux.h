@@ -29,6 +29,7 @@ public:
 	virtual void changeSyncBpm(double bpm) override;
 	virtual bool isSyncStarted() const override;
 	virtual std::chrono::microseconds syncInitialLatencyForTempo(double bpm) const override;
+	virtual MidiSyncMetrics metrics() const override;
 
 private:
 	std::unique_ptr<Implementation> _impl;
@@ -6,14 +6,20 @@
 
 #include "MidiDeviceEnumeratorImpl.h"
 #include "MidiAlsaConstants.h"
+#include "../../MidiLogging.h"
 #include "MidiInPortLinuxImpl.h"
 #include "MidiOutPortLinuxImpl.h"
 #include <algorithm>
-#include <iostream>
 
 const int MidiDeviceEnumerator::Implementation::kWriteCapabilities = SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE;
 const int MidiDeviceEnumerator::Implementation::kReadCapabilities = SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ;
 
+namespace
+{
+	const int kChannels = 16;
+	const unsigned int kAllNotesOff = 123;
+}
+
 
 MidiDeviceEnumerator::Implementation::Implementation()
     : _sequencer(nullptr)
@@ -31,7 +37,7 @@ MidiDeviceEnumerator::Implementation::Implementation()
 	}
 	else
 	{
-		std::cerr << "Couldn't open ALSA sequencer client: " << snd_strerror(error) << std::endl;
+		SMIDI_LOG_ERROR("Couldn't open ALSA sequencer client: %s", snd_strerror(error));
 	}
 }
 
@@ -39,6 +45,13 @@ MidiDeviceEnumerator::Implementation::~Implementation()
 {
 	if (_sequencer)
 	{
+		// routes belong to the enumerator, the kernel would keep them otherwise
+		for (const Route& route : _routes)
+		{
+			disconnectRoute(route);
+		}
+		_routeQueue.close();
+
 		snd_seq_close(_sequencer);
 	}
 }
@@ -86,7 +99,7 @@ std::shared_ptr<MidiDevice> MidiDeviceEnumerator::Implementation::createDevice(c
 			}
 			else
 			{
-				std::cerr << "Couldn't get client info for device named '" << deviceName << "'' (" << clientId << ") because:" << snd_strerror(error) << std::endl;
+				SMIDI_LOG_ERROR("Couldn't get client info for device named '%s' (%d) because: %s", deviceName.c_str(), clientId, snd_strerror(error));
 			}
 		}
 	}
@@ -95,7 +108,63 @@ std::shared_ptr<MidiDevice> MidiDeviceEnumerator::Implementation::createDevice(c
 
 void MidiDeviceEnumerator::Implementation::updateDeviceList()
 {
+	const DeviceMap previousDevices = _deviceMap;
 	refreshDevices();
+
+	// an unplugged keyboard never sends Note Off of the notes its routes have passed
+	releaseRoutesOfLostDevices(previousDevices);
+
+	// the kernel drops connections of unplugged devices, reconnect the routes whose ports are back
+	connectRoutes();
+}
+
+bool MidiDeviceEnumerator::Implementation::addRoute(const Route& route)
+{
+	bool result = false;
+	if (_sequencer)
+	{
+		// the kernel keeps a single connection between two ports, whatever its timestamping
+		const auto connectsSamePorts = [&route](const Route& other) { return route.connectsSamePorts(other); };
+		if (std::find_if(std::begin(_routes), std::end(_routes), connectsSamePorts) == std::end(_routes))
+		{
+			_routes.push_back(route);
+			if (!connectRoute(route))
+			{
+				SMIDI_LOG_DEBUG("Route %s:%s -> %s:%s waits for its ports", route.sourceDevice.c_str(), route.sourcePort.c_str(), route.destinationDevice.c_str(), route.destinationPort.c_str());
+			}
+			result = true;
+		}
+		else
+		{
+			SMIDI_LOG_WARNING("Route %s:%s -> %s:%s is already added", route.sourceDevice.c_str(), route.sourcePort.c_str(), route.destinationDevice.c_str(), route.destinationPort.c_str());
+		}
+	}
+	return result;
+}
+
+bool MidiDeviceEnumerator::Implementation::removeRoute(const Route& route)
+{
+	bool result = false;
+	const auto i = std::find(std::begin(_routes), std::end(_routes), route);
+	if (i != std::end(_routes))
+	{
+		disconnectRoute(*i);
+		_routes.erase(i);
+		result = true;
+	}
+	return result;
+}
+
+std::list<MidiDeviceEnumerator::Route> MidiDeviceEnumerator::Implementation::routes() const
+{
+	return _routes;
+}
+
+bool MidiDeviceEnumerator::Implementation::isRouteConnected(const Route& route) const
+{
+	snd_seq_port_subscribe_t* subscription = nullptr;
+	snd_seq_port_subscribe_alloca(&subscription);
+	return prepareSubscription(route, subscription) && MidiAlsaConstants::kNoError == snd_seq_get_port_subscription(_sequencer, subscription);
 }
 
 void MidiDeviceEnumerator::Implementation::clearDevices()
@@ -116,6 +185,44 @@ void MidiDeviceEnumerator::Implementation::updateAllDeviceInformation(DeviceMap&
 	traverseAllClients(_sequencer, clientAction);
 }
 
+void MidiDeviceEnumerator::Implementation::releaseRoutesOfLostDevices(const DeviceMap& previousDevices)
+{
+	for (const Route& route : _routes)
+	{
+		// a device which is back with another client id has lost its notes as well
+		const auto previous = previousDevices.find(route.sourceDevice);
+		const auto current = _deviceMap.find(route.sourceDevice);
+		const bool isSourceLost = previous != std::end(previousDevices)
+		                          && (current == std::end(_deviceMap) || std::get<ClientId>(current->second) != std::get<ClientId>(previous->second));
+
+		snd_seq_addr_t destination = {};
+		if (isSourceLost && findPortAddress(route.destinationDevice, route.destinationPort, kWriteCapabilities, destination))
+		{
+			sendAllNotesOff(destination);
+		}
+	}
+}
+
+void MidiDeviceEnumerator::Implementation::sendAllNotesOff(const snd_seq_addr_t& destination)
+{
+	// notes of a route pass in the kernel, nothing has tracked which of them are on
+	for (int channel = 0; channel < kChannels; ++channel)
+	{
+		snd_seq_event_t event = {};
+		snd_seq_ev_clear(&event);
+		snd_seq_ev_set_dest(&event, destination.client, destination.port);
+		snd_seq_ev_set_direct(&event);
+		snd_seq_ev_set_controller(&event, channel, kAllNotesOff, 0);
+		snd_seq_event_output(_sequencer, &event);
+	}
+
+	const int error = snd_seq_drain_output(_sequencer);
+	if (error < 0)
+	{
+		SMIDI_LOG_ERROR("Couldn't send All Notes Off to %d:%d because: %s", destination.client, destination.port, snd_strerror(error));
+	}
+}
+
 void MidiDeviceEnumerator::Implementation::collectClientInformation(snd_seq_t* sequencer, snd_seq_client_info_t* clientInfo, DeviceMap& devices) const
 {
 	const int clientId = snd_seq_client_info_get_client(clientInfo);
@@ -201,4 +308,107 @@ bool MidiDeviceEnumerator::Implementation::isOurClient(const unsigned char clien
 	return _ourClientIds.count(clientId) != 0;
 }
 
+bool MidiDeviceEnumerator::Implementation::findPortAddress(const std::string& deviceName, const std::string& portName, int capabilities, snd_seq_addr_t& address) const
+{
+	bool result = false;
+	const auto i = _deviceMap.find(deviceName);
+	if (i != std::end(_deviceMap))
+	{
+		const int clientId = std::get<ClientId>(i->second);
+
+		snd_seq_port_info_t* portInfo = nullptr;
+		snd_seq_port_info_alloca(&portInfo);
+		snd_seq_port_info_set_client(portInfo, clientId);
+		snd_seq_port_info_set_port(portInfo, -1);
+
+		while (!result && MidiAlsaConstants::kNoError == snd_seq_query_next_port(_sequencer, portInfo))
+		{
+			const int caps = static_cast<int>(snd_seq_port_info_get_capability(portInfo));
+			if (portName == snd_seq_port_info_get_name(portInfo) && (caps & capabilities) == capabilities)
+			{
+				address.client = static_cast<unsigned char>(clientId);
+				address.port = static_cast<unsigned char>(snd_seq_port_info_get_port(portInfo));
+				result = true;
+			}
+		}
+	}
+	return result;
+}
+
+bool MidiDeviceEnumerator::Implementation::prepareSubscription(const Route& route, snd_seq_port_subscribe_t* subscription) const
+{
+	// source is read from (MidiInPort), destination is written to (MidiOutPort)
+	snd_seq_addr_t sender = {};
+	snd_seq_addr_t destination = {};
+	const bool result = _sequencer
+	                    && findPortAddress(route.sourceDevice, route.sourcePort, kReadCapabilities, sender)
+	                    && findPortAddress(route.destinationDevice, route.destinationPort, kWriteCapabilities, destination);
+	if (result)
+	{
+		snd_seq_port_subscribe_set_sender(subscription, &sender);
+		snd_seq_port_subscribe_set_dest(subscription, &destination);
+		if (route.timestamped && _routeQueue.isValid())
+		{
+			snd_seq_port_subscribe_set_queue(subscription, _routeQueue);
+			snd_seq_port_subscribe_set_time_update(subscription, 1);
+			snd_seq_port_subscribe_set_time_real(subscription, 1);
+		}
+	}
+	return result;
+}
+
+bool MidiDeviceEnumerator::Implementation::connectRoute(const Route& route)
+{
+	if (route.timestamped && !_routeQueue.isValid())
+	{
+		// one running queue stamps events of all timestamped routes
+		_routeQueue.init(_sequencer, "smidi routes");
+		_routeQueue.start();
+	}
+
+	bool result = false;
+	snd_seq_port_subscribe_t* subscription = nullptr;
+	snd_seq_port_subscribe_alloca(&subscription);
+	if (prepareSubscription(route, subscription))
+	{
+		if (MidiAlsaConstants::kNoError == snd_seq_get_port_subscription(_sequencer, subscription))
+		{
+			// still connected
+			result = true;
+		}
+		else
+		{
+			const int error = snd_seq_subscribe_port(_sequencer, subscription);
+			if (MidiAlsaConstants::kNoError == error)
+			{
+				result = true;
+			}
+			else
+			{
+				SMIDI_LOG_ERROR("Couldn't connect route %s:%s -> %s:%s because: %s", route.sourceDevice.c_str(), route.sourcePort.c_str(), route.destinationDevice.c_str(), route.destinationPort.c_str(), snd_strerror(error));
+			}
+		}
+	}
+	return result;
+}
+
+void MidiDeviceEnumerator::Implementation::disconnectRoute(const Route& route)
+{
+	snd_seq_port_subscribe_t* subscription = nullptr;
+	snd_seq_port_subscribe_alloca(&subscription);
+	if (prepareSubscription(route, subscription))
+	{
+		// the connection may be gone already, e.g. removed with aconnect
+		snd_seq_unsubscribe_port(_sequencer, subscription);
+	}
+}
+
+void MidiDeviceEnumerator::Implementation::connectRoutes()
+{
+	for (const Route& route : _routes)
+	{
+		connectRoute(route);
+	}
+}
+
 //! \endcond
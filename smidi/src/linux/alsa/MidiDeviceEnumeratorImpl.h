@@ -11,6 +11,8 @@
 #include "../../../include/smidi/MidiDeviceEnumerator.h"
 #include "../../../include/smidi/MidiDevice.h"
 #include "../../../include/smidi/MidiPort.h"
+#include "MidiQueue.h"
+#include <list>
 #include <map>
 #include <set>
 #include <vector>
@@ -45,11 +47,18 @@ public:
 
 	void updateDeviceList();
 
+	bool addRoute(const Route& route);
+	bool removeRoute(const Route& route);
+	std::list<Route> routes() const;
+	bool isRouteConnected(const Route& route) const;
+
 private:
 	void clearDevices();
 	void refreshDevices();
 
 	void updateAllDeviceInformation(DeviceMap& devices) const;
+	void releaseRoutesOfLostDevices(const DeviceMap& previousDevices);
+	void sendAllNotesOff(const snd_seq_addr_t& destination);
 
 	void collectClientInformation(snd_seq_t* sequencer, snd_seq_client_info_t* clientInfo, DeviceMap& devices) const;
 	void collectMidiPortObjects(snd_seq_t* sequencer, snd_seq_client_info_t* clientInfo, snd_seq_port_info_t*portInfo, std::vector<std::shared_ptr<MidiInPort>>& inputPorts, std::vector<std::shared_ptr<MidiOutPort> >& outputPorts);
@@ -59,9 +68,17 @@ private:
 
 	bool isOurClient(const unsigned char clientId) const;
 
+	bool findPortAddress(const std::string& deviceName, const std::string& portName, int capabilities, snd_seq_addr_t& address) const;
+	bool prepareSubscription(const Route& route, snd_seq_port_subscribe_t* subscription) const;
+	bool connectRoute(const Route& route);
+	void disconnectRoute(const Route& route);
+	void connectRoutes();
+
 private:
-	DeviceMap     _deviceMap;
-	std::set<int> _ourClientIds;
-	snd_seq_t*    _sequencer;
-	unsigned char _myClientId;
+	DeviceMap        _deviceMap;
+	std::set<int>    _ourClientIds;
+	snd_seq_t*       _sequencer;
+	unsigned char    _myClientId;
+	std::list<Route> _routes;
+	MidiQueue        _routeQueue;
 };
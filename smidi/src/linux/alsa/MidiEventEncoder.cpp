@@ -6,8 +6,7 @@
 
 #include "MidiEventEncoder.h"
 #include "MidiAlsaConstants.h"
-#include <sys/time.h>
-#include <iostream>
+#include "../../MidiLogging.h"
 
 MidiEventEncoder::MidiEventEncoder(int initialBufferSize)
 	: _parser(nullptr)
@@ -20,7 +19,7 @@ MidiEventEncoder::MidiEventEncoder(int initialBufferSize)
 	}
 	else
 	{
-		std::cerr << "Couldn't create MIDI event parser with size " << initialBufferSize << " because: " << snd_strerror(error) << std::endl;
+		SMIDI_LOG_ERROR("Couldn't create MIDI event parser with size %d because: %s", initialBufferSize, snd_strerror(error));
 	}
 }
 
@@ -44,7 +43,7 @@ void MidiEventEncoder::resizeBuffer(int newBufferSize)
 		int error = snd_midi_event_resize_buffer(_parser, newBufferSize);
 		if (MidiAlsaConstants::kNoError != error)
 		{
-			std::cerr << "Couldn't resize MIDI event parser size from " << _bufferSize << " to " << newBufferSize << " because: " << snd_strerror(error) << std::endl;
+			SMIDI_LOG_ERROR("Couldn't resize MIDI event parser size from %d to %d because: %s", _bufferSize, newBufferSize, snd_strerror(error));
 		}
 	}
 }
@@ -68,7 +67,7 @@ bool MidiEventEncoder::decode(snd_seq_event_t* event, MidiMessage& message)
 		const int sourcePort = event->data.connect.sender.port;
 		const int destClient = event->data.connect.dest.client;
 		const int destPort = event->data.connect.dest.port;
-		std::cout << "Port subscribed: (" << sourceClient << ":" << sourcePort << ") -> (" << destClient << ":" << destPort << ")\n";
+		SMIDI_LOG_DEBUG("Port subscribed: (%d:%d) -> (%d:%d)", sourceClient, sourcePort, destClient, destPort);
 	}
 	else if (event->type == SND_SEQ_EVENT_PORT_UNSUBSCRIBED)
 	{
@@ -76,7 +75,7 @@ bool MidiEventEncoder::decode(snd_seq_event_t* event, MidiMessage& message)
 		const int sourcePort = event->data.connect.sender.port;
 		const int destClient = event->data.connect.dest.client;
 		const int destPort = event->data.connect.dest.port;
-		std::cout << "Port unsubscribed: (" << sourceClient << ":" << sourcePort << ") -> (" << destClient << ":" << destPort << ")\n";
+		SMIDI_LOG_DEBUG("Port unsubscribed: (%d:%d) -> (%d:%d)", sourceClient, sourcePort, destClient, destPort);
 	}
 	else
 	{
@@ -95,16 +94,12 @@ bool MidiEventEncoder::decode(snd_seq_event_t* event, MidiMessage& message)
 		long numberOfBytes = snd_midi_event_decode(_parser, message, message.size(), event);
 		if (numberOfBytes > 0)
 		{
-			// timestamp
-			timeval currentSystemTime = {};
-			gettimeofday(&currentSystemTime, nullptr);
-			const unsigned long long timeStampInMs = (currentSystemTime.tv_sec * 1000) + (currentSystemTime.tv_usec / 1000);
-			message.setTimestamp(timeStampInMs);
+			message.resizeBuffer(numberOfBytes);
 			result = true;
 		}
 		else
 		{
-			perror("Event decoding failed");
+			SMIDI_LOG_WARNING("Event decoding failed: %s", snd_strerror(static_cast<int>(numberOfBytes)));
 		}
 	}
 	return result;
@@ -128,7 +123,7 @@ bool MidiEventEncoder::encode(snd_seq_event_t* event, const MidiMessage& message
 	}
 	else
 	{
-		std::cerr << "Couldn't parse outgoing MIDI message: " << message.toString() << " (number of encoded bytes is " << bytesEncoded << ")\n";
+		SMIDI_LOG_ERROR("Couldn't parse outgoing MIDI message of %zu bytes with status 0x%02X (number of encoded bytes is %d)", message.size(), message.isEmpty() ? 0u : static_cast<unsigned int>(message.data().front()), bytesEncoded);
 	}
 	return result;
 }
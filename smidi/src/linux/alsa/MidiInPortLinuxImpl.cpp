@@ -8,8 +8,10 @@
 #include "MidiInPortLinuxImpl.h"
 #include "MidiEventEncoder.h"
 #include "MidiAlsaConstants.h"
+#include "../../MidiLogging.h"
+#include "../../../include/smidi/MidiTimestamp.h"
 #include <functional>
-#include <iostream>
+#include <algorithm>
 #include <unistd.h>
 #include <alsa/asoundlib.h>
 
@@ -19,10 +21,15 @@ MidiInPortLinux::Implementation::Implementation(const std::string& name, int cli
 	, _deviceAddress{static_cast<unsigned char>(clientId), static_cast<unsigned char>(portId)}
 	, _applicationAddress{static_cast<unsigned char>(MidiAlsaConstants::kInvalidId), static_cast<unsigned char>(MidiAlsaConstants::kInvalidId)}
 	, _subscription(nullptr)
-	, _parser(nullptr)
+	, _decoder(0)
 	, _pipefd{MidiAlsaConstants::kInvalidId, MidiAlsaConstants::kInvalidId}
+	, _pollDescriptor(MidiAlsaConstants::kInvalidId)
+	, _dispatchMode(MidiInPort::DispatchMode::InputThread)
 	, _isOpen(false)
+	, _poll(false)
 {
+	_decoder.setRunningStatusEnabled(false);
+
 	// open ALSA sequencer client
 	if (MidiAlsaConstants::kNoError == snd_seq_open(&_sequencer, "default", SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK))
 	{
@@ -40,12 +47,12 @@ MidiInPortLinux::Implementation::Implementation(const std::string& name, int cli
 		}
 		else
 		{
-			std::cerr << "Couldn't create pipe for " << _name.c_str() << std::endl;
+			SMIDI_LOG_ERROR("Couldn't create pipe for %s", _name.c_str());
 		}
 	}
 	else
 	{
-		std::cerr << "Couldn't open ALSA sequencer for " << _name.c_str() << std::endl;
+		SMIDI_LOG_ERROR("Couldn't open ALSA sequencer for %s", _name.c_str());
 	}
 }
 
@@ -116,50 +123,55 @@ void MidiInPortLinux::Implementation::open()
 					result = snd_seq_subscribe_port(_sequencer, _subscription);
 					if (MidiAlsaConstants::kNoError == result)
 					{
-						// start the input queue
+						// start the input queue, incoming events are stamped with its real time
 						_queue.start();
+						_queueClock.calibrate(_queue);
 
-						// set the flag to poll input event
-						_poll = true;
+						// remember sequencer descriptor for applications with their own event loop
+						pollfd descriptor = {};
+						if (snd_seq_poll_descriptors(_sequencer, &descriptor, 1, POLLIN) == 1)
+						{
+							_pollDescriptor = descriptor.fd;
+						}
 
-						// start MIDI input thread.
-						_thread = std::thread(&Implementation::midiInputThread, this);
-						if (_thread.joinable())
+						// start MIDI input thread unless the application dispatches itself.
+						if (_dispatchMode == MidiInPort::DispatchMode::CallerThread || startInputThread())
 						{
 							_isOpen = true;
 						}
 						else
 						{
-							std::cerr << "Couldn't start midi input thread: " << _name.c_str() << std::endl;
+							SMIDI_LOG_ERROR("Couldn't start midi input thread: %s", _name.c_str());
 							snd_seq_unsubscribe_port(_sequencer, _subscription);
 							snd_seq_port_subscribe_free(_subscription);
+							_subscription = nullptr;
 						}
 					}
 					else
 					{
-						std::cerr << "Couldn't subscribe port: " << _name.c_str() << " because: " << snd_strerror(result) << std::endl;
+						SMIDI_LOG_ERROR("Couldn't subscribe port: %s because: %s", _name.c_str(), snd_strerror(result));
 						snd_seq_port_subscribe_free(_subscription);
 						_subscription = nullptr;
 					}
 				}
 				else
 				{
-					std::cerr << "Couldn't allocate port subscription: " << _name.c_str() << " because: " << snd_strerror(result) << std::endl;
+					SMIDI_LOG_ERROR("Couldn't allocate port subscription: %s because: %s", _name.c_str(), snd_strerror(result));
 				}
 			}
 			else
 			{
-				std::cerr << "Couldn't create input port: " << _name.c_str() << " because: " << snd_strerror(result) << std::endl;
+				SMIDI_LOG_ERROR("Couldn't create input port: %s because: %s", _name.c_str(), snd_strerror(result));
 			}
 		}
 		else
 		{
-			std::cerr << "Invalid client id/port id specified: " << _name.c_str() << ", client id: " << _deviceAddress.client << ", port id: " << _deviceAddress.port << std::endl;
+			SMIDI_LOG_ERROR("Invalid client id/port id specified: %s, client id: %d, port id: %d", _name.c_str(), _deviceAddress.client, _deviceAddress.port);
 		}
 	}
 	else
 	{
-		std::cerr << "Already open: " << _name.c_str() << std::endl;
+		SMIDI_LOG_WARNING("Already open: %s", _name.c_str());
 	}
 }
 
@@ -182,13 +194,11 @@ void MidiInPortLinux::Implementation::close()
 		_queue.stop();
 
 		// stop the thread
-		if (_poll)
-		{
-			_poll = false;
-			unsigned char stop = 1;
-			::write(_pipefd[1], &stop, sizeof(stop));
-			_thread.join();
-		}
+		stopInputThread();
+		_pollDescriptor = MidiAlsaConstants::kInvalidId;
+
+		// nothing will be received anymore
+		_waiters.completeExpired(true);
 
 		// destroy port
 		snd_seq_delete_port(_sequencer, _applicationAddress.port);
@@ -198,9 +208,14 @@ void MidiInPortLinux::Implementation::close()
 	}
 }
 
-void MidiInPortLinux::Implementation::setCallback(MidiInPortLinux::Implementation::Callback callback)
+MidiPortMetrics MidiInPortLinux::Implementation::metrics() const
 {
-	_callback = callback;
+	return _counters.snapshot();
+}
+
+MidiMessageDispatcher& MidiInPortLinux::Implementation::dispatcher()
+{
+	return _dispatcher;
 }
 
 void MidiInPortLinux::Implementation::start()
@@ -211,69 +226,203 @@ void MidiInPortLinux::Implementation::stop()
 {
 }
 
-int MidiInPortLinux::Implementation::applicationClientId() const
+void MidiInPortLinux::Implementation::setDispatchMode(MidiInPort::DispatchMode mode)
 {
-	return _applicationAddress.client;
+	if (mode != _dispatchMode)
+	{
+		_dispatchMode = mode;
+		if (_isOpen)
+		{
+			if (mode == MidiInPort::DispatchMode::InputThread)
+			{
+				if (!startInputThread())
+				{
+					SMIDI_LOG_ERROR("Couldn't start midi input thread: %s", _name.c_str());
+				}
+			}
+			else
+			{
+				stopInputThread();
+			}
+		}
+	}
 }
 
-void MidiInPortLinux::Implementation::midiInputThread()
+MidiInPort::DispatchMode MidiInPortLinux::Implementation::dispatchMode() const
+{
+	return _dispatchMode;
+}
+
+int MidiInPortLinux::Implementation::pollDescriptor() const
 {
-	Implementation* impl = this;
+	return _pollDescriptor;
+}
 
-	MidiEventEncoder encoder(0);
-	encoder.setRunningStatusEnabled(false);
+std::size_t MidiInPortLinux::Implementation::processPending()
+{
+	std::size_t result = 0;
+	if (_isOpen && _dispatchMode == MidiInPort::DispatchMode::CallerThread)
+	{
+		result = processPendingEvents();
+		_waiters.completeExpired(false);
+	}
+	return result;
+}
 
-	// setup poll descriptors
-	const int pollDescriptorsCount = snd_seq_poll_descriptors_count(impl->_sequencer, POLLIN);
-	// note: we add 1 custom descriptor to force the poll() call to return
-	pollfd* pollDescriptors = reinterpret_cast<pollfd*>(alloca((pollDescriptorsCount + 1) * sizeof(pollfd)));
-	snd_seq_poll_descriptors(impl->_sequencer, pollDescriptors, pollDescriptorsCount, POLLIN);
-	pollDescriptors[pollDescriptorsCount].fd = impl->_pipefd[0];
-	pollDescriptors[pollDescriptorsCount].events = POLLIN;
+void MidiInPortLinux::Implementation::addWaiter(MidiMessageWaiter& waiter)
+{
+	_waiters.add(waiter);
 
-	MidiMessage message;
+	// input thread should recalculate its poll timeout
+	if (waiter.deadline != MidiMessageWaiter::Clock::time_point::max())
+	{
+		wakeUpInputThread();
+	}
+}
+
+bool MidiInPortLinux::Implementation::removeWaiter(MidiMessageWaiter& waiter)
+{
+	return _waiters.remove(waiter);
+}
+
+int MidiInPortLinux::Implementation::applicationClientId() const
+{
+	return _applicationAddress.client;
+}
 
-	while (impl->_poll)
+bool MidiInPortLinux::Implementation::startInputThread()
+{
+	if (!_poll)
 	{
-		const int checkSequencerFIFO = 1;
-		const int numberOfEventPending = snd_seq_event_input_pending(impl->_sequencer, checkSequencerFIFO);
-		if (numberOfEventPending == 0)
+		// set the flag to poll input event
+		_poll = true;
+
+		_thread = std::thread(&Implementation::midiInputThread, this);
+		if (!_thread.joinable())
 		{
-			if (poll(pollDescriptors, pollDescriptorsCount + 1, -1) >= 0)
-			{
-				// check if the polled one is our custom descriptur
-				const bool shouldCheckPollingStatus = (pollDescriptors[pollDescriptorsCount].revents & POLLIN) == POLLIN;
-				if (shouldCheckPollingStatus)
-				{
-					unsigned char data;
-					::read(pollDescriptors[pollDescriptorsCount].fd, &data, sizeof(data));
-				}
-			}
-			continue;
+			_poll = false;
 		}
+	}
+	return _poll;
+}
 
+void MidiInPortLinux::Implementation::stopInputThread()
+{
+	if (_poll)
+	{
+		_poll = false;
+		wakeUpInputThread();
+		_thread.join();
+	}
+}
+
+void MidiInPortLinux::Implementation::wakeUpInputThread()
+{
+	if (_poll)
+	{
+		unsigned char wakeUp = 1;
+		::write(_pipefd[1], &wakeUp, sizeof(wakeUp));
+	}
+}
+
+std::size_t MidiInPortLinux::Implementation::processPendingEvents()
+{
+	std::size_t numberOfDispatchedMessages = 0;
+
+	_queueClock.maintain(_queue);
+
+	const int checkSequencerFIFO = 1;
+	while (snd_seq_event_input_pending(_sequencer, checkSequencerFIFO) > 0)
+	{
 		snd_seq_event_t* event = nullptr;
-		const int resultOrError = snd_seq_event_input(impl->_sequencer, &event);
+		const int resultOrError = snd_seq_event_input(_sequencer, &event);
 		if (resultOrError >= MidiAlsaConstants::kNoError)
 		{
-			MidiMessage decodedMessage;
-			encoder.decode(event, decodedMessage);
+			const unsigned long long timestamp = eventTimestamp(event);
+			const bool isSubscriptionEvent = (event->type == SND_SEQ_EVENT_PORT_SUBSCRIBED || event->type == SND_SEQ_EVENT_PORT_UNSUBSCRIBED);
+			const bool decoded = _decoder.decode(event, _decodedMessage);
 			snd_seq_free_event(event);
 
-			message += decodedMessage;
+			if (decoded)
+			{
+				// split SysEx keeps the arrival time of its first part
+				if (_message.isEmpty())
+				{
+					_message.setTimestamp(timestamp);
+				}
+				_message += _decodedMessage;
+			}
+			else if (!isSubscriptionEvent)
+			{
+				_counters.countDecodeFailure();
+			}
 		}
 		else
 		{
 			const int error = resultOrError;
-			std::cerr << "Couldn't read midi event with: " << impl->_name.c_str() << " because: " << snd_strerror(error) << std::endl;
+			SMIDI_LOG_ERROR("Couldn't read midi event with: %s because: %s", _name.c_str(), snd_strerror(error));
+			if (error == -ENOSPC)
+			{
+				// input buffer overrun, some events are lost
+				_counters.countOverrun();
+			}
+			else if (error == -EAGAIN)
+			{
+				break;
+			}
 		}
 
-		const bool partialSysEx = message.isActually(MidiMessage::SysEx) && !message.isCompleteSysEx();
-		if (!partialSysEx && !message.isEmpty())
+		// SysEx can be split by the driver into several events, so it's dispatched only when complete
+		const bool partialSysEx = !_message.isEmpty() && _message.data().front() == MidiMessage::SysEx && !_message.isCompleteSysEx();
+		if (!partialSysEx && !_message.isEmpty())
+		{
+			_counters.countMessage(_message);
+			// a timestamp mapped from the queue time may be a bit ahead of the clock
+			const unsigned long long now = MidiTimestamp::now();
+			_counters.countLatency(now > _message.timestamp() ? now - _message.timestamp() : 0);
+
+			// waiters take the message first, suspended coroutines are resumed right from here
+			const bool waiterCompleted = !_waiters.isEmpty() && _waiters.complete(_message);
+			if (waiterCompleted || _dispatcher.dispatch(_message))
+			{
+				++numberOfDispatchedMessages;
+			}
+			_message.resizeBuffer(0);
+		}
+	}
+	return numberOfDispatchedMessages;
+}
+
+unsigned long long MidiInPortLinux::Implementation::eventTimestamp(const snd_seq_event_t* event) const
+{
+	// events are stamped by the kernel on arrival with the real time of our input queue
+	const bool stampedByQueue = ((event->flags & SND_SEQ_TIME_STAMP_MASK) == SND_SEQ_TIME_STAMP_REAL) && (event->queue == _queue);
+	return (stampedByQueue && _queueClock.isCalibrated()) ? _queueClock.toTimestamp(event->time.time) : MidiTimestamp::now();
+}
+
+void MidiInPortLinux::Implementation::midiInputThread()
+{
+	// setup poll descriptors
+	const int pollDescriptorsCount = snd_seq_poll_descriptors_count(_sequencer, POLLIN);
+	// note: we add 1 custom descriptor to force the poll() call to return
+	pollfd* pollDescriptors = reinterpret_cast<pollfd*>(alloca((pollDescriptorsCount + 1) * sizeof(pollfd)));
+	snd_seq_poll_descriptors(_sequencer, pollDescriptors, pollDescriptorsCount, POLLIN);
+	pollDescriptors[pollDescriptorsCount].fd = _pipefd[0];
+	pollDescriptors[pollDescriptorsCount].events = POLLIN;
+
+	while (_poll)
+	{
+		processPendingEvents();
+		_waiters.completeExpired(false);
+
+		if (poll(pollDescriptors, pollDescriptorsCount + 1, _waiters.timeoutToNextDeadline()) >= 0)
 		{
-			if (impl->_callback)
+			// check if the polled one is our custom descriptor
+			const bool shouldCheckPollingStatus = (pollDescriptors[pollDescriptorsCount].revents & POLLIN) == POLLIN;
+			if (shouldCheckPollingStatus)
 			{
-				impl->_callback(message);
+				unsigned char data;
+				::read(pollDescriptors[pollDescriptorsCount].fd, &data, sizeof(data));
 			}
 		}
 	}
@@ -9,7 +9,13 @@
 
 #include "../MidiInPortLinux.h"
 #include "MidiQueue.h"
+#include "MidiEventEncoder.h"
+#include "MidiQueueClock.h"
+#include "../../MidiMetricsCounters.h"
+#include "../../MidiMessageWaiterList.h"
+#include "../../../include/smidi/MidiMessageDispatcher.h"
 #include <thread>
+#include <atomic>
 #include <alsa/asoundlib.h>
 
 class MidiMessage;
@@ -22,9 +28,6 @@ class MidiInPortLinux::Implementation
 	static const int kReadCaps = SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ;
 	static const int kWriteCaps = SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE;
 
-public:
-	using Callback = std::function<void(MidiMessage&)>;
-
 public:
 	Implementation(const std::string& name, int clientId, int portId);
 	~Implementation();
@@ -35,29 +38,51 @@ public:
 	void close();
 	bool isOpen() const;
 
-	void setCallback(Callback callback);
+	MidiMessageDispatcher& dispatcher();
 
 	void start();
 	void stop();
 
+	MidiPortMetrics metrics() const;
+
+	void setDispatchMode(MidiInPort::DispatchMode mode);
+	MidiInPort::DispatchMode dispatchMode() const;
+	int pollDescriptor() const;
+	std::size_t processPending();
+
+	void addWaiter(MidiMessageWaiter& waiter);
+	bool removeWaiter(MidiMessageWaiter& waiter);
+
 	int applicationClientId() const;
 
 private:
+	bool startInputThread();
+	void stopInputThread();
+	std::size_t processPendingEvents();
+	unsigned long long eventTimestamp(const snd_seq_event_t* event) const;
 	void midiInputThread();
+	void wakeUpInputThread();
 
 private:
 	std::string                _name;
-	Callback                   _callback;
+	MidiMessageDispatcher      _dispatcher;
 	snd_seq_t*                 _sequencer;
 	snd_seq_addr_t             _deviceAddress;
 	snd_seq_addr_t             _applicationAddress;
 	snd_seq_port_subscribe_t*  _subscription;
-	snd_midi_event_t*          _parser;
+	MidiEventEncoder           _decoder;
+	MidiMessage                _message;
+	MidiMessage                _decodedMessage;
 	std::thread                _thread;
 	MidiQueue                  _queue;
+	MidiQueueClock             _queueClock;
+	MidiPortCounters           _counters;
 	int                        _pipefd[2];
+	int                        _pollDescriptor;
+	MidiInPort::DispatchMode   _dispatchMode;
 	bool                       _isOpen;
-	bool                       _poll;
+	std::atomic<bool>          _poll;
+	MidiMessageWaiterList      _waiters;
 };
 
 //! \endcond
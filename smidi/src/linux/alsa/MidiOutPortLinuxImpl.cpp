@@ -6,8 +6,8 @@
 
 #include "MidiOutPortLinuxImpl.h"
 #include "MidiAlsaConstants.h"
+#include "../../MidiLogging.h"
 #include "../../../include/smidi/MidiMessage.h"
-#include <iostream>
 
 MidiOutPortLinux::Implementation::Implementation(const std::string& name, int clientId, int portId)
     : _name(name)
@@ -16,7 +16,12 @@ MidiOutPortLinux::Implementation::Implementation(const std::string& name, int cl
     , _sequencer(nullptr)
     , _subscription(nullptr)
     , _encoder(kInitialBufferSize)
+    , _coalescer([this](const MidiMessage* messages, std::size_t count) { outputMessages(messages, count); }, _counters, MidiClock::system())
+    , _outputMutex(&_deviceOutputMutex)
+    , _capabilities(SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ)
+    , _isVirtual(false)
     , _isOpen(false)
+    , _runningStatusEnabled(false)
 {
 	// open ALSA sequencer client
 	if (MidiAlsaConstants::kNoError == snd_seq_open(&_sequencer, "default", SND_SEQ_OPEN_OUTPUT, SND_SEQ_NONBLOCK))
@@ -28,14 +33,33 @@ MidiOutPortLinux::Implementation::Implementation(const std::string& name, int cl
 	}
 	else
 	{
-		std::cerr << "Couldn't open ALSA sequencer for " << _name.c_str() << std::endl;
+		SMIDI_LOG_ERROR("Couldn't open ALSA sequencer for %s", _name.c_str());
 	}
 }
 
+MidiOutPortLinux::Implementation::Implementation(const std::string& name, snd_seq_t* sharedSequencer, std::mutex& outputMutex, unsigned int capabilities)
+    : _name(name)
+    , _deviceAddress{static_cast<unsigned char>(MidiAlsaConstants::kInvalidId), static_cast<unsigned char>(MidiAlsaConstants::kInvalidId)}
+    , _applicationAddress{static_cast<unsigned char>(snd_seq_client_id(sharedSequencer)), static_cast<unsigned char>(MidiAlsaConstants::kInvalidId)}
+    , _sequencer(sharedSequencer)
+    , _subscription(nullptr)
+    , _encoder(kInitialBufferSize)
+    , _coalescer([this](const MidiMessage* messages, std::size_t count) { outputMessages(messages, count); }, _counters, MidiClock::system())
+    , _outputMutex(&outputMutex)
+    , _capabilities(capabilities)
+    , _isVirtual(true)
+    , _isOpen(false)
+    , _runningStatusEnabled(false)
+{
+}
+
 MidiOutPortLinux::Implementation::~Implementation()
 {
+	// the flusher thread of the coalescer sends to the sequencer
+	_coalescer.close();
 	close();
-	if (_sequencer)
+	// shared sequencer belongs to MidiVirtualClient
+	if (_sequencer && !_isVirtual)
 	{
 		snd_seq_close(_sequencer);
 	}
@@ -50,10 +74,16 @@ void MidiOutPortLinux::Implementation::open()
 {
 	if (!_isOpen)
 	{
-		const unsigned int capabilities = SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ;
 		const unsigned int type = SND_SEQ_PORT_TYPE_MIDI_GENERIC|SND_SEQ_PORT_TYPE_APPLICATION;
-		_applicationAddress.port = snd_seq_create_simple_port(_sequencer, _name.c_str(), capabilities, type);
-		if (_applicationAddress.port >= 0)
+		const int portIdOrError = snd_seq_create_simple_port(_sequencer, _name.c_str(), _capabilities, type);
+		_applicationAddress.port = static_cast<unsigned char>(portIdOrError);
+		if (portIdOrError >= 0 && _isVirtual)
+		{
+			// nothing to subscribe to, other clients connect to the port
+			_isOpen = true;
+			_sync.initialize(std::unique_ptr<MidiSyncLinux::Implementation>(new MidiSyncLinux::Implementation(*this)));
+		}
+		else if (portIdOrError >= 0)
 		{
 			snd_seq_port_info_t *portInfo = nullptr;
 			snd_seq_port_info_alloca(&portInfo);
@@ -72,24 +102,30 @@ void MidiOutPortLinux::Implementation::open()
 				}
 				else
 				{
-					std::cerr << "Couldn't allocate space for port subscription for " << _name.c_str() << std::endl;
+					SMIDI_LOG_ERROR("Couldn't allocate space for port subscription for %s", _name.c_str());
 					snd_seq_port_subscribe_free(_subscription);
 				}
 			}
 			else
 			{
-				std::cerr << "Couldn't allocate space for port subscription for " << _name.c_str() << std::endl;
+				SMIDI_LOG_ERROR("Couldn't allocate space for port subscription for %s", _name.c_str());
 				snd_seq_port_subscribe_free(_subscription);
 			}
 		}
 		else
 		{
-			std::cerr << "Couldn't create MIDI input port for " << _name.c_str() << std::endl;
+			SMIDI_LOG_ERROR("Couldn't create MIDI input port for %s", _name.c_str());
+		}
+
+		// close() stopped coalescing, the settings stay with the port
+		if (_isOpen)
+		{
+			_coalescer.reopen();
 		}
 	}
 	else
 	{
-		std::cerr << "The port is already opened for " << _name.c_str() << std::endl;
+		SMIDI_LOG_WARNING("The port is already opened for %s", _name.c_str());
 	}
 }
 
@@ -97,14 +133,30 @@ void MidiOutPortLinux::Implementation::close()
 {
 	if (_isOpen)
 	{
-		snd_seq_unsubscribe_port(_sequencer, _subscription);
-		snd_seq_port_subscribe_free(_subscription);
+		_coalescer.close();
+
+		// the device is still connected, so nothing it plays is left hanging
+		if (_activeNotes.isEnabled())
+		{
+			releaseNotes();
+		}
+		_scheduleQueue.close();
+		if (_isVirtual)
+		{
+			_sync.close();
+			snd_seq_delete_simple_port(_sequencer, _applicationAddress.port);
+		}
+		else
+		{
+			snd_seq_unsubscribe_port(_sequencer, _subscription);
+			snd_seq_port_subscribe_free(_subscription);
+		}
 
 		_isOpen = false;
 	}
 	else
 	{
-		std::cerr << "The port isn't' opened for " << _name.c_str() << std::endl;
+		SMIDI_LOG_WARNING("The port isn't opened for %s", _name.c_str());
 	}
 }
 
@@ -123,24 +175,234 @@ void MidiOutPortLinux::Implementation::stop()
 
 void MidiOutPortLinux::Implementation::sendMessage(const MidiMessage& message)
 {
+	if (_coalescer.isEnabled())
+	{
+		_coalescer.send(&message, 1);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(*_outputMutex);
+
+		if (outputMessage(message, nullptr))
+		{
+			drainOutput();
+		}
+	}
+}
+
+void MidiOutPortLinux::Implementation::sendMessages(const MidiMessage* messages, std::size_t count)
+{
+	if (_coalescer.isEnabled())
+	{
+		_coalescer.send(messages, count);
+	}
+	else
+	{
+		outputMessages(messages, count);
+	}
+}
+
+void MidiOutPortLinux::Implementation::outputMessages(const MidiMessage* messages, std::size_t count)
+{
+	std::lock_guard<std::mutex> lock(*_outputMutex);
+
+	// events pile up in the output buffer of the client and go to the kernel with a single write
+	bool hasOutput = false;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		hasOutput = outputMessage(messages[i], nullptr) || hasOutput;
+	}
+	if (hasOutput)
+	{
+		drainOutput();
+	}
+}
+
+bool MidiOutPortLinux::Implementation::scheduleMessages(const MidiMessage* messages, std::size_t count)
+{
+	std::lock_guard<std::mutex> lock(*_outputMutex);
+
+	// the queue of MidiSync is restarted on every tempo correction, which resets its time, so scheduled
+	// messages have a queue of their own which runs as long as the port is open
+	if (!_scheduleQueue.isValid() && _isOpen)
+	{
+		_scheduleQueue.init(_sequencer, _name + " schedule");
+		if (_scheduleQueue.isValid())
+		{
+			_scheduleQueue.start();
+			_scheduleQueueClock.calibrate(_scheduleQueue);
+		}
+		else
+		{
+			SMIDI_LOG_ERROR("Couldn't allocate schedule queue for %s", _name.c_str());
+		}
+	}
+
+	const bool result = _scheduleQueue.isValid() && _scheduleQueueClock.isCalibrated();
+	if (result && count > 0)
+	{
+		_scheduleQueueClock.maintain(_scheduleQueue);
+
+		bool hasOutput = false;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const snd_seq_real_time_t deliveryTime = _scheduleQueueClock.toQueueTime(messages[i].timestamp());
+			hasOutput = outputMessage(messages[i], &deliveryTime) || hasOutput;
+		}
+		if (hasOutput)
+		{
+			drainOutput();
+		}
+	}
+	return result;
+}
+
+void MidiOutPortLinux::Implementation::cancelScheduledMessages()
+{
+	std::lock_guard<std::mutex> lock(*_outputMutex);
+
+	if (_scheduleQueue.isValid())
+	{
+		// the output buffer may hold events of the sibling ports of a virtual client, so it is flushed
+		// rather than dropped and the events of this port are removed from the kernel queue
+		drainOutput();
+		if (!_isVirtual)
+		{
+			snd_seq_drop_output(_sequencer);
+		}
+
+		snd_seq_remove_events_t* removeEvents = nullptr;
+		snd_seq_remove_events_alloca(&removeEvents);
+		snd_seq_remove_events_set_condition(removeEvents, SND_SEQ_REMOVE_OUTPUT | SND_SEQ_REMOVE_TAG_MATCH);
+		snd_seq_remove_events_set_tag(removeEvents, scheduledEventTag());
+		const int result = snd_seq_remove_events(_sequencer, removeEvents);
+		if (result < 0)
+		{
+			SMIDI_LOG_ERROR("Couldn't cancel scheduled MIDI messages for %s because: %s", _name.c_str(), snd_strerror(result));
+		}
+	}
+}
+
+unsigned char MidiOutPortLinux::Implementation::scheduledEventTag() const
+{
+	// MidiSync events are not tagged (0) and the ports of a virtual client share it, so every port has its own tag
+	return static_cast<unsigned char>(1 + _applicationAddress.port % 255);
+}
+
+bool MidiOutPortLinux::Implementation::outputMessage(const MidiMessage& message, const snd_seq_real_time_t* deliveryTime)
+{
+	bool result = false;
 	snd_seq_event_t event = {};
 	if (_encoder.encode(&event, message))
 	{
 		snd_seq_ev_set_source(&event, _applicationAddress.port);
 		snd_seq_ev_set_subs(&event);
-		snd_seq_ev_set_direct(&event);
+		if (deliveryTime)
+		{
+			snd_seq_ev_schedule_real(&event, _scheduleQueue, 0, deliveryTime);
+			snd_seq_ev_set_tag(&event, scheduledEventTag());
+		}
+		else
+		{
+			snd_seq_ev_set_direct(&event);
+		}
+
+		int numberOfUnprocessedEventsOrError = snd_seq_event_output(_sequencer, &event);
+		if (numberOfUnprocessedEventsOrError == -EAGAIN)
+		{
+			// output buffer is full of the previous events of the batch, flush it and try again
+			drainOutput();
+			numberOfUnprocessedEventsOrError = snd_seq_event_output(_sequencer, &event);
+		}
 
-		const int numberOfUnprocessedEventsOrError = snd_seq_event_output(_sequencer, &event);
 		if (numberOfUnprocessedEventsOrError >= 0)
 		{
-			snd_seq_drain_output(_sequencer);
+			_counters.countMessage(message);
+			if (deliveryTime)
+			{
+				_activeNotes.trackScheduled(message);
+			}
+			else
+			{
+				_activeNotes.track(message);
+			}
+			result = true;
 		}
 		else
 		{
 			const int error = numberOfUnprocessedEventsOrError;
-			std::cerr << "Couldn't send MIDI message: " << message.toString() << " for " << _name.c_str() << " because: " << snd_strerror(error) << std::endl;
+			SMIDI_LOG_ERROR("Couldn't send MIDI message of %zu bytes with status 0x%02X for %s because: %s", message.size(), message.isEmpty() ? 0u : static_cast<unsigned int>(message.data().front()), _name.c_str(), snd_strerror(error));
+			if (error == -ENOSPC || error == -EAGAIN)
+			{
+				// output buffer is full, the message is lost
+				_counters.countOverrun();
+			}
+			else
+			{
+				_counters.countSendFailure();
+			}
 		}
 	}
+	else
+	{
+		_counters.countEncodeFailure();
+	}
+	return result;
+}
+
+void MidiOutPortLinux::Implementation::drainOutput()
+{
+	const int result = snd_seq_drain_output(_sequencer);
+	if (result < 0 && result != -EAGAIN)
+	{
+		SMIDI_LOG_ERROR("Couldn't flush MIDI output for %s because: %s", _name.c_str(), snd_strerror(result));
+		_counters.countSendFailure();
+	}
+}
+
+void MidiOutPortLinux::Implementation::setRunningStatusEnabled(bool enabled)
+{
+	// sequencer events carry no status bytes, the driver encodes the byte stream itself
+	_runningStatusEnabled = enabled;
+}
+
+bool MidiOutPortLinux::Implementation::isRunningStatusEnabled() const
+{
+	return _runningStatusEnabled;
+}
+
+void MidiOutPortLinux::Implementation::setNoteTrackingEnabled(bool enabled)
+{
+	_activeNotes.setEnabled(enabled);
+}
+
+bool MidiOutPortLinux::Implementation::isNoteTrackingEnabled() const
+{
+	return _activeNotes.isEnabled();
+}
+
+void MidiOutPortLinux::Implementation::releaseNotes()
+{
+	const std::vector<MidiMessage> messages = _activeNotes.takeReleaseMessages();
+	if (!messages.empty())
+	{
+		sendMessages(messages.data(), messages.size());
+	}
+}
+
+void MidiOutPortLinux::Implementation::setCoalescing(const MidiOutPort::Coalescing& coalescing)
+{
+	_coalescer.setCoalescing(coalescing);
+}
+
+MidiOutPort::Coalescing MidiOutPortLinux::Implementation::coalescing() const
+{
+	return _coalescer.coalescing();
+}
+
+MidiPortMetrics MidiOutPortLinux::Implementation::metrics() const
+{
+	return _counters.snapshot();
 }
 
 MidiSync& MidiOutPortLinux::Implementation::sync()
@@ -163,4 +425,9 @@ snd_seq_t*MidiOutPortLinux::Implementation::sequencer() const
 	return _sequencer;
 }
 
+std::mutex& MidiOutPortLinux::Implementation::outputMutex() const
+{
+	return *_outputMutex;
+}
+
 //! \endcond
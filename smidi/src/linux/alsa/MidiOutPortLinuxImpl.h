@@ -10,6 +10,12 @@
 #include "../MidiOutPortLinux.h"
 #include "MidiEventEncoder.h"
 #include "MidiSyncLinuxImpl.h"
+#include "MidiQueue.h"
+#include "MidiQueueClock.h"
+#include "../../MidiActiveNotes.h"
+#include "../../MidiCoalescer.h"
+#include "../../MidiMetricsCounters.h"
+#include <mutex>
 #include <alsa/asoundlib.h>
 
 class MidiOutPortLinux::Implementation
@@ -17,7 +23,15 @@ class MidiOutPortLinux::Implementation
 	const static std::size_t kInitialBufferSize = 256;
 
 public:
+	//! Output port of its own sequencer client connected to the device port, output is serialized with a mutex of the port
 	Implementation(const std::string& name, int clientId, int portId);
+
+	/*!
+	 * Virtual port of the shared MidiVirtualClient sequencer client, other clients subscribe to it themselves.
+	 * Output to the shared client is serialized with outputMutex.
+	 */
+	Implementation(const std::string& name, snd_seq_t* sharedSequencer, std::mutex& outputMutex, unsigned int capabilities);
+
 	~Implementation();
 
 	const std::string& name() const;
@@ -30,6 +44,22 @@ public:
 	void stop();
 
 	void sendMessage(const MidiMessage& message);
+	void sendMessages(const MidiMessage* messages, std::size_t count);
+
+	bool scheduleMessages(const MidiMessage* messages, std::size_t count);
+	void cancelScheduledMessages();
+
+	void setRunningStatusEnabled(bool enabled);
+	bool isRunningStatusEnabled() const;
+
+	void setNoteTrackingEnabled(bool enabled);
+	bool isNoteTrackingEnabled() const;
+	void releaseNotes();
+
+	void setCoalescing(const MidiOutPort::Coalescing& coalescing);
+	MidiOutPort::Coalescing coalescing() const;
+
+	MidiPortMetrics metrics() const;
 
 	MidiSync& sync();
 
@@ -39,6 +69,16 @@ public:
 public:
 	snd_seq_t* sequencer() const;
 
+	//! Mutex every write to sequencer() takes, the sync thread writes its queue events under it too
+	std::mutex& outputMutex() const;
+
+private:
+	//! Sends the messages right away, the sender of the coalescer
+	void outputMessages(const MidiMessage* messages, std::size_t count);
+	bool outputMessage(const MidiMessage& message, const snd_seq_real_time_t* deliveryTime);
+	unsigned char scheduledEventTag() const;
+	void drainOutput();
+
 private:
 	std::string               _name;
 	snd_seq_addr_t            _deviceAddress;
@@ -47,7 +87,17 @@ private:
 	snd_seq_port_subscribe_t* _subscription;
 	MidiEventEncoder          _encoder;
 	MidiSyncLinux             _sync;
+	MidiQueue                 _scheduleQueue;
+	MidiQueueClock            _scheduleQueueClock;
+	MidiPortCounters          _counters;
+	MidiActiveNotes           _activeNotes;
+	MidiCoalescer             _coalescer;
+	std::mutex                _deviceOutputMutex;
+	std::mutex*               _outputMutex;
+	unsigned int              _capabilities;
+	bool                      _isVirtual;
 	bool                      _isOpen;
+	bool                      _runningStatusEnabled;
 };
 
 //! \endcond
@@ -6,7 +6,7 @@
  */
 
 #include "MidiQueue.h"
-#include <iostream>
+#include "../../MidiLogging.h"
 
 MidiQueue::MidiQueue()
 	: _sequencer(nullptr)
@@ -27,7 +27,7 @@ void MidiQueue::init(snd_seq_t* sequencer)
 	}
 	else
 	{
-		std::cerr << "Queue is already initialized\n";
+		SMIDI_LOG_WARNING("Queue is already initialized");
 	}
 }
 
@@ -40,7 +40,7 @@ void MidiQueue::init(snd_seq_t* sequencer, const std::string& name)
 	}
 	else
 	{
-		std::cerr << "Queue is already initialized\n";
+		SMIDI_LOG_WARNING("Queue is already initialized");
 	}
 }
 
@@ -59,7 +59,7 @@ void MidiQueue::start()
 	int result = snd_seq_drain_output(_sequencer);
 	if (result < 0)
 	{
-		std::cerr << "MidiQueue::start error:" << snd_strerror(result) << std::endl;
+		SMIDI_LOG_ERROR("MidiQueue::start error: %s", snd_strerror(result));
 	}
 }
 
@@ -69,7 +69,7 @@ void MidiQueue::stop()
 	int result = snd_seq_drain_output(_sequencer);
 	if (result < 0)
 	{
-		std::cerr << "MidiQueue::stop error:" << snd_strerror(result) << std::endl;
+		SMIDI_LOG_ERROR("MidiQueue::stop error: %s", snd_strerror(result));
 	}
 }
 
@@ -79,7 +79,7 @@ void MidiQueue::resume()
 	int result = snd_seq_drain_output(_sequencer);
 	if (result < 0)
 	{
-		std::cerr << "MidiQueue::resume error:" << snd_strerror(result) << std::endl;
+		SMIDI_LOG_ERROR("MidiQueue::resume error: %s", snd_strerror(result));
 	}
 }
 
@@ -94,7 +94,7 @@ void MidiQueue::setTempo(double bpm)
 	int result = snd_seq_drain_output(_sequencer);
 	if (result < 0)
 	{
-		std::cerr << "MidiQueue::setTempo error:" << snd_strerror(result) << std::endl;
+		SMIDI_LOG_ERROR("MidiQueue::setTempo error: %s", snd_strerror(result));
 	}
 }
 
@@ -105,15 +105,36 @@ void MidiQueue::changeTempo(double bpm)
 	int result = snd_seq_drain_output(_sequencer);
 	if (result < 0)
 	{
-		std::cerr << "MidiQueue::changeTempo error:" << snd_strerror(result) << std::endl;
+		SMIDI_LOG_ERROR("MidiQueue::changeTempo error: %s", snd_strerror(result));
 	}
 }
 
+bool MidiQueue::isValid() const
+{
+	return _id >= 0;
+}
+
 MidiQueue::operator int() const
 {
 	return _id;
 }
 
+bool MidiQueue::realTime(snd_seq_real_time_t& time) const
+{
+	snd_seq_queue_status_t* status = nullptr;
+	snd_seq_queue_status_alloca(&status);
+	int result = snd_seq_get_queue_status(_sequencer, _id, status);
+	if (result >= 0)
+	{
+		time = *snd_seq_queue_status_get_real_time(status);
+	}
+	else
+	{
+		SMIDI_LOG_ERROR("MidiQueue::realTime error: %s", snd_strerror(result));
+	}
+	return result >= 0;
+}
+
 void MidiQueue::enqueueMidiMessage(const snd_seq_event_type messageType, const int sourcePort, const snd_seq_tick_time_t& tick)
 {
 	snd_seq_event_t event = {};
@@ -124,7 +145,7 @@ void MidiQueue::enqueueMidiMessage(const snd_seq_event_type messageType, const i
 	int result = snd_seq_event_output_direct(_sequencer, &event);
 	if (result < 0)
 	{
-		std::cerr << "MidiQueue::enqueueMidiMessage error:" << snd_strerror(result) << std::endl;
+		SMIDI_LOG_ERROR("MidiQueue::enqueueMidiMessage error: %s", snd_strerror(result));
 	}
 }
 
@@ -151,7 +172,7 @@ void MidiQueue::enqueueMidiSyncEvents(const int sourcePort, bool includeMidiStar
 	int result = snd_seq_drain_output(_sequencer);
 	if (result < 0)
 	{
-		std::cerr << "MidiQueue::enqueueMidiSyncEvents error:" << snd_strerror(result) << std::endl;
+		SMIDI_LOG_ERROR("MidiQueue::enqueueMidiSyncEvents error: %s", snd_strerror(result));
 	}
 }
 
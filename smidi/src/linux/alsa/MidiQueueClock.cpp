@@ -0,0 +1,96 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiQueueClock.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiQueueClock.h"
+#include "MidiQueue.h"
+#include "../../../include/smidi/MidiTimestamp.h"
+#include <algorithm>
+#include <limits>
+
+MidiQueueClock::MidiQueueClock()
+    : _offset(0)
+    , _lastCalibrationTime(0)
+    , _isCalibrated(false)
+{
+}
+
+void MidiQueueClock::calibrate(const MidiQueue& queue)
+{
+	long long offset = 0;
+	if (measureOffset(queue, offset))
+	{
+		_offset = offset;
+		_isCalibrated = true;
+	}
+	_lastCalibrationTime = MidiTimestamp::now();
+}
+
+void MidiQueueClock::maintain(const MidiQueue& queue)
+{
+	const unsigned long long now = MidiTimestamp::now();
+	if (!_isCalibrated)
+	{
+		calibrate(queue);
+	}
+	else if (now - _lastCalibrationTime >= kCalibrationIntervalInNanoseconds)
+	{
+		long long offset = 0;
+		if (measureOffset(queue, offset))
+		{
+			// follow the drift slowly, so consecutive timestamps never jump
+			_offset += (offset - _offset) / 8;
+		}
+		_lastCalibrationTime = now;
+	}
+}
+
+bool MidiQueueClock::isCalibrated() const
+{
+	return _isCalibrated;
+}
+
+unsigned long long MidiQueueClock::toTimestamp(const snd_seq_real_time_t& queueTime) const
+{
+	return static_cast<unsigned long long>(toNanoseconds(queueTime) + _offset);
+}
+
+snd_seq_real_time_t MidiQueueClock::toQueueTime(unsigned long long timestamp) const
+{
+	const long long nanoseconds = std::max(static_cast<long long>(timestamp) - _offset, 0LL);
+	snd_seq_real_time_t queueTime = {};
+	queueTime.tv_sec = static_cast<unsigned int>(nanoseconds / 1000000000LL);
+	queueTime.tv_nsec = static_cast<unsigned int>(nanoseconds % 1000000000LL);
+	return queueTime;
+}
+
+bool MidiQueueClock::measureOffset(const MidiQueue& queue, long long& offset) const
+{
+	bool result = false;
+	unsigned long long shortestRoundTrip = std::numeric_limits<unsigned long long>::max();
+	for (int sample = 0; sample < kSamplesPerCalibration; ++sample)
+	{
+		snd_seq_real_time_t queueTime = {};
+		const unsigned long long before = MidiTimestamp::now();
+		const bool queueTimeRead = queue.realTime(queueTime);
+		const unsigned long long after = MidiTimestamp::now();
+		if (queueTimeRead && (after - before) < shortestRoundTrip)
+		{
+			// assume the queue was read in the middle of the round trip
+			shortestRoundTrip = after - before;
+			offset = static_cast<long long>(before + shortestRoundTrip / 2) - toNanoseconds(queueTime);
+			result = true;
+		}
+	}
+	return result;
+}
+
+long long MidiQueueClock::toNanoseconds(const snd_seq_real_time_t& queueTime)
+{
+	return static_cast<long long>(queueTime.tv_sec) * 1000000000LL + queueTime.tv_nsec;
+}
+
+//! \endcond
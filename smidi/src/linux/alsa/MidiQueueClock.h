@@ -0,0 +1,56 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiQueueClock.h
+ * \warning This file is not part of the library public interface!
+ * Contains mapping of ALSA queue real time onto the monotonic clock
+ */
+
+#include <alsa/asoundlib.h>
+
+class MidiQueue;
+
+/*!
+ * \brief The MidiQueueClock class converts ALSA queue real time stamps into MidiTimestamp (monotonic nanoseconds).
+ * \class MidiQueueClock MidiQueueClock.h "MidiQueueClock.h"
+ * \warning This class is not part of the library public interface!
+ *
+ * Queue real time starts with zero when the queue is started, so the offset between queue and monotonic time
+ * is measured by reading both clocks. The queue timer can drift against the monotonic clock, so the offset is
+ * re-measured periodically and smoothed to avoid jumps of the resulting timestamps.
+ */
+
+class MidiQueueClock
+{
+	//! Interval between offset measurements
+	constexpr static unsigned long long kCalibrationIntervalInNanoseconds = 1000000000ULL;
+
+	//! Number of queue reads per measurement, the one with the shortest round trip is used
+	constexpr static int kSamplesPerCalibration = 3;
+
+public:
+	MidiQueueClock();
+
+	void calibrate(const MidiQueue& queue);
+	void maintain(const MidiQueue& queue);
+
+	bool isCalibrated() const;
+	unsigned long long toTimestamp(const snd_seq_real_time_t& queueTime) const;
+
+	//! Inverse of toTimestamp(), timestamps before the queue start give zero queue time
+	snd_seq_real_time_t toQueueTime(unsigned long long timestamp) const;
+
+private:
+	bool measureOffset(const MidiQueue& queue, long long& offset) const;
+
+	static long long toNanoseconds(const snd_seq_real_time_t& queueTime);
+
+private:
+	long long          _offset;
+	unsigned long long _lastCalibrationTime;
+	bool               _isCalibrated;
+};
+
+//! \endcond
@@ -7,17 +7,23 @@
 #include "MidiSyncLinuxImpl.h"
 #include "MidiAlsaConstants.h"
 #include <chrono>
+#include "../../MidiLogging.h"
+#include <cstring>
 #include <pthread.h>
-#include <iostream>
 
 const unsigned int MidiSyncLinux::Implementation::kPPQN = 24;
 
 const std::chrono::microseconds MidiSyncLinux::Implementation::kMicrosecondsInAMinute = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::minutes(1));
 
+const unsigned long long MidiSyncLinux::Implementation::kSpinTimeInNanoseconds = 4000000ULL;
+
 MidiSyncLinux::Implementation::Implementation(MidiOutPortLinux::Implementation& midiOut)
     : _midiOutPort(midiOut)
+    , _clock(MidiClock::system())
+    , _compensator(120.0)
     , _queue()
     , _sourcePort(midiOut.applicationPortId())
+    , _includeMidiStart(true)
     , _bpm(120.0)
     , _threadIsCreated(false)
     , _syncIsStarted(false)
@@ -38,6 +44,8 @@ MidiSyncLinux::Implementation::~Implementation()
 
 void MidiSyncLinux::Implementation::close()
 {
+	// the sync thread uses the queue, so it goes first
+	stopSyncThread();
 	_queue.close();
 }
 
@@ -62,6 +70,10 @@ void MidiSyncLinux::Implementation::resumeSync()
 	if (!_syncIsStarted)
 	{
 		_resume = true;
+		{
+			// the sync thread either checks the flag before waiting or gets the notification
+			std::lock_guard<std::mutex> lock(_pauseMutex);
+		}
 		_resumeCondition.notify_one();
 		_syncIsStarted = true;
 	}
@@ -85,6 +97,11 @@ std::chrono::microseconds MidiSyncLinux::Implementation::syncInitialLatencyForTe
 	return 2 * clockDuration; // MIDI Start and MIDI Sond Position Pointer are sent before first MIDI Clock
 }
 
+MidiSyncMetrics MidiSyncLinux::Implementation::metrics() const
+{
+	return _counters.snapshot();
+}
+
 void* syncThreadFunction(void* param)
 {
 	MidiSyncLinux::Implementation* sync = reinterpret_cast<MidiSyncLinux::Implementation*>(param);
@@ -111,16 +128,20 @@ void MidiSyncLinux::Implementation::startSyncThread()
 			pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
 			pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
 
-			pthread_t threadId;
-			err = pthread_create(&threadId, &attr, syncThreadFunction, reinterpret_cast<void*>(this));
-			if (err != MidiAlsaConstants::kNoError)
+			err = pthread_create(&_thread, &attr, syncThreadFunction, reinterpret_cast<void*>(this));
+			if (err == MidiAlsaConstants::kNoError)
 			{
-				perror("pthread_create");
+				_threadIsCreated = true;
 			}
+			else
+			{
+				SMIDI_LOG_ERROR("Couldn't create MIDI sync thread: %s", std::strerror(err));
+			}
+			pthread_attr_destroy(&attr);
 		}
 		else
 		{
-			perror("pthread_attr_init");
+			SMIDI_LOG_ERROR("Couldn't initialize MIDI sync thread attributes: %s", std::strerror(err));
 		}
 	}
 }
@@ -130,48 +151,55 @@ void MidiSyncLinux::Implementation::stopSyncThread()
 	if (_threadIsCreated)
 	{
 		_exit = true;
+		{
+			// the thread may be paused, waiting for resume
+			std::lock_guard<std::mutex> lock(_pauseMutex);
+		}
+		_resumeCondition.notify_one();
 		pthread_join(_thread, nullptr);
+		_threadIsCreated = false;
 	}
 }
 
-inline void MidiSyncLinux::Implementation::compensateLatency(std::chrono::time_point<std::chrono::high_resolution_clock>& now, std::chrono::time_point<std::chrono::high_resolution_clock>& plannedSendingTime, bool& compensationHappened, std::chrono::microseconds& compensation)
+inline void MidiSyncLinux::Implementation::compensateLatency(unsigned long long now)
 {
-	// here comes jitter/drift compensation tricks (still not almighty)
+	// here comes jitter/drift compensation tricks (still not almighty), see MidiSyncCompensator
+	const MidiSyncCompensator::Beat beat = _compensator.nextBeat(now);
 
-	if (compensationHappened)
+	if (!beat.first)
 	{
-		// we need to reset queue tempo back to normal if compensation has been applied on the previous frame
-		_queue.stop();
-		_queue.setTempo(_bpm);
-		_queue.start();
-		compensationHappened = false;
+		_counters.countPeriod(beat.lateness);
 	}
 
-	if (now > plannedSendingTime)
+	if (beat.sendTime > now)
 	{
-		// "we are late", so we add this value to overall compensation
-		compensation += std::chrono::duration_cast<std::chrono::microseconds>(now - plannedSendingTime);
+		// "we are early" and we will send next beat as planned
+		preciseWaitUntil(beat.sendTime);
 	}
-	else if (now < plannedSendingTime)
+
+	if (beat.tempoChanged)
 	{
-		// "we are early" and we will send next buffer as planned
-		preciseWaitUntil(plannedSendingTime);
-		now = plannedSendingTime;
+		// either a bit faster tempo to catch the phase, or back to normal after that
+		restartQueue(beat.bpm);
 	}
 
-	if (compensation > std::chrono::microseconds(5))
+	if (beat.phaseCorrection != 0)
 	{
-		// calculate new bpm (a bit faster) to catch the phase during next send
-		const std::chrono::microseconds compensatedTimeToSendPackets = std::chrono::microseconds(static_cast<int>(kMicrosecondsInAMinute.count() / _bpm)) - compensation;
-		const double compensatedBpm = static_cast<double>(kMicrosecondsInAMinute.count()) / compensatedTimeToSendPackets.count();
+		_counters.countPhaseCorrection(beat.phaseCorrection);
+	}
+}
 
-		_queue.stop();
-		_queue.setTempo(compensatedBpm);
-		_queue.start();
+bool MidiSyncLinux::Implementation::syncStateChanged() const
+{
+	return (_exit || _pause || _changeBpm || _restart);
+}
 
-		compensationHappened = true;
-		compensation = std::chrono::microseconds(0);
-	}
+bool MidiSyncLinux::Implementation::waitForResume()
+{
+	std::unique_lock<std::mutex> lock(_pauseMutex);
+	_resumeCondition.wait(lock, [this]()->bool { return _resume || _exit; });
+	_resume = false;
+	return !_exit;
 }
 
 void MidiSyncLinux::Implementation::syncThread()
@@ -180,114 +208,110 @@ void MidiSyncLinux::Implementation::syncThread()
 	if (_pause)
 	{
 		_pause = false;
-		std::unique_lock<std::mutex> lock(_pauseMutex);
-		_resumeCondition.wait(lock, [this]{ return _resume.load(); });
-		_resume = false;
+		if (!waitForResume())
+		{
+			return;
+		}
 	}
 
 	// initial setup
-	_queue.setTempo(_bpm);
-	_queue.start();
+	restartQueue(_bpm);
+	_compensator.reset(_bpm);
 
-	std::chrono::time_point<std::chrono::high_resolution_clock> now;
-	std::chrono::time_point<std::chrono::high_resolution_clock> plannedSendingTime;
-	std::chrono::microseconds compensation = std::chrono::microseconds(0);
-	std::chrono::microseconds timeToSendPackets = std::chrono::microseconds(static_cast<int>(kMicrosecondsInAMinute.count() / _bpm));
-
-	const auto syncStateChanged = [this]{ return (_exit || _pause || _changeBpm || _restart); };
-
-	bool inludeMidiStart = true;
-	bool compensationHappened = false;
+	_includeMidiStart = true;
 
 	while (true)
 	{
 		if (!syncStateChanged())
 		{
-			now = std::chrono::high_resolution_clock::now();
+			compensateLatency(_clock->now());
 
-			if (plannedSendingTime == std::chrono::time_point<std::chrono::high_resolution_clock>())
-			{
-				// either initial cycle or reset was made -> reset
-				plannedSendingTime = now;
-			}
-			else
+			// filling the queue with MIDI messages, since queue is started it will start sending immediately
 			{
-				compensateLatency(now, plannedSendingTime, compensationHappened, compensation);
+				std::lock_guard<std::mutex> lock(_midiOutPort.outputMutex());
+				_queue.enqueueMidiSyncEvents(_sourcePort, _includeMidiStart, _includeMidiStart, kPPQN);
 			}
-
-			// next planned sending time
-			plannedSendingTime += timeToSendPackets;
-
-			// filling the queue with MIDI messages, since queue is started it will start sending immediately
-			_queue.enqueueMidiSyncEvents(_sourcePort, inludeMidiStart, inludeMidiStart, kPPQN);
+			_includeMidiStart = false;
 		}
 		else
 		{
 			if (_pause)
 			{
 				_pause = false;
-				_queue.stop();
-
-				std::unique_lock<std::mutex> lock(_pauseMutex);
-				_resumeCondition.wait(lock, [this]()->bool { return _resume; });
-				_resume = false;
-
-				inludeMidiStart = true;
-
-				_queue.start();
+				stopQueue();
+
+				// notes played along with the clock would hang on the stopped devices
+				if (_midiOutPort.isNoteTrackingEnabled())
+				{
+					_midiOutPort.releaseNotes();
+				}
+
+				if (!waitForResume())
+				{
+					break;
+				}
+
+				// the phase of the previous run means nothing after the pause
+				_includeMidiStart = true;
+				restartQueue(_bpm);
+				_compensator.reset(_bpm);
 				continue;
 			}
 
 			if (_exit)
 			{
-				_queue.stop();
+				stopQueue();
 				break;
 			}
 
 			if (_changeBpm)
 			{
 				_changeBpm = false;
-				_queue.stop();
-				_queue.setTempo(_bpm);
-
-				timeToSendPackets = std::chrono::microseconds(static_cast<int>(kMicrosecondsInAMinute.count() / _bpm));
-				plannedSendingTime = std::chrono::time_point<std::chrono::high_resolution_clock>();
-
-				_queue.start();
+				restartQueue(_bpm);
+				_compensator.reset(_bpm);
 				continue;
 			}
 
 			if (_restart)
 			{
 				_restart = false;
-				_queue.stop();
-
-				inludeMidiStart = true;
-
-				plannedSendingTime = std::chrono::time_point<std::chrono::high_resolution_clock>();
-
-				_queue.start();
+				_includeMidiStart = true;
+				restartQueue(_bpm);
+				_compensator.reset(_bpm);
 				continue;
 			}
 		}
 
-		if (inludeMidiStart)
-		{
-			inludeMidiStart = false;
-		}
-
-		preciseWaitUntil(plannedSendingTime);
+		preciseWaitUntil(_compensator.plannedTime());
 	}
 }
 
-void MidiSyncLinux::Implementation::preciseWaitUntil(const std::chrono::time_point<std::chrono::high_resolution_clock>& timePoint)
+void MidiSyncLinux::Implementation::stopQueue()
 {
-	const std::chrono::milliseconds spinTime(4);
-	const std::chrono::time_point<std::chrono::high_resolution_clock> timePointWithoutSpinTime = timePoint - spinTime;
+	// the queue events go through the output buffer of the port's sequencer client
+	std::lock_guard<std::mutex> lock(_midiOutPort.outputMutex());
+	_queue.stop();
+}
 
-	std::this_thread::sleep_until(timePointWithoutSpinTime);
+void MidiSyncLinux::Implementation::restartQueue(double bpm)
+{
+	std::lock_guard<std::mutex> lock(_midiOutPort.outputMutex());
+	_queue.stop();
+	_queue.setTempo(bpm);
+	_queue.start();
+}
+
+void MidiSyncLinux::Implementation::preciseWaitUntil(unsigned long long time)
+{
+	// waking up from sleep is too coarse, so the last few milliseconds are spun
+	const unsigned long long sleepTime = (time > kSpinTimeInNanoseconds) ? time - kSpinTimeInNanoseconds : time;
+
+	while (_clock->now() < sleepTime && !syncStateChanged())
+	{
+		_clock->sleepUntil(sleepTime);
+	}
 
-	while (std::chrono::high_resolution_clock::now() < timePoint); //spin
+	while (_clock->now() < time && !syncStateChanged()); //spin
 }
 
 //! \endcond
@@ -10,6 +10,9 @@
 #include "../MidiSyncLinux.h"
 #include "MidiOutPortLinuxImpl.h"
 #include "MidiQueue.h"
+#include "../../MidiMetricsCounters.h"
+#include "../../MidiSyncCompensator.h"
+#include "../../../include/smidi/MidiClock.h"
 #include <thread>
 #include <atomic>
 #include <mutex>
@@ -18,17 +21,22 @@
 /*!
  * \brief The MidiSync::Implementation class
  * \warning This class is not a part of library public interface!
+ *
+ * The sync thread queues one beat of MIDI Clocks on the sequencer queue and sleeps on the system MidiClock until
+ * the next beat, MidiSyncCompensator decides when and at which tempo. The queue runs in real time, so the thread
+ * does too.
  */
 
 class MidiSyncLinux::Implementation
 {
 	static const unsigned int kPPQN;
 	static const std::chrono::microseconds kMicrosecondsInAMinute;
+	static const unsigned long long kSpinTimeInNanoseconds;
 
 	friend void* syncThreadFunction(void*);
 
 public:
-	Implementation(MidiOutPortLinux::Implementation& midiOut);
+	explicit Implementation(MidiOutPortLinux::Implementation& midiOut);
 	~Implementation();
 
 	void close();
@@ -39,34 +47,45 @@ public:
 	void changeSyncBpm(double bpm);
 	bool isSyncStarted() const;
 	std::chrono::microseconds syncInitialLatencyForTempo(double bpm) const;
+	MidiSyncMetrics metrics() const;
 
 private:
 	void startSyncThread();
 	void stopSyncThread();
-	void compensateLatency(std::chrono::time_point<std::chrono::high_resolution_clock>& now, std::chrono::time_point<std::chrono::high_resolution_clock>& plannedSendingTime, bool& compensationHappened, std::chrono::microseconds& compensation);
+	void compensateLatency(unsigned long long now);
 	void syncThread();
+	bool syncStateChanged() const;
+	bool waitForResume();
+	void stopQueue();
+	void restartQueue(double bpm);
 
-	static void preciseWaitUntil(const std::chrono::time_point<std::chrono::high_resolution_clock>& timePoint);
+	void preciseWaitUntil(unsigned long long time);
 
 private:
 	MidiOutPortLinux::Implementation& _midiOutPort;
 
-	MidiQueue               _queue;
-	std::atomic<int>        _sourcePort;
-	double                  _bpm;
+	std::shared_ptr<MidiClock> _clock;
+	MidiSyncCompensator        _compensator;
 
-	pthread_t               _thread;
-	bool                    _threadIsCreated;
-	bool                    _syncIsStarted;
+	MidiQueue                  _queue;
+	std::atomic<int>           _sourcePort;
+	bool                       _includeMidiStart;
+	double                     _bpm;
 
-	std::atomic<bool>       _pause;
-	std::atomic<bool>       _resume;
-	std::atomic<bool>       _changeBpm;
-	std::atomic<bool>       _restart;
-	std::atomic<bool>       _exit;
+	pthread_t                  _thread;
+	bool                       _threadIsCreated;
+	bool                       _syncIsStarted;
 
-	std::mutex              _pauseMutex;
-	std::condition_variable _resumeCondition;
+	std::atomic<bool>          _pause;
+	std::atomic<bool>          _resume;
+	std::atomic<bool>          _changeBpm;
+	std::atomic<bool>          _restart;
+	std::atomic<bool>          _exit;
+
+	std::mutex                 _pauseMutex;
+	std::condition_variable    _resumeCondition;
+
+	MidiSyncCounters           _counters;
 };
 
 //! \endcond
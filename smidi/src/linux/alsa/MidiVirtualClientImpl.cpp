@@ -0,0 +1,502 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiVirtualClientImpl.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiVirtualClientImpl.h"
+#include "MidiVirtualPorts.h"
+#include "MidiOutPortLinuxImpl.h"
+#include "MidiAlsaConstants.h"
+#include "../../MidiLogging.h"
+#include "../../../include/smidi/MidiTimestamp.h"
+#include <algorithm>
+#include <unistd.h>
+
+MidiVirtualClient::Implementation::Implementation(const std::string& name)
+	: _name(name)
+	, _sequencer(nullptr)
+	, _clientId(MidiAlsaConstants::kInvalidId)
+	, _pipefd{MidiAlsaConstants::kInvalidId, MidiAlsaConstants::kInvalidId}
+	, _pollDescriptor(MidiAlsaConstants::kInvalidId)
+	, _dispatchMode(MidiInPort::DispatchMode::InputThread)
+	, _poll(false)
+{
+	const int error = snd_seq_open(&_sequencer, "default", SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK);
+	if (MidiAlsaConstants::kNoError == error)
+	{
+		snd_seq_set_client_name(_sequencer, _name.c_str());
+		_clientId = snd_seq_client_id(_sequencer);
+
+		if (MidiAlsaConstants::kNoError == pipe(_pipefd))
+		{
+			// incoming events of all input ports are stamped with the real time of this queue
+			_queue.init(_sequencer, _name + " Input Queue");
+			_queue.setTempo(1200.0); // some random high tempo
+			_queue.start();
+			_queueClock.calibrate(_queue);
+
+			pollfd descriptor = {};
+			if (snd_seq_poll_descriptors(_sequencer, &descriptor, 1, POLLIN) == 1)
+			{
+				_pollDescriptor = descriptor.fd;
+			}
+		}
+		else
+		{
+			SMIDI_LOG_ERROR("Couldn't create pipe for %s", _name.c_str());
+		}
+	}
+	else
+	{
+		SMIDI_LOG_ERROR("Couldn't open ALSA sequencer client %s because: %s", _name.c_str(), snd_strerror(error));
+		_sequencer = nullptr;
+	}
+}
+
+MidiVirtualClient::Implementation::~Implementation()
+{
+	stopInputThread();
+
+	if (_sequencer)
+	{
+		_queue.stop();
+	}
+
+	// close pipe
+	if (_pipefd[0] != MidiAlsaConstants::kInvalidId)
+	{
+		::close(_pipefd[0]);
+	}
+	if (_pipefd[1] != MidiAlsaConstants::kInvalidId)
+	{
+		::close(_pipefd[1]);
+	}
+
+	if (_sequencer)
+	{
+		snd_seq_close(_sequencer);
+	}
+}
+
+bool MidiVirtualClient::Implementation::isValid() const
+{
+	return _sequencer != nullptr;
+}
+
+const std::string& MidiVirtualClient::Implementation::name() const
+{
+	return _name;
+}
+
+std::string MidiVirtualClient::Implementation::address(const MidiPort& port) const
+{
+	std::string result;
+	PortEntry entry = {};
+	if (findPort(port, entry))
+	{
+		result = std::to_string(_clientId) + ":" + std::to_string(entry.portId);
+	}
+	return result;
+}
+
+std::shared_ptr<MidiInPort> MidiVirtualClient::Implementation::createInputPort(const std::string& name, unsigned int capabilities)
+{
+	std::shared_ptr<MidiInPort> result;
+	if (_sequencer)
+	{
+		snd_seq_port_info_t* portInfo = nullptr;
+		snd_seq_port_info_alloca(&portInfo);
+		snd_seq_port_info_set_capability(portInfo, alsaCapabilities(true, capabilities));
+		snd_seq_port_info_set_type(portInfo, SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+		snd_seq_port_info_set_midi_channels(portInfo, 16);
+		snd_seq_port_info_set_timestamping(portInfo, 1);
+		snd_seq_port_info_set_timestamp_real(portInfo, 1);
+		snd_seq_port_info_set_timestamp_queue(portInfo, _queue);
+		snd_seq_port_info_set_name(portInfo, name.c_str());
+
+		const int error = snd_seq_create_port(_sequencer, portInfo);
+		if (MidiAlsaConstants::kNoError == error)
+		{
+			const int portId = snd_seq_port_info_get_port(portInfo);
+			std::shared_ptr<MidiVirtualInPort> port = std::make_shared<MidiVirtualInPort>(*this, name, portId);
+			{
+				std::lock_guard<std::mutex> lock(_portsMutex);
+				_ports[port.get()] = PortEntry{portId, true};
+				_inputPorts[portId] = port;
+			}
+
+			if (_dispatchMode.load() == MidiInPort::DispatchMode::InputThread && !startInputThread())
+			{
+				SMIDI_LOG_ERROR("Couldn't start midi input thread: %s", _name.c_str());
+			}
+			result = port;
+		}
+		else
+		{
+			SMIDI_LOG_ERROR("Couldn't create virtual input port %s of %s because: %s", name.c_str(), _name.c_str(), snd_strerror(error));
+		}
+	}
+	return result;
+}
+
+std::shared_ptr<MidiOutPort> MidiVirtualClient::Implementation::createOutputPort(const std::string& name, unsigned int capabilities)
+{
+	std::shared_ptr<MidiOutPort> result;
+	if (_sequencer)
+	{
+		std::unique_ptr<MidiOutPortLinux::Implementation> impl(new MidiOutPortLinux::Implementation(name, _sequencer, _outputMutex, alsaCapabilities(false, capabilities)));
+		MidiOutPortLinux::Implementation& portImpl = *impl;
+
+		std::shared_ptr<MidiVirtualOutPort> port = std::make_shared<MidiVirtualOutPort>(*this, std::move(impl));
+		if (portImpl.isOpen())
+		{
+			std::lock_guard<std::mutex> lock(_portsMutex);
+			_ports[port.get()] = PortEntry{portImpl.applicationPortId(), false};
+			result = port;
+		}
+	}
+	return result;
+}
+
+bool MidiVirtualClient::Implementation::setCapabilities(const MidiPort& port, unsigned int capabilities)
+{
+	bool result = false;
+	PortEntry entry = {};
+	if (findPort(port, entry))
+	{
+		snd_seq_port_info_t* portInfo = nullptr;
+		snd_seq_port_info_alloca(&portInfo);
+		int error = snd_seq_get_port_info(_sequencer, entry.portId, portInfo);
+		if (MidiAlsaConstants::kNoError == error)
+		{
+			snd_seq_port_info_set_capability(portInfo, alsaCapabilities(entry.isInput, capabilities));
+			error = snd_seq_set_port_info(_sequencer, entry.portId, portInfo);
+		}
+		result = (MidiAlsaConstants::kNoError == error);
+		if (!result)
+		{
+			SMIDI_LOG_ERROR("Couldn't change capabilities of %s because: %s", port.name().c_str(), snd_strerror(error));
+		}
+	}
+	return result;
+}
+
+bool MidiVirtualClient::Implementation::connect(const MidiPort& port, const std::string& address)
+{
+	bool result = false;
+	PortEntry entry = {};
+	snd_seq_addr_t other = {};
+	if (findPort(port, entry))
+	{
+		int error = snd_seq_parse_address(_sequencer, &other, address.c_str());
+		if (MidiAlsaConstants::kNoError == error)
+		{
+			error = entry.isInput ? snd_seq_connect_from(_sequencer, entry.portId, other.client, other.port)
+			                      : snd_seq_connect_to(_sequencer, entry.portId, other.client, other.port);
+		}
+		result = (MidiAlsaConstants::kNoError == error);
+		if (!result)
+		{
+			SMIDI_LOG_ERROR("Couldn't connect %s to %s because: %s", port.name().c_str(), address.c_str(), snd_strerror(error));
+		}
+	}
+	return result;
+}
+
+bool MidiVirtualClient::Implementation::disconnect(const MidiPort& port, const std::string& address)
+{
+	bool result = false;
+	PortEntry entry = {};
+	snd_seq_addr_t other = {};
+	if (findPort(port, entry))
+	{
+		int error = snd_seq_parse_address(_sequencer, &other, address.c_str());
+		if (MidiAlsaConstants::kNoError == error)
+		{
+			error = entry.isInput ? snd_seq_disconnect_from(_sequencer, entry.portId, other.client, other.port)
+			                      : snd_seq_disconnect_to(_sequencer, entry.portId, other.client, other.port);
+		}
+		result = (MidiAlsaConstants::kNoError == error);
+		if (!result)
+		{
+			SMIDI_LOG_WARNING("Couldn't disconnect %s from %s because: %s", port.name().c_str(), address.c_str(), snd_strerror(error));
+		}
+	}
+	return result;
+}
+
+std::list<std::string> MidiVirtualClient::Implementation::connections(const MidiPort& port) const
+{
+	std::list<std::string> result;
+	PortEntry entry = {};
+	if (findPort(port, entry))
+	{
+		const snd_seq_addr_t root = {static_cast<unsigned char>(_clientId), static_cast<unsigned char>(entry.portId)};
+
+		snd_seq_query_subscribe_t* query = nullptr;
+		snd_seq_query_subscribe_alloca(&query);
+		snd_seq_query_subscribe_set_root(query, &root);
+		// input port is written to by its connections, output port is read from
+		snd_seq_query_subscribe_set_type(query, entry.isInput ? SND_SEQ_QUERY_SUBS_WRITE : SND_SEQ_QUERY_SUBS_READ);
+		snd_seq_query_subscribe_set_index(query, 0);
+		while (snd_seq_query_port_subscribers(_sequencer, query) >= 0)
+		{
+			const snd_seq_addr_t* other = snd_seq_query_subscribe_get_addr(query);
+			result.push_back(std::to_string(other->client) + ":" + std::to_string(other->port));
+			snd_seq_query_subscribe_set_index(query, snd_seq_query_subscribe_get_index(query) + 1);
+		}
+	}
+	return result;
+}
+
+void MidiVirtualClient::Implementation::removePort(const MidiPort& port)
+{
+	std::lock_guard<std::mutex> lock(_portsMutex);
+	const auto i = _ports.find(&port);
+	if (i != std::end(_ports))
+	{
+		if (i->second.isInput)
+		{
+			_inputPorts.erase(i->second.portId);
+			snd_seq_delete_port(_sequencer, i->second.portId);
+		}
+		_ports.erase(i);
+	}
+}
+
+void MidiVirtualClient::Implementation::setDispatchMode(MidiInPort::DispatchMode mode)
+{
+	if (mode != _dispatchMode.exchange(mode))
+	{
+		if (mode == MidiInPort::DispatchMode::InputThread)
+		{
+			if (!startInputThread())
+			{
+				SMIDI_LOG_ERROR("Couldn't start midi input thread: %s", _name.c_str());
+			}
+		}
+		else
+		{
+			stopInputThread();
+		}
+	}
+}
+
+MidiInPort::DispatchMode MidiVirtualClient::Implementation::dispatchMode() const
+{
+	return _dispatchMode.load();
+}
+
+int MidiVirtualClient::Implementation::pollDescriptor() const
+{
+	return _pollDescriptor;
+}
+
+std::size_t MidiVirtualClient::Implementation::processPending()
+{
+	std::size_t result = 0;
+	if (_sequencer && _dispatchMode.load() == MidiInPort::DispatchMode::CallerThread)
+	{
+		result = processPendingEvents();
+		completeExpiredWaiters(false);
+	}
+	return result;
+}
+
+void MidiVirtualClient::Implementation::wakeUpInputThread()
+{
+	if (_poll)
+	{
+		unsigned char wakeUp = 1;
+		::write(_pipefd[1], &wakeUp, sizeof(wakeUp));
+	}
+}
+
+unsigned int MidiVirtualClient::Implementation::alsaCapabilities(bool isInput, unsigned int capabilities)
+{
+	unsigned int result = isInput ? SND_SEQ_PORT_CAP_WRITE : SND_SEQ_PORT_CAP_READ;
+	if (capabilities & MidiVirtualClient::Subscribable)
+	{
+		result |= isInput ? SND_SEQ_PORT_CAP_SUBS_WRITE : SND_SEQ_PORT_CAP_SUBS_READ;
+	}
+	if (capabilities & MidiVirtualClient::Hidden)
+	{
+		result |= SND_SEQ_PORT_CAP_NO_EXPORT;
+	}
+	return result;
+}
+
+bool MidiVirtualClient::Implementation::findPort(const MidiPort& port, PortEntry& entry) const
+{
+	std::lock_guard<std::mutex> lock(_portsMutex);
+	const auto i = _ports.find(&port);
+	const bool result = (i != std::end(_ports));
+	if (result)
+	{
+		entry = i->second;
+	}
+	else
+	{
+		SMIDI_LOG_WARNING("Port %s doesn't belong to %s", port.name().c_str(), _name.c_str());
+	}
+	return result;
+}
+
+std::shared_ptr<MidiVirtualInPort> MidiVirtualClient::Implementation::findInputPort(int portId) const
+{
+	std::shared_ptr<MidiVirtualInPort> result;
+	std::lock_guard<std::mutex> lock(_portsMutex);
+	const auto i = _inputPorts.find(portId);
+	if (i != std::end(_inputPorts))
+	{
+		// empty if the port is being destroyed and waits for the lock in removePort()
+		result = i->second.lock();
+	}
+	return result;
+}
+
+void MidiVirtualClient::Implementation::copyInputPorts(std::vector<std::shared_ptr<MidiVirtualInPort>>& ports) const
+{
+	std::lock_guard<std::mutex> lock(_portsMutex);
+	for (const auto& port : _inputPorts)
+	{
+		std::shared_ptr<MidiVirtualInPort> livePort = port.second.lock();
+		if (livePort)
+		{
+			ports.push_back(std::move(livePort));
+		}
+	}
+}
+
+bool MidiVirtualClient::Implementation::startInputThread()
+{
+	if (!_poll && _sequencer)
+	{
+		// set the flag to poll input event
+		_poll = true;
+
+		_thread = std::thread(&Implementation::midiInputThread, this);
+		if (!_thread.joinable())
+		{
+			_poll = false;
+		}
+	}
+	return _poll;
+}
+
+void MidiVirtualClient::Implementation::stopInputThread()
+{
+	if (_poll)
+	{
+		_poll = false;
+		wakeUpInputThread();
+		_thread.join();
+	}
+}
+
+std::size_t MidiVirtualClient::Implementation::processPendingEvents()
+{
+	std::size_t numberOfDispatchedMessages = 0;
+
+	_queueClock.maintain(_queue);
+
+	const int checkSequencerFIFO = 1;
+	while (snd_seq_event_input_pending(_sequencer, checkSequencerFIFO) > 0)
+	{
+		snd_seq_event_t* event = nullptr;
+		const int resultOrError = snd_seq_event_input(_sequencer, &event);
+		if (resultOrError >= MidiAlsaConstants::kNoError)
+		{
+			const unsigned long long timestamp = eventTimestamp(event);
+
+			// the reference keeps the port alive while its handlers run, the ports lock isn't held by then
+			std::shared_ptr<MidiVirtualInPort> port = findInputPort(event->dest.port);
+			if (port && port->deliver(event, timestamp))
+			{
+				++numberOfDispatchedMessages;
+			}
+			snd_seq_free_event(event);
+		}
+		else if (resultOrError == -ENOSPC)
+		{
+			// input buffer overrun, some events are lost
+			SMIDI_LOG_ERROR("Input buffer overrun in %s", _name.c_str());
+		}
+		else
+		{
+			break;
+		}
+	}
+	return numberOfDispatchedMessages;
+}
+
+void MidiVirtualClient::Implementation::completeExpiredWaiters(bool completeAll)
+{
+	// the storage is reused, a completion which processes pending input again gets a new one
+	std::vector<std::shared_ptr<MidiVirtualInPort>> ports;
+	ports.swap(_inputPortsCopy);
+	copyInputPorts(ports);
+	for (const std::shared_ptr<MidiVirtualInPort>& port : ports)
+	{
+		port->waiters().completeExpired(completeAll);
+	}
+	// may destroy the ports released by the completions, so it's done without the ports lock too
+	ports.clear();
+	ports.swap(_inputPortsCopy);
+}
+
+int MidiVirtualClient::Implementation::timeoutToNextDeadline()
+{
+	int result = -1; // infinite
+	std::vector<std::shared_ptr<MidiVirtualInPort>> ports;
+	ports.swap(_inputPortsCopy);
+	copyInputPorts(ports);
+	for (const std::shared_ptr<MidiVirtualInPort>& port : ports)
+	{
+		const int timeout = port->waiters().timeoutToNextDeadline();
+		if (timeout >= 0)
+		{
+			result = (result < 0) ? timeout : std::min(result, timeout);
+		}
+	}
+	ports.clear();
+	ports.swap(_inputPortsCopy);
+	return result;
+}
+
+unsigned long long MidiVirtualClient::Implementation::eventTimestamp(const snd_seq_event_t* event) const
+{
+	// events are stamped by the kernel on arrival with the real time of our input queue
+	const bool stampedByQueue = ((event->flags & SND_SEQ_TIME_STAMP_MASK) == SND_SEQ_TIME_STAMP_REAL) && (event->queue == _queue);
+	return (stampedByQueue && _queueClock.isCalibrated()) ? _queueClock.toTimestamp(event->time.time) : MidiTimestamp::now();
+}
+
+void MidiVirtualClient::Implementation::midiInputThread()
+{
+	// note: we add 1 custom descriptor to force the poll() call to return
+	pollfd pollDescriptors[2] = {};
+	pollDescriptors[0].fd = _pollDescriptor;
+	pollDescriptors[0].events = POLLIN;
+	pollDescriptors[1].fd = _pipefd[0];
+	pollDescriptors[1].events = POLLIN;
+
+	while (_poll)
+	{
+		processPendingEvents();
+		completeExpiredWaiters(false);
+
+		if (poll(pollDescriptors, 2, timeoutToNextDeadline()) >= 0)
+		{
+			// check if the polled one is our custom descriptor
+			if ((pollDescriptors[1].revents & POLLIN) == POLLIN)
+			{
+				unsigned char data;
+				::read(pollDescriptors[1].fd, &data, sizeof(data));
+			}
+		}
+	}
+}
+
+//! \endcond
@@ -0,0 +1,102 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiVirtualClientImpl.h
+ * \warning This file is not a part of library public interface!
+ * Contains ALSA sequencer implementation of MidiVirtualClient
+ */
+
+#include "../../../include/smidi/MidiVirtualClient.h"
+#include "../../../include/smidi/MidiInPort.h"
+#include "MidiQueue.h"
+#include "MidiQueueClock.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <alsa/asoundlib.h>
+
+class MidiVirtualInPort;
+
+/*!
+ * \brief The MidiVirtualClient::Implementation class owns the sequencer client of the virtual ports
+ * \warning This class is not a part of library public interface!
+ *
+ * Output ports write to the client directly (serialized with the output mutex). Input of all ports is read
+ * by one input thread (or by processPending() of any port) and delivered to the port by the event destination.
+ * Input ports are kept as weak references: the port an event goes to is locked and copied out under the ports
+ * lock, and handlers and completions run after it's released, so they may use the client, create ports and drop
+ * the last reference to a port (which is then destroyed on the dispatching thread).
+ */
+class MidiVirtualClient::Implementation
+{
+public:
+	explicit Implementation(const std::string& name);
+	~Implementation();
+
+	bool isValid() const;
+	const std::string& name() const;
+	std::string address(const MidiPort& port) const;
+
+	std::shared_ptr<MidiInPort> createInputPort(const std::string& name, unsigned int capabilities);
+	std::shared_ptr<MidiOutPort> createOutputPort(const std::string& name, unsigned int capabilities);
+	bool setCapabilities(const MidiPort& port, unsigned int capabilities);
+
+	bool connect(const MidiPort& port, const std::string& address);
+	bool disconnect(const MidiPort& port, const std::string& address);
+	std::list<std::string> connections(const MidiPort& port) const;
+
+	// used by the ports
+	void removePort(const MidiPort& port);
+	void setDispatchMode(MidiInPort::DispatchMode mode);
+	MidiInPort::DispatchMode dispatchMode() const;
+	int pollDescriptor() const;
+	std::size_t processPending();
+	void wakeUpInputThread();
+
+private:
+	struct PortEntry
+	{
+		int  portId;
+		bool isInput;
+	};
+
+	static unsigned int alsaCapabilities(bool isInput, unsigned int capabilities);
+
+	bool findPort(const MidiPort& port, PortEntry& entry) const;
+	std::shared_ptr<MidiVirtualInPort> findInputPort(int portId) const;
+
+	//! Appends the live input ports, the references must be released without the ports lock
+	void copyInputPorts(std::vector<std::shared_ptr<MidiVirtualInPort>>& ports) const;
+
+	bool startInputThread();
+	void stopInputThread();
+	std::size_t processPendingEvents();
+	void completeExpiredWaiters(bool completeAll);
+	int timeoutToNextDeadline();
+	unsigned long long eventTimestamp(const snd_seq_event_t* event) const;
+	void midiInputThread();
+
+private:
+	std::string                                     _name;
+	snd_seq_t*                                      _sequencer;
+	int                                             _clientId;
+	MidiQueue                                       _queue;
+	MidiQueueClock                                  _queueClock;
+	std::mutex                                      _outputMutex;
+	mutable std::mutex                              _portsMutex;
+	std::map<const MidiPort*, PortEntry>            _ports;
+	std::map<int, std::weak_ptr<MidiVirtualInPort>> _inputPorts;
+	std::vector<std::shared_ptr<MidiVirtualInPort>> _inputPortsCopy; // storage reused by the dispatching thread
+	std::thread                                     _thread;
+	int                                             _pipefd[2];
+	int                                             _pollDescriptor;
+	std::atomic<MidiInPort::DispatchMode>           _dispatchMode; // set by the application, read by the input thread
+	std::atomic<bool>                               _poll;
+};
+
+//! \endcond
@@ -0,0 +1,156 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiVirtualPorts.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiVirtualPorts.h"
+#include "MidiVirtualClientImpl.h"
+#include "MidiOutPortLinuxImpl.h"
+#include "../../../include/smidi/MidiTimestamp.h"
+
+MidiVirtualInPort::MidiVirtualInPort(MidiVirtualClient::Implementation& client, const std::string& name, int portId)
+	: _client(client)
+	, _name(name)
+	, _portId(portId)
+	, _decoder(0)
+{
+	_decoder.setRunningStatusEnabled(false);
+}
+
+MidiVirtualInPort::~MidiVirtualInPort()
+{
+	// the client doesn't deliver to the port after this call
+	_client.removePort(*this);
+
+	// nothing will be received anymore
+	_waiters.completeExpired(true);
+}
+
+int MidiVirtualInPort::portId() const
+{
+	return _portId;
+}
+
+bool MidiVirtualInPort::deliver(snd_seq_event_t* event, unsigned long long timestamp)
+{
+	bool result = false;
+	const bool isSubscriptionEvent = (event->type == SND_SEQ_EVENT_PORT_SUBSCRIBED || event->type == SND_SEQ_EVENT_PORT_UNSUBSCRIBED);
+	if (_decoder.decode(event, _decodedMessage))
+	{
+		// split SysEx keeps the arrival time of its first part
+		if (_message.isEmpty())
+		{
+			_message.setTimestamp(timestamp);
+		}
+		_message += _decodedMessage;
+	}
+	else if (!isSubscriptionEvent)
+	{
+		_counters.countDecodeFailure();
+	}
+
+	// SysEx can be split by the driver into several events, so it's dispatched only when complete
+	const bool partialSysEx = !_message.isEmpty() && _message.data().front() == MidiMessage::SysEx && !_message.isCompleteSysEx();
+	if (!partialSysEx && !_message.isEmpty())
+	{
+		_counters.countMessage(_message);
+		// a timestamp mapped from the queue time may be a bit ahead of the clock
+		const unsigned long long now = MidiTimestamp::now();
+		_counters.countLatency(now > _message.timestamp() ? now - _message.timestamp() : 0);
+
+		// waiters take the message first, suspended coroutines are resumed right from here
+		const bool waiterCompleted = !_waiters.isEmpty() && _waiters.complete(_message);
+		result = waiterCompleted || _dispatcher.dispatch(_message);
+		_message.resizeBuffer(0);
+	}
+	return result;
+}
+
+MidiMessageWaiterList& MidiVirtualInPort::waiters()
+{
+	return _waiters;
+}
+
+const std::string& MidiVirtualInPort::name() const
+{
+	return _name;
+}
+
+void MidiVirtualInPort::start()
+{
+}
+
+void MidiVirtualInPort::stop()
+{
+}
+
+MidiPortMetrics MidiVirtualInPort::metrics() const
+{
+	return _counters.snapshot();
+}
+
+void MidiVirtualInPort::setMessageHandler(MessageHandler handler)
+{
+	_dispatcher.setHandler(handler);
+}
+
+void MidiVirtualInPort::setMessageHandler(MidiMessage::Type type, MessageHandler handler)
+{
+	_dispatcher.setHandler(type, handler);
+}
+
+void MidiVirtualInPort::resetMessageHandlers()
+{
+	_dispatcher.resetHandlers();
+}
+
+void MidiVirtualInPort::setDispatchMode(DispatchMode mode)
+{
+	_client.setDispatchMode(mode);
+}
+
+MidiInPort::DispatchMode MidiVirtualInPort::dispatchMode() const
+{
+	return _client.dispatchMode();
+}
+
+int MidiVirtualInPort::pollDescriptor() const
+{
+	return _client.pollDescriptor();
+}
+
+std::size_t MidiVirtualInPort::processPending()
+{
+	return _client.processPending();
+}
+
+void MidiVirtualInPort::addWaiter(MidiMessageWaiter& waiter)
+{
+	_waiters.add(waiter);
+
+	// input thread should recalculate its poll timeout
+	if (waiter.deadline != MidiMessageWaiter::Clock::time_point::max())
+	{
+		_client.wakeUpInputThread();
+	}
+}
+
+bool MidiVirtualInPort::removeWaiter(MidiMessageWaiter& waiter)
+{
+	return _waiters.remove(waiter);
+}
+
+MidiVirtualOutPort::MidiVirtualOutPort(MidiVirtualClient::Implementation& client, std::unique_ptr<MidiOutPortLinux::Implementation>&& implementation)
+	: MidiOutPortLinux(std::move(implementation))
+	, _client(client)
+{
+}
+
+MidiVirtualOutPort::~MidiVirtualOutPort()
+{
+	_client.removePort(*this);
+}
+
+//! \endcond
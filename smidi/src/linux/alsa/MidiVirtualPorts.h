@@ -0,0 +1,89 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiVirtualPorts.h
+ * \warning This file is not a part of library public interface!
+ * Contains ports created by MidiVirtualClient
+ */
+
+#include "../MidiOutPortLinux.h"
+#include "MidiEventEncoder.h"
+#include "../../MidiMetricsCounters.h"
+#include "../../MidiMessageWaiterList.h"
+#include "../../../include/smidi/MidiInPort.h"
+#include "../../../include/smidi/MidiVirtualClient.h"
+#include "../../../include/smidi/MidiMessageDispatcher.h"
+#include <alsa/asoundlib.h>
+
+/*!
+ * \brief The MidiVirtualInPort class is the input port of MidiVirtualClient
+ * \class MidiVirtualInPort MidiVirtualPorts.h "MidiVirtualPorts.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Events are read by the client (all its ports share one sequencer client) and delivered to the port
+ * they were addressed to, the port decodes them and passes to waiters and handlers.
+ */
+class MidiVirtualInPort : public MidiInPort
+{
+public:
+	MidiVirtualInPort(MidiVirtualClient::Implementation& client, const std::string& name, int portId);
+	virtual ~MidiVirtualInPort();
+
+	int portId() const;
+
+	//! Decodes the event and dispatches complete message, returns `true` if the message was dispatched
+	bool deliver(snd_seq_event_t* event, unsigned long long timestamp);
+
+	MidiMessageWaiterList& waiters();
+
+	virtual const std::string& name() const override;
+
+	virtual void start() override;
+	virtual void stop() override;
+
+	virtual MidiPortMetrics metrics() const override;
+
+	virtual void setMessageHandler(MessageHandler handler) override;
+	virtual void setMessageHandler(MidiMessage::Type type, MessageHandler handler) override;
+	virtual void resetMessageHandlers() override;
+
+	virtual void setDispatchMode(DispatchMode mode) override;
+	virtual DispatchMode dispatchMode() const override;
+	virtual int pollDescriptor() const override;
+	virtual std::size_t processPending() override;
+
+	virtual void addWaiter(MidiMessageWaiter& waiter) override;
+	virtual bool removeWaiter(MidiMessageWaiter& waiter) override;
+
+private:
+	MidiVirtualClient::Implementation& _client;
+	std::string                        _name;
+	int                                _portId;
+	MidiMessageDispatcher              _dispatcher;
+	MidiEventEncoder                   _decoder;
+	MidiMessage                        _message;
+	MidiMessage                        _decodedMessage;
+	MidiPortCounters                   _counters;
+	MidiMessageWaiterList              _waiters;
+};
+
+/*!
+ * \brief The MidiVirtualOutPort class is the output port of MidiVirtualClient
+ * \class MidiVirtualOutPort MidiVirtualPorts.h "MidiVirtualPorts.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Regular sequencer output port working on the shared client, it only unregisters itself from the client.
+ */
+class MidiVirtualOutPort : public MidiOutPortLinux
+{
+public:
+	MidiVirtualOutPort(MidiVirtualClient::Implementation& client, std::unique_ptr<MidiOutPortLinux::Implementation>&& implementation);
+	virtual ~MidiVirtualOutPort();
+
+private:
+	MidiVirtualClient::Implementation& _client;
+};
+
+//! \endcond
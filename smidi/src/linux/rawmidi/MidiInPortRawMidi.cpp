@@ -0,0 +1,313 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiInPortRawMidi.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiInPortRawMidi.h"
+#include "../alsa/MidiAlsaConstants.h"
+#include "../../MidiLogging.h"
+#include "../../../include/smidi/MidiTimestamp.h"
+#include <unistd.h>
+#include <poll.h>
+
+MidiInPortRawMidi::MidiInPortRawMidi(const std::string& name, const std::string& hardwareId)
+	: _name(name)
+	, _hardwareId(hardwareId)
+	, _rawMidi(nullptr)
+	, _pipefd{MidiAlsaConstants::kInvalidId, MidiAlsaConstants::kInvalidId}
+	, _pollDescriptor(MidiAlsaConstants::kInvalidId)
+	, _dispatchMode(DispatchMode::InputThread)
+	, _poll(false)
+	, _droppedBytes(0)
+	, _dispatchedMessages(0)
+{
+	_parser.setHandler(MidiStreamParser::Handler(&MidiInPortRawMidi::handleParsedMessage, this));
+
+	if (MidiAlsaConstants::kNoError == pipe(_pipefd))
+	{
+		open();
+	}
+	else
+	{
+		SMIDI_LOG_ERROR("Couldn't create pipe for %s", _name.c_str());
+	}
+}
+
+MidiInPortRawMidi::~MidiInPortRawMidi()
+{
+	close();
+
+	// close pipe
+	if (_pipefd[0] != MidiAlsaConstants::kInvalidId)
+	{
+		::close(_pipefd[0]);
+	}
+	if (_pipefd[1] != MidiAlsaConstants::kInvalidId)
+	{
+		::close(_pipefd[1]);
+	}
+}
+
+const std::string& MidiInPortRawMidi::name() const
+{
+	return _name;
+}
+
+void MidiInPortRawMidi::start()
+{
+}
+
+void MidiInPortRawMidi::stop()
+{
+}
+
+MidiPortMetrics MidiInPortRawMidi::metrics() const
+{
+	return _counters.snapshot();
+}
+
+void MidiInPortRawMidi::setMessageHandler(MessageHandler handler)
+{
+	_dispatcher.setHandler(handler);
+}
+
+void MidiInPortRawMidi::setMessageHandler(MidiMessage::Type type, MessageHandler handler)
+{
+	_dispatcher.setHandler(type, handler);
+}
+
+void MidiInPortRawMidi::resetMessageHandlers()
+{
+	_dispatcher.resetHandlers();
+}
+
+void MidiInPortRawMidi::setDispatchMode(DispatchMode mode)
+{
+	if (mode != _dispatchMode)
+	{
+		_dispatchMode = mode;
+		if (_rawMidi)
+		{
+			if (mode == DispatchMode::InputThread)
+			{
+				if (!startInputThread())
+				{
+					SMIDI_LOG_ERROR("Couldn't start midi input thread: %s", _name.c_str());
+				}
+			}
+			else
+			{
+				stopInputThread();
+			}
+		}
+	}
+}
+
+MidiInPort::DispatchMode MidiInPortRawMidi::dispatchMode() const
+{
+	return _dispatchMode;
+}
+
+int MidiInPortRawMidi::pollDescriptor() const
+{
+	return _pollDescriptor;
+}
+
+std::size_t MidiInPortRawMidi::processPending()
+{
+	std::size_t result = 0;
+	if (_rawMidi && _dispatchMode == DispatchMode::CallerThread)
+	{
+		result = processPendingBytes();
+		_waiters.completeExpired(false);
+	}
+	return result;
+}
+
+void MidiInPortRawMidi::addWaiter(MidiMessageWaiter& waiter)
+{
+	_waiters.add(waiter);
+
+	// input thread should recalculate its poll timeout
+	if (waiter.deadline != MidiMessageWaiter::Clock::time_point::max())
+	{
+		wakeUpInputThread();
+	}
+}
+
+bool MidiInPortRawMidi::removeWaiter(MidiMessageWaiter& waiter)
+{
+	return _waiters.remove(waiter);
+}
+
+void MidiInPortRawMidi::open()
+{
+	// non-blocking, so the input thread can be woken up through the pipe and processPending() never blocks
+	const int result = snd_rawmidi_open(&_rawMidi, nullptr, _hardwareId.c_str(), SND_RAWMIDI_NONBLOCK);
+	if (MidiAlsaConstants::kNoError == result)
+	{
+		pollfd descriptor = {};
+		if (snd_rawmidi_poll_descriptors(_rawMidi, &descriptor, 1) == 1)
+		{
+			_pollDescriptor = descriptor.fd;
+		}
+
+		if (_dispatchMode == DispatchMode::InputThread && !startInputThread())
+		{
+			SMIDI_LOG_ERROR("Couldn't start midi input thread: %s", _name.c_str());
+			snd_rawmidi_close(_rawMidi);
+			_rawMidi = nullptr;
+			_pollDescriptor = MidiAlsaConstants::kInvalidId;
+		}
+	}
+	else
+	{
+		SMIDI_LOG_ERROR("Couldn't open raw MIDI input %s (%s) because: %s", _name.c_str(), _hardwareId.c_str(), snd_strerror(result));
+		_rawMidi = nullptr;
+	}
+}
+
+void MidiInPortRawMidi::close()
+{
+	if (_rawMidi)
+	{
+		stopInputThread();
+		_pollDescriptor = MidiAlsaConstants::kInvalidId;
+
+		// nothing will be received anymore
+		_waiters.completeExpired(true);
+
+		snd_rawmidi_close(_rawMidi);
+		_rawMidi = nullptr;
+		_parser.reset();
+	}
+}
+
+bool MidiInPortRawMidi::startInputThread()
+{
+	if (!_poll)
+	{
+		// set the flag to poll input bytes
+		_poll = true;
+
+		_thread = std::thread(&MidiInPortRawMidi::midiInputThread, this);
+		if (!_thread.joinable())
+		{
+			_poll = false;
+		}
+	}
+	return _poll;
+}
+
+void MidiInPortRawMidi::stopInputThread()
+{
+	if (_poll)
+	{
+		_poll = false;
+		wakeUpInputThread();
+		_thread.join();
+	}
+}
+
+void MidiInPortRawMidi::wakeUpInputThread()
+{
+	if (_poll)
+	{
+		unsigned char wakeUp = 1;
+		::write(_pipefd[1], &wakeUp, sizeof(wakeUp));
+	}
+}
+
+std::size_t MidiInPortRawMidi::processPendingBytes()
+{
+	_dispatchedMessages = 0;
+
+	ssize_t resultOrError = 0;
+	do
+	{
+		resultOrError = snd_rawmidi_read(_rawMidi, _buffer, sizeof(_buffer));
+		if (resultOrError > 0)
+		{
+			const std::size_t size = static_cast<std::size_t>(resultOrError);
+			_parser.parse(_buffer, size, MidiTimestamp::now());
+
+			// bytes the parser couldn't use (e.g. data bytes of a message whose status byte was lost)
+			const unsigned long long droppedBytes = _parser.droppedBytes();
+			if (droppedBytes != _droppedBytes)
+			{
+				_counters.countDecodeFailure(droppedBytes - _droppedBytes);
+				_droppedBytes = droppedBytes;
+			}
+
+			// the driver buffer may have been filled up while we were away
+			if (size == sizeof(_buffer))
+			{
+				checkOverrun();
+			}
+		}
+		else if (resultOrError < 0 && resultOrError != -EAGAIN)
+		{
+			SMIDI_LOG_ERROR("Couldn't read raw MIDI from %s because: %s", _name.c_str(), snd_strerror(static_cast<int>(resultOrError)));
+		}
+	}
+	while (resultOrError == static_cast<ssize_t>(sizeof(_buffer)));
+
+	return _dispatchedMessages;
+}
+
+void MidiInPortRawMidi::checkOverrun()
+{
+	snd_rawmidi_status_t* status = nullptr;
+	snd_rawmidi_status_alloca(&status);
+	if (MidiAlsaConstants::kNoError == snd_rawmidi_status(_rawMidi, status) && snd_rawmidi_status_get_xruns(status) > 0)
+	{
+		// some bytes are lost, the message in progress can't be trusted anymore
+		_counters.countOverrun();
+		_parser.reset();
+	}
+}
+
+void MidiInPortRawMidi::handleParsedMessage(void* context, const MidiMessage& message)
+{
+	MidiInPortRawMidi* self = static_cast<MidiInPortRawMidi*>(context);
+
+	// no latency is counted, the timestamp is the time of the read, not of the arrival
+	self->_counters.countMessage(message);
+
+	// waiters take the message first, suspended coroutines are resumed right from here
+	const bool waiterCompleted = !self->_waiters.isEmpty() && self->_waiters.complete(message);
+	if (waiterCompleted || self->_dispatcher.dispatch(message))
+	{
+		++self->_dispatchedMessages;
+	}
+}
+
+void MidiInPortRawMidi::midiInputThread()
+{
+	// note: we add 1 custom descriptor to force the poll() call to return
+	pollfd pollDescriptors[2] = {};
+	pollDescriptors[0].fd = _pollDescriptor;
+	pollDescriptors[0].events = POLLIN;
+	pollDescriptors[1].fd = _pipefd[0];
+	pollDescriptors[1].events = POLLIN;
+
+	while (_poll)
+	{
+		processPendingBytes();
+		_waiters.completeExpired(false);
+
+		if (poll(pollDescriptors, 2, _waiters.timeoutToNextDeadline()) >= 0)
+		{
+			// check if the polled one is our custom descriptor
+			if ((pollDescriptors[1].revents & POLLIN) == POLLIN)
+			{
+				unsigned char data;
+				::read(pollDescriptors[1].fd, &data, sizeof(data));
+			}
+		}
+	}
+}
+
+//! \endcond
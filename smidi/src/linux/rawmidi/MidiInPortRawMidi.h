@@ -0,0 +1,86 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiInPortRawMidi.h
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "../../../include/smidi/MidiInPort.h"
+#include "../../../include/smidi/MidiStreamParser.h"
+#include "../../../include/smidi/MidiMessageDispatcher.h"
+#include "../../MidiMetricsCounters.h"
+#include "../../MidiMessageWaiterList.h"
+#include <thread>
+#include <atomic>
+#include <alsa/asoundlib.h>
+
+/*!
+ * \brief The MidiInPortRawMidi class reads raw MIDI subdevice (`hw:card,device,subdevice`)
+ * \class MidiInPortRawMidi MidiInPortRawMidi.h "MidiInPortRawMidi.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Bytes are read without the sequencer in between and assembled into messages by MidiStreamParser,
+ * so messages are timestamped when the read returns.
+ */
+class MidiInPortRawMidi : public MidiInPort
+{
+	static const std::size_t kReadBufferSize = 256;
+
+public:
+	MidiInPortRawMidi(const std::string& name, const std::string& hardwareId);
+	virtual ~MidiInPortRawMidi();
+
+	virtual const std::string& name() const override;
+
+	virtual void start() override;
+	virtual void stop() override;
+
+	virtual MidiPortMetrics metrics() const override;
+
+	virtual void setMessageHandler(MessageHandler handler) override;
+	virtual void setMessageHandler(MidiMessage::Type type, MessageHandler handler) override;
+	virtual void resetMessageHandlers() override;
+
+	virtual void setDispatchMode(DispatchMode mode) override;
+	virtual DispatchMode dispatchMode() const override;
+	virtual int pollDescriptor() const override;
+	virtual std::size_t processPending() override;
+
+	virtual void addWaiter(MidiMessageWaiter& waiter) override;
+	virtual bool removeWaiter(MidiMessageWaiter& waiter) override;
+
+private:
+	void open();
+	void close();
+
+	bool startInputThread();
+	void stopInputThread();
+	void wakeUpInputThread();
+	void midiInputThread();
+
+	std::size_t processPendingBytes();
+	void checkOverrun();
+
+	static void handleParsedMessage(void* context, const MidiMessage& message);
+
+private:
+	std::string           _name;
+	std::string           _hardwareId;
+	MidiMessageDispatcher _dispatcher;
+	MidiStreamParser      _parser;
+	MidiPortCounters      _counters;
+	MidiMessageWaiterList _waiters;
+	snd_rawmidi_t*        _rawMidi;
+	std::thread           _thread;
+	int                   _pipefd[2];
+	int                   _pollDescriptor;
+	DispatchMode          _dispatchMode;
+	std::atomic<bool>     _poll;
+	unsigned long long    _droppedBytes;
+	std::size_t           _dispatchedMessages;
+	unsigned char         _buffer[kReadBufferSize];
+};
+
+//! \endcond
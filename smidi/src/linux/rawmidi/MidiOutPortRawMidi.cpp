@@ -0,0 +1,261 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiOutPortRawMidi.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiOutPortRawMidi.h"
+#include "../alsa/MidiAlsaConstants.h"
+#include "../../MidiLogging.h"
+#include <poll.h>
+
+MidiOutPortRawMidi::MidiOutPortRawMidi(const std::string& name, const std::string& hardwareId)
+	: _name(name)
+	, _hardwareId(hardwareId)
+	, _rawMidi(nullptr)
+	, _pollDescriptor(MidiAlsaConstants::kInvalidId)
+	, _coalescer([this](const MidiMessage* messages, std::size_t count) { writeMessages(messages, count); }, _counters, MidiClock::system())
+	, _runningStatusEnabled(false)
+	, _runningStatus(0)
+	, _sync([this](const MidiMessage& message) { sendSyncMessage(message); }, MidiClock::system())
+{
+	open();
+}
+
+MidiOutPortRawMidi::~MidiOutPortRawMidi()
+{
+	// sync and flusher threads write to the port, so they go first
+	_sync.close();
+	_coalescer.close();
+	close();
+}
+
+const std::string& MidiOutPortRawMidi::name() const
+{
+	return _name;
+}
+
+void MidiOutPortRawMidi::start()
+{
+}
+
+void MidiOutPortRawMidi::stop()
+{
+}
+
+MidiPortMetrics MidiOutPortRawMidi::metrics() const
+{
+	return _counters.snapshot();
+}
+
+void MidiOutPortRawMidi::sendMessage(const MidiMessage& message)
+{
+	if (_coalescer.isEnabled())
+	{
+		_coalescer.send(&message, 1);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(_writeMutex);
+		writeMessage(message);
+	}
+}
+
+void MidiOutPortRawMidi::sendMessages(const MidiMessage* messages, std::size_t count)
+{
+	if (_coalescer.isEnabled())
+	{
+		_coalescer.send(messages, count);
+	}
+	else
+	{
+		writeMessages(messages, count);
+	}
+}
+
+void MidiOutPortRawMidi::writeMessages(const MidiMessage* messages, std::size_t count)
+{
+	// the lock is taken once, so the sync thread can't wedge its clocks into the batch
+	std::lock_guard<std::mutex> lock(_writeMutex);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		writeMessage(messages[i]);
+	}
+}
+
+bool MidiOutPortRawMidi::scheduleMessages(const MidiMessage*, std::size_t)
+{
+	// raw MIDI has no queue, bytes go to the device as soon as they are written
+	return false;
+}
+
+void MidiOutPortRawMidi::cancelScheduledMessages()
+{
+}
+
+void MidiOutPortRawMidi::writeMessage(const MidiMessage& message)
+{
+	if (message.isEmpty())
+	{
+		_counters.countEncodeFailure();
+		return;
+	}
+
+	const unsigned char* data = message.data().data();
+	std::size_t size = message.data().size();
+	const unsigned char status = data[0];
+
+	if (status < MidiMessage::System)
+	{
+		// channel message: status byte is omitted if it repeats the previous one
+		if (_runningStatusEnabled && status == _runningStatus)
+		{
+			++data;
+			--size;
+		}
+		_runningStatus = status;
+	}
+	else if (status < MidiMessage::MidiClock)
+	{
+		// System Common and SysEx cancel running status, real time messages don't affect it
+		_runningStatus = 0;
+	}
+
+	if (write(data, size))
+	{
+		_counters.countMessage(message);
+		_activeNotes.track(message);
+	}
+	else
+	{
+		// the receiver may have lost the status byte
+		_runningStatus = 0;
+	}
+}
+
+void MidiOutPortRawMidi::setRunningStatusEnabled(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(_writeMutex);
+	_runningStatusEnabled = enabled;
+	_runningStatus = 0;
+}
+
+bool MidiOutPortRawMidi::isRunningStatusEnabled() const
+{
+	return _runningStatusEnabled;
+}
+
+void MidiOutPortRawMidi::setNoteTrackingEnabled(bool enabled)
+{
+	_activeNotes.setEnabled(enabled);
+}
+
+bool MidiOutPortRawMidi::isNoteTrackingEnabled() const
+{
+	return _activeNotes.isEnabled();
+}
+
+void MidiOutPortRawMidi::releaseNotes()
+{
+	const std::vector<MidiMessage> messages = _activeNotes.takeReleaseMessages();
+	sendMessages(messages.data(), messages.size());
+}
+
+void MidiOutPortRawMidi::setCoalescing(const Coalescing& coalescing)
+{
+	_coalescer.setCoalescing(coalescing);
+}
+
+MidiOutPort::Coalescing MidiOutPortRawMidi::coalescing() const
+{
+	return _coalescer.coalescing();
+}
+
+MidiSync& MidiOutPortRawMidi::sync()
+{
+	return _sync;
+}
+
+void MidiOutPortRawMidi::sendSyncMessage(const MidiMessage& message)
+{
+	sendMessage(message);
+	if (message.data().front() == MidiMessage::MidiStop && _activeNotes.isEnabled())
+	{
+		releaseNotes();
+	}
+}
+
+void MidiOutPortRawMidi::open()
+{
+	// non-blocking, so a stuck device can't block the caller forever
+	const int result = snd_rawmidi_open(nullptr, &_rawMidi, _hardwareId.c_str(), SND_RAWMIDI_NONBLOCK);
+	if (MidiAlsaConstants::kNoError == result)
+	{
+		pollfd descriptor = {};
+		if (snd_rawmidi_poll_descriptors(_rawMidi, &descriptor, 1) == 1)
+		{
+			_pollDescriptor = descriptor.fd;
+		}
+	}
+	else
+	{
+		SMIDI_LOG_ERROR("Couldn't open raw MIDI output %s (%s) because: %s", _name.c_str(), _hardwareId.c_str(), snd_strerror(result));
+		_rawMidi = nullptr;
+	}
+}
+
+void MidiOutPortRawMidi::close()
+{
+	if (_rawMidi)
+	{
+		if (_activeNotes.isEnabled())
+		{
+			releaseNotes();
+		}
+		snd_rawmidi_drain(_rawMidi);
+		snd_rawmidi_close(_rawMidi);
+		_rawMidi = nullptr;
+		_pollDescriptor = MidiAlsaConstants::kInvalidId;
+	}
+}
+
+bool MidiOutPortRawMidi::write(const unsigned char* data, std::size_t size)
+{
+	if (!_rawMidi)
+	{
+		_counters.countSendFailure();
+		return false;
+	}
+
+	while (size > 0)
+	{
+		const ssize_t resultOrError = snd_rawmidi_write(_rawMidi, data, size);
+		if (resultOrError > 0)
+		{
+			data += resultOrError;
+			size -= static_cast<std::size_t>(resultOrError);
+		}
+		else if (resultOrError == -EAGAIN || resultOrError == 0)
+		{
+			// driver buffer is full, wait until the wire takes the rest
+			pollfd descriptor = {_pollDescriptor, POLLOUT, 0};
+			const int timeout = static_cast<int>(size * kMicrosecondsPerByte / 1000) + kWriteTimeoutMarginInMilliseconds;
+			if (poll(&descriptor, 1, timeout) <= 0)
+			{
+				SMIDI_LOG_ERROR("Raw MIDI output %s is stuck, %zu bytes are not sent", _name.c_str(), size);
+				_counters.countOverrun();
+				return false;
+			}
+		}
+		else
+		{
+			SMIDI_LOG_ERROR("Couldn't write raw MIDI to %s because: %s", _name.c_str(), snd_strerror(static_cast<int>(resultOrError)));
+			_counters.countSendFailure();
+			return false;
+		}
+	}
+	return true;
+}
+
+//! \endcond
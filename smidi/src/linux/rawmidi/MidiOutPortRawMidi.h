@@ -0,0 +1,86 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiOutPortRawMidi.h
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "../../../include/smidi/MidiOutPort.h"
+#include "../../MidiActiveNotes.h"
+#include "../../MidiCoalescer.h"
+#include "../../MidiMetricsCounters.h"
+#include "../../MidiSoftwareSync.h"
+#include <mutex>
+#include <alsa/asoundlib.h>
+
+/*!
+ * \brief The MidiOutPortRawMidi class writes to raw MIDI subdevice (`hw:card,device,subdevice`)
+ * \class MidiOutPortRawMidi MidiOutPortRawMidi.h "MidiOutPortRawMidi.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Messages are written as is, optionally with running status. Writes from several threads (e.g. application
+ * and MidiSync) are serialized, so messages are never interleaved on the wire.
+ */
+class MidiOutPortRawMidi : public MidiOutPort
+{
+	// one byte takes 320 microseconds at 31250 baud
+	static const int kMicrosecondsPerByte = 320;
+	static const int kWriteTimeoutMarginInMilliseconds = 10;
+
+public:
+	MidiOutPortRawMidi(const std::string& name, const std::string& hardwareId);
+	virtual ~MidiOutPortRawMidi();
+
+	virtual const std::string& name() const override;
+
+	virtual void start() override;
+	virtual void stop() override;
+
+	virtual MidiPortMetrics metrics() const override;
+
+	virtual void sendMessage(const MidiMessage& message) override;
+	virtual void sendMessages(const MidiMessage* messages, std::size_t count) override;
+	virtual bool scheduleMessages(const MidiMessage* messages, std::size_t count) override;
+	virtual void cancelScheduledMessages() override;
+
+	virtual void setRunningStatusEnabled(bool enabled) override;
+	virtual bool isRunningStatusEnabled() const override;
+
+	virtual void setNoteTrackingEnabled(bool enabled) override;
+	virtual bool isNoteTrackingEnabled() const override;
+	virtual void releaseNotes() override;
+
+	virtual void setCoalescing(const Coalescing& coalescing) override;
+	virtual Coalescing coalescing() const override;
+
+	virtual MidiSync& sync() override;
+
+private:
+	void open();
+	void close();
+
+	//! Sender of the sync, MIDI Stop also releases the notes
+	void sendSyncMessage(const MidiMessage& message);
+
+	//! Writes the messages right away, the sender of the coalescer
+	void writeMessages(const MidiMessage* messages, std::size_t count);
+	void writeMessage(const MidiMessage& message);
+	bool write(const unsigned char* data, std::size_t size);
+
+private:
+	std::string       _name;
+	std::string       _hardwareId;
+	snd_rawmidi_t*    _rawMidi;
+	int               _pollDescriptor;
+	std::mutex        _writeMutex;
+	MidiPortCounters  _counters;
+	MidiActiveNotes   _activeNotes;
+	MidiCoalescer     _coalescer;
+	std::atomic<bool> _runningStatusEnabled;
+	unsigned char     _runningStatus;
+	MidiSoftwareSync  _sync;
+};
+
+//! \endcond
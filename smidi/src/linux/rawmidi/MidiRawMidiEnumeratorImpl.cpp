@@ -0,0 +1,168 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiRawMidiEnumeratorImpl.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiRawMidiEnumeratorImpl.h"
+#include "MidiInPortRawMidi.h"
+#include "MidiOutPortRawMidi.h"
+#include "../alsa/MidiAlsaConstants.h"
+#include "../../MidiLogging.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+	std::string controlId(int card)
+	{
+		return "hw:" + std::to_string(card);
+	}
+}
+
+MidiDeviceEnumerator::RawMidiImplementation::RawMidiImplementation()
+{
+	refreshDevices();
+}
+
+std::list<std::string> MidiDeviceEnumerator::RawMidiImplementation::deviceNames() const
+{
+	std::list<std::string> result;
+
+	const auto getDeviceName = [](const DeviceMap::value_type& device) -> std::string { return device.first; };
+	std::transform(std::begin(_deviceMap), std::end(_deviceMap), std::back_inserter(result), getDeviceName);
+
+	return result;
+}
+
+std::shared_ptr<MidiDevice> MidiDeviceEnumerator::RawMidiImplementation::createDevice(const std::string& deviceName)
+{
+	std::shared_ptr<MidiDevice> result;
+
+	const auto i = _deviceMap.find(deviceName);
+	if (i != std::end(_deviceMap))
+	{
+		const std::shared_ptr<MidiDevice>& device = std::get<DeviceObject>(i->second);
+		if (device)
+		{
+			result = device;
+		}
+		else
+		{
+			const int card = std::get<CardNumber>(i->second);
+
+			snd_ctl_t* control = nullptr;
+			const int error = snd_ctl_open(&control, controlId(card).c_str(), 0);
+			if (MidiAlsaConstants::kNoError == error)
+			{
+				MidiDevice::InputPortContainer inputs;
+				MidiDevice::OutputPortContainer outputs;
+
+				int device = -1;
+				while (snd_ctl_rawmidi_next_device(control, &device) == MidiAlsaConstants::kNoError && device >= 0)
+				{
+					collectStreamPorts(control, card, device, SND_RAWMIDI_STREAM_INPUT, inputs, outputs);
+					collectStreamPorts(control, card, device, SND_RAWMIDI_STREAM_OUTPUT, inputs, outputs);
+				}
+				snd_ctl_close(control);
+
+				result = std::make_shared<MidiDevice>(deviceName, inputs, outputs);
+
+				// cache the device object
+				_deviceMap[deviceName] = std::make_tuple(card, result);
+			}
+			else
+			{
+				SMIDI_LOG_ERROR("Couldn't open control of the card '%s' (%d) because: %s", deviceName.c_str(), card, snd_strerror(error));
+			}
+		}
+	}
+	return result;
+}
+
+void MidiDeviceEnumerator::RawMidiImplementation::updateDeviceList()
+{
+	refreshDevices();
+}
+
+void MidiDeviceEnumerator::RawMidiImplementation::refreshDevices()
+{
+	_deviceMap.clear();
+
+	int card = -1;
+	while (snd_card_next(&card) == MidiAlsaConstants::kNoError && card >= 0)
+	{
+		snd_ctl_t* control = nullptr;
+		if (snd_ctl_open(&control, controlId(card).c_str(), 0) == MidiAlsaConstants::kNoError)
+		{
+			if (hasRawMidiDevices(control))
+			{
+				std::string name = controlId(card);
+				char* cardName = nullptr;
+				if (snd_card_get_name(card, &cardName) == MidiAlsaConstants::kNoError && cardName)
+				{
+					name = cardName;
+					std::free(cardName);
+				}
+
+				// two identical cards are told apart by the card number
+				if (_deviceMap.count(name) > 0)
+				{
+					name += " (" + controlId(card) + ")";
+				}
+				_deviceMap.emplace(name, std::make_tuple(card, nullptr));
+			}
+			snd_ctl_close(control);
+		}
+	}
+}
+
+bool MidiDeviceEnumerator::RawMidiImplementation::hasRawMidiDevices(snd_ctl_t* control)
+{
+	int device = -1;
+	return snd_ctl_rawmidi_next_device(control, &device) == MidiAlsaConstants::kNoError && device >= 0;
+}
+
+void MidiDeviceEnumerator::RawMidiImplementation::collectStreamPorts(snd_ctl_t* control, int card, int device, snd_rawmidi_stream_t stream, MidiDevice::InputPortContainer& inputPorts, MidiDevice::OutputPortContainer& outputPorts)
+{
+	snd_rawmidi_info_t* info = nullptr;
+	snd_rawmidi_info_alloca(&info);
+	snd_rawmidi_info_set_device(info, static_cast<unsigned int>(device));
+	snd_rawmidi_info_set_subdevice(info, 0);
+	snd_rawmidi_info_set_stream(info, stream);
+
+	// the device may have no subdevices in this direction at all
+	if (snd_ctl_rawmidi_info(control, info) == MidiAlsaConstants::kNoError)
+	{
+		const unsigned int subdevices = snd_rawmidi_info_get_subdevices_count(info);
+		for (unsigned int subdevice = 0; subdevice < subdevices; ++subdevice)
+		{
+			snd_rawmidi_info_set_subdevice(info, subdevice);
+			if (snd_ctl_rawmidi_info(control, info) == MidiAlsaConstants::kNoError)
+			{
+				const std::string hardwareId = controlId(card) + "," + std::to_string(device) + "," + std::to_string(subdevice);
+				std::string portName = snd_rawmidi_info_get_subdevice_name(info);
+				if (portName.empty())
+				{
+					portName = snd_rawmidi_info_get_name(info);
+				}
+				if (portName.empty() || subdevices > 1)
+				{
+					portName += " (" + hardwareId + ")";
+				}
+
+				if (stream == SND_RAWMIDI_STREAM_INPUT)
+				{
+					inputPorts.emplace_back(std::make_shared<MidiInPortRawMidi>(portName, hardwareId));
+				}
+				else
+				{
+					outputPorts.emplace_back(std::make_shared<MidiOutPortRawMidi>(portName, hardwareId));
+				}
+			}
+		}
+	}
+}
+
+//! \endcond
@@ -0,0 +1,55 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiRawMidiEnumeratorImpl.h
+ * \warning This file is not a part of library public interface!
+ * Contains ALSA raw MIDI implementation of MidiDeviceEnumerator
+ */
+
+#include "../../../include/smidi/MidiDeviceEnumerator.h"
+#include "../../../include/smidi/MidiDevice.h"
+#include <map>
+#include <tuple>
+#include <string>
+#include <memory>
+#include <alsa/asoundlib.h>
+
+/*!
+ * \brief The MidiDeviceEnumerator::RawMidiImplementation class enumerates sound cards with raw MIDI devices
+ * \warning This class is not a part of library public interface!
+ *
+ * Every sound card is one MidiDevice. Each subdevice of its raw MIDI devices becomes an input and/or output
+ * port named after the subdevice, ports are opened by `hw:card,device,subdevice` id.
+ */
+class MidiDeviceEnumerator::RawMidiImplementation
+{
+	enum DeviceInfoFields
+	{
+		CardNumber,
+		DeviceObject
+	};
+
+	using DeviceInfo = std::tuple<int, std::shared_ptr<MidiDevice>>;
+	using DeviceMap  = std::map<std::string, DeviceInfo>;
+
+public:
+	RawMidiImplementation();
+
+	std::list<std::string> deviceNames() const;
+	std::shared_ptr<MidiDevice> createDevice(const std::string& deviceName);
+
+	void updateDeviceList();
+
+private:
+	void refreshDevices();
+
+	static bool hasRawMidiDevices(snd_ctl_t* control);
+	static void collectStreamPorts(snd_ctl_t* control, int card, int device, snd_rawmidi_stream_t stream, MidiDevice::InputPortContainer& inputPorts, MidiDevice::OutputPortContainer& outputPorts);
+
+private:
+	DeviceMap _deviceMap;
+};
+
+//! \endcond
@@ -0,0 +1,115 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiLoopbackChannel.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiLoopbackChannel.h"
+#include "../MidiLogging.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+
+namespace
+{
+	const int kInvalidDescriptor = -1;
+
+	// splitmix64: jitter of every message depends only on the seed and the message number
+	unsigned long long mix(unsigned long long value)
+	{
+		value += 0x9E3779B97F4A7C15ULL;
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+		return value ^ (value >> 31);
+	}
+}
+
+MidiLoopbackChannel::MidiLoopbackChannel(std::shared_ptr<MidiClock> clock, const MidiLoopback::Options& options)
+	: _clock(std::move(clock))
+	, _options(options)
+	, _ring(options.capacity)
+	, _pending(0)
+	, _sequence(0)
+	, _eventfd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+	if (_eventfd == kInvalidDescriptor)
+	{
+		SMIDI_LOG_ERROR("Couldn't create eventfd for loopback because: %s", std::strerror(errno));
+	}
+}
+
+MidiLoopbackChannel::~MidiLoopbackChannel()
+{
+	if (_eventfd != kInvalidDescriptor)
+	{
+		::close(_eventfd);
+	}
+}
+
+MidiClock& MidiLoopbackChannel::clock()
+{
+	return *_clock;
+}
+
+bool MidiLoopbackChannel::push(const MidiMessage& message)
+{
+	const unsigned long long deliveryTime = _clock->now() + static_cast<unsigned long long>(_options.latency.count()) + jitterFor(_sequence++);
+	const bool result = _ring.push([&message, deliveryTime](Entry& entry)
+	{
+		entry.message = message;
+		entry.deliveryTime = deliveryTime;
+	});
+
+	// only the first message of a batch wakes up the consumer
+	if (result && _pending.fetch_add(1, std::memory_order_acq_rel) == 0)
+	{
+		signal();
+	}
+	return result;
+}
+
+MidiLoopbackChannel::Entry* MidiLoopbackChannel::front()
+{
+	return _ring.front();
+}
+
+void MidiLoopbackChannel::popFront()
+{
+	_ring.popFront();
+}
+
+void MidiLoopbackChannel::finishBatch(std::size_t count)
+{
+	// messages still in flight keep the descriptor readable
+	if (_pending.fetch_sub(count, std::memory_order_acq_rel) > count)
+	{
+		signal();
+	}
+}
+
+int MidiLoopbackChannel::pollDescriptor() const
+{
+	return _eventfd;
+}
+
+void MidiLoopbackChannel::signal()
+{
+	const eventfd_t value = 1;
+	::write(_eventfd, &value, sizeof(value));
+}
+
+void MidiLoopbackChannel::clearSignal()
+{
+	eventfd_t value = 0;
+	::read(_eventfd, &value, sizeof(value));
+}
+
+unsigned long long MidiLoopbackChannel::jitterFor(unsigned long long sequence) const
+{
+	const unsigned long long jitter = static_cast<unsigned long long>(_options.jitter.count());
+	return (jitter > 0) ? mix(_options.seed + sequence) % (jitter + 1) : 0;
+}
+
+//! \endcond
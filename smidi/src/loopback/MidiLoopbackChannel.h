@@ -0,0 +1,74 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiLoopbackChannel.h
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "../../include/smidi/MidiMessage.h"
+#include "../../include/smidi/MidiClock.h"
+#include "../../include/smidi/MidiLoopback.h"
+#include "../MidiRingBuffer.h"
+#include <atomic>
+#include <memory>
+
+/*!
+ * \brief The MidiLoopbackChannel class is the "cable" between loopback output and input ports
+ * \class MidiLoopbackChannel MidiLoopbackChannel.h "MidiLoopbackChannel.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Messages are copied into the preallocated ring together with their delivery time (send time plus latency
+ * and jitter). The poll descriptor is an eventfd which is written only when the ring becomes non-empty, so
+ * a stream of messages costs one system call per batch rather than per message.
+ */
+class MidiLoopbackChannel
+{
+public:
+	struct Entry
+	{
+		MidiMessage        message;
+		unsigned long long deliveryTime = 0;
+	};
+
+public:
+	MidiLoopbackChannel(std::shared_ptr<MidiClock> clock, const MidiLoopback::Options& options);
+	~MidiLoopbackChannel();
+
+	MidiClock& clock();
+
+	//! Producer side, any thread: returns `false` if the ring is full and the message is lost
+	bool push(const MidiMessage& message);
+
+	//! Consumer side: returns the oldest message or `nullptr`, the message may not be due yet
+	Entry* front();
+
+	//! Consumer side: releases the message returned by front()
+	void popFront();
+
+	//! Consumer side: called once per drain with the number of popped messages, re-arms pollDescriptor()
+	void finishBatch(std::size_t count);
+
+	//! Readable while there are messages in the ring
+	int pollDescriptor() const;
+
+	//! Makes pollDescriptor() readable, e.g. to wake up the input thread
+	void signal();
+
+	//! Consumer side: clears the readable state before the ring is drained
+	void clearSignal();
+
+private:
+	unsigned long long jitterFor(unsigned long long sequence) const;
+
+private:
+	std::shared_ptr<MidiClock>      _clock;
+	MidiLoopback::Options           _options;
+	MidiRingBuffer<Entry>           _ring;
+	std::atomic<std::size_t>        _pending;
+	std::atomic<unsigned long long> _sequence;
+	int                             _eventfd;
+};
+
+//! \endcond
@@ -0,0 +1,39 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiLoopbackEnumeratorImpl.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiLoopbackEnumeratorImpl.h"
+#include "../MidiLogging.h"
+
+std::list<std::string> MidiDeviceEnumerator::LoopbackImplementation::deviceNames() const
+{
+	return {kLoopbackDeviceName};
+}
+
+std::shared_ptr<MidiDevice> MidiDeviceEnumerator::LoopbackImplementation::createDevice(const std::string& deviceName)
+{
+	std::shared_ptr<MidiDevice> result;
+	if (deviceName == kLoopbackDeviceName)
+	{
+		if (!_loopback)
+		{
+			_loopback.reset(new MidiLoopback(deviceName));
+		}
+		result = _loopback->device();
+	}
+	else
+	{
+		SMIDI_LOG_WARNING("Couldn't find loopback device: %s", deviceName.c_str());
+	}
+	return result;
+}
+
+void MidiDeviceEnumerator::LoopbackImplementation::updateDeviceList()
+{
+	_loopback.reset();
+}
+
+//! \endcond
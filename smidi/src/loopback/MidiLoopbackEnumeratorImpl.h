@@ -0,0 +1,38 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiLoopbackEnumeratorImpl.h
+ * \warning This file is not a part of library public interface!
+ * Contains loopback implementation of MidiDeviceEnumerator
+ */
+
+#include "../../include/smidi/MidiDeviceEnumerator.h"
+#include "../../include/smidi/MidiLoopback.h"
+#include <list>
+#include <string>
+#include <memory>
+
+/*!
+ * \brief The MidiDeviceEnumerator::LoopbackImplementation class provides the single MidiLoopback device
+ * \warning This class is not a part of library public interface!
+ *
+ * The loopback is created on the first createDevice() call with the system clock and default options,
+ * tests which need a simulated clock or latency construct MidiLoopback themselves.
+ */
+class MidiDeviceEnumerator::LoopbackImplementation
+{
+public:
+	LoopbackImplementation() = default;
+
+	std::list<std::string> deviceNames() const;
+	std::shared_ptr<MidiDevice> createDevice(const std::string& deviceName);
+
+	void updateDeviceList();
+
+private:
+	std::unique_ptr<MidiLoopback> _loopback;
+};
+
+//! \endcond
@@ -0,0 +1,355 @@
+//! \cond INTERNAL
+
+/*!
+ * \file MidiLoopbackPorts.cpp
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "MidiLoopbackPorts.h"
+#include "../MidiLogging.h"
+#include <algorithm>
+#include <poll.h>
+
+MidiLoopbackInPort::MidiLoopbackInPort(const std::string& name, std::shared_ptr<MidiLoopbackChannel> channel)
+	: _name(name)
+	, _channel(std::move(channel))
+	, _dispatchMode(DispatchMode::InputThread)
+	, _poll(false)
+	, _lastDeliveryTime(0)
+{
+	if (!startInputThread())
+	{
+		SMIDI_LOG_ERROR("Couldn't start midi input thread: %s", _name.c_str());
+	}
+}
+
+MidiLoopbackInPort::~MidiLoopbackInPort()
+{
+	stopInputThread();
+
+	// nothing will be received anymore
+	_waiters.completeExpired(true);
+}
+
+const std::string& MidiLoopbackInPort::name() const
+{
+	return _name;
+}
+
+void MidiLoopbackInPort::start()
+{
+}
+
+void MidiLoopbackInPort::stop()
+{
+}
+
+MidiPortMetrics MidiLoopbackInPort::metrics() const
+{
+	return _counters.snapshot();
+}
+
+void MidiLoopbackInPort::setMessageHandler(MessageHandler handler)
+{
+	_dispatcher.setHandler(handler);
+}
+
+void MidiLoopbackInPort::setMessageHandler(MidiMessage::Type type, MessageHandler handler)
+{
+	_dispatcher.setHandler(type, handler);
+}
+
+void MidiLoopbackInPort::resetMessageHandlers()
+{
+	_dispatcher.resetHandlers();
+}
+
+void MidiLoopbackInPort::setDispatchMode(DispatchMode mode)
+{
+	if (mode != _dispatchMode)
+	{
+		_dispatchMode = mode;
+		if (mode == DispatchMode::InputThread)
+		{
+			if (!startInputThread())
+			{
+				SMIDI_LOG_ERROR("Couldn't start midi input thread: %s", _name.c_str());
+			}
+		}
+		else
+		{
+			stopInputThread();
+		}
+	}
+}
+
+MidiInPort::DispatchMode MidiLoopbackInPort::dispatchMode() const
+{
+	return _dispatchMode;
+}
+
+int MidiLoopbackInPort::pollDescriptor() const
+{
+	return _channel->pollDescriptor();
+}
+
+std::size_t MidiLoopbackInPort::processPending()
+{
+	std::size_t result = 0;
+	if (_dispatchMode == DispatchMode::CallerThread)
+	{
+		unsigned long long nextDeliveryTime = 0;
+		result = processDueMessages(nextDeliveryTime);
+		_waiters.completeExpired(false);
+	}
+	return result;
+}
+
+void MidiLoopbackInPort::addWaiter(MidiMessageWaiter& waiter)
+{
+	_waiters.add(waiter);
+
+	// input thread should recalculate its poll timeout
+	if (_poll && waiter.deadline != MidiMessageWaiter::Clock::time_point::max())
+	{
+		_channel->signal();
+	}
+}
+
+bool MidiLoopbackInPort::removeWaiter(MidiMessageWaiter& waiter)
+{
+	return _waiters.remove(waiter);
+}
+
+bool MidiLoopbackInPort::startInputThread()
+{
+	if (!_poll)
+	{
+		// set the flag to poll input messages
+		_poll = true;
+
+		_thread = std::thread(&MidiLoopbackInPort::midiInputThread, this);
+		if (!_thread.joinable())
+		{
+			_poll = false;
+		}
+	}
+	return _poll;
+}
+
+void MidiLoopbackInPort::stopInputThread()
+{
+	if (_poll)
+	{
+		_poll = false;
+		_channel->signal();
+		_thread.join();
+	}
+}
+
+std::size_t MidiLoopbackInPort::processDueMessages(unsigned long long& nextDeliveryTime)
+{
+	_channel->clearSignal();
+
+	MidiClock& clock = _channel->clock();
+	const unsigned long long now = clock.now();
+	std::size_t poppedMessages = 0;
+	std::size_t dispatchedMessages = 0;
+	nextDeliveryTime = 0;
+
+	MidiLoopbackChannel::Entry* entry = nullptr;
+	while ((entry = _channel->front()) != nullptr)
+	{
+		// a message never overtakes its predecessor
+		const unsigned long long deliveryTime = std::max(entry->deliveryTime, _lastDeliveryTime);
+		if (deliveryTime > now)
+		{
+			nextDeliveryTime = deliveryTime;
+			break;
+		}
+		_lastDeliveryTime = deliveryTime;
+
+		MidiMessage& message = entry->message;
+		message.setTimestamp(deliveryTime);
+		_counters.countMessage(message);
+		_counters.countLatency(now - deliveryTime);
+
+		// waiters take the message first, suspended coroutines are resumed right from here
+		const bool waiterCompleted = !_waiters.isEmpty() && _waiters.complete(message);
+		if (waiterCompleted || _dispatcher.dispatch(message))
+		{
+			++dispatchedMessages;
+		}
+
+		_channel->popFront();
+		++poppedMessages;
+	}
+
+	_channel->finishBatch(poppedMessages);
+	return dispatchedMessages;
+}
+
+void MidiLoopbackInPort::midiInputThread()
+{
+	pollfd pollDescriptor = {};
+	pollDescriptor.fd = _channel->pollDescriptor();
+	pollDescriptor.events = POLLIN;
+
+	MidiClock& clock = _channel->clock();
+	while (_poll)
+	{
+		unsigned long long nextDeliveryTime = 0;
+		processDueMessages(nextDeliveryTime);
+		_waiters.completeExpired(false);
+
+		if (nextDeliveryTime != 0)
+		{
+			// the descriptor stays readable while messages are in flight, so sleep on the clock instead
+			clock.sleepUntil(std::min(nextDeliveryTime, clock.now() + kSleepSliceInNanoseconds));
+		}
+		else
+		{
+			poll(&pollDescriptor, 1, _waiters.timeoutToNextDeadline());
+		}
+	}
+}
+
+MidiLoopbackOutPort::MidiLoopbackOutPort(const std::string& name, std::shared_ptr<MidiLoopbackChannel> channel, std::shared_ptr<MidiClock> clock)
+	: _name(name)
+	, _channel(std::move(channel))
+	, _coalescer([this](const MidiMessage* messages, std::size_t count) { outputMessages(messages, count); }, _counters, clock)
+	, _runningStatusEnabled(false)
+	, _sync([this](const MidiMessage& message) { sendSyncMessage(message); }, std::move(clock))
+{
+}
+
+MidiLoopbackOutPort::~MidiLoopbackOutPort()
+{
+	// sync and flusher threads send to the channel, so they go first
+	_sync.close();
+	_coalescer.close();
+
+	if (_activeNotes.isEnabled())
+	{
+		releaseNotes();
+	}
+}
+
+const std::string& MidiLoopbackOutPort::name() const
+{
+	return _name;
+}
+
+void MidiLoopbackOutPort::start()
+{
+}
+
+void MidiLoopbackOutPort::stop()
+{
+}
+
+MidiPortMetrics MidiLoopbackOutPort::metrics() const
+{
+	return _counters.snapshot();
+}
+
+void MidiLoopbackOutPort::sendMessage(const MidiMessage& message)
+{
+	sendMessages(&message, 1);
+}
+
+void MidiLoopbackOutPort::sendMessages(const MidiMessage* messages, std::size_t count)
+{
+	if (_coalescer.isEnabled())
+	{
+		_coalescer.send(messages, count);
+	}
+	else
+	{
+		outputMessages(messages, count);
+	}
+}
+
+void MidiLoopbackOutPort::outputMessages(const MidiMessage* messages, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const MidiMessage& message = messages[i];
+		if (message.isEmpty())
+		{
+			_counters.countEncodeFailure();
+		}
+		else if (_channel->push(message))
+		{
+			_counters.countMessage(message);
+			_activeNotes.track(message);
+		}
+		else
+		{
+			_counters.countOverrun();
+		}
+	}
+}
+
+bool MidiLoopbackOutPort::scheduleMessages(const MidiMessage*, std::size_t)
+{
+	// the channel is a FIFO, messages scheduled later couldn't be taken back from it
+	return false;
+}
+
+void MidiLoopbackOutPort::cancelScheduledMessages()
+{
+}
+
+void MidiLoopbackOutPort::setRunningStatusEnabled(bool enabled)
+{
+	// messages are passed as a whole, there is no byte stream to compress
+	_runningStatusEnabled = enabled;
+}
+
+bool MidiLoopbackOutPort::isRunningStatusEnabled() const
+{
+	return _runningStatusEnabled;
+}
+
+void MidiLoopbackOutPort::setNoteTrackingEnabled(bool enabled)
+{
+	_activeNotes.setEnabled(enabled);
+}
+
+bool MidiLoopbackOutPort::isNoteTrackingEnabled() const
+{
+	return _activeNotes.isEnabled();
+}
+
+void MidiLoopbackOutPort::releaseNotes()
+{
+	const std::vector<MidiMessage> messages = _activeNotes.takeReleaseMessages();
+	sendMessages(messages.data(), messages.size());
+}
+
+void MidiLoopbackOutPort::setCoalescing(const Coalescing& coalescing)
+{
+	_coalescer.setCoalescing(coalescing);
+}
+
+MidiOutPort::Coalescing MidiLoopbackOutPort::coalescing() const
+{
+	return _coalescer.coalescing();
+}
+
+MidiSync& MidiLoopbackOutPort::sync()
+{
+	return _sync;
+}
+
+void MidiLoopbackOutPort::sendSyncMessage(const MidiMessage& message)
+{
+	sendMessage(message);
+	if (message.data().front() == MidiMessage::MidiStop && _activeNotes.isEnabled())
+	{
+		releaseNotes();
+	}
+}
+
+//! \endcond
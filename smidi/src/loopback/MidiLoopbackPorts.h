@@ -0,0 +1,134 @@
+#pragma once
+
+//! \cond INTERNAL
+
+/*!
+ * \file MidiLoopbackPorts.h
+ * \warning This file is not a part of library public interface!
+ */
+
+#include "../../include/smidi/MidiInPort.h"
+#include "../../include/smidi/MidiOutPort.h"
+#include "../../include/smidi/MidiMessageDispatcher.h"
+#include "../MidiActiveNotes.h"
+#include "../MidiCoalescer.h"
+#include "../MidiMetricsCounters.h"
+#include "../MidiMessageWaiterList.h"
+#include "../MidiSoftwareSync.h"
+#include "MidiLoopbackChannel.h"
+#include <thread>
+#include <atomic>
+#include <memory>
+
+/*!
+ * \brief The MidiLoopbackInPort class receives messages sent to MidiLoopbackOutPort of the same channel
+ * \class MidiLoopbackInPort MidiLoopbackPorts.h "MidiLoopbackPorts.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Messages are dispatched when the channel clock reaches their delivery time. While messages are in flight
+ * the poll descriptor stays readable, so in DispatchMode::CallerThread the application has to call
+ * processPending() until they are delivered.
+ */
+class MidiLoopbackInPort : public MidiInPort
+{
+	// the input thread waiting for a message in flight checks for stop at least this often
+	static const unsigned long long kSleepSliceInNanoseconds = 10000000ULL;
+
+public:
+	MidiLoopbackInPort(const std::string& name, std::shared_ptr<MidiLoopbackChannel> channel);
+	virtual ~MidiLoopbackInPort();
+
+	virtual const std::string& name() const override;
+
+	virtual void start() override;
+	virtual void stop() override;
+
+	virtual MidiPortMetrics metrics() const override;
+
+	virtual void setMessageHandler(MessageHandler handler) override;
+	virtual void setMessageHandler(MidiMessage::Type type, MessageHandler handler) override;
+	virtual void resetMessageHandlers() override;
+
+	virtual void setDispatchMode(DispatchMode mode) override;
+	virtual DispatchMode dispatchMode() const override;
+	virtual int pollDescriptor() const override;
+	virtual std::size_t processPending() override;
+
+	virtual void addWaiter(MidiMessageWaiter& waiter) override;
+	virtual bool removeWaiter(MidiMessageWaiter& waiter) override;
+
+private:
+	bool startInputThread();
+	void stopInputThread();
+	void midiInputThread();
+
+	//! Dispatches due messages, returns their number and the delivery time of the next message (0 if there is none)
+	std::size_t processDueMessages(unsigned long long& nextDeliveryTime);
+
+private:
+	std::string                          _name;
+	std::shared_ptr<MidiLoopbackChannel> _channel;
+	MidiMessageDispatcher                _dispatcher;
+	MidiPortCounters                     _counters;
+	MidiMessageWaiterList                _waiters;
+	std::thread                          _thread;
+	DispatchMode                         _dispatchMode;
+	std::atomic<bool>                    _poll;
+	unsigned long long                   _lastDeliveryTime;
+};
+
+/*!
+ * \brief The MidiLoopbackOutPort class sends messages to MidiLoopbackInPort of the same channel
+ * \class MidiLoopbackOutPort MidiLoopbackPorts.h "MidiLoopbackPorts.h"
+ * \warning This class is not a part of library public interface!
+ *
+ * Sending never blocks: a message that doesn't fit into the channel ring is lost and counted as overrun.
+ */
+class MidiLoopbackOutPort : public MidiOutPort
+{
+public:
+	MidiLoopbackOutPort(const std::string& name, std::shared_ptr<MidiLoopbackChannel> channel, std::shared_ptr<MidiClock> clock);
+	virtual ~MidiLoopbackOutPort();
+
+	virtual const std::string& name() const override;
+
+	virtual void start() override;
+	virtual void stop() override;
+
+	virtual MidiPortMetrics metrics() const override;
+
+	virtual void sendMessage(const MidiMessage& message) override;
+	virtual void sendMessages(const MidiMessage* messages, std::size_t count) override;
+	virtual bool scheduleMessages(const MidiMessage* messages, std::size_t count) override;
+	virtual void cancelScheduledMessages() override;
+
+	virtual void setRunningStatusEnabled(bool enabled) override;
+	virtual bool isRunningStatusEnabled() const override;
+
+	virtual void setNoteTrackingEnabled(bool enabled) override;
+	virtual bool isNoteTrackingEnabled() const override;
+	virtual void releaseNotes() override;
+
+	virtual void setCoalescing(const Coalescing& coalescing) override;
+	virtual Coalescing coalescing() const override;
+
+	virtual MidiSync& sync() override;
+
+private:
+	//! Pushes the messages to the channel, the sender of the coalescer
+	void outputMessages(const MidiMessage* messages, std::size_t count);
+
+	//! Sender of the sync, MIDI Stop also releases the notes
+	void sendSyncMessage(const MidiMessage& message);
+
+private:
+	std::string                          _name;
+	std::shared_ptr<MidiLoopbackChannel> _channel;
+	MidiPortCounters                     _counters;
+	MidiActiveNotes                      _activeNotes;
+	MidiCoalescer                        _coalescer;
+	std::atomic<bool>                    _runningStatusEnabled;
+	MidiSoftwareSync                     _sync;
+};
+
+//! \endcond
@@ -0,0 +1,149 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiCapture.h>
+#include <smidi/MidiLoopback.h>
+#include <smidi/MidiOutPort.h>
+#include "TemporaryFile.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Bytes = std::vector<unsigned char>;
+
+	struct Record
+	{
+		unsigned long long timestamp;
+		std::size_t        port;
+		Bytes              data;
+	};
+
+	std::vector<Record> readAll(MidiCaptureReader& reader)
+	{
+		std::vector<Record> result;
+		MidiCaptureRecord record;
+		while (reader.next(record))
+		{
+			result.push_back(Record{record.timestamp, record.port, Bytes(record.data, record.data + record.size)});
+		}
+		return result;
+	}
+}
+
+SUITE(MidiCaptureTests)
+{
+	TEST(MidiCaptureWritesReadableFile)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual, 1000000000);
+		MidiLoopback keyboard("Keyboard", clock);
+		keyboard.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		MidiCapture capture(MidiCapture::Options(), clock);
+		CHECK_EQUAL(0u, capture.addPort(keyboard.inputPort()->name()));
+		keyboard.inputPort()->setMessageHandler(capture.handler(0));
+		const std::size_t synth = capture.addPort("Synth");
+		CHECK_EQUAL(1u, synth);
+
+		const TemporaryFile temporary("smidi_capture");
+		const std::string& path = temporary.path();
+		CHECK(capture.open(path));
+		CHECK(capture.isCapturing());
+		CHECK(!capture.open(path));
+
+		keyboard.outputPort()->sendMessage({MidiMessage::NoteOn, 60, 100});
+		keyboard.inputPort()->processPending();
+		clock->advance(1500);
+		keyboard.outputPort()->sendMessage({MidiMessage::SysEx, 0x7E, 0x7F, 0x09, 0x01, MidiMessage::SysExEnd});
+		keyboard.inputPort()->processPending();
+		// sent messages are stamped when they go out, possibly earlier than the last received one
+		capture.capture(synth, MidiMessage({MidiMessage::ControlChange, 7, 90}, 999999000));
+		clock->advance(3000000000ull);
+		capture.capture(synth, {MidiMessage::MidiClock});
+		CHECK(capture.close());
+		CHECK(!capture.isCapturing());
+		CHECK(!capture.close());
+		CHECK_EQUAL(4u, capture.counters().captured);
+		CHECK_EQUAL(0u, capture.counters().dropped);
+		CHECK_EQUAL(0u, capture.counters().overwritten);
+
+		MidiCaptureReader reader;
+		CHECK(reader.open(path));
+		CHECK(reader.portNames() == std::vector<std::string>({keyboard.inputPort()->name(), "Synth"}));
+		const std::vector<Record> records = readAll(reader);
+		CHECK_EQUAL(4u, records.size());
+		if (records.size() != 4)
+		{
+			return;
+		}
+		CHECK(records[0].data == Bytes({MidiMessage::NoteOn, 60, 100}));
+		CHECK_EQUAL(1000000000ull, records[0].timestamp);
+		CHECK_EQUAL(0u, records[0].port);
+		CHECK(records[1].data == Bytes({MidiMessage::SysEx, 0x7E, 0x7F, 0x09, 0x01, MidiMessage::SysExEnd}));
+		CHECK_EQUAL(1000001500ull, records[1].timestamp);
+		CHECK(records[2].data == Bytes({MidiMessage::ControlChange, 7, 90}));
+		CHECK_EQUAL(999999000ull, records[2].timestamp);
+		CHECK_EQUAL(1u, records[2].port);
+		CHECK(records[3].data == Bytes({MidiMessage::MidiClock}));
+		CHECK_EQUAL(4000001500ull, records[3].timestamp);
+
+		reader.rewind();
+		CHECK_EQUAL(4u, readAll(reader).size());
+		reader.close();
+	}
+
+	TEST(MidiCaptureOverwritesOldestBlocks)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual);
+		MidiCapture::Options options;
+		options.blockSize = 256;
+		options.fileSize = 4096 + 4 * options.blockSize;
+		MidiCapture capture(options, clock);
+		const std::size_t port = capture.addPort("Generator");
+
+		const TemporaryFile temporary("smidi_capture");
+		const std::string& path = temporary.path();
+		CHECK(capture.open(path));
+		const unsigned long long count = 1000;
+		for (unsigned long long i = 0; i < count; ++i)
+		{
+			capture.capture(port, MidiMessage({MidiMessage::NoteOn, static_cast<unsigned char>(i % 128), 100}, 1000 * (i + 1)));
+		}
+		// a message that can never fit a block
+		capture.capture(port, MidiMessage(Bytes(300, 0x01)));
+		CHECK(capture.close());
+		CHECK_EQUAL(count, capture.counters().captured);
+		CHECK_EQUAL(1u, capture.counters().dropped);
+		CHECK(capture.counters().overwritten > 0);
+
+		MidiCaptureReader reader;
+		CHECK(reader.open(path));
+		const std::vector<Record> records = readAll(reader);
+		CHECK(!records.empty() && records.size() < count);
+		if (records.empty())
+		{
+			return;
+		}
+		// the newest records survive, in order and without gaps
+		const unsigned long long first = count - records.size();
+		for (std::size_t i = 0; i < records.size(); ++i)
+		{
+			CHECK_EQUAL(1000 * (first + i + 1), records[i].timestamp);
+			CHECK(records[i].data == Bytes({MidiMessage::NoteOn, static_cast<unsigned char>((first + i) % 128), 100}));
+		}
+		reader.close();
+	}
+
+	TEST(MidiCaptureReaderRejectsOtherFiles)
+	{
+		const TemporaryFile temporary("smidi_capture");
+		const std::string& path = temporary.path();
+		{
+			std::ofstream file(path, std::ios::binary);
+			file << std::string(8192, 'M');
+		}
+		MidiCaptureReader reader;
+		CHECK(!reader.open(path));
+		CHECK(!reader.isOpen());
+		MidiCaptureRecord record;
+		CHECK(!reader.next(record));
+	}
+}
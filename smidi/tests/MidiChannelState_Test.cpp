@@ -0,0 +1,174 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiChannelState.h>
+#include <smidi/MidiLoopback.h>
+#include <smidi/MidiOutPort.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Bytes = std::vector<unsigned char>;
+
+	std::vector<Bytes> bytesOf(const std::vector<MidiMessage>& messages)
+	{
+		std::vector<Bytes> result;
+		for (const MidiMessage& message : messages)
+		{
+			result.push_back(Bytes(message.data().begin(), message.data().end()));
+		}
+		return result;
+	}
+}
+
+SUITE(MidiChannelStateTests)
+{
+	TEST(MidiChannelStateTracksInputPort)
+	{
+		MidiLoopback loopback("Keyboard");
+		loopback.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		MidiChannelState state;
+		loopback.inputPort()->setMessageHandler(state.handler());
+
+		CHECK_EQUAL(MidiChannelState::kUnknown, state.controller(2, 7));
+		CHECK_EQUAL(MidiChannelState::kUnknownPitchBend, state.pitchBend(2));
+		const std::vector<MidiMessage> sent = {
+			{MidiMessage::ControlChange | 2, 7, 90},
+			{MidiMessage::NoteOn | 2, 60, 100},
+			{MidiMessage::NoteOn | 2, 64, 80},
+			{MidiMessage::AfterTouch | 2, 64, 33},
+			{MidiMessage::NoteOn | 2, 60, 0},
+			{MidiMessage::ProgramChange | 2, 12},
+			{MidiMessage::ChannelPressure | 2, 70},
+			{MidiMessage::PitchWheel | 2, 0x01, 0x50},
+			{MidiMessage::MidiClock}
+		};
+		for (const MidiMessage& message : sent)
+		{
+			loopback.outputPort()->sendMessage(message);
+		}
+		loopback.inputPort()->processPending();
+
+		CHECK_EQUAL(90u, state.controller(2, 7));
+		CHECK_EQUAL(MidiChannelState::kUnknown, state.controller(3, 7));
+		CHECK_EQUAL(0u, state.noteVelocity(2, 60));
+		CHECK_EQUAL(80u, state.noteVelocity(2, 64));
+		CHECK_EQUAL(33u, state.polyPressure(2, 64));
+		CHECK_EQUAL(12u, state.program(2));
+		CHECK_EQUAL(70u, state.channelPressure(2));
+		CHECK_EQUAL(0x50u * 128 + 1, state.pitchBend(2));
+		loopback.inputPort()->setMessageHandler(MidiInPort::MessageHandler());
+	}
+
+	TEST(MidiChannelStateFollowsChannelModeMessages)
+	{
+		MidiChannelState state;
+		state.process({MidiMessage::NoteOn, 60, 100});
+		state.process({MidiMessage::NoteOn | 1, 60, 100});
+		state.process({MidiMessage::ControlChange, 64, 127});
+		state.process({MidiMessage::ControlChange, 7, 100});
+		state.process({MidiMessage::PitchWheel, 0x00, 0x7F});
+
+		// All Notes Off only on channel 0
+		state.process({MidiMessage::ControlChange, 123, 0});
+		CHECK_EQUAL(0u, state.noteVelocity(0, 60));
+		CHECK_EQUAL(100u, state.noteVelocity(1, 60));
+		CHECK_EQUAL(MidiChannelState::kUnknown, state.controller(0, 123));
+
+		// Reset All Controllers: sustain off, bend to the center, volume untouched
+		state.process({MidiMessage::ControlChange, 121, 0});
+		CHECK_EQUAL(0u, state.controller(0, 64));
+		CHECK_EQUAL(127u, state.controller(0, 11));
+		CHECK_EQUAL(100u, state.controller(0, 7));
+		CHECK_EQUAL(8192u, state.pitchBend(0));
+		CHECK_EQUAL(0u, state.channelPressure(0));
+
+		state.process({MidiMessage::Reset});
+		CHECK_EQUAL(0u, state.noteVelocity(1, 60));
+		CHECK_EQUAL(MidiChannelState::kUnknown, state.controller(0, 7));
+		CHECK_EQUAL(MidiChannelState::kUnknownPitchBend, state.pitchBend(0));
+	}
+
+	TEST(MidiChannelStateRestoresOnlyKnownValues)
+	{
+		MidiChannelState state;
+		state.process({MidiMessage::ControlChange | 3, 7, 100});
+		state.process({MidiMessage::ProgramChange | 3, 5});
+		state.process({MidiMessage::ControlChange | 3, 0, 1});
+		state.process({MidiMessage::ControlChange | 3, 101, 0});
+		state.process({MidiMessage::ControlChange | 3, 100, 0});
+		state.process({MidiMessage::ControlChange | 3, 6, 12});
+		state.process({MidiMessage::PitchWheel | 3, 0x00, 0x40});
+		state.process({MidiMessage::NoteOn | 9, 36, 127});
+
+		const std::vector<Bytes> expected = {
+			{MidiMessage::ControlChange | 3, 0, 1},
+			{MidiMessage::ProgramChange | 3, 5},
+			{MidiMessage::ControlChange | 3, 7, 100},
+			{MidiMessage::PitchWheel | 3, 0x00, 0x40}
+		};
+		CHECK(expected == bytesOf(state.restoreMessages()));
+
+		std::vector<Bytes> withNotes = expected;
+		withNotes.push_back({MidiMessage::NoteOn | 9, 36, 127});
+		CHECK(withNotes == bytesOf(state.restoreMessages(true)));
+	}
+
+	TEST(MidiChannelStateSnapshotIsConsistent)
+	{
+		MidiChannelState state;
+		std::atomic<bool> stop(false);
+		std::thread writer([&state, &stop]()
+		{
+			for (unsigned int i = 0; !stop.load(); ++i)
+			{
+				// controllers 1 and 2 always change together
+				state.process({MidiMessage::ControlChange, 1, static_cast<unsigned char>(i % 128)});
+				state.process({MidiMessage::ControlChange, 2, static_cast<unsigned char>(i % 128)});
+			}
+		});
+
+		bool isConsistent = true;
+		for (int i = 0; i < 10000; ++i)
+		{
+			const MidiChannelState::Snapshot snapshot = state.snapshot();
+			const unsigned int first = snapshot.controllers[0][1];
+			const unsigned int second = snapshot.controllers[0][2];
+			isConsistent = isConsistent && (first == second || (second == MidiChannelState::kUnknown && first == 0) || (second + 1) % 128 == first);
+		}
+		stop = true;
+		writer.join();
+		CHECK(isConsistent);
+	}
+
+	TEST(MidiChannelStateResetsFromAnotherThread)
+	{
+		MidiChannelState state;
+		std::atomic<bool> stop(false);
+		std::thread writer([&state, &stop]()
+		{
+			for (unsigned int i = 0; !stop.load(); ++i)
+			{
+				state.process({MidiMessage::ControlChange, 1, static_cast<unsigned char>(i % 128)});
+				state.process({MidiMessage::ControlChange, 2, static_cast<unsigned char>(i % 128)});
+			}
+		});
+
+		// a reset never lands in the middle of a message, so a controller is unknown or they are one message apart
+		bool isConsistent = true;
+		for (int i = 0; i < 1000; ++i)
+		{
+			state.reset();
+			const MidiChannelState::Snapshot snapshot = state.snapshot();
+			const unsigned int first = snapshot.controllers[0][1];
+			const unsigned int second = snapshot.controllers[0][2];
+			isConsistent = isConsistent && (first == MidiChannelState::kUnknown || second == MidiChannelState::kUnknown || first == second || (second + 1) % 128 == first);
+		}
+		stop = true;
+		writer.join();
+		CHECK(isConsistent);
+
+		state.reset();
+		CHECK_EQUAL(MidiChannelState::kUnknown, state.controller(0, 1));
+	}
+}
@@ -0,0 +1,134 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiFileRecorder.h>
+#include <smidi/MidiFile.h>
+#include <smidi/MidiLoopback.h>
+#include <smidi/MidiOutPort.h>
+#include "TemporaryFile.h"
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Bytes = std::vector<unsigned char>;
+
+	MidiFileRecorder::Options millisecondTicks()
+	{
+		// 500 ticks per quarter note at 120 BPM: a tick is a millisecond
+		MidiFileRecorder::Options options;
+		options.ticksPerQuarterNote = 500;
+		return options;
+	}
+}
+
+SUITE(MidiFileRecorderTests)
+{
+	TEST(MidiFileRecorderWritesReadableFile)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual, 1000000000);
+		MidiLoopback keyboard("Keyboard", clock);
+		MidiLoopback pads("Pads", clock);
+		keyboard.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		pads.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		MidiFileRecorder recorder(millisecondTicks(), clock);
+		keyboard.inputPort()->setMessageHandler(recorder.handler());
+		pads.inputPort()->setMessageHandler(recorder.handler());
+
+		const TemporaryFile temporary("smidi_recorder");
+		const std::string& path = temporary.path();
+		CHECK(recorder.open(path));
+		CHECK(recorder.isRecording());
+
+		const std::vector<MidiMessage> sent = {
+			{MidiMessage::NoteOn, 60, 100},
+			{MidiMessage::NoteOn, 64, 90},
+			{MidiMessage::SysEx, 0x7E, 0x7F, 0x09, 0x01, MidiMessage::SysExEnd},
+			{MidiMessage::MidiStart},
+			{MidiMessage::NoteOn | 9, 36, 127},
+			{MidiMessage::NoteOn, 60, 0}
+		};
+		for (std::size_t i = 0; i < sent.size(); ++i)
+		{
+			MidiLoopback& loopback = (i == 4) ? pads : keyboard;
+			loopback.outputPort()->sendMessage(sent[i]);
+			clock->advance(250000000);
+			loopback.inputPort()->processPending();
+		}
+		CHECK(recorder.close());
+		CHECK(!recorder.isRecording());
+		CHECK_EQUAL(sent.size(), recorder.counters().recorded);
+		CHECK_EQUAL(0u, recorder.counters().dropped);
+
+		MidiFile file;
+		CHECK(file.open(path));
+		CHECK_EQUAL(0u, file.format());
+		CHECK_EQUAL(500000u, file.tempoMap().tempoAt(0));
+		std::vector<Bytes> received;
+		std::vector<unsigned long long> ticks;
+		bool hasEndOfTrack = false;
+		for (const MidiFileEvent& event : file.events())
+		{
+			if (event.isMessage())
+			{
+				const MidiMessage message = event.toMessage();
+				received.push_back(Bytes(message.data().begin(), message.data().end()));
+				ticks.push_back(event.tick);
+			}
+			hasEndOfTrack = hasEndOfTrack || event.metaType == MidiFileEvent::kMetaEndOfTrack;
+		}
+		CHECK(hasEndOfTrack);
+		CHECK_EQUAL(sent.size(), received.size());
+		for (std::size_t i = 0; i < std::min(sent.size(), received.size()); ++i)
+		{
+			CHECK(Bytes(sent[i].data().begin(), sent[i].data().end()) == received[i]);
+			CHECK_EQUAL(250u * i, ticks[i]);
+		}
+		file.close();
+	}
+
+	TEST(MidiFileRecorderIgnoresMessagesWhileStopped)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual);
+		MidiLoopback keyboard("Keyboard", clock);
+		keyboard.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		MidiFileRecorder recorder(millisecondTicks(), clock);
+		// the application keeps its own handler and chains the recorder
+		std::size_t handled = 0;
+		keyboard.inputPort()->setMessageHandler([&recorder, &handled](const MidiMessage& message)
+		{
+			++handled;
+			recorder.record(message);
+		});
+
+		keyboard.outputPort()->sendMessage({MidiMessage::NoteOn, 60, 100});
+		keyboard.inputPort()->processPending();
+
+		const TemporaryFile temporary("smidi_recorder");
+		const std::string& path = temporary.path();
+		CHECK(recorder.open(path));
+		CHECK(!recorder.open(path));
+		clock->advance(1000000);
+		keyboard.outputPort()->sendMessage({MidiMessage::ControlChange, 64, 127});
+		keyboard.inputPort()->processPending();
+		CHECK(recorder.close());
+		CHECK(!recorder.close());
+
+		keyboard.outputPort()->sendMessage({MidiMessage::NoteOn, 62, 100});
+		keyboard.inputPort()->processPending();
+
+		MidiFile file;
+		CHECK(file.open(path));
+		std::size_t messages = 0;
+		for (const MidiFileEvent& event : file.events())
+		{
+			if (event.isMessage())
+			{
+				++messages;
+				CHECK_EQUAL(MidiMessage::ControlChange, event.status);
+				CHECK_EQUAL(1u, event.tick);
+			}
+		}
+		CHECK_EQUAL(1u, messages);
+		CHECK_EQUAL(3u, handled);
+		file.close();
+	}
+}
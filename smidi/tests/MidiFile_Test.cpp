@@ -0,0 +1,218 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiFile.h>
+#include <smidi/MidiTempoMap.h>
+#include "TemporaryFile.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Bytes = std::vector<unsigned char>;
+
+	void appendUint32(Bytes& bytes, unsigned long long value)
+	{
+		for (int shift = 24; shift >= 0; shift -= 8)
+		{
+			bytes.push_back(static_cast<unsigned char>(value >> shift));
+		}
+	}
+
+	Bytes standardMidiFile(unsigned int format, unsigned int division, const std::vector<Bytes>& tracks)
+	{
+		Bytes result = {'M', 'T', 'h', 'd', 0, 0, 0, 6};
+		result.push_back(0);
+		result.push_back(static_cast<unsigned char>(format));
+		result.push_back(0);
+		result.push_back(static_cast<unsigned char>(tracks.size()));
+		result.push_back(static_cast<unsigned char>(division >> 8));
+		result.push_back(static_cast<unsigned char>(division));
+		for (const Bytes& track : tracks)
+		{
+			result.insert(result.end(), {'M', 'T', 'r', 'k'});
+			appendUint32(result, track.size());
+			result.insert(result.end(), track.begin(), track.end());
+		}
+		return result;
+	}
+
+	struct Event
+	{
+		unsigned long long tick;
+		unsigned long long time;
+		unsigned int       track;
+		Bytes              bytes;
+	};
+
+	std::vector<Event> messages(const MidiFile::EventRange& range)
+	{
+		std::vector<Event> result;
+		MidiMessage message;
+		for (const MidiFileEvent& event : range)
+		{
+			if (event.isMessage())
+			{
+				event.copyTo(message);
+				result.push_back(Event{event.tick, event.time, event.track, Bytes(message.data().begin(), message.data().end())});
+			}
+		}
+		return result;
+	}
+}
+
+SUITE(MidiFileTests)
+{
+	TEST(MidiTempoMapConvertsTicks)
+	{
+		MidiTempoMap tempoMap(96);
+		CHECK_EQUAL(500000000u, tempoMap.timeAt(96));
+		tempoMap.addTempo(192, 1000000);
+		CHECK_EQUAL(1000000000u, tempoMap.timeAt(192));
+		CHECK_EQUAL(2000000000u, tempoMap.timeAt(288));
+		CHECK_EQUAL(1000000u, tempoMap.tempoAt(300));
+		CHECK_EQUAL(288u, tempoMap.tickAt(2000000000));
+		CHECK_EQUAL(96u, tempoMap.tickAt(500000000));
+
+		std::size_t hint = 0;
+		CHECK_EQUAL(500000000u, tempoMap.timeAt(96, hint));
+		CHECK_EQUAL(2000000000u, tempoMap.timeAt(288, hint));
+		CHECK_EQUAL(1u, hint);
+
+		// 25 frames per second, 40 ticks per frame: 1 ms per tick
+		const MidiTempoMap smpte = MidiTempoMap::smpte(25, 40);
+		CHECK(smpte.isSmpte());
+		CHECK_EQUAL(1000000000u, smpte.timeAt(1000));
+		CHECK_EQUAL(1000u, smpte.tickAt(1000000000));
+	}
+
+	TEST(MidiFileDecodesSingleTrack)
+	{
+		const Bytes data = standardMidiFile(0, 96, {{
+			0x00, 0xFF, 0x51, 0x03, 0x0F, 0x42, 0x40, // 60 BPM
+			0x00, 0x90, 0x3C, 0x64,
+			0x60, 0x3C, 0x00,                         // running status
+			0x81, 0x40, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20, // 120 BPM at tick 288
+			0x60, 0xC0, 0x05,
+			0x00, 0xFF, 0x2F, 0x00
+		}});
+		MidiFile file;
+		CHECK(file.open(data.data(), data.size()));
+		CHECK_EQUAL(0u, file.format());
+		CHECK_EQUAL(1u, file.trackCount());
+		CHECK_EQUAL(1u, file.tempoMap().size());
+
+		const std::vector<Event> events = messages(file.events());
+		CHECK_EQUAL(3u, events.size());
+		if (events.size() != 3)
+		{
+			return;
+		}
+		CHECK(events[0].bytes == Bytes({0x90, 0x3C, 0x64}));
+		CHECK_EQUAL(0u, events[0].time);
+		CHECK(events[1].bytes == Bytes({0x90, 0x3C, 0x00}));
+		CHECK_EQUAL(96u, events[1].tick);
+		CHECK_EQUAL(1000000000u, events[1].time);
+		CHECK(events[2].bytes == Bytes({0xC0, 0x05}));
+		CHECK_EQUAL(384u, events[2].tick);
+		CHECK_EQUAL(3500000000u, events[2].time);
+	}
+
+	TEST(MidiFileMergesTracksByTick)
+	{
+		const Bytes conductor = {0x00, 0xFF, 0x51, 0x03, 0x0F, 0x42, 0x40, 0x00, 0xFF, 0x2F, 0x00};
+		const Bytes first = {0x00, 0x90, 0x30, 0x40, 0x60, 0x80, 0x30, 0x00, 0x00, 0xFF, 0x2F, 0x00};
+		const Bytes second = {0x30, 0x91, 0x40, 0x40, 0x30, 0x81, 0x40, 0x00, 0x00, 0xFF, 0x2F, 0x00};
+		const Bytes data = standardMidiFile(1, 96, {conductor, first, second});
+		MidiFile file;
+		CHECK(file.open(data.data(), data.size()));
+		CHECK_EQUAL(3u, file.trackCount());
+
+		const std::vector<Event> events = messages(file.events());
+		CHECK_EQUAL(4u, events.size());
+		if (events.size() != 4)
+		{
+			return;
+		}
+		CHECK_EQUAL(0u, events[0].tick);
+		CHECK_EQUAL(1u, events[0].track);
+		CHECK_EQUAL(48u, events[1].tick);
+		CHECK_EQUAL(2u, events[1].track);
+		CHECK_EQUAL(500000000u, events[1].time);
+		// the same tick: the lower track goes first
+		CHECK_EQUAL(96u, events[2].tick);
+		CHECK_EQUAL(1u, events[2].track);
+		CHECK_EQUAL(96u, events[3].tick);
+		CHECK_EQUAL(2u, events[3].track);
+		CHECK_EQUAL(1000000000u, events[3].time);
+
+		CHECK_EQUAL(2u, messages(file.trackEvents(2)).size());
+		CHECK(messages(file.trackEvents(3)).empty());
+	}
+
+	TEST(MidiFileDecodesSysExAndEscapes)
+	{
+		const Bytes data = standardMidiFile(0, 96, {{
+			0x00, 0xF0, 0x04, 0x7E, 0x7F, 0x09, 0xF7,
+			0x10, 0xF7, 0x01, 0xF8,
+			0x00, 0xFF, 0x2F, 0x00
+		}});
+		MidiFile file;
+		CHECK(file.open(data.data(), data.size()));
+		const std::vector<Event> events = messages(file.events());
+		CHECK_EQUAL(2u, events.size());
+		if (events.size() != 2)
+		{
+			return;
+		}
+		CHECK(events[0].bytes == Bytes({0xF0, 0x7E, 0x7F, 0x09, 0xF7}));
+		CHECK(events[1].bytes == Bytes({0xF8}));
+		CHECK_EQUAL(16u, events[1].tick);
+	}
+
+	TEST(MidiFileStopsAtMalformedData)
+	{
+		MidiFile file;
+		const Bytes garbage = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+		CHECK(!file.open(garbage.data(), garbage.size()));
+		CHECK(!file.isOpen());
+
+		// data byte without running status, the track ends there
+		const Bytes data = standardMidiFile(0, 96, {{0x00, 0x90, 0x3C, 0x64, 0x00, 0xFF, 0x01, 0x20, 0x00, 0x3C, 0x00}});
+		CHECK(file.open(data.data(), data.size()));
+		CHECK_EQUAL(1u, messages(file.events()).size());
+
+		// a meta event cancels running status, so the data byte after it isn't a Note On
+		const Bytes afterMeta = standardMidiFile(0, 96, {{0x00, 0x90, 0x3C, 0x64, 0x00, 0xFF, 0x01, 0x00, 0x00, 0x3C, 0x00}});
+		CHECK(file.open(afterMeta.data(), afterMeta.size()));
+		CHECK_EQUAL(1u, messages(file.events()).size());
+
+		// the chunk claims more bytes than there are
+		Bytes truncated = standardMidiFile(0, 96, {{0x00, 0x90, 0x3C, 0x64, 0x00, 0x80, 0x3C}});
+		truncated[21] = 0x40;
+		CHECK(file.open(truncated.data(), truncated.size()));
+		CHECK_EQUAL(1u, messages(file.events()).size());
+	}
+
+	TEST(MidiFileMapsFile)
+	{
+		const Bytes data = standardMidiFile(1, 480, {{0x00, 0x90, 0x3C, 0x64, 0x00, 0xFF, 0x2F, 0x00}});
+		MidiFile file;
+		std::string path;
+		{
+			const TemporaryFile temporary;
+			path = temporary.path();
+			{
+				std::ofstream stream(path, std::ios::binary);
+				stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+			}
+
+			CHECK(file.open(path));
+			CHECK_EQUAL(480u, file.tempoMap().ticksPerQuarterNote());
+			CHECK_EQUAL(1u, messages(file.events()).size());
+			file.close();
+		}
+
+		// the file is removed with the temporary
+		CHECK(!file.open(path));
+	}
+}
@@ -0,0 +1,161 @@
+#include <UnitTest++/UnitTest++.h>
+
+#if defined(__cpp_impl_coroutine)
+
+#include <smidi/MidiDeviceEnumerator.h>
+#include <smidi/MidiDevice.h>
+#include <smidi/MidiInPort.h>
+#include <alsa/asoundlib.h>
+#include <coroutine>
+#include <chrono>
+#include <vector>
+#include <poll.h>
+
+namespace
+{
+	const char* const kLoopbackClientName = "smidi awaitable test";
+
+	/*!
+	 * Sequencer client with a single output port. Input port created by MidiDeviceEnumerator for this
+	 * client receives everything sent from here, which makes a loopback without any hardware.
+	 */
+	class LoopbackSource
+	{
+	public:
+		LoopbackSource()
+		    : _sequencer(nullptr)
+		    , _port(-1)
+		{
+			if (snd_seq_open(&_sequencer, "default", SND_SEQ_OPEN_OUTPUT, 0) == 0)
+			{
+				snd_seq_set_client_name(_sequencer, kLoopbackClientName);
+				_port = snd_seq_create_simple_port(_sequencer, "out", SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ, SND_SEQ_PORT_TYPE_MIDI_GENERIC|SND_SEQ_PORT_TYPE_APPLICATION);
+			}
+			else
+			{
+				_sequencer = nullptr;
+			}
+		}
+
+		~LoopbackSource()
+		{
+			if (_sequencer)
+			{
+				snd_seq_close(_sequencer);
+			}
+		}
+
+		bool isValid() const
+		{
+			return _sequencer && _port >= 0;
+		}
+
+		void send(const std::vector<unsigned char>& bytes)
+		{
+			snd_midi_event_t* encoder = nullptr;
+			snd_midi_event_new(bytes.size(), &encoder);
+			snd_seq_event_t event;
+			snd_seq_ev_clear(&event);
+			snd_midi_event_encode(encoder, bytes.data(), bytes.size(), &event);
+			snd_midi_event_free(encoder);
+
+			snd_seq_ev_set_source(&event, _port);
+			snd_seq_ev_set_subs(&event);
+			snd_seq_ev_set_direct(&event);
+			snd_seq_event_output_direct(_sequencer, &event);
+		}
+
+	private:
+		snd_seq_t* _sequencer;
+		int        _port;
+	};
+
+	//! Minimal eagerly started coroutine type
+	struct Task
+	{
+		struct promise_type
+		{
+			Task get_return_object() { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() {}
+		};
+	};
+
+	Task receiveSequence(MidiInPort& port, std::vector<MidiMessage>& received, bool& done)
+	{
+		// any message
+		received.push_back(co_await port.receive());
+
+		// filtered message, the Control Change sent in between goes to the port handlers
+		const auto isNoteOn = [](const MidiMessage& message) { return message.isActually(MidiMessage::NoteOn); };
+		received.push_back(co_await port.receive(isNoteOn, std::chrono::seconds(1)));
+
+		// timeout
+		const auto rejectAll = [](const MidiMessage&) { return false; };
+		received.push_back(co_await port.receive(rejectAll, std::chrono::milliseconds(20)));
+
+		done = true;
+	}
+
+	void processUntil(MidiInPort& port, const bool& done, std::chrono::milliseconds limit)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + limit;
+		while (!done && std::chrono::steady_clock::now() < deadline)
+		{
+			pollfd descriptor = {port.pollDescriptor(), POLLIN, 0};
+			poll(&descriptor, 1, 5);
+			port.processPending();
+		}
+	}
+}
+
+SUITE(MidiInPortAwaitableTests)
+{
+	TEST(MidiInPortAwaitableLoopback)
+	{
+		LoopbackSource source;
+		if (!source.isValid())
+		{
+			// no ALSA sequencer on this machine
+			return;
+		}
+
+		MidiDeviceEnumerator enumerator;
+		std::shared_ptr<MidiDevice> device = enumerator.createDevice(kLoopbackClientName);
+		CHECK(device && device->inputPorts().size() == 1);
+		if (!device || device->inputPorts().empty())
+		{
+			return;
+		}
+
+		MidiInPort& port = *device->inputPorts().front();
+		port.setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+
+		int controlChanges = 0;
+		port.setMessageHandler(MidiMessage::ControlChange, [&controlChanges](const MidiMessage&) { ++controlChanges; });
+
+		std::vector<MidiMessage> received;
+		bool done = false;
+		receiveSequence(port, received, done);
+
+		source.send({0xF8});
+		source.send({0xB2, 0x07, 0x64});
+		source.send({0x93, 0x3C, 0x40});
+		processUntil(port, done, std::chrono::seconds(2));
+
+		CHECK(done);
+		CHECK_EQUAL(3u, received.size());
+		if (received.size() == 3)
+		{
+			CHECK(received[0].isActually(MidiMessage::MidiClock));
+			CHECK(received[1].isActually(MidiMessage::NoteOn));
+			CHECK_EQUAL(3, received[1].channel());
+			CHECK(received[2].isEmpty());
+		}
+		CHECK_EQUAL(1, controlChanges);
+	}
+}
+
+#endif
@@ -0,0 +1,106 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiLog.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct CapturingSink
+	{
+		std::vector<std::string> records;
+
+		void operator()(MidiLog::Level, const char* text)
+		{
+			records.push_back(text);
+		}
+	};
+
+	void capture(void* context, MidiLog::Level level, const char* text)
+	{
+		(*static_cast<CapturingSink*>(context))(level, text);
+	}
+
+	void captureOnce(void* context, MidiLog::Level level, const char* text)
+	{
+		capture(context, level, text);
+		MidiLog::setSink(nullptr);
+	}
+}
+
+SUITE(MidiLogTests)
+{
+	TEST(MidiLogFormatsRecordsAndFiltersLevels)
+	{
+		// records queued by earlier tests go to the default sink
+		MidiLog::flush();
+
+		CapturingSink sink;
+		MidiLog::setSink(MidiLog::Sink(&capture, &sink));
+		MidiLog::setLevel(MidiLog::Level::Warning);
+
+		MidiLog::write(MidiLog::Level::Error, "port %s failed with %d", "test", -12);
+		MidiLog::write(MidiLog::Level::Info, "filtered out");
+		MidiLog::flush();
+
+		CHECK_EQUAL(1u, sink.records.size());
+		if (!sink.records.empty())
+		{
+			CHECK_EQUAL(std::string("port test failed with -12"), sink.records.front());
+		}
+
+		MidiLog::setLevel(MidiLog::Level::Info);
+		MidiLog::setSink(nullptr);
+	}
+
+	TEST(MidiLogRateLimitsEveryCallSite)
+	{
+		CapturingSink sink;
+		MidiLog::setSink(MidiLog::Sink(&capture, &sink));
+		MidiLog::setRateLimit(2, std::chrono::milliseconds(60000));
+
+		MidiLog::RateLimit rateLimit;
+		for (int i = 0; i < 5; ++i)
+		{
+			MidiLog::write(MidiLog::Level::Error, rateLimit, "repeated %d", i);
+		}
+		MidiLog::RateLimit otherRateLimit;
+		MidiLog::write(MidiLog::Level::Error, otherRateLimit, "other");
+		MidiLog::flush();
+
+		CHECK_EQUAL(3u, sink.records.size());
+		if (sink.records.size() == 3)
+		{
+			CHECK_EQUAL(std::string("repeated 0"), sink.records[0]);
+			CHECK_EQUAL(std::string("repeated 1"), sink.records[1]);
+			CHECK_EQUAL(std::string("other"), sink.records[2]);
+		}
+
+		// suppressed records are reported once the call site is allowed again
+		unsigned int suppressed = 0;
+		MidiLog::setRateLimit(0, std::chrono::milliseconds(0));
+		CHECK(rateLimit.allow(suppressed));
+		MidiLog::setRateLimit(2, std::chrono::milliseconds(0));
+		CHECK(rateLimit.allow(suppressed));
+		CHECK_EQUAL(3u, suppressed);
+
+		MidiLog::setRateLimit(10, std::chrono::milliseconds(1000));
+		MidiLog::setSink(nullptr);
+	}
+
+	TEST(MidiLogSinkMayReplaceItself)
+	{
+		CapturingSink sink;
+		MidiLog::setSink(MidiLog::Sink(&captureOnce, &sink));
+		MidiLog::write(MidiLog::Level::Error, "first");
+		MidiLog::flush();
+
+		// the sink was called without the sink lock held, or it would never return
+		CHECK_EQUAL(1u, sink.records.size());
+	}
+
+	TEST(MidiLogLevelNames)
+	{
+		CHECK_EQUAL(std::string("error"), std::string(MidiLog::levelName(MidiLog::Level::Error)));
+		CHECK_EQUAL(std::string("debug"), std::string(MidiLog::levelName(MidiLog::Level::Debug)));
+	}
+}
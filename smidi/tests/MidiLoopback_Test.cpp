@@ -0,0 +1,388 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiLoopback.h>
+#include <smidi/MidiDevice.h>
+#include <smidi/MidiDeviceEnumerator.h>
+#include <smidi/MidiInPort.h>
+#include <smidi/MidiOutPort.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <poll.h>
+
+namespace
+{
+	struct Received
+	{
+		std::vector<MidiMessage> messages;
+	};
+
+	void collect(void* context, const MidiMessage& message)
+	{
+		static_cast<Received*>(context)->messages.push_back(message);
+	}
+
+	std::shared_ptr<MidiInPort> callerThreadInput(MidiLoopback& loopback, Received& received)
+	{
+		std::shared_ptr<MidiInPort> input = loopback.inputPort();
+		input->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		input->setMessageHandler(MidiInPort::MessageHandler(&collect, &received));
+		return input;
+	}
+
+	bool isReadable(const MidiInPort& port)
+	{
+		pollfd descriptor = {port.pollDescriptor(), POLLIN, 0};
+		return poll(&descriptor, 1, 0) > 0;
+	}
+
+	std::vector<unsigned long long> deliveryTimes(unsigned long long seed)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual);
+		MidiLoopback::Options options;
+		options.jitter = std::chrono::microseconds(300);
+		options.seed = seed;
+		MidiLoopback loopback("Loopback", clock, options);
+		Received received;
+		std::shared_ptr<MidiInPort> input = callerThreadInput(loopback, received);
+
+		for (unsigned char i = 0; i < 32; ++i)
+		{
+			loopback.outputPort()->sendMessage({MidiMessage::NoteOn, i, 100});
+		}
+		clock->advance(1000000);
+		input->processPending();
+
+		std::vector<unsigned long long> result;
+		for (const MidiMessage& message : received.messages)
+		{
+			result.push_back(message.timestamp());
+		}
+		return result;
+	}
+}
+
+SUITE(MidiLoopbackTests)
+{
+	TEST(MidiLoopbackDeliversAfterLatency)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual, 1000);
+		MidiLoopback::Options options;
+		options.latency = std::chrono::microseconds(500);
+		options.jitter = std::chrono::microseconds(100);
+		MidiLoopback loopback("Loopback", clock, options);
+		Received received;
+		std::shared_ptr<MidiInPort> input = callerThreadInput(loopback, received);
+
+		for (unsigned char i = 0; i < 100; ++i)
+		{
+			loopback.outputPort()->sendMessage({MidiMessage::ControlChange, 7, i});
+		}
+
+		// nothing is due yet, but the descriptor tells there are messages in flight
+		CHECK(isReadable(*input));
+		CHECK_EQUAL(0u, input->processPending());
+		CHECK(received.messages.empty());
+
+		clock->advance(600000);
+		CHECK_EQUAL(100u, input->processPending());
+		CHECK(!isReadable(*input));
+
+		CHECK_EQUAL(100u, received.messages.size());
+		unsigned long long previousTimestamp = 0;
+		for (std::size_t i = 0; i < received.messages.size(); ++i)
+		{
+			const MidiMessage& message = received.messages[i];
+			CHECK_EQUAL(i, static_cast<std::size_t>(message.data()[2]));
+			CHECK(message.timestamp() >= 501000 && message.timestamp() <= 601000);
+			CHECK(message.timestamp() >= previousTimestamp);
+			previousTimestamp = message.timestamp();
+		}
+		CHECK_EQUAL(100u, input->metrics().totalMessages());
+		CHECK_EQUAL(100u, loopback.outputPort()->metrics().totalMessages());
+	}
+
+	TEST(MidiLoopbackJitterIsReproducible)
+	{
+		const std::vector<unsigned long long> first = deliveryTimes(42);
+		CHECK_EQUAL(32u, first.size());
+		CHECK(first == deliveryTimes(42));
+		CHECK(first != deliveryTimes(43));
+	}
+
+	TEST(MidiLoopbackCountsOverruns)
+	{
+		MidiLoopback::Options options;
+		options.capacity = 4;
+		MidiLoopback loopback("Loopback", std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual), options);
+		Received received;
+		std::shared_ptr<MidiInPort> input = callerThreadInput(loopback, received);
+
+		std::vector<MidiMessage> messages(10, MidiMessage({MidiMessage::NoteOn, 60, 100}));
+		loopback.outputPort()->sendMessages(messages.data(), messages.size());
+		CHECK_EQUAL(4u, input->processPending());
+		CHECK_EQUAL(6u, loopback.outputPort()->metrics().overruns);
+
+		// the ring is free again
+		loopback.outputPort()->sendMessage(messages.front());
+		CHECK_EQUAL(1u, input->processPending());
+	}
+
+	TEST(MidiLoopbackRemoveWaiterWaitsForCompletion)
+	{
+		MidiLoopback loopback("Loopback", std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual));
+		Received received;
+		std::shared_ptr<MidiInPort> input = callerThreadInput(loopback, received);
+
+		struct Completion
+		{
+			std::atomic<bool> isEntered{false};
+			std::atomic<bool> isFinished{false};
+
+			static void complete(void* context)
+			{
+				Completion* completion = static_cast<Completion*>(context);
+				completion->isEntered = true;
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				completion->isFinished = true;
+			}
+		} completion;
+
+		MidiMessageWaiter waiter;
+		waiter.completion = MidiMessageWaiter::Completion(&Completion::complete, &completion);
+		input->addWaiter(waiter);
+		loopback.outputPort()->sendMessage({MidiMessage::NoteOn, 60, 100});
+
+		std::thread dispatcher([&input]() { input->processPending(); });
+		while (!completion.isEntered)
+		{
+			std::this_thread::yield();
+		}
+
+		// the waiter is claimed already, so it's not removed, but it's safe to destroy once the call returns
+		CHECK(!input->removeWaiter(waiter));
+		CHECK(completion.isFinished);
+		dispatcher.join();
+		CHECK(waiter.completed);
+	}
+
+	TEST(MidiLoopbackSyncIsExactOnSimulatedClock)
+	{
+		// sleeping moves the instant clock forward, so minutes of clocks take milliseconds
+		MidiLoopback loopback("Loopback", std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Instant));
+		Received received;
+		std::shared_ptr<MidiInPort> input = callerThreadInput(loopback, received);
+
+		MidiSync& sync = loopback.outputPort()->sync();
+		sync.startSync(120.0);
+		CHECK(sync.isSyncStarted());
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (received.messages.size() < 100 && std::chrono::steady_clock::now() < deadline)
+		{
+			pollfd descriptor = {input->pollDescriptor(), POLLIN, 0};
+			poll(&descriptor, 1, 5);
+			input->processPending();
+		}
+		sync.stopSync();
+		CHECK(!sync.isSyncStarted());
+
+		CHECK(received.messages.size() >= 100u);
+		if (received.messages.size() < 100u)
+		{
+			return;
+		}
+		CHECK_EQUAL(MidiMessage::SongPosition, received.messages[0].data()[0]);
+		CHECK_EQUAL(MidiMessage::MidiStart, received.messages[1].data()[0]);
+
+		// the ring overflows while the generator runs ahead, but every clock that made it is on the grid
+		const unsigned long long period = 60000000000ULL / (120 * 24);
+		const unsigned long long start = received.messages[1].timestamp();
+		for (std::size_t i = 2; i < received.messages.size(); ++i)
+		{
+			CHECK_EQUAL(MidiMessage::MidiClock, received.messages[i].data()[0]);
+			CHECK_EQUAL(0u, (received.messages[i].timestamp() - start) % period);
+		}
+		CHECK_EQUAL(0, sync.metrics().maxPeriodError);
+		CHECK_EQUAL(0u, sync.metrics().phaseCorrections);
+	}
+
+	TEST(MidiLoopbackReleasesExactlyTheNotesThatAreOn)
+	{
+		MidiLoopback loopback("Loopback");
+		Received received;
+		std::shared_ptr<MidiInPort> input = callerThreadInput(loopback, received);
+		std::shared_ptr<MidiOutPort> output = loopback.outputPort();
+		CHECK(output->isNoteTrackingEnabled());
+
+		const std::vector<MidiMessage> played = {
+			{MidiMessage::NoteOn, 60, 100},
+			{MidiMessage::NoteOn, 64, 100},
+			{MidiMessage::NoteOn | 9, 127, 90},
+			{MidiMessage::NoteOn, 60, 0},
+			{MidiMessage::NoteOn | 3, 40, 80},
+			{MidiMessage::ControlChange | 3, 123, 0},
+			{MidiMessage::NoteOn | 5, 1, 80},
+			{MidiMessage::NoteOff | 5, 1, 64}
+		};
+		output->sendMessages(played.data(), played.size());
+		input->processPending();
+		received.messages.clear();
+
+		output->releaseNotes();
+		input->processPending();
+		const std::vector<std::vector<unsigned char>> expected = {{MidiMessage::NoteOff, 64, 0}, {MidiMessage::NoteOff | 9, 127, 0}};
+		std::vector<std::vector<unsigned char>> released;
+		for (const MidiMessage& message : received.messages)
+		{
+			released.push_back(std::vector<unsigned char>(message.data().begin(), message.data().end()));
+		}
+		CHECK(expected == released);
+
+		// nothing is on anymore
+		received.messages.clear();
+		output->releaseNotes();
+		input->processPending();
+		CHECK(received.messages.empty());
+	}
+
+	TEST(MidiLoopbackSendsAllNotesOffWithoutTracking)
+	{
+		MidiLoopback loopback("Loopback");
+		Received received;
+		std::shared_ptr<MidiInPort> input = callerThreadInput(loopback, received);
+		std::shared_ptr<MidiOutPort> output = loopback.outputPort();
+		output->setNoteTrackingEnabled(false);
+		output->sendMessage({MidiMessage::NoteOn, 60, 100});
+		output->releaseNotes();
+		input->processPending();
+
+		CHECK_EQUAL(17u, received.messages.size());
+		for (std::size_t i = 1; i < received.messages.size(); ++i)
+		{
+			CHECK(std::vector<unsigned char>({static_cast<unsigned char>(MidiMessage::ControlChange | (i - 1)), 123, 0}) == std::vector<unsigned char>(received.messages[i].data().begin(), received.messages[i].data().end()));
+		}
+	}
+
+	TEST(MidiLoopbackReleasesNotesWhenSyncStops)
+	{
+		// real time, so the clocks can't overflow the ring before the Note Off
+		MidiLoopback loopback("Loopback");
+		Received received;
+		std::shared_ptr<MidiInPort> input = callerThreadInput(loopback, received);
+		std::shared_ptr<MidiOutPort> output = loopback.outputPort();
+
+		output->sync().startSync(120.0);
+		output->sendMessage({MidiMessage::NoteOn | 2, 48, 100});
+		output->sync().stopSync();
+
+		// the sync thread sends MIDI Stop and then Note Off
+		bool released = false;
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (!released && std::chrono::steady_clock::now() < deadline)
+		{
+			pollfd descriptor = {input->pollDescriptor(), POLLIN, 0};
+			poll(&descriptor, 1, 5);
+			input->processPending();
+			released = !received.messages.empty() && received.messages.back().data() == MidiMessage::data_type({MidiMessage::NoteOff | 2, 48, 0});
+		}
+		CHECK(released);
+	}
+
+	TEST(MidiLoopbackCoalescesControllersInChannelOrder)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual, 1000000000);
+		MidiLoopback loopback("Loopback", clock);
+		Received received;
+		std::shared_ptr<MidiInPort> input = callerThreadInput(loopback, received);
+		std::shared_ptr<MidiOutPort> output = loopback.outputPort();
+		MidiOutPort::Coalescing coalescing;
+		coalescing.interval = std::chrono::milliseconds(10);
+		output->setCoalescing(coalescing);
+		CHECK(output->coalescing().interval == coalescing.interval);
+
+		// the first value of each goes right away, the rest of the sweep waits and only the last one survives
+		for (unsigned char i = 0; i < 100; ++i)
+		{
+			output->sendMessage({MidiMessage::ControlChange, 1, i});
+			output->sendMessage({MidiMessage::PitchWheel, 0, i});
+		}
+		output->sendMessage({MidiMessage::NoteOn, 60, 100});
+		input->processPending();
+
+		const std::vector<std::vector<unsigned char>> expected = {
+			{MidiMessage::ControlChange, 1, 0},
+			{MidiMessage::PitchWheel, 0, 0},
+			{MidiMessage::ControlChange, 1, 99},
+			{MidiMessage::PitchWheel, 0, 99},
+			{MidiMessage::NoteOn, 60, 100}
+		};
+		std::vector<std::vector<unsigned char>> sent;
+		for (const MidiMessage& message : received.messages)
+		{
+			sent.push_back(std::vector<unsigned char>(message.data().begin(), message.data().end()));
+		}
+		CHECK(expected == sent);
+		CHECK_EQUAL(2u * 98u, output->metrics().coalesced);
+
+		// a value held back without anything after it goes when its interval is over
+		received.messages.clear();
+		output->sendMessage({MidiMessage::ControlChange | 1, 74, 10});
+		output->sendMessage({MidiMessage::ControlChange | 1, 74, 20});
+		input->processPending();
+		CHECK_EQUAL(1u, received.messages.size());
+
+		clock->advance(10000000);
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (received.messages.size() < 2 && std::chrono::steady_clock::now() < deadline)
+		{
+			pollfd descriptor = {input->pollDescriptor(), POLLIN, 0};
+			poll(&descriptor, 1, 5);
+			input->processPending();
+		}
+		CHECK_EQUAL(2u, received.messages.size());
+		if (received.messages.size() == 2)
+		{
+			CHECK(MidiMessage::data_type({MidiMessage::ControlChange | 1, 74, 20}) == received.messages[1].data());
+		}
+	}
+
+	TEST(MidiLoopbackCoalescingStopsWithoutWaitingForTheInterval)
+	{
+		MidiLoopback loopback("Loopback");
+		Received received;
+		std::shared_ptr<MidiInPort> input = callerThreadInput(loopback, received);
+		std::shared_ptr<MidiOutPort> output = loopback.outputPort();
+		MidiOutPort::Coalescing coalescing;
+		coalescing.interval = std::chrono::seconds(10);
+		output->setCoalescing(coalescing);
+
+		// the second value waits for the flusher thread, which sleeps until its interval is over
+		output->sendMessage({MidiMessage::ControlChange, 7, 10});
+		output->sendMessage({MidiMessage::ControlChange, 7, 20});
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+		const auto start = std::chrono::steady_clock::now();
+		output->setCoalescing(MidiOutPort::Coalescing());
+		CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+
+		input->processPending();
+		CHECK_EQUAL(2u, received.messages.size());
+	}
+
+	TEST(MidiLoopbackEnumerator)
+	{
+		MidiDeviceEnumerator enumerator(MidiDeviceEnumerator::Backend::Loopback);
+		CHECK(enumerator.deviceNames() == std::list<std::string>{MidiDeviceEnumerator::kLoopbackDeviceName});
+
+		std::shared_ptr<MidiDevice> device = enumerator.createDevice(MidiDeviceEnumerator::kLoopbackDeviceName);
+		CHECK(device != nullptr);
+		if (!device)
+		{
+			return;
+		}
+		CHECK_EQUAL(1u, device->inputPorts().size());
+		CHECK_EQUAL(1u, device->outputPorts().size());
+		CHECK(device == enumerator.createDevice(MidiDeviceEnumerator::kLoopbackDeviceName));
+		CHECK(enumerator.createDevice("Unknown") == nullptr);
+	}
+}
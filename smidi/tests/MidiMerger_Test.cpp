@@ -0,0 +1,194 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiMerger.h>
+#include <smidi/MidiLoopback.h>
+#include <smidi/MidiOutPort.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <poll.h>
+
+namespace
+{
+	struct Merged
+	{
+		std::vector<MidiMessage> messages;
+		std::vector<std::size_t> inputs;
+	};
+
+	void collect(void* context, std::size_t input, const MidiMessage& message)
+	{
+		Merged* merged = static_cast<Merged*>(context);
+		merged->messages.push_back(message);
+		merged->inputs.push_back(input);
+	}
+
+	std::unique_ptr<MidiLoopback> callerThreadLoopback(std::shared_ptr<MidiClock> clock, std::chrono::nanoseconds latency, std::chrono::nanoseconds jitter = std::chrono::nanoseconds(0), unsigned long long seed = 0)
+	{
+		MidiLoopback::Options options;
+		options.latency = latency;
+		options.jitter = jitter;
+		options.seed = seed;
+		std::unique_ptr<MidiLoopback> loopback(new MidiLoopback("Loopback", std::move(clock), options));
+		loopback->inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		return loopback;
+	}
+
+	MidiMerger::Options callerThreadOptions(std::chrono::nanoseconds reorderWindow)
+	{
+		MidiMerger::Options options;
+		options.reorderWindow = reorderWindow;
+		options.dispatchMode = MidiInPort::DispatchMode::CallerThread;
+		return options;
+	}
+}
+
+SUITE(MidiMergerTests)
+{
+	TEST(MidiMergerWaitsForReorderWindow)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual);
+		std::unique_ptr<MidiLoopback> slow = callerThreadLoopback(clock, std::chrono::microseconds(800));
+		std::unique_ptr<MidiLoopback> fast = callerThreadLoopback(clock, std::chrono::microseconds(100));
+		MidiMerger merger(2, callerThreadOptions(std::chrono::milliseconds(2)), clock);
+		slow->inputPort()->setMessageHandler(merger.handler(0));
+		fast->inputPort()->setMessageHandler(merger.handler(1));
+		Merged merged;
+		merger.setHandler(MidiMerger::Handler(&collect, &merged));
+
+		// the slow port delivers its older message later than the fast one
+		slow->outputPort()->sendMessage({MidiMessage::NoteOn, 60, 100});
+		clock->advanceTo(200000);
+		fast->outputPort()->sendMessage({MidiMessage::NoteOn, 62, 100});
+		clock->advanceTo(1000000);
+		slow->inputPort()->processPending();
+		fast->inputPort()->processPending();
+
+		CHECK_EQUAL(0u, merger.processPending());
+		clock->advanceTo(2300000);
+		CHECK_EQUAL(1u, merger.processPending());
+		clock->advanceTo(2800000);
+		CHECK_EQUAL(1u, merger.processPending());
+
+		CHECK_EQUAL(2u, merged.messages.size());
+		if (merged.messages.size() != 2)
+		{
+			return;
+		}
+		CHECK_EQUAL(300000u, merged.messages[0].timestamp());
+		CHECK_EQUAL(1u, merged.inputs[0]);
+		CHECK_EQUAL(800000u, merged.messages[1].timestamp());
+		CHECK_EQUAL(0u, merged.inputs[1]);
+		CHECK_EQUAL(0u, merger.counters().late);
+	}
+
+	TEST(MidiMergerKeepsLateMessagesInOrder)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual);
+		std::unique_ptr<MidiLoopback> first = callerThreadLoopback(clock, std::chrono::microseconds(100));
+		std::unique_ptr<MidiLoopback> second = callerThreadLoopback(clock, std::chrono::microseconds(100));
+		MidiMerger merger(2, callerThreadOptions(std::chrono::microseconds(100)), clock);
+		first->inputPort()->setMessageHandler(merger.handler(0));
+		second->inputPort()->setMessageHandler(merger.handler(1));
+		Merged merged;
+		merger.setHandler(MidiMerger::Handler(&collect, &merged));
+
+		second->outputPort()->sendMessage({MidiMessage::NoteOn, 60, 100});
+		clock->advanceTo(50000);
+		first->outputPort()->sendMessage({MidiMessage::NoteOn, 62, 100});
+		clock->advanceTo(1000000);
+
+		// the older message of the second port is dispatched after the reorder window is over
+		first->inputPort()->processPending();
+		merger.processPending();
+		second->inputPort()->processPending();
+		merger.processPending();
+
+		CHECK_EQUAL(2u, merged.messages.size());
+		if (merged.messages.size() != 2)
+		{
+			return;
+		}
+		CHECK_EQUAL(150000u, merged.messages[0].timestamp());
+		CHECK_EQUAL(150000u, merged.messages[1].timestamp());
+		CHECK_EQUAL(1u, merger.counters().late);
+	}
+
+	TEST(MidiMergerOrdersManyJitteryInputs)
+	{
+		const std::size_t kInputs = 8;
+		const unsigned char kMessagesPerInput = 100;
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual);
+		MidiMerger merger(kInputs, callerThreadOptions(std::chrono::milliseconds(2)), clock);
+		std::vector<std::unique_ptr<MidiLoopback>> loopbacks;
+		for (std::size_t i = 0; i < kInputs; ++i)
+		{
+			loopbacks.push_back(callerThreadLoopback(clock, std::chrono::microseconds(100 * i), std::chrono::microseconds(500), i));
+			loopbacks.back()->inputPort()->setMessageHandler(merger.handler(i));
+		}
+
+		for (unsigned char n = 0; n < kMessagesPerInput; ++n)
+		{
+			for (const std::unique_ptr<MidiLoopback>& loopback : loopbacks)
+			{
+				loopback->outputPort()->sendMessage({MidiMessage::ControlChange, 1, n});
+			}
+			clock->advance(100000);
+			for (const std::unique_ptr<MidiLoopback>& loopback : loopbacks)
+			{
+				loopback->inputPort()->processPending();
+			}
+			merger.processPending();
+		}
+		clock->advance(10000000);
+		for (const std::unique_ptr<MidiLoopback>& loopback : loopbacks)
+		{
+			loopback->inputPort()->processPending();
+		}
+		merger.flush();
+
+		// nothing was handled, so the stream is in the output ring
+		std::vector<unsigned long long> timestamps;
+		MidiMessage message;
+		while (merger.pop(message))
+		{
+			timestamps.push_back(message.timestamp());
+		}
+		CHECK_EQUAL(kInputs * kMessagesPerInput, timestamps.size());
+		CHECK(std::is_sorted(timestamps.begin(), timestamps.end()));
+		CHECK_EQUAL(0u, merger.counters().late);
+		CHECK_EQUAL(kInputs * kMessagesPerInput, merger.counters().merged);
+	}
+
+	TEST(MidiMergerThreadFillsOutputRing)
+	{
+		MidiLoopback first("First");
+		MidiLoopback second("Second");
+		MidiMerger::Options options;
+		options.reorderWindow = std::chrono::microseconds(500);
+		MidiMerger merger(2, options);
+		first.inputPort()->setMessageHandler(merger.handler(0));
+		second.inputPort()->setMessageHandler(merger.handler(1));
+
+		first.outputPort()->sendMessage({MidiMessage::NoteOn, 60, 100});
+		second.outputPort()->sendMessage({MidiMessage::NoteOn, 62, 100});
+
+		std::vector<std::size_t> inputs;
+		pollfd descriptor = {merger.pollDescriptor(), POLLIN, 0};
+		while (inputs.size() < 2 && poll(&descriptor, 1, 1000) > 0)
+		{
+			MidiMessage message;
+			std::size_t input = 0;
+			while (merger.pop(message, &input))
+			{
+				inputs.push_back(input);
+			}
+		}
+		CHECK_EQUAL(2u, inputs.size());
+		if (inputs.size() == 2)
+		{
+			CHECK_EQUAL(0u, inputs[0]);
+			CHECK_EQUAL(1u, inputs[1]);
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiDelegate.h>
+#include <smidi/MidiMessageDispatcher.h>
+#include <memory>
+
+namespace
+{
+	int addToContext(void* context, int value)
+	{
+		return *static_cast<int*>(context) + value;
+	}
+}
+
+SUITE(MidiMessageDispatcherTests)
+{
+	TEST(MidiDelegateConstruction)
+	{
+		// Empty delegate
+		MidiDelegate<int(int)> empty;
+		CHECK(!empty);
+
+		// Function with context
+		int base = 10;
+		MidiDelegate<int(int)> bound(&addToContext, &base);
+		CHECK(bound);
+		CHECK_EQUAL(15, bound(5));
+
+		// Lambda
+		int multiplier = 3;
+		MidiDelegate<int(int)> lambda = [&multiplier](int value) { return value * multiplier; };
+		CHECK_EQUAL(12, lambda(4));
+
+		// Copy and reset
+		MidiDelegate<int(int)> copied(lambda);
+		lambda = nullptr;
+		CHECK(!lambda);
+		CHECK_EQUAL(6, copied(2));
+
+		// Non-trivially copyable callable is copied and destroyed properly
+		std::shared_ptr<int> counter = std::make_shared<int>(0);
+		{
+			MidiDelegate<int(int)> owning = [counter](int value) { return *counter += value; };
+			MidiDelegate<int(int)> owningCopy = owning;
+			CHECK_EQUAL(3, counter.use_count());
+			owning(1);
+			owningCopy(2);
+		}
+		CHECK_EQUAL(1, counter.use_count());
+		CHECK_EQUAL(3, *counter);
+	}
+
+	TEST(MidiMessageDispatcherRouting)
+	{
+		MidiMessageDispatcher dispatcher;
+
+		int noteOns = 0;
+		int clocks = 0;
+		int others = 0;
+
+		// nothing is handled without handlers
+		CHECK(!dispatcher.dispatch(MidiMessage{0x90, 0x40, 0x7F}));
+
+		dispatcher.setHandler(MidiMessage::NoteOn, [&noteOns](const MidiMessage&) { ++noteOns; });
+		dispatcher.setHandler(MidiMessage::MidiClock, [&clocks](const MidiMessage&) { ++clocks; });
+		dispatcher.setHandler([&others](const MidiMessage&) { ++others; });
+
+		// channel is ignored for channel messages
+		CHECK(dispatcher.dispatch(MidiMessage{0x90, 0x40, 0x7F}));
+		CHECK(dispatcher.dispatch(MidiMessage{0x9F, 0x40, 0x7F}));
+		CHECK(dispatcher.dispatch(MidiMessage{0xF8}));
+		CHECK(dispatcher.dispatch(MidiMessage{0x80, 0x40, 0x00}));
+		CHECK(dispatcher.dispatch(MidiMessage{0xFA}));
+		CHECK(!dispatcher.dispatch(MidiMessage()));
+
+		CHECK_EQUAL(2, noteOns);
+		CHECK_EQUAL(1, clocks);
+		CHECK_EQUAL(2, others);
+
+		// removing type specific handler makes default handler receive such messages
+		dispatcher.setHandler(MidiMessage::NoteOn, nullptr);
+		dispatcher.dispatch(MidiMessage{0x91, 0x40, 0x7F});
+		CHECK_EQUAL(2, noteOns);
+		CHECK_EQUAL(3, others);
+
+		dispatcher.resetHandlers();
+		CHECK(!dispatcher.dispatch(MidiMessage{0xF8}));
+		CHECK_EQUAL(1, clocks);
+	}
+}
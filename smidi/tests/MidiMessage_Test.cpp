@@ -88,6 +88,14 @@ SUITE(MidiMessageTests)
 		CHECK_EQUAL(0x67, concatenated.data()[1]);
 		CHECK_EQUAL(0x89, concatenated.data()[2]);
 
+		// type checks ignore channel but don't mix different types
+		CHECK(MidiMessage({0xB3, 0x07, 0x64}).isActually(MidiMessage::ControlChange));
+		CHECK(!MidiMessage({0xB3, 0x07, 0x64}).isActually(MidiMessage::NoteOn));
+		CHECK(MidiMessage{0xF8}.isActually(MidiMessage::MidiClock));
+		CHECK(!MidiMessage{0xF8}.isActually(MidiMessage::SysEx));
+		CHECK(!MidiMessage{0xF8}.isActually(MidiMessage::System));
+		CHECK(!MidiMessage{0xFA}.isActually(MidiMessage::MidiClock));
+
 		// set/get timestamp
 		concatenated.setTimestamp(123);
 		CHECK_EQUAL(123, concatenated.timestamp());
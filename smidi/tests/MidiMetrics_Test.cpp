@@ -0,0 +1,101 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiMetrics.h>
+#include "../src/MidiMetricsCounters.h"
+
+SUITE(MidiMetricsTests)
+{
+	TEST(MidiPortMetricsTypeIndex)
+	{
+		// channel is ignored
+		CHECK_EQUAL(MidiPortMetrics::typeIndex(0x90), MidiPortMetrics::typeIndex(0x9F));
+		CHECK(MidiPortMetrics::typeIndex(0x80) != MidiPortMetrics::typeIndex(0x90));
+
+		// every type has its own index within the arrays, data bytes are out of range
+		CHECK_EQUAL(0u, MidiPortMetrics::typeIndex(MidiMessage::NoteOff));
+		CHECK_EQUAL(6u, MidiPortMetrics::typeIndex(MidiMessage::PitchWheel));
+		CHECK_EQUAL(7u, MidiPortMetrics::typeIndex(MidiMessage::SysEx));
+		CHECK_EQUAL(MidiPortMetrics::kMessageTypes - 1, MidiPortMetrics::typeIndex(MidiMessage::Reset));
+		CHECK_EQUAL(MidiPortMetrics::kMessageTypes, MidiPortMetrics::typeIndex(0x7F));
+	}
+
+	TEST(MidiPortMetricsAccessors)
+	{
+		MidiPortMetrics metrics = {};
+		metrics.messages[MidiPortMetrics::typeIndex(MidiMessage::NoteOn)] = 3;
+		metrics.bytes[MidiPortMetrics::typeIndex(MidiMessage::NoteOn)] = 9;
+		metrics.messages[MidiPortMetrics::typeIndex(MidiMessage::MidiClock)] = 24;
+		CHECK_EQUAL(3u, metrics.messagesOfType(MidiMessage::NoteOn));
+		CHECK_EQUAL(9u, metrics.bytesOfType(MidiMessage::NoteOn));
+		CHECK_EQUAL(27u, metrics.totalMessages());
+
+		// no data
+		CHECK_EQUAL(0u, metrics.latencyPercentile(0.5));
+
+		// 90 messages below 1 us, 9 below 4 us, 1 below 1 ms
+		metrics.latencyHistogram[0] = 90;
+		metrics.latencyHistogram[2] = 9;
+		metrics.latencyHistogram[10] = 1;
+		CHECK_EQUAL(1000u, metrics.latencyPercentile(0.5));
+		CHECK_EQUAL(4000u, metrics.latencyPercentile(0.95));
+		CHECK_EQUAL(1024000u, metrics.latencyPercentile(1.0));
+	}
+
+	TEST(MidiPortCountersBuckets)
+	{
+		CHECK_EQUAL(0u, MidiPortCounters::bucketFor(0));
+		CHECK_EQUAL(0u, MidiPortCounters::bucketFor(999));
+		CHECK_EQUAL(1u, MidiPortCounters::bucketFor(1000));
+		CHECK_EQUAL(1u, MidiPortCounters::bucketFor(1999));
+		CHECK_EQUAL(2u, MidiPortCounters::bucketFor(2000));
+		CHECK_EQUAL(11u, MidiPortCounters::bucketFor(1024000));
+
+		// everything too long ends up in the last bucket
+		CHECK_EQUAL(MidiPortMetrics::kLatencyBuckets - 1, MidiPortCounters::bucketFor(~0ULL));
+	}
+
+	TEST(MidiPortCountersSnapshot)
+	{
+		MidiPortCounters counters;
+		counters.countMessage({MidiMessage::NoteOn | 3, 60, 100});
+		counters.countMessage({MidiMessage::NoteOn, 60, 0});
+		counters.countMessage({MidiMessage::MidiClock});
+		counters.countMessage(MidiMessage());
+		counters.countLatency(0);
+		counters.countLatency(1500);
+		counters.countOverrun();
+		counters.countCoalesced();
+		counters.countCoalesced();
+
+		const MidiPortMetrics metrics = counters.snapshot();
+		CHECK_EQUAL(2u, metrics.messagesOfType(MidiMessage::NoteOn));
+		CHECK_EQUAL(6u, metrics.bytesOfType(MidiMessage::NoteOn));
+		CHECK_EQUAL(3u, metrics.totalMessages());
+		CHECK_EQUAL(1u, metrics.latencyHistogram[0]);
+		CHECK_EQUAL(1u, metrics.latencyHistogram[1]);
+		CHECK_EQUAL(1u, metrics.overruns);
+		CHECK_EQUAL(2u, metrics.coalesced);
+		CHECK_EQUAL(0u, metrics.decodeFailures);
+	}
+
+	TEST(MidiSyncCountersSnapshot)
+	{
+		MidiSyncCounters counters;
+		counters.countPeriod(500);
+		counters.countPeriod(-3000);
+		counters.countPeriod(2000);
+		counters.countPhaseCorrection(-100);
+		counters.countPhaseCorrection(40);
+
+		const MidiSyncMetrics metrics = counters.snapshot();
+		CHECK_EQUAL(3u, metrics.periods);
+		CHECK_EQUAL(2000, metrics.lastPeriodError);
+		CHECK_EQUAL(2000, metrics.maxPeriodError);
+
+		// early batches count by their magnitude
+		CHECK_EQUAL(1u, metrics.jitterHistogram[0]);
+		CHECK_EQUAL(2u, metrics.jitterHistogram[2]);
+		CHECK_EQUAL(2u, metrics.phaseCorrections);
+		CHECK_EQUAL(40, metrics.lastPhaseCorrection);
+		CHECK_EQUAL(-60, metrics.totalPhaseCorrection);
+	}
+}
@@ -0,0 +1,205 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiParameters.h>
+#include <vector>
+
+namespace
+{
+	using Bytes = std::vector<unsigned char>;
+
+	void collect(void* context, const MidiParameterEvent& event)
+	{
+		static_cast<std::vector<MidiParameterEvent>*>(context)->push_back(event);
+	}
+
+	MidiMessage controlChange(unsigned char channel, unsigned char controller, unsigned char value, unsigned long long timestamp)
+	{
+		return MidiMessage({static_cast<unsigned char>(MidiMessage::ControlChange | channel), controller, value}, timestamp);
+	}
+
+	std::vector<Bytes> bytesOf(const MidiMessage* messages, std::size_t count)
+	{
+		std::vector<Bytes> result;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			result.push_back(Bytes(messages[i].data().begin(), messages[i].data().end()));
+		}
+		return result;
+	}
+}
+
+SUITE(MidiParametersTests)
+{
+	TEST(MidiParameterDecoderAssemblesControllerPairs)
+	{
+		std::vector<MidiParameterEvent> events;
+		MidiParameterDecoder decoder(MidiParameterDecoder::Handler(&collect, &events));
+
+		CHECK(decoder.process(controlChange(0, 1, 0x40, 1000)));
+		CHECK(events.empty());
+		CHECK(decoder.process(controlChange(0, 33, 0x05, 1100)));
+		// LSB alone changes the fine part
+		CHECK(decoder.process(controlChange(0, 33, 0x06, 1200)));
+		// 7-bit controller and note pass
+		CHECK(!decoder.process(controlChange(0, 70, 100, 1300)));
+		CHECK(!decoder.process(MidiMessage({MidiMessage::NoteOn, 60, 100}, 1400)));
+
+		CHECK_EQUAL(2u, events.size());
+		if (events.size() != 2)
+		{
+			return;
+		}
+		CHECK_EQUAL(MidiParameterEvent::Controller, events[0].type);
+		CHECK_EQUAL(1u, events[0].number);
+		CHECK_EQUAL(0x40u * 128 + 5, events[0].value);
+		CHECK(events[0].isFine);
+		CHECK_EQUAL(1100u, events[0].timestamp);
+		CHECK_EQUAL(0x40u * 128 + 6, events[1].value);
+	}
+
+	TEST(MidiParameterDecoderCompletesLoneMsb)
+	{
+		std::vector<MidiParameterEvent> events;
+		MidiParameterDecoder decoder(MidiParameterDecoder::Handler(&collect, &events));
+
+		// another message of the channel
+		decoder.process(controlChange(2, 1, 10, 1000));
+		decoder.process(MidiMessage({MidiMessage::NoteOn | 2, 60, 100}, 1001));
+		// a message of another channel after the timeout
+		decoder.process(controlChange(2, 1, 11, 2000));
+		decoder.process(controlChange(3, 70, 100, 2000 + 10000001));
+		// explicit flush
+		decoder.process(controlChange(2, 1, 12, 30000000));
+		decoder.flush(30000000);
+		CHECK_EQUAL(2u, events.size());
+		decoder.flush();
+
+		CHECK_EQUAL(3u, events.size());
+		if (events.size() != 3)
+		{
+			return;
+		}
+		for (std::size_t i = 0; i < events.size(); ++i)
+		{
+			CHECK(!events[i].isFine);
+			CHECK_EQUAL((10u + i) * 128, events[i].value);
+			CHECK_EQUAL(2u, events[i].channel);
+		}
+
+		MidiParameterDecoder::Options options;
+		options.partialUpdate = MidiParameterDecoder::PartialUpdate::Immediate;
+		events.clear();
+		MidiParameterDecoder immediate(MidiParameterDecoder::Handler(&collect, &events), options);
+		immediate.process(controlChange(0, 11, 1, 0));
+		CHECK_EQUAL(1u, events.size());
+		immediate.process(controlChange(0, 43, 2, 0));
+		CHECK_EQUAL(2u, events.size());
+		CHECK_EQUAL(130u, events.back().value);
+	}
+
+	TEST(MidiParameterDecoderAssemblesRpnAndNrpn)
+	{
+		std::vector<MidiParameterEvent> events;
+		MidiParameterDecoder decoder(MidiParameterDecoder::Handler(&collect, &events));
+
+		// data entry without a parameter is not a parameter
+		CHECK(!decoder.process(controlChange(5, 6, 1, 0)));
+
+		// pitch bend sensitivity: 12 semitones and 50 cents
+		decoder.process(controlChange(5, 101, 0, 0));
+		decoder.process(controlChange(5, 100, 0, 0));
+		decoder.process(controlChange(5, 6, 12, 0));
+		decoder.process(controlChange(5, 38, 50, 0));
+
+		// NRPN 1 * 128 + 2, then only its LSB changes
+		decoder.process(controlChange(5, 99, 1, 0));
+		decoder.process(controlChange(5, 98, 2, 0));
+		decoder.process(controlChange(5, 6, 100, 0));
+		decoder.process(controlChange(5, 98, 3, 0));
+		decoder.process(controlChange(5, 6, 101, 0));
+		decoder.process(controlChange(5, 38, 1, 0));
+
+		// null RPN
+		decoder.process(controlChange(5, 101, 127, 0));
+		decoder.process(controlChange(5, 100, 127, 0));
+		CHECK(!decoder.process(controlChange(5, 6, 1, 0)));
+		decoder.flush();
+
+		CHECK_EQUAL(3u, events.size());
+		if (events.size() != 3)
+		{
+			return;
+		}
+		CHECK_EQUAL(MidiParameterEvent::Rpn, events[0].type);
+		CHECK_EQUAL(0u, events[0].number);
+		CHECK_EQUAL(12u * 128 + 50, events[0].value);
+		CHECK_EQUAL(MidiParameterEvent::Nrpn, events[1].type);
+		CHECK_EQUAL(1u * 128 + 2, events[1].number);
+		CHECK_EQUAL(100u * 128, events[1].value);
+		CHECK(!events[1].isFine);
+		CHECK_EQUAL(1u * 128 + 3, events[2].number);
+		CHECK_EQUAL(101u * 128 + 1, events[2].value);
+	}
+
+	TEST(MidiParameterEncoderSendsMinimalSequence)
+	{
+		MidiParameterEncoder encoder;
+		MidiMessage messages[MidiParameterEncoder::kMaxMessages];
+
+		std::size_t count = encoder.encode({MidiParameterEvent::Rpn, 3, 0, 12 * 128 + 50, true, 7}, messages);
+		CHECK(std::vector<Bytes>({{0xB3, 101, 0}, {0xB3, 100, 0}, {0xB3, 6, 12}, {0xB3, 38, 50}}) == bytesOf(messages, count));
+		CHECK_EQUAL(7u, messages[0].timestamp());
+
+		// same MSB: only the LSB, same value: nothing
+		count = encoder.encode({MidiParameterEvent::Rpn, 3, 0, 12 * 128 + 51, true, 0}, messages);
+		CHECK(std::vector<Bytes>({{0xB3, 38, 51}}) == bytesOf(messages, count));
+		CHECK_EQUAL(0u, encoder.encode({MidiParameterEvent::Rpn, 3, 0, 12 * 128 + 51, true, 0}, messages));
+
+		// RPN 1: only the changed byte of the number, then the whole value
+		count = encoder.encode({MidiParameterEvent::Rpn, 3, 1, 12 * 128 + 51, true, 0}, messages);
+		CHECK(std::vector<Bytes>({{0xB3, 100, 1}, {0xB3, 6, 12}, {0xB3, 38, 51}}) == bytesOf(messages, count));
+
+		// controllers
+		count = encoder.encode({MidiParameterEvent::Controller, 0, 1, 64 * 128 + 1, true, 0}, messages);
+		CHECK(std::vector<Bytes>({{0xB0, 1, 64}, {0xB0, 33, 1}}) == bytesOf(messages, count));
+		count = encoder.encode({MidiParameterEvent::Controller, 0, 1, 64 * 128 + 2, true, 0}, messages);
+		CHECK(std::vector<Bytes>({{0xB0, 33, 2}}) == bytesOf(messages, count));
+		count = encoder.encode({MidiParameterEvent::Controller, 0, 1, 64 * 128, false, 0}, messages);
+		CHECK(std::vector<Bytes>({{0xB0, 1, 64}}) == bytesOf(messages, count));
+		CHECK_EQUAL(0u, encoder.encode({MidiParameterEvent::Controller, 0, 1, 64 * 128, false, 0}, messages));
+
+		encoder.reset();
+		CHECK_EQUAL(2u, encoder.encode({MidiParameterEvent::Controller, 0, 1, 64 * 128 + 2, true, 0}, messages));
+	}
+
+	TEST(MidiParameterEncoderOutputDecodesToTheSameEvents)
+	{
+		std::vector<MidiParameterEvent> events;
+		MidiParameterDecoder decoder(MidiParameterDecoder::Handler(&collect, &events));
+		MidiParameterEncoder encoder;
+		MidiMessage messages[MidiParameterEncoder::kMaxMessages];
+
+		const std::vector<MidiParameterEvent> sent = {
+			{MidiParameterEvent::Nrpn, 9, 0x3FFF - 128, 1, true, 0},
+			{MidiParameterEvent::Nrpn, 9, 0x3FFF - 128, 0x3FFF, true, 0},
+			{MidiParameterEvent::Controller, 9, 7, 1000, true, 0},
+			{MidiParameterEvent::Rpn, 9, 2, 8192, true, 0}
+		};
+		for (const MidiParameterEvent& event : sent)
+		{
+			const std::size_t count = encoder.encode(event, messages);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				CHECK(decoder.process(messages[i]));
+			}
+		}
+		decoder.flush();
+
+		CHECK_EQUAL(sent.size(), events.size());
+		for (std::size_t i = 0; i < sent.size() && i < events.size(); ++i)
+		{
+			CHECK_EQUAL(sent[i].type, events[i].type);
+			CHECK_EQUAL(sent[i].number, events[i].number);
+			CHECK_EQUAL(sent[i].value, events[i].value);
+		}
+	}
+}
@@ -0,0 +1,412 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiPlayer.h>
+#include <smidi/MidiFile.h>
+#include <smidi/MidiLoopback.h>
+#include <smidi/MidiInPort.h>
+#include <smidi/MidiOutPort.h>
+#include <smidi/MidiTimestamp.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Bytes = std::vector<unsigned char>;
+
+	const unsigned long long kStartTime = 1000000000ULL;
+	const unsigned long long kMillisecond = 1000000ULL;
+
+	struct SourceEvent
+	{
+		unsigned long long tick;
+		Bytes              bytes; // status byte first, 0xFF and the meta type for meta events
+	};
+
+	//! In-memory source, as an editor would provide
+	class VectorSource : public MidiPlayer::Source
+	{
+	public:
+		explicit VectorSource(std::vector<SourceEvent> events)
+			: _events(std::move(events))
+			, _next(0)
+		{
+		}
+
+		virtual void seek(unsigned long long tick) override
+		{
+			_next = 0;
+			while (_next < _events.size() && _events[_next].tick < tick)
+			{
+				++_next;
+			}
+		}
+
+		virtual bool next(MidiFileEvent& event) override
+		{
+			const bool result = _next < _events.size();
+			if (result)
+			{
+				const SourceEvent& source = _events[_next++];
+				const bool isMeta = source.bytes[0] == 0xFF;
+				event = MidiFileEvent();
+				event.tick = source.tick;
+				event.kind = isMeta ? MidiFileEvent::Meta : MidiFileEvent::Channel;
+				event.status = source.bytes[0];
+				event.metaType = isMeta ? source.bytes[1] : 0;
+				event.data = source.bytes.data() + (isMeta ? 2 : 1);
+				event.size = source.bytes.size() - (isMeta ? 2 : 1);
+			}
+			return result;
+		}
+
+	private:
+		std::vector<SourceEvent> _events;
+		std::size_t              _next;
+	};
+
+	//! 500 ticks per quarter note at 120 BPM: a tick is a millisecond
+	MidiTempoMap millisecondTicks()
+	{
+		return MidiTempoMap(500);
+	}
+
+	bool waitForStop(const MidiPlayer& player)
+	{
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (player.isPlaying() && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return !player.isPlaying();
+	}
+
+	//! Output port with a queue: scheduled messages are delivered at their timestamps unless cancelled before
+	class QueuePort : public MidiOutPort
+	{
+	public:
+		QueuePort()
+			: _name("Queue")
+			, _loopback("Queue sync")
+		{
+		}
+
+		virtual const std::string& name() const override { return _name; }
+		virtual void start() override {}
+		virtual void stop() override {}
+		virtual MidiPortMetrics metrics() const override { return MidiPortMetrics(); }
+
+		virtual void sendMessage(const MidiMessage& message) override
+		{
+			sendMessages(&message, 1);
+		}
+
+		virtual void sendMessages(const MidiMessage* messages, std::size_t count) override
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_delivered.insert(_delivered.end(), messages, messages + count);
+		}
+
+		virtual bool scheduleMessages(const MidiMessage* messages, std::size_t count) override
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_queue.insert(_queue.end(), messages, messages + count);
+			return true;
+		}
+
+		virtual void cancelScheduledMessages() override
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			deliver(MidiTimestamp::now());
+			_queue.clear();
+		}
+
+		virtual void setRunningStatusEnabled(bool) override {}
+		virtual bool isRunningStatusEnabled() const override { return false; }
+		virtual void setNoteTrackingEnabled(bool) override {}
+		virtual bool isNoteTrackingEnabled() const override { return false; }
+		virtual void releaseNotes() override {}
+		virtual void setCoalescing(const Coalescing&) override {}
+		virtual Coalescing coalescing() const override { return Coalescing(); }
+		virtual MidiSync& sync() override { return _loopback.outputPort()->sync(); }
+
+		//! Returns the messages delivered until now in the order of delivery
+		std::vector<MidiMessage> delivered()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			deliver(MidiTimestamp::now());
+			return _delivered;
+		}
+
+	private:
+		void deliver(unsigned long long now)
+		{
+			std::stable_sort(_queue.begin(), _queue.end(), [](const MidiMessage& a, const MidiMessage& b) { return a.timestamp() < b.timestamp(); });
+			const std::vector<MidiMessage>::iterator due = std::find_if(_queue.begin(), _queue.end(), [now](const MidiMessage& message) { return message.timestamp() > now; });
+			_delivered.insert(_delivered.end(), _queue.begin(), due);
+			_queue.erase(_queue.begin(), due);
+		}
+
+	private:
+		const std::string        _name;
+		MidiLoopback             _loopback;
+		std::mutex               _mutex;
+		std::vector<MidiMessage> _queue;
+		std::vector<MidiMessage> _delivered;
+	};
+
+	std::vector<MidiMessage> receive(MidiLoopback& loopback)
+	{
+		std::vector<MidiMessage> result;
+		loopback.inputPort()->setMessageHandler([&result](const MidiMessage& message) { result.push_back(message); });
+		loopback.inputPort()->processPending();
+		loopback.inputPort()->resetMessageHandlers();
+		return result;
+	}
+}
+
+SUITE(MidiPlayerTests)
+{
+	TEST(MidiPlayerPlaysEventsAtTempoMapTimes)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Instant, kStartTime);
+		MidiLoopback loopback("Synth", clock);
+		loopback.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+
+		// the tempo doubles at tick 1000, so the last half note is as long as a quarter note
+		MidiTempoMap tempoMap = millisecondTicks();
+		tempoMap.addTempo(1000, 250000);
+		MidiPlayer player(loopback.outputPort(), MidiPlayer::Options(), clock);
+		player.load(std::unique_ptr<MidiPlayer::Source>(new VectorSource({
+			{0, {MidiMessage::NoteOn, 60, 100}},
+			{500, {MidiMessage::NoteOff, 60, 0}},
+			{1000, {0xFF, MidiFileEvent::kMetaTempo, 0x03, 0xD0, 0x90}},
+			{1000, {MidiMessage::NoteOn, 62, 100}},
+			{2000, {MidiMessage::NoteOff, 62, 0}}
+		})), tempoMap);
+		CHECK(!player.isQueueScheduling());
+
+		player.play();
+		CHECK(waitForStop(player));
+		CHECK_EQUAL(2000u, player.position());
+		CHECK_EQUAL(4u, player.counters().messages);
+
+		const std::vector<MidiMessage> received = receive(loopback);
+		const std::vector<unsigned long long> expectedTimes = {0, 500 * kMillisecond, 1000 * kMillisecond, 1500 * kMillisecond};
+		CHECK_EQUAL(expectedTimes.size(), received.size());
+		if (received.size() != expectedTimes.size())
+		{
+			return;
+		}
+		for (std::size_t i = 0; i < received.size(); ++i)
+		{
+			CHECK_EQUAL(kStartTime + expectedTimes[i], received[i].timestamp());
+		}
+		CHECK(received[2].data() == Bytes({MidiMessage::NoteOn, 62, 100}));
+	}
+
+	TEST(MidiPlayerPlaysFileFromLocatedTick)
+	{
+		// format 0, 500 ticks per quarter note: Note On at 0, 250 and 500, all Note Off at 1000
+		const Bytes data = {
+			'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xF4,
+			'M', 'T', 'r', 'k', 0, 0, 0, 26,
+			0x00, 0x90, 0x3C, 0x64,
+			0x81, 0x7A, 0x40, 0x64,
+			0x81, 0x7A, 0x43, 0x64,
+			0x83, 0x74, 0x3C, 0x00,
+			0x00, 0x40, 0x00,
+			0x00, 0x43, 0x00,
+			0x00, 0xFF, 0x2F, 0x00
+		};
+		MidiFile file;
+		CHECK(file.open(data.data(), data.size()));
+
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Instant, kStartTime);
+		MidiLoopback loopback("Synth", clock);
+		loopback.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		MidiPlayer player(loopback.outputPort(), MidiPlayer::Options(), clock);
+		CHECK(player.load(file));
+
+		player.locate(250);
+		CHECK_EQUAL(250u, player.position());
+		player.play();
+		CHECK(waitForStop(player));
+
+		// playback starts right away at the located tick, the note started before it is not played
+		const std::vector<MidiMessage> received = receive(loopback);
+		CHECK_EQUAL(5u, received.size());
+		if (received.size() != 5)
+		{
+			return;
+		}
+		CHECK(received[0].data() == Bytes({MidiMessage::NoteOn, 0x40, 0x64}));
+		CHECK_EQUAL(kStartTime, received[0].timestamp());
+		CHECK(received[1].data() == Bytes({MidiMessage::NoteOn, 0x43, 0x64}));
+		CHECK_EQUAL(kStartTime + 250 * kMillisecond, received[1].timestamp());
+		CHECK_EQUAL(kStartTime + 750 * kMillisecond, received[4].timestamp());
+	}
+
+	TEST(MidiPlayerLoopsWithoutHangingNotes)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Instant, kStartTime);
+		MidiLoopback::Options loopbackOptions;
+		loopbackOptions.capacity = 65536;
+		MidiLoopback loopback("Synth", clock, loopbackOptions);
+
+		// the note is longer than the loop, it must be released at the loop end
+		std::unique_ptr<MidiPlayer> player(new MidiPlayer(loopback.outputPort(), MidiPlayer::Options(), clock));
+		player->load(std::unique_ptr<MidiPlayer::Source>(new VectorSource({
+			{100, {MidiMessage::NoteOn, 60, 100}},
+			{3000, {MidiMessage::NoteOff, 60, 0}}
+		})), millisecondTicks());
+		CHECK(player->setLoop(0, 1000));
+		CHECK(!player->setLoop(1000, 1000));
+
+		// the simulated time runs as fast as the player thread, so it is stopped from the receiving side
+		struct Receiver
+		{
+			std::mutex               mutex;
+			std::vector<MidiMessage> messages;
+			int                      sounding;
+			bool                     stopped;
+			MidiPlayer*              player;
+		};
+		Receiver receiver;
+		receiver.sounding = 0;
+		receiver.stopped = false;
+		receiver.player = player.get();
+		loopback.inputPort()->setMessageHandler([&receiver](const MidiMessage& message)
+		{
+			std::lock_guard<std::mutex> lock(receiver.mutex);
+			receiver.messages.push_back(message);
+			receiver.sounding += (message.data()[0] == MidiMessage::NoteOn) ? 1 : -1;
+			if (!receiver.stopped && receiver.messages.size() >= 6)
+			{
+				receiver.player->stop();
+				receiver.stopped = true;
+			}
+		});
+		player->play();
+		CHECK(waitForStop(*player));
+		CHECK(player->counters().loops >= 3);
+
+		// the player thread sends Note Off of the sounding note on stop and is done with that when destroyed
+		player.reset();
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		bool released = false;
+		while (!released && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			std::lock_guard<std::mutex> lock(receiver.mutex);
+			released = (receiver.sounding == 0);
+		}
+		loopback.inputPort()->resetMessageHandlers();
+
+		std::lock_guard<std::mutex> lock(receiver.mutex);
+		const std::vector<MidiMessage>& received = receiver.messages;
+		CHECK(released);
+		CHECK_EQUAL(0u, loopback.outputPort()->metrics().overruns);
+		CHECK(received.size() >= 6);
+		int notes = 0;
+		for (std::size_t i = 0; i < received.size(); ++i)
+		{
+			const bool isNoteOn = received[i].data()[0] == MidiMessage::NoteOn;
+			notes += isNoteOn ? 1 : -1;
+			CHECK(notes == 0 || notes == 1);
+			if (i < 6)
+			{
+				// Note On at tick 100 of every pass, Note Off at the loop end
+				const unsigned long long pass = i / 2;
+				const unsigned long long expectedTime = isNoteOn ? 100 + 1000 * pass : 1000 * (pass + 1);
+				CHECK_EQUAL(kStartTime + expectedTime * kMillisecond, received[i].timestamp());
+			}
+		}
+	}
+
+	TEST(MidiPlayerDrivesSync)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual, kStartTime);
+		MidiLoopback loopback("Synth", clock);
+		MidiLoopback clockLoopback("Clock", clock);
+		loopback.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		clockLoopback.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+
+		MidiPlayer::Options options;
+		options.sync = &clockLoopback.outputPort()->sync();
+		MidiPlayer player(loopback.outputPort(), options, clock);
+		player.load(std::unique_ptr<MidiPlayer::Source>(new VectorSource({
+			{0, {MidiMessage::NoteOn, 60, 100}},
+			{500, {0xFF, MidiFileEvent::kMetaTempo, 0x03, 0xD0, 0x90}},
+			{1000, {MidiMessage::NoteOff, 60, 0}}
+		})), millisecondTicks());
+
+		// the time goes on in steps, so both the player and the sync thread wake up at every step
+		player.play();
+		bool syncStarted = false;
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (player.isPlaying() && std::chrono::steady_clock::now() < deadline)
+		{
+			syncStarted = syncStarted || options.sync->isSyncStarted();
+			clock->advance(10 * kMillisecond);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		CHECK(!player.isPlaying());
+		CHECK(syncStarted);
+		CHECK(!options.sync->isSyncStarted());
+
+		// the sync thread notices the stop at its next clock
+		bool hasStart = false;
+		bool hasClock = false;
+		bool hasStop = false;
+		clockLoopback.inputPort()->setMessageHandler([&](const MidiMessage& message)
+		{
+			hasStart = hasStart || message.isActually(MidiMessage::MidiStart);
+			hasClock = hasClock || message.isActually(MidiMessage::MidiClock);
+			hasStop = hasStop || message.isActually(MidiMessage::MidiStop);
+		});
+		while (!hasStop && std::chrono::steady_clock::now() < deadline)
+		{
+			clock->advance(10 * kMillisecond);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			clockLoopback.inputPort()->processPending();
+		}
+		clockLoopback.inputPort()->resetMessageHandlers();
+		CHECK(hasStart);
+		CHECK(hasClock);
+		CHECK(hasStop);
+	}
+
+	TEST(MidiPlayerReleasesNotesWhoseNoteOffIsCancelled)
+	{
+		std::shared_ptr<QueuePort> port = std::make_shared<QueuePort>();
+		MidiPlayer::Options options;
+		options.lookahead = std::chrono::milliseconds(1000);
+		std::unique_ptr<MidiPlayer> player(new MidiPlayer(port, options));
+		player->load(std::unique_ptr<MidiPlayer::Source>(new VectorSource({
+			{0, {MidiMessage::NoteOn, 60, 100}},
+			{200, {MidiMessage::NoteOff, 60, 0}},
+			{300, {MidiMessage::NoteOn, 62, 100}},
+			{400, {MidiMessage::NoteOff, 62, 0}}
+		})), millisecondTicks());
+		CHECK(player->isQueueScheduling());
+
+		// all four messages are queued at once, the stop comes while the first note sounds
+		player->play();
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		player->stop();
+		player.reset();
+
+		// whatever was delivered before the stop, no note is left sounding
+		int sounding[128] = {};
+		for (const MidiMessage& message : port->delivered())
+		{
+			const bool isNoteOn = (message.data()[0] & 0xF0) == MidiMessage::NoteOn && message.data()[2] != 0;
+			sounding[message.data()[1]] += isNoteOn ? 1 : -1;
+			CHECK(sounding[message.data()[1]] == 0 || sounding[message.data()[1]] == 1);
+		}
+		CHECK_EQUAL(0, sounding[60]);
+		CHECK_EQUAL(0, sounding[62]);
+	}
+}
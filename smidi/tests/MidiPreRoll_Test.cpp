@@ -0,0 +1,184 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiPreRoll.h>
+#include <smidi/MidiFile.h>
+#include <smidi/MidiLoopback.h>
+#include <smidi/MidiOutPort.h>
+#include "TemporaryFile.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Bytes = std::vector<unsigned char>;
+
+	Bytes bytesOf(const MidiMessage& message)
+	{
+		return Bytes(message.data().begin(), message.data().end());
+	}
+
+	//! SysEx whose payload is derived from the number, so a torn copy is recognized
+	MidiMessage numberedSysEx(unsigned int number, std::size_t size, unsigned long long timestamp)
+	{
+		Bytes bytes(size, static_cast<unsigned char>(number % 128));
+		bytes.front() = MidiMessage::SysEx;
+		bytes.back() = MidiMessage::SysExEnd;
+		return MidiMessage(bytes, timestamp);
+	}
+}
+
+SUITE(MidiPreRollTests)
+{
+	TEST(MidiPreRollSnapshotsLastSecondsOfAllPorts)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual, 1000000000);
+		MidiLoopback keyboard("Keyboard", clock);
+		MidiLoopback pads("Pads", clock);
+		keyboard.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		pads.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		MidiPreRoll preRoll(2, MidiPreRoll::Options(), clock);
+		keyboard.inputPort()->setMessageHandler(preRoll.handler(0));
+		pads.inputPort()->setMessageHandler(preRoll.handler(1));
+
+		const std::vector<MidiMessage> sent = {
+			{MidiMessage::NoteOn, 60, 100},
+			{MidiMessage::NoteOn | 9, 36, 127},
+			{MidiMessage::SysEx, 0x7E, 0x7F, 0x09, 0x01, MidiMessage::SysExEnd},
+			{MidiMessage::ProgramChange, 5},
+			{MidiMessage::NoteOn | 9, 38, 90},
+			{MidiMessage::NoteOn, 60, 0}
+		};
+		for (std::size_t i = 0; i < sent.size(); ++i)
+		{
+			MidiLoopback& loopback = (i == 1 || i == 4) ? pads : keyboard;
+			loopback.outputPort()->sendMessage(sent[i]);
+			loopback.inputPort()->processPending();
+			clock->advance(1000000000);
+		}
+		CHECK_EQUAL(sent.size(), preRoll.counters().recorded);
+
+		// the first two messages are older than 4.5 seconds
+		const std::vector<MidiPreRoll::Event> events = preRoll.snapshot(std::chrono::milliseconds(4500));
+		CHECK_EQUAL(4u, events.size());
+		if (events.size() != 4)
+		{
+			return;
+		}
+		for (std::size_t i = 0; i < events.size(); ++i)
+		{
+			CHECK(bytesOf(sent[i + 2]) == bytesOf(events[i].message));
+			CHECK_EQUAL(1000000000ull * (i + 3), events[i].message.timestamp());
+			CHECK_EQUAL((i == 2) ? 1u : 0u, events[i].port);
+		}
+		CHECK_EQUAL(sent.size(), preRoll.snapshot(std::chrono::seconds(60)).size());
+	}
+
+	TEST(MidiPreRollKeepsNewestWhenFull)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual, 1000000000);
+		MidiPreRoll::Options options;
+		options.capacity = 16;
+		options.sysExMemory = 64;
+		MidiPreRoll preRoll(1, options, clock);
+
+		for (unsigned int i = 0; i < 40; ++i)
+		{
+			// every fourth message is a SysEx of 20 bytes, the SysEx memory holds the last three of them
+			const unsigned long long timestamp = 1000 + i;
+			preRoll.record(0, (i % 4 == 0) ? numberedSysEx(i, 20, timestamp) : MidiMessage({MidiMessage::ControlChange, 1, static_cast<unsigned char>(i)}, timestamp));
+		}
+		preRoll.record(0, numberedSysEx(0, 65, 2000));
+		CHECK_EQUAL(1u, preRoll.counters().dropped);
+		CHECK_EQUAL(40u, preRoll.counters().recorded);
+
+		const std::vector<MidiPreRoll::Event> events = preRoll.snapshot(std::chrono::seconds(1));
+		std::vector<unsigned long long> timestamps;
+		for (const MidiPreRoll::Event& event : events)
+		{
+			const unsigned int i = static_cast<unsigned int>(event.message.timestamp() - 1000);
+			timestamps.push_back(i);
+			if (i % 4 == 0)
+			{
+				CHECK(bytesOf(numberedSysEx(i, 20, 0)) == bytesOf(event.message));
+			}
+			else
+			{
+				CHECK(Bytes({MidiMessage::ControlChange, 1, static_cast<unsigned char>(i)}) == bytesOf(event.message));
+			}
+		}
+		// the last 16 events, without the SysEx at 24 whose bytes were overwritten
+		std::vector<unsigned long long> expected;
+		for (unsigned int i = 24; i < 40; ++i)
+		{
+			if (i != 24)
+			{
+				expected.push_back(i);
+			}
+		}
+		CHECK(expected == timestamps);
+	}
+
+	TEST(MidiPreRollSnapshotsWhileRecording)
+	{
+		MidiPreRoll::Options options;
+		options.capacity = 256;
+		options.sysExMemory = 256;
+		MidiPreRoll preRoll(1, options);
+
+		std::atomic<bool> stop(false);
+		std::thread writer([&preRoll, &stop]()
+		{
+			for (unsigned int i = 1; !stop.load(); ++i)
+			{
+				const MidiMessage message = (i % 8 == 0) ? numberedSysEx(i, 40, i) : MidiMessage({MidiMessage::NoteOn, static_cast<unsigned char>(i % 128), 1}, i);
+				preRoll.record(0, message);
+			}
+		});
+
+		// every copy that is returned must be exactly what was recorded, and in order
+		bool isConsistent = true;
+		for (int round = 0; round < 2000; ++round)
+		{
+			unsigned long long previous = 0;
+			for (const MidiPreRoll::Event& event : preRoll.snapshot(std::chrono::hours(1)))
+			{
+				const unsigned int i = static_cast<unsigned int>(event.message.timestamp());
+				const Bytes expected = (i % 8 == 0) ? bytesOf(numberedSysEx(i, 40, 0)) : Bytes({MidiMessage::NoteOn, static_cast<unsigned char>(i % 128), 1});
+				isConsistent = isConsistent && expected == bytesOf(event.message) && i > previous;
+				previous = i;
+			}
+		}
+		stop = true;
+		writer.join();
+		CHECK(isConsistent);
+	}
+
+	TEST(MidiPreRollSavesReadableFile)
+	{
+		std::shared_ptr<MidiSimulatedClock> clock = std::make_shared<MidiSimulatedClock>(MidiSimulatedClock::Mode::Manual, 1000000000);
+		MidiPreRoll preRoll(1, MidiPreRoll::Options(), clock);
+		preRoll.record(0, {MidiMessage::NoteOn, 60, 100});
+		clock->advance(500000000);
+		preRoll.record(0, {MidiMessage::NoteOn, 60, 0});
+		clock->advance(10000000);
+
+		const TemporaryFile temporary("smidi_preroll");
+		const std::string& path = temporary.path();
+		CHECK(preRoll.saveSnapshot(path, std::chrono::seconds(10)));
+
+		MidiFile file;
+		CHECK(file.open(path));
+		std::vector<unsigned long long> ticks;
+		for (const MidiFileEvent& event : file.events())
+		{
+			if (event.isMessage())
+			{
+				ticks.push_back(event.tick);
+			}
+		}
+		// half a second at 120 BPM is a quarter note
+		CHECK(std::vector<unsigned long long>({0, 480}) == ticks);
+		file.close();
+	}
+}
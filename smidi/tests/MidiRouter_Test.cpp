@@ -0,0 +1,196 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiRouter.h>
+#include <smidi/MidiLoopback.h>
+#include <vector>
+
+namespace
+{
+	struct Received
+	{
+		std::vector<MidiMessage> messages;
+	};
+
+	void collect(void* context, const MidiMessage& message)
+	{
+		static_cast<Received*>(context)->messages.push_back(message);
+	}
+
+	//! Source loopback -> router -> destination loopback, both inputs are processed by the test thread
+	struct RouterFixture
+	{
+		RouterFixture()
+			: source("Source", std::make_shared<MidiSimulatedClock>())
+			, destination("Destination", std::make_shared<MidiSimulatedClock>())
+		{
+			source.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+			destination.inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+			destination.inputPort()->setMessageHandler(MidiInPort::MessageHandler(&collect, &received));
+			source.inputPort()->setMessageHandler(router.handler(source.inputPort()));
+		}
+
+		void send(const MidiMessage& message)
+		{
+			source.outputPort()->sendMessage(message);
+			source.inputPort()->processPending();
+			destination.inputPort()->processPending();
+		}
+
+		MidiRouter   router;
+		MidiLoopback source;
+		MidiLoopback destination;
+		Received     received;
+	};
+
+	std::vector<unsigned char> bytes(const MidiMessage& message)
+	{
+		return std::vector<unsigned char>(message.data().begin(), message.data().end());
+	}
+}
+
+SUITE(MidiRouterTests)
+{
+	TEST(MidiPipelineAppliesStagesInOrder)
+	{
+		const auto pipeline = makeMidiPipeline(MidiChannelMap().map(0, 9), MidiTranspose(12), MidiVelocityCurve(MidiCurve::fixed(64)));
+		unsigned char noteOn[] = {MidiMessage::NoteOn, 60, 100};
+		CHECK(pipeline(noteOn, 3));
+		CHECK_EQUAL(MidiMessage::NoteOn | 9, noteOn[0]);
+		CHECK_EQUAL(72, noteOn[1]);
+		CHECK_EQUAL(64, noteOn[2]);
+
+		// Note On with velocity 0 is Note Off and stays so
+		unsigned char noteOff[] = {MidiMessage::NoteOn, 60, 0};
+		CHECK(pipeline(noteOff, 3));
+		CHECK_EQUAL(0, noteOff[2]);
+
+		// notes out of range are dropped
+		unsigned char highNote[] = {MidiMessage::NoteOn, 120, 100};
+		CHECK(!pipeline(highNote, 3));
+
+		// system messages have no channel
+		unsigned char clock[] = {MidiMessage::MidiClock};
+		CHECK(pipeline(clock, 1));
+		CHECK_EQUAL(MidiMessage::MidiClock, clock[0]);
+	}
+
+	TEST(MidiPipelineFiltersAndRemapsControllers)
+	{
+		const auto pipeline = makeMidiPipeline(MidiTypeFilter(MidiTypeFilter::Reject, {MidiMessage::PitchWheel, MidiMessage::MidiClock}),
+		                                       MidiControllerMap().map(1, 11).drop(64),
+		                                       MidiControllerCurve(11, MidiCurve::linear(20, 100)),
+		                                       MidiChannelMap().drop(15));
+
+		unsigned char modulation[] = {MidiMessage::ControlChange | 2, 1, 127};
+		CHECK(pipeline(modulation, 3));
+		CHECK_EQUAL(11, modulation[1]);
+		CHECK_EQUAL(100, modulation[2]);
+
+		unsigned char expression[] = {MidiMessage::ControlChange, 11, 0};
+		CHECK(pipeline(expression, 3));
+		CHECK_EQUAL(20, expression[2]);
+
+		unsigned char sustain[] = {MidiMessage::ControlChange, 64, 127};
+		CHECK(!pipeline(sustain, 3));
+		unsigned char pitchBend[] = {MidiMessage::PitchWheel | 5, 0, 64};
+		CHECK(!pipeline(pitchBend, 3));
+		unsigned char clock[] = {MidiMessage::MidiClock};
+		CHECK(!pipeline(clock, 1));
+		unsigned char start[] = {MidiMessage::MidiStart};
+		CHECK(pipeline(start, 1));
+		unsigned char lastChannel[] = {MidiMessage::NoteOn | 15, 60, 100};
+		CHECK(!pipeline(lastChannel, 3));
+	}
+
+	TEST(MidiRouterForwardsThroughPipeline)
+	{
+		RouterFixture fixture;
+		const MidiRouter::RouteId id = fixture.router.addRoute(fixture.source.inputPort(), fixture.destination.outputPort(),
+		                                                       makeMidiPipeline(MidiTypeFilter(MidiTypeFilter::Accept, {MidiMessage::NoteOn}), MidiTranspose(-12)));
+		CHECK(id != 0);
+		CHECK_EQUAL(1u, fixture.router.routeCount());
+
+		fixture.send({MidiMessage::NoteOn, 60, 100});
+		fixture.send({MidiMessage::ControlChange, 7, 100});
+		fixture.send({MidiMessage::NoteOn | 3, 64, 90});
+
+		CHECK_EQUAL(2u, fixture.received.messages.size());
+		if (fixture.received.messages.size() != 2)
+		{
+			return;
+		}
+		CHECK(bytes(fixture.received.messages[0]) == std::vector<unsigned char>({MidiMessage::NoteOn, 48, 100}));
+		CHECK(bytes(fixture.received.messages[1]) == std::vector<unsigned char>({MidiMessage::NoteOn | 3, 52, 90}));
+
+		const MidiRouter::RouteMetrics metrics = fixture.router.metrics(id);
+		CHECK_EQUAL(2u, metrics.forwarded);
+		CHECK_EQUAL(1u, metrics.dropped);
+	}
+
+	TEST(MidiRouterFansOutAndRemovesRoutes)
+	{
+		RouterFixture fixture;
+		const MidiRouter::RouteId thru = fixture.router.addRoute(fixture.source.inputPort(), fixture.destination.outputPort());
+		const MidiRouter::RouteId layer = fixture.router.addRoute(fixture.source.inputPort(), fixture.destination.outputPort(), makeMidiPipeline(MidiChannelMap::all(1)));
+		CHECK(thru != layer);
+
+		fixture.send({MidiMessage::NoteOn, 60, 100});
+		CHECK_EQUAL(2u, fixture.received.messages.size());
+
+		CHECK(fixture.router.removeRoute(thru));
+		CHECK(!fixture.router.removeRoute(thru));
+		fixture.received.messages.clear();
+		fixture.send({MidiMessage::NoteOn, 60, 100});
+		CHECK_EQUAL(1u, fixture.received.messages.size());
+		if (fixture.received.messages.size() == 1)
+		{
+			CHECK_EQUAL(MidiMessage::NoteOn | 1, fixture.received.messages[0].data()[0]);
+		}
+
+		// the handler stays, there is just no route to forward to
+		CHECK(fixture.router.removeRoute(layer));
+		CHECK_EQUAL(0u, fixture.router.routeCount());
+		fixture.received.messages.clear();
+		fixture.send({MidiMessage::NoteOn, 60, 100});
+		CHECK(fixture.received.messages.empty());
+	}
+
+	TEST(MidiRouterIsChainedFromApplicationHandler)
+	{
+		RouterFixture fixture;
+		fixture.router.addRoute(fixture.source.inputPort(), fixture.destination.outputPort());
+
+		struct Chain
+		{
+			MidiInPort::MessageHandler router;
+			Received                   seen;
+		} chain = {fixture.router.handler(fixture.source.inputPort()), Received()};
+		fixture.source.inputPort()->setMessageHandler([&chain](const MidiMessage& message)
+		{
+			chain.seen.messages.push_back(message);
+			chain.router(message);
+		});
+
+		fixture.send({MidiMessage::NoteOn, 60, 100});
+		CHECK_EQUAL(1u, chain.seen.messages.size());
+		CHECK_EQUAL(1u, fixture.received.messages.size());
+
+		// routes added later get the messages of the same handler
+		fixture.router.addRoute(fixture.source.inputPort(), fixture.destination.outputPort());
+		fixture.send({MidiMessage::NoteOn, 62, 100});
+		CHECK_EQUAL(3u, fixture.received.messages.size());
+	}
+
+	TEST(MidiRouterKeepsTypeHandlers)
+	{
+		RouterFixture fixture;
+		Received controllers;
+		fixture.source.inputPort()->setMessageHandler(MidiMessage::ControlChange, MidiInPort::MessageHandler(&collect, &controllers));
+		fixture.router.addRoute(fixture.source.inputPort(), fixture.destination.outputPort());
+
+		fixture.send({MidiMessage::ControlChange, 7, 100});
+		fixture.send({MidiMessage::NoteOn, 60, 100});
+
+		CHECK_EQUAL(1u, controllers.messages.size());
+		CHECK_EQUAL(1u, fixture.received.messages.size());
+	}
+}
@@ -0,0 +1,117 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiDeviceEnumerator.h>
+#include <smidi/MidiVirtualClient.h>
+#include <smidi/MidiInPort.h>
+#include <smidi/MidiOutPort.h>
+#include <chrono>
+#include <vector>
+#include <poll.h>
+
+namespace
+{
+	void collect(void* context, const MidiMessage& message)
+	{
+		static_cast<std::vector<MidiMessage>*>(context)->push_back(message);
+	}
+
+	void processUntil(MidiInPort& port, const std::vector<MidiMessage>& received, std::size_t count, std::chrono::milliseconds limit)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + limit;
+		while (received.size() < count && std::chrono::steady_clock::now() < deadline)
+		{
+			pollfd descriptor = {port.pollDescriptor(), POLLIN, 0};
+			poll(&descriptor, 1, 5);
+			port.processPending();
+		}
+	}
+}
+
+SUITE(MidiRoutingTests)
+{
+	TEST(MidiRouteBetweenDevicePorts)
+	{
+		// the virtual client is just a device with ports here, the route doesn't go through its threads
+		MidiVirtualClient client("smidi routing test");
+		if (!client.isValid())
+		{
+			// no ALSA sequencer on this machine
+			return;
+		}
+		std::shared_ptr<MidiOutPort> source = client.createOutputPort("route source");
+		std::shared_ptr<MidiInPort> destination = client.createInputPort("route destination");
+		CHECK(source && destination);
+		if (!source || !destination)
+		{
+			return;
+		}
+
+		std::vector<MidiMessage> received;
+		destination->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		destination->setMessageHandler(MidiInPort::MessageHandler(&collect, &received));
+
+		MidiDeviceEnumerator enumerator;
+		MidiDeviceEnumerator::Route route;
+		route.sourceDevice = client.name();
+		route.sourcePort = "route source";
+		route.destinationDevice = client.name();
+		route.destinationPort = "route destination";
+		route.timestamped = true;
+
+		CHECK(enumerator.addRoute(route));
+		CHECK(!enumerator.addRoute(route));
+		CHECK(enumerator.isRouteConnected(route));
+		CHECK_EQUAL(1u, enumerator.routes().size());
+
+		source->sendMessage({MidiMessage::NoteOn, 60, 100});
+		processUntil(*destination, received, 1, std::chrono::milliseconds(500));
+		CHECK_EQUAL(1u, received.size());
+
+		// reconnects to the same ports
+		enumerator.updateDeviceList();
+		CHECK(enumerator.isRouteConnected(route));
+
+		CHECK(enumerator.removeRoute(route));
+		CHECK(!enumerator.isRouteConnected(route));
+		CHECK(!enumerator.removeRoute(route));
+		CHECK(enumerator.routes().empty());
+
+		source->sendMessage({MidiMessage::NoteOff, 60, 0});
+		processUntil(*destination, received, 2, std::chrono::milliseconds(100));
+		CHECK_EQUAL(1u, received.size());
+	}
+
+	TEST(MidiRouteWaitsForPorts)
+	{
+		MidiDeviceEnumerator enumerator;
+		MidiDeviceEnumerator::Route route;
+		route.sourceDevice = "smidi routing test (not plugged)";
+		route.sourcePort = "out";
+		route.destinationDevice = route.sourceDevice;
+		route.destinationPort = "in";
+
+		// without the sequencer the route can't be added at all
+		const bool added = enumerator.addRoute(route);
+		CHECK(!enumerator.isRouteConnected(route));
+		CHECK_EQUAL(added ? 1u : 0u, enumerator.routes().size());
+	}
+
+	TEST(MidiRouteEqualityIncludesTimestamping)
+	{
+		MidiDeviceEnumerator::Route route;
+		route.sourceDevice = "keyboard";
+		route.sourcePort = "out";
+		route.destinationDevice = "synth";
+		route.destinationPort = "in";
+
+		MidiDeviceEnumerator::Route timestamped = route;
+		timestamped.timestamped = true;
+		CHECK(!(route == timestamped));
+		CHECK(route.connectsSamePorts(timestamped));
+
+		// the kernel keeps one connection between two ports
+		MidiDeviceEnumerator enumerator;
+		const bool added = enumerator.addRoute(route);
+		CHECK(!enumerator.addRoute(timestamped));
+		CHECK_EQUAL(added ? 1u : 0u, enumerator.routes().size());
+	}
+}
@@ -0,0 +1,200 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiStreamParser.h>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+namespace
+{
+	struct ParsedMessages
+	{
+		std::vector<std::vector<unsigned char>> data;
+		std::vector<unsigned long long>         timestamps;
+	};
+
+	void collect(void* context, const MidiMessage& message)
+	{
+		ParsedMessages* parsed = static_cast<ParsedMessages*>(context);
+		parsed->data.push_back(message.data());
+		parsed->timestamps.push_back(message.timestamp());
+	}
+
+	// random stream biased towards the interesting cases: long SysEx, running status, real time bytes inside
+	std::vector<unsigned char> randomStream(std::mt19937& random, std::size_t size)
+	{
+		std::vector<unsigned char> stream;
+		std::uniform_int_distribution<int> kind(0, 9);
+		std::uniform_int_distribution<int> byte(0, 255);
+		std::uniform_int_distribution<int> dataByte(0, 127);
+		std::uniform_int_distribution<int> runLength(0, 100);
+		while (stream.size() < size)
+		{
+			switch (kind(random))
+			{
+			case 0:
+				stream.push_back(MidiMessage::SysEx);
+				for (int i = runLength(random) * 3; i > 0; --i)
+				{
+					stream.push_back(static_cast<unsigned char>(dataByte(random)));
+				}
+				stream.push_back(MidiMessage::SysExEnd);
+				break;
+			case 1:
+				stream.push_back(static_cast<unsigned char>(0xF8 + byte(random) % 8));
+				break;
+			case 2:
+			case 3:
+				stream.push_back(static_cast<unsigned char>(byte(random)));
+				break;
+			default:
+				stream.push_back(static_cast<unsigned char>(dataByte(random)));
+				break;
+			}
+		}
+		return stream;
+	}
+
+	std::size_t parse(MidiStreamParser& parser, const std::vector<unsigned char>& bytes, unsigned long long timestamp = 0)
+	{
+		return parser.parse(bytes.data(), bytes.size(), timestamp);
+	}
+}
+
+SUITE(MidiStreamParserTests)
+{
+	TEST(RunningStatus)
+	{
+		ParsedMessages parsed;
+		MidiStreamParser parser;
+		parser.setHandler(MidiStreamParser::Handler(&collect, &parsed));
+
+		// two notes with running status, then program change with running status
+		CHECK_EQUAL(4u, parse(parser, {0x90, 60, 100, 64, 90, 0xC1, 5, 6}));
+		CHECK_EQUAL(4u, parsed.data.size());
+		CHECK((std::vector<unsigned char>{0x90, 60, 100}) == parsed.data[0]);
+		CHECK((std::vector<unsigned char>{0x90, 64, 90}) == parsed.data[1]);
+		CHECK((std::vector<unsigned char>{0xC1, 5}) == parsed.data[2]);
+		CHECK((std::vector<unsigned char>{0xC1, 6}) == parsed.data[3]);
+
+		// System Common cancels running status, following data bytes are dropped
+		CHECK_EQUAL(1u, parse(parser, {0xF6, 7, 8}));
+		CHECK((std::vector<unsigned char>{0xF6}) == parsed.data.back());
+		CHECK_EQUAL(2u, parser.droppedBytes());
+	}
+
+	TEST(RealTimeInterleaved)
+	{
+		ParsedMessages parsed;
+		MidiStreamParser parser;
+		parser.setHandler(MidiStreamParser::Handler(&collect, &parsed));
+
+		// clock in the middle of note on and SysEx doesn't break them
+		CHECK_EQUAL(4u, parse(parser, {0x90, 0xF8, 60, 100, 0xF0, 0x7D, 0xFA, 1, 0xF7}));
+		CHECK_EQUAL(4u, parsed.data.size());
+		CHECK((std::vector<unsigned char>{0xF8}) == parsed.data[0]);
+		CHECK((std::vector<unsigned char>{0x90, 60, 100}) == parsed.data[1]);
+		CHECK((std::vector<unsigned char>{0xFA}) == parsed.data[2]);
+		CHECK((std::vector<unsigned char>{0xF0, 0x7D, 1, 0xF7}) == parsed.data[3]);
+
+		// undefined real time bytes are dropped
+		CHECK_EQUAL(0u, parse(parser, {0xF9, 0xFD}));
+		CHECK_EQUAL(2u, parser.droppedBytes());
+	}
+
+	TEST(MessagesSplitBetweenChunks)
+	{
+		ParsedMessages parsed;
+		MidiStreamParser parser;
+		parser.setHandler(MidiStreamParser::Handler(&collect, &parsed));
+
+		CHECK_EQUAL(0u, parse(parser, {0xB0, 7}, 100));
+		CHECK_EQUAL(1u, parse(parser, {127, 0xF0, 0x7D}, 200));
+		CHECK_EQUAL(0u, parse(parser, {1, 2, 3}, 300));
+		CHECK_EQUAL(1u, parse(parser, {4, 0xF7}, 400));
+
+		// messages keep the timestamp of their first byte
+		CHECK_EQUAL(2u, parsed.data.size());
+		CHECK((std::vector<unsigned char>{0xB0, 7, 127}) == parsed.data[0]);
+		CHECK_EQUAL(100u, parsed.timestamps[0]);
+		CHECK((std::vector<unsigned char>{0xF0, 0x7D, 1, 2, 3, 4, 0xF7}) == parsed.data[1]);
+		CHECK_EQUAL(200u, parsed.timestamps[1]);
+	}
+
+	TEST(BrokenMessagesAreDropped)
+	{
+		ParsedMessages parsed;
+		MidiStreamParser parser(8);
+		parser.setHandler(MidiStreamParser::Handler(&collect, &parsed));
+
+		// orphan data bytes and stray End Of Exclusive
+		CHECK_EQUAL(0u, parse(parser, {1, 2, 0xF7}));
+		CHECK_EQUAL(3u, parser.droppedBytes());
+
+		// SysEx interrupted by note on
+		CHECK_EQUAL(1u, parse(parser, {0xF0, 1, 2, 0x80, 60, 0}));
+		CHECK_EQUAL(6u, parser.droppedBytes());
+		CHECK((std::vector<unsigned char>{0x80, 60, 0}) == parsed.data.back());
+
+		// SysEx longer than the limit
+		CHECK_EQUAL(0u, parse(parser, {0xF0, 1, 2, 3, 4, 5, 6, 7, 8, 0xF7}));
+		CHECK_EQUAL(1u, parsed.data.size());
+
+		// parser recovers with the next status byte
+		CHECK_EQUAL(1u, parse(parser, {0xF0, 1, 0xF7}));
+		CHECK((std::vector<unsigned char>{0xF0, 1, 0xF7}) == parsed.data.back());
+
+		// reset() forgets running status
+		parser.reset();
+		CHECK_EQUAL(0u, parse(parser, {60, 0}));
+	}
+
+	TEST(DataBytesForStatus)
+	{
+		CHECK_EQUAL(2, MidiStreamParser::dataBytesFor(0x93));
+		CHECK_EQUAL(1, MidiStreamParser::dataBytesFor(0xC0));
+		CHECK_EQUAL(1, MidiStreamParser::dataBytesFor(0xDF));
+		CHECK_EQUAL(2, MidiStreamParser::dataBytesFor(0xE0));
+		CHECK_EQUAL(1, MidiStreamParser::dataBytesFor(0xF1));
+		CHECK_EQUAL(2, MidiStreamParser::dataBytesFor(0xF2));
+		CHECK_EQUAL(0, MidiStreamParser::dataBytesFor(0xF8));
+		CHECK_EQUAL(-1, MidiStreamParser::dataBytesFor(0xF0));
+		CHECK_EQUAL(-1, MidiStreamParser::dataBytesFor(0xF4));
+		CHECK_EQUAL(-1, MidiStreamParser::dataBytesFor(0x40));
+	}
+
+	TEST(VectorScanMatchesScalar)
+	{
+		std::mt19937 random(20240611);
+		std::uniform_int_distribution<std::size_t> chunkSize(1, 97);
+		std::uniform_int_distribution<std::size_t> maxSysExSize(2, 400);
+
+		for (int round = 0; round < 200; ++round)
+		{
+			const std::vector<unsigned char> stream = randomStream(random, 4096);
+			const std::size_t maxSize = maxSysExSize(random);
+
+			ParsedMessages vectorParsed;
+			MidiStreamParser vectorParser(maxSize, MidiStreamParser::ScanMode::Vector);
+			vectorParser.setHandler(MidiStreamParser::Handler(&collect, &vectorParsed));
+
+			ParsedMessages scalarParsed;
+			MidiStreamParser scalarParser(maxSize, MidiStreamParser::ScanMode::Scalar);
+			scalarParser.setHandler(MidiStreamParser::Handler(&collect, &scalarParsed));
+
+			// both parsers get the same chunks, so timestamps must match as well
+			unsigned long long timestamp = 0;
+			for (std::size_t offset = 0; offset < stream.size(); ++timestamp)
+			{
+				const std::size_t size = std::min(chunkSize(random), stream.size() - offset);
+				const std::size_t vectorCount = vectorParser.parse(stream.data() + offset, size, timestamp);
+				const std::size_t scalarCount = scalarParser.parse(stream.data() + offset, size, timestamp);
+				CHECK_EQUAL(scalarCount, vectorCount);
+				offset += size;
+			}
+
+			CHECK(scalarParsed.data == vectorParsed.data);
+			CHECK(scalarParsed.timestamps == vectorParsed.timestamps);
+			CHECK_EQUAL(scalarParser.droppedBytes(), vectorParser.droppedBytes());
+		}
+	}
+}
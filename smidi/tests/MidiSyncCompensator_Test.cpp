@@ -0,0 +1,201 @@
+#include <UnitTest++/UnitTest++.h>
+#include "../src/MidiSyncCompensator.h"
+#include <algorithm>
+#include <vector>
+#include <random>
+#include <cstdlib>
+
+namespace
+{
+	const unsigned long long kStartTime = 1000000000ULL;
+	const double kNanosecondsInAMinute = 60e9;
+
+	struct TraceResult
+	{
+		std::size_t beats = 0;
+		std::size_t tempoChanges = 0;
+		std::size_t phaseCorrections = 0;
+		long long   maxDrift = 0;      // |end of the beat's last clock - time the next beat is planned for|
+		long long   maxBoundaryGap = 0; // |start of the beat - end of the previous beat|, what the receiver sees as jitter
+		double      minBpm = 0.0;
+		double      maxBpm = 0.0;
+	};
+
+	/*!
+	 * Replays wake up lateness of the sync thread: each beat the thread wakes up `lateness[i % size]` nanoseconds
+	 * after the planned time and its 24 clocks take one beat at the tempo the compensator chose.
+	 */
+	TraceResult replay(double bpm, const std::vector<long long>& lateness, std::size_t beats)
+	{
+		TraceResult result;
+		result.minBpm = bpm;
+		result.maxBpm = bpm;
+
+		MidiSyncCompensator compensator(bpm);
+		unsigned long long now = kStartTime;
+		unsigned long long previousEnd = 0;
+		for (std::size_t i = 0; i < beats; ++i)
+		{
+			const MidiSyncCompensator::Beat beat = compensator.nextBeat(now);
+			const unsigned long long end = beat.sendTime + static_cast<unsigned long long>(kNanosecondsInAMinute / beat.bpm);
+
+			++result.beats;
+			result.tempoChanges += beat.tempoChanged ? 1 : 0;
+			result.phaseCorrections += (beat.phaseCorrection != 0) ? 1 : 0;
+			result.minBpm = std::min(result.minBpm, beat.bpm);
+			result.maxBpm = std::max(result.maxBpm, beat.bpm);
+			result.maxDrift = std::max(result.maxDrift, std::llabs(static_cast<long long>(end - compensator.plannedTime())));
+			if (i > 0)
+			{
+				result.maxBoundaryGap = std::max(result.maxBoundaryGap, std::llabs(static_cast<long long>(beat.sendTime - previousEnd)));
+			}
+			previousEnd = end;
+
+			now = compensator.plannedTime() + static_cast<unsigned long long>(lateness[i % lateness.size()]);
+		}
+		return result;
+	}
+
+	std::vector<long long> randomLateness(unsigned int seed, long long maxLateness, std::size_t size)
+	{
+		std::mt19937 random(seed);
+		std::uniform_int_distribution<long long> distribution(0, maxLateness);
+		std::vector<long long> result(size);
+		for (long long& value : result)
+		{
+			value = distribution(random);
+		}
+		return result;
+	}
+
+	// beats in an hour at 120 BPM
+	const std::size_t kBeatsInAnHour = 7200;
+
+	// rounding of the compensated tempo to nanoseconds
+	const long long kRoundingError = 10;
+}
+
+SUITE(MidiSyncCompensatorTests)
+{
+	TEST(MidiSyncCompensatorOnTime)
+	{
+		const TraceResult result = replay(120.0, {0}, kBeatsInAnHour);
+		CHECK_EQUAL(kBeatsInAnHour, result.beats);
+		CHECK_EQUAL(0u, result.tempoChanges);
+		CHECK_EQUAL(0u, result.phaseCorrections);
+		CHECK_EQUAL(0, result.maxDrift);
+		CHECK_EQUAL(0, result.maxBoundaryGap);
+	}
+
+	TEST(MidiSyncCompensatorRandomLatenessDoesNotDrift)
+	{
+		// an hour of a loaded machine: up to 2 ms late every beat
+		const TraceResult result = replay(120.0, randomLateness(1, 2000000, kBeatsInAnHour), kBeatsInAnHour);
+		CHECK(result.phaseCorrections > kBeatsInAnHour / 2);
+		CHECK(result.maxDrift <= MidiSyncCompensator::kCompensationThreshold + kRoundingError);
+		CHECK(result.maxBoundaryGap <= 2000000 + MidiSyncCompensator::kCompensationThreshold + kRoundingError);
+		CHECK(result.maxBpm < 121.0);
+	}
+
+	TEST(MidiSyncCompensatorSpikyTrace)
+	{
+		// wake up lateness shaped like a desktop without real time priority (nanoseconds): mostly tiny with rare spikes
+		const std::vector<long long> recorded = {
+			3120, 2870, 55210, 4010, 1980, 2650, 3300, 870400,
+			2210, 3980, 2760, 41980, 3050, 1890, 2430, 3610,
+			2990, 2040, 3320, 128700, 2580, 3170, 1960, 2720,
+			3410, 2230, 64330, 2870, 1990, 3560, 2480, 2110
+		};
+		for (double bpm : {60.0, 120.0, 174.0, 300.0})
+		{
+			const TraceResult result = replay(bpm, recorded, kBeatsInAnHour);
+			CHECK(result.maxDrift <= MidiSyncCompensator::kCompensationThreshold + kRoundingError);
+			CHECK(result.minBpm == bpm);
+			CHECK(result.maxBpm < bpm * 1.01);
+		}
+	}
+
+	TEST(MidiSyncCompensatorRestoresTempo)
+	{
+		MidiSyncCompensator compensator(120.0);
+		MidiSyncCompensator::Beat beat = compensator.nextBeat(kStartTime);
+		CHECK(beat.first);
+		CHECK(!beat.tempoChanged);
+
+		// 1 ms late: the next beat is a bit faster and ends on time
+		beat = compensator.nextBeat(compensator.plannedTime() + 1000000);
+		CHECK(!beat.first);
+		CHECK_EQUAL(1000000, beat.lateness);
+		CHECK_EQUAL(1000000, beat.phaseCorrection);
+		CHECK(beat.tempoChanged);
+		CHECK_CLOSE(60e9 / (500000000 - 1000000), beat.bpm, 1e-9);
+
+		// on time: back to normal
+		beat = compensator.nextBeat(compensator.plannedTime());
+		CHECK(beat.tempoChanged);
+		CHECK_EQUAL(120.0, beat.bpm);
+		CHECK_EQUAL(0, beat.phaseCorrection);
+
+		beat = compensator.nextBeat(compensator.plannedTime());
+		CHECK(!beat.tempoChanged);
+	}
+
+	TEST(MidiSyncCompensatorSmallLatenessAccumulates)
+	{
+		MidiSyncCompensator compensator(120.0);
+		compensator.nextBeat(kStartTime);
+
+		MidiSyncCompensator::Beat beat = compensator.nextBeat(compensator.plannedTime() + 3000);
+		CHECK_EQUAL(0, beat.phaseCorrection);
+		CHECK(!beat.tempoChanged);
+
+		beat = compensator.nextBeat(compensator.plannedTime() + 3000);
+		CHECK_EQUAL(6000, beat.phaseCorrection);
+		CHECK(beat.tempoChanged);
+	}
+
+	TEST(MidiSyncCompensatorEarlyWakeUp)
+	{
+		MidiSyncCompensator compensator(120.0);
+		compensator.nextBeat(kStartTime);
+
+		const unsigned long long plannedTime = compensator.plannedTime();
+		const MidiSyncCompensator::Beat beat = compensator.nextBeat(plannedTime - 250000);
+		CHECK_EQUAL(plannedTime, beat.sendTime);
+		CHECK_EQUAL(-250000, beat.lateness);
+		CHECK(!beat.tempoChanged);
+		CHECK_EQUAL(plannedTime + 500000000, compensator.plannedTime());
+	}
+
+	TEST(MidiSyncCompensatorStallResetsPhase)
+	{
+		// longer than a beat: catching up would need a negative beat duration
+		for (long long stall : {300000000LL, 700000000LL, 5000000000LL})
+		{
+			MidiSyncCompensator compensator(120.0);
+			compensator.nextBeat(kStartTime);
+
+			const unsigned long long now = compensator.plannedTime() + static_cast<unsigned long long>(stall);
+			const MidiSyncCompensator::Beat beat = compensator.nextBeat(now);
+			CHECK_EQUAL(stall, beat.phaseCorrection);
+			CHECK_EQUAL(120.0, beat.bpm);
+			CHECK(!beat.tempoChanged);
+			CHECK_EQUAL(now + 500000000, compensator.plannedTime());
+		}
+	}
+
+	TEST(MidiSyncCompensatorReset)
+	{
+		MidiSyncCompensator compensator(120.0);
+		compensator.nextBeat(kStartTime);
+		compensator.nextBeat(compensator.plannedTime() + 1000000);
+
+		// the queue is restarted at the new nominal tempo, lateness of the old tempo is forgotten
+		compensator.reset(90.0);
+		const MidiSyncCompensator::Beat beat = compensator.nextBeat(kStartTime + 10000000000ULL);
+		CHECK(beat.first);
+		CHECK(!beat.tempoChanged);
+		CHECK_EQUAL(0, beat.phaseCorrection);
+		CHECK_EQUAL(static_cast<long long>(60e9 / 90.0), compensator.period());
+	}
+}
@@ -0,0 +1,41 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiTimestamp.h>
+#include <time.h>
+
+SUITE(MidiTimestampTests)
+{
+	TEST(MidiTimestampIsMonotonicClock)
+	{
+		timespec before = {};
+		clock_gettime(CLOCK_MONOTONIC, &before);
+		const unsigned long long now = MidiTimestamp::now();
+		timespec after = {};
+		clock_gettime(CLOCK_MONOTONIC, &after);
+
+		CHECK(MidiTimestamp::fromTimespec(before) <= now);
+		CHECK(now <= MidiTimestamp::fromTimespec(after));
+
+		// std::chrono::steady_clock shares the epoch
+		const unsigned long long steadyNow = MidiTimestamp::fromTimePoint(MidiTimestamp::Clock::now());
+		CHECK(steadyNow >= now);
+		CHECK(steadyNow - now < 1000000000ULL);
+	}
+
+	TEST(MidiTimestampConversions)
+	{
+		const unsigned long long timestamp = 12345678901234ULL;
+
+		const timespec time = MidiTimestamp::toTimespec(timestamp);
+		CHECK_EQUAL(12345, time.tv_sec);
+		CHECK_EQUAL(678901234, time.tv_nsec);
+		CHECK_EQUAL(timestamp, MidiTimestamp::fromTimespec(time));
+
+		CHECK_EQUAL(timestamp, MidiTimestamp::fromTimePoint(MidiTimestamp::toTimePoint(timestamp)));
+
+		// 1 ms at 48 kHz is 48 frames
+		const unsigned long long periodStart = 5000000000ULL;
+		CHECK_EQUAL(48, MidiTimestamp::framesBetween(periodStart, periodStart + 1000000ULL, 48000.0));
+		CHECK_EQUAL(-48, MidiTimestamp::framesBetween(periodStart + 1000000ULL, periodStart, 48000.0));
+		CHECK_EQUAL(periodStart + 1000000ULL, MidiTimestamp::fromFrame(1048, 1000, periodStart, 48000.0));
+	}
+}
@@ -0,0 +1,71 @@
+#include <UnitTest++/UnitTest++.h>
+#include <smidi/MidiVirtualClient.h>
+#include <smidi/MidiInPort.h>
+#include <smidi/MidiOutPort.h>
+#include <chrono>
+#include <vector>
+#include <poll.h>
+
+namespace
+{
+	void processUntil(MidiInPort& port, const std::vector<MidiMessage>& received, std::size_t count, std::chrono::milliseconds limit)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + limit;
+		while (received.size() < count && std::chrono::steady_clock::now() < deadline)
+		{
+			pollfd descriptor = {port.pollDescriptor(), POLLIN, 0};
+			poll(&descriptor, 1, 5);
+			port.processPending();
+		}
+	}
+}
+
+SUITE(MidiVirtualClientTests)
+{
+	TEST(MidiVirtualClientLoopback)
+	{
+		MidiVirtualClient client("smidi virtual client test");
+		if (!client.isValid())
+		{
+			// no ALSA sequencer on this machine
+			return;
+		}
+
+		std::shared_ptr<MidiInPort> input = client.createInputPort("in");
+		std::shared_ptr<MidiOutPort> output = client.createOutputPort("out", MidiVirtualClient::Subscribable | MidiVirtualClient::Hidden);
+		CHECK(input && output);
+		if (!input || !output)
+		{
+			return;
+		}
+
+		input->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+		std::vector<MidiMessage> received;
+		input->setMessageHandler([&received](const MidiMessage& message) { received.push_back(message); });
+
+		// our own output to our own input, exactly what other programs do with aconnect
+		const std::string inputAddress = client.address(*input);
+		CHECK(!inputAddress.empty());
+		CHECK(client.connect(*output, inputAddress));
+		CHECK_EQUAL(1u, client.connections(*output).size());
+		CHECK_EQUAL(1u, client.connections(*input).size());
+
+		output->sendMessage(MidiMessage({0x90, 0x3C, 0x64}));
+		const MidiMessage batch[] = {MidiMessage({0xB0, 0x07, 0x40}), MidiMessage({0xF0, 0x7D, 0x01, 0x02, 0xF7}), MidiMessage({0x80, 0x3C, 0x00})};
+		output->sendMessages(batch, 3);
+
+		processUntil(*input, received, 4, std::chrono::seconds(1));
+		CHECK_EQUAL(4u, received.size());
+		if (received.size() == 4)
+		{
+			CHECK((std::vector<unsigned char>{0x90, 0x3C, 0x64}) == received[0].data());
+			CHECK((std::vector<unsigned char>{0xB0, 0x07, 0x40}) == received[1].data());
+			CHECK((std::vector<unsigned char>{0xF0, 0x7D, 0x01, 0x02, 0xF7}) == received[2].data());
+			CHECK((std::vector<unsigned char>{0x80, 0x3C, 0x00}) == received[3].data());
+		}
+		CHECK_EQUAL(4u, output->metrics().totalMessages());
+
+		CHECK(client.disconnect(*output, inputAddress));
+		CHECK(client.connections(*output).empty());
+	}
+}
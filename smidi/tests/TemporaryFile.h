@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+/*!
+ * \brief The TemporaryFile class creates an empty file with unique name in /tmp and removes it when destroyed
+ */
+class TemporaryFile
+{
+public:
+	explicit TemporaryFile(const std::string& prefix = "smidi_test")
+		: _path("/tmp/" + prefix + "_XXXXXX")
+	{
+		const int descriptor = mkstemp(&_path[0]);
+		if (descriptor >= 0)
+		{
+			close(descriptor);
+		}
+	}
+
+	~TemporaryFile()
+	{
+		std::remove(_path.c_str());
+	}
+
+	TemporaryFile(const TemporaryFile&) = delete;
+	TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+	const std::string& path() const
+	{
+		return _path;
+	}
+
+private:
+	std::string _path;
+};
@@ -0,0 +1,758 @@
+/*!
+ * \file MidiLatency.cpp
+ * smidi_latency - end-to-end loopback latency and jitter benchmark.
+ *
+ * Probes are sent with MidiOutPort::sendMessage() and timed until the MidiInPort handler is called for them.
+ * The loopback is one of:
+ * - "Midi Through" kernel client (snd-seq-dummy), used by default when it exists,
+ * - in-process MidiVirtualClient that forwards everything it receives (`--bridge`),
+ * - any other device, e.g. hardware MIDI interface with a loopback cable (`--device=<name>`).
+ *
+ * In `--sync` mode MidiSync of the out port sends MIDI Clocks and their period stability is measured instead.
+ * In `--player` mode MidiPlayer plays a stream of notes at the probe rate and the timing error of their arrival
+ * and the CPU time of the process are measured.
+ */
+
+#include <smidi/MidiDeviceEnumerator.h>
+#include <smidi/MidiDevice.h>
+#include <smidi/MidiInPort.h>
+#include <smidi/MidiOutPort.h>
+#include <smidi/MidiPlayer.h>
+#include <smidi/MidiTimestamp.h>
+#include <smidi/MidiVirtualClient.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+namespace
+{
+	const char* const kBridgeClientName = "smidi latency bridge";
+	const char* const kMidiThroughName = "Midi Through";
+
+	// probe ids are 14-bit, the high part is never 0 so Note On probes never have zero velocity
+	const unsigned int kProbeIdWindow = 127 * 128;
+	const std::size_t kHistogramBuckets = 24;
+
+	struct Options
+	{
+		std::string              device;
+		bool                     bridge = false;
+		unsigned int             rate = 1000;
+		unsigned int             count = 10000;
+		std::vector<std::string> mix = {"note"};
+		unsigned int             sysExSize = 256;
+		unsigned int             sysExBurst = 4;
+		bool                     sync = false;
+		bool                     player = false;
+		unsigned int             lookahead = 100;
+		double                   bpm = 120.0;
+		unsigned int             duration = 10;
+		bool                     json = false;
+	};
+
+	/*!
+	 * In-process virtual client: everything written to its "in" port is sent from its "out" port.
+	 * Used when there is no Midi Through client, it adds one user space hop to the measured latency.
+	 */
+	class Bridge
+	{
+	public:
+		Bridge()
+			: _client(kBridgeClientName)
+		{
+			if (_client.isValid())
+			{
+				_output = _client.createOutputPort("out");
+				_input = _client.createInputPort("in");
+				if (_input && _output)
+				{
+					MidiOutPort* output = _output.get();
+					_input->setMessageHandler([output](const MidiMessage& message) { output->sendMessage(message); });
+				}
+			}
+		}
+
+		bool isValid() const
+		{
+			return _input && _output;
+		}
+
+	private:
+		// the input port goes first, its handler uses the output port
+		MidiVirtualClient            _client;
+		std::shared_ptr<MidiOutPort> _output;
+		std::shared_ptr<MidiInPort>  _input;
+	};
+
+	//! Percentiles and log2 histogram of non-negative nanosecond values
+	class Distribution
+	{
+	public:
+		explicit Distribution(std::vector<unsigned long long> values)
+			: _values(std::move(values))
+		{
+			std::sort(_values.begin(), _values.end());
+		}
+
+		bool isEmpty() const
+		{
+			return _values.empty();
+		}
+
+		std::size_t size() const
+		{
+			return _values.size();
+		}
+
+		unsigned long long percentile(double percentile) const
+		{
+			if (_values.empty())
+			{
+				return 0;
+			}
+			const std::size_t index = static_cast<std::size_t>(std::ceil(percentile * _values.size())) - 1;
+			return _values[std::min(index, _values.size() - 1)];
+		}
+
+		unsigned long long max() const
+		{
+			return _values.empty() ? 0 : _values.back();
+		}
+
+		double mean() const
+		{
+			double sum = 0.0;
+			for (unsigned long long value : _values)
+			{
+				sum += static_cast<double>(value);
+			}
+			return _values.empty() ? 0.0 : sum / _values.size();
+		}
+
+		//! Bucket 0 is below 1 us, every next one doubles
+		std::vector<unsigned long long> histogram() const
+		{
+			std::vector<unsigned long long> result(kHistogramBuckets, 0);
+			for (unsigned long long value : _values)
+			{
+				std::size_t bucket = 0;
+				while (bucket + 1 < kHistogramBuckets && value >= (1000ULL << bucket))
+				{
+					++bucket;
+				}
+				++result[bucket];
+			}
+			return result;
+		}
+
+	private:
+		std::vector<unsigned long long> _values;
+	};
+
+	std::string formatNanoseconds(unsigned long long value)
+	{
+		char text[32];
+		if (value < 10000ULL)
+		{
+			std::snprintf(text, sizeof(text), "%llu ns", value);
+		}
+		else if (value < 10000000ULL)
+		{
+			std::snprintf(text, sizeof(text), "%.1f us", value / 1e3);
+		}
+		else
+		{
+			std::snprintf(text, sizeof(text), "%.2f ms", value / 1e6);
+		}
+		return text;
+	}
+
+	void printDistribution(const char* title, const Distribution& distribution)
+	{
+		std::cout << title << " (" << distribution.size() << " samples)\n"
+		          << "  p50:   " << formatNanoseconds(distribution.percentile(0.5)) << "\n"
+		          << "  p99:   " << formatNanoseconds(distribution.percentile(0.99)) << "\n"
+		          << "  p99.9: " << formatNanoseconds(distribution.percentile(0.999)) << "\n"
+		          << "  max:   " << formatNanoseconds(distribution.max()) << "\n"
+		          << "  mean:  " << formatNanoseconds(static_cast<unsigned long long>(distribution.mean())) << "\n";
+
+		const std::vector<unsigned long long> histogram = distribution.histogram();
+		const unsigned long long largest = *std::max_element(histogram.begin(), histogram.end());
+		std::size_t last = histogram.size();
+		while (last > 0 && histogram[last - 1] == 0)
+		{
+			--last;
+		}
+		for (std::size_t bucket = 0; bucket < last; ++bucket)
+		{
+			const std::size_t width = largest ? static_cast<std::size_t>(50 * histogram[bucket] / largest) : 0;
+			char line[64];
+			std::snprintf(line, sizeof(line), "  < %-10s %10llu ", formatNanoseconds(1000ULL << bucket).c_str(), histogram[bucket]);
+			std::cout << line << std::string(width, '#') << "\n";
+		}
+	}
+
+	void writeJsonDistribution(std::ostream& stream, const char* name, const Distribution& distribution)
+	{
+		stream << "  \"" << name << "\": {\"samples\": " << distribution.size()
+		       << ", \"p50_ns\": " << distribution.percentile(0.5)
+		       << ", \"p99_ns\": " << distribution.percentile(0.99)
+		       << ", \"p999_ns\": " << distribution.percentile(0.999)
+		       << ", \"max_ns\": " << distribution.max()
+		       << ", \"histogram\": [";
+		const std::vector<unsigned long long> histogram = distribution.histogram();
+		for (std::size_t bucket = 0; bucket < histogram.size(); ++bucket)
+		{
+			stream << (bucket ? ", " : "") << histogram[bucket];
+		}
+		stream << "]}";
+	}
+
+	MidiMessage makeProbe(const std::string& kind, unsigned int id, unsigned int sysExSize)
+	{
+		const unsigned char low = static_cast<unsigned char>(id % 128);
+		const unsigned char high = static_cast<unsigned char>(1 + id / 128);
+		if (kind == "cc")
+		{
+			return MidiMessage({MidiMessage::ControlChange, low, high});
+		}
+		if (kind == "pitch")
+		{
+			return MidiMessage({MidiMessage::PitchWheel, low, high});
+		}
+		if (kind == "sysex")
+		{
+			std::vector<unsigned char> bytes(std::max(sysExSize, 5u), 0x55);
+			bytes[0] = MidiMessage::SysEx;
+			bytes[1] = 0x7D; // non-commercial manufacturer id
+			bytes[2] = low;
+			bytes[3] = high;
+			bytes.back() = MidiMessage::SysExEnd;
+			return MidiMessage(bytes);
+		}
+		return MidiMessage({MidiMessage::NoteOn, low, high});
+	}
+
+	bool probeId(const MidiMessage& message, unsigned int& id)
+	{
+		const MidiMessage::data_type& bytes = message.data();
+		std::size_t offset = 1;
+		if (message.isActually(MidiMessage::SysEx) && bytes.size() >= 5)
+		{
+			offset = 2;
+		}
+		else if (bytes.size() != 3 || bytes.front() >= MidiMessage::System)
+		{
+			return false;
+		}
+		if (bytes[offset + 1] == 0)
+		{
+			return false;
+		}
+		id = bytes[offset] + (bytes[offset + 1] - 1u) * 128u;
+		return true;
+	}
+
+	void sleepUntil(unsigned long long timestamp)
+	{
+		const timespec time = MidiTimestamp::toTimespec(timestamp);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) != 0)
+		{
+		}
+	}
+
+	//! Receives probes on the input thread, everything is preallocated
+	class ProbeReceiver
+	{
+	public:
+		explicit ProbeReceiver(std::size_t capacity)
+			: _ids(capacity)
+			, _receiveTimes(capacity)
+			, _arrivalTimes(capacity)
+			, _received(0)
+		{
+		}
+
+		void operator()(const MidiMessage& message)
+		{
+			const unsigned long long now = MidiTimestamp::now();
+			unsigned int id = 0;
+			const std::size_t index = _received.load(std::memory_order_relaxed);
+			if (index < _ids.size() && probeId(message, id))
+			{
+				_ids[index] = id;
+				_receiveTimes[index] = now;
+				_arrivalTimes[index] = message.timestamp();
+				_received.store(index + 1, std::memory_order_release);
+			}
+		}
+
+		std::size_t received() const
+		{
+			return _received.load(std::memory_order_acquire);
+		}
+
+		unsigned int id(std::size_t index) const { return _ids[index]; }
+		unsigned long long receiveTime(std::size_t index) const { return _receiveTimes[index]; }
+		unsigned long long arrivalTime(std::size_t index) const { return _arrivalTimes[index]; }
+
+	private:
+		std::vector<unsigned int>       _ids;
+		std::vector<unsigned long long> _receiveTimes;
+		std::vector<unsigned long long> _arrivalTimes;
+		std::atomic<std::size_t>        _received;
+	};
+
+	int measureLatency(const Options& options, MidiInPort& input, MidiOutPort& output)
+	{
+		// every sysex probe is a burst of several messages
+		std::vector<std::string> schedule;
+		for (const std::string& kind : options.mix)
+		{
+			const unsigned int repeat = (kind == "sysex") ? std::max(options.sysExBurst, 1u) : 1u;
+			schedule.insert(schedule.end(), repeat, kind);
+		}
+
+		ProbeReceiver receiver(options.count);
+		input.setMessageHandler([&receiver](const MidiMessage& message) { receiver(message); });
+
+		std::vector<unsigned long long> sendTimes(options.count);
+		std::vector<MidiMessage> probes(options.count);
+		for (unsigned int i = 0; i < options.count; ++i)
+		{
+			probes[i] = makeProbe(schedule[i % schedule.size()], i % kProbeIdWindow, options.sysExSize);
+		}
+
+		const unsigned long long interval = 1000000000ULL / std::max(options.rate, 1u);
+		unsigned long long nextSend = MidiTimestamp::now() + 100000000ULL;
+		for (unsigned int i = 0; i < options.count; ++i)
+		{
+			// bursts are sent back-to-back
+			const bool burstContinues = i > 0 && schedule[i % schedule.size()] == "sysex" && schedule[(i - 1) % schedule.size()] == "sysex" && (i % schedule.size()) != 0;
+			if (!burstContinues)
+			{
+				sleepUntil(nextSend);
+				nextSend += interval;
+			}
+			sendTimes[i] = MidiTimestamp::now();
+			output.sendMessage(probes[i]);
+		}
+
+		const unsigned long long deadline = MidiTimestamp::now() + 2000000000ULL;
+		while (receiver.received() < options.count && MidiTimestamp::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		input.resetMessageHandlers();
+
+		// match received probes to sent ones, the order is preserved so lost probes are just skipped
+		const std::size_t received = receiver.received();
+		std::vector<unsigned long long> latencies;
+		std::vector<unsigned long long> driverLatencies;
+		std::vector<unsigned long long> jitters;
+		latencies.reserve(received);
+		driverLatencies.reserve(received);
+		jitters.reserve(received);
+		std::size_t previousIndex = 0;
+		bool hasPrevious = false;
+		std::size_t expectedIndex = 0;
+		for (std::size_t r = 0; r < received; ++r)
+		{
+			const unsigned int id = receiver.id(r);
+			const std::size_t index = expectedIndex + (id + kProbeIdWindow - expectedIndex % kProbeIdWindow) % kProbeIdWindow;
+			if (index >= options.count)
+			{
+				break;
+			}
+			latencies.push_back(receiver.receiveTime(r) - sendTimes[index]);
+			driverLatencies.push_back(receiver.arrivalTime(r) > sendTimes[index] ? receiver.arrivalTime(r) - sendTimes[index] : 0);
+			if (hasPrevious)
+			{
+				const long long sendDelta = static_cast<long long>(sendTimes[index] - sendTimes[previousIndex]);
+				const long long receiveDelta = static_cast<long long>(receiver.receiveTime(r) - receiver.receiveTime(r - 1));
+				jitters.push_back(static_cast<unsigned long long>(std::llabs(receiveDelta - sendDelta)));
+			}
+			previousIndex = index;
+			hasPrevious = true;
+			expectedIndex = index + 1;
+		}
+
+		const Distribution latency(latencies);
+		const Distribution driverLatency(driverLatencies);
+		const Distribution jitter(jitters);
+		const MidiPortMetrics inputMetrics = input.metrics();
+		const MidiPortMetrics outputMetrics = output.metrics();
+		if (options.json)
+		{
+			std::cout << "{\n  \"sent\": " << options.count << ", \"received\": " << latencies.size()
+			          << ", \"overruns\": " << (inputMetrics.overruns + outputMetrics.overruns) << ",\n";
+			writeJsonDistribution(std::cout, "latency", latency);
+			std::cout << ",\n";
+			writeJsonDistribution(std::cout, "send_to_arrival", driverLatency);
+			std::cout << ",\n";
+			writeJsonDistribution(std::cout, "jitter", jitter);
+			std::cout << "\n}\n";
+		}
+		else
+		{
+			std::cout << "Sent " << options.count << " probes, received " << latencies.size()
+			          << " (overruns: " << (inputMetrics.overruns + outputMetrics.overruns) << ")\n\n";
+			printDistribution("sendMessage() to handler latency", latency);
+			std::cout << "\n";
+			printDistribution("sendMessage() to kernel arrival timestamp", driverLatency);
+			std::cout << "\n";
+			printDistribution("Jitter (inter-arrival vs inter-send interval)", jitter);
+		}
+		return latencies.size() == options.count ? 0 : 2;
+	}
+
+	int measureSync(const Options& options, MidiInPort& input, MidiOutPort& output)
+	{
+		const std::size_t capacity = static_cast<std::size_t>(options.bpm / 60.0 * 24.0 * options.duration * 1.5) + 64;
+		std::vector<unsigned long long> clockTimes(capacity);
+		std::atomic<std::size_t> clocks(0);
+		input.setMessageHandler(MidiMessage::MidiClock, [&clockTimes, &clocks](const MidiMessage& message)
+		{
+			const std::size_t index = clocks.load(std::memory_order_relaxed);
+			if (index < clockTimes.size())
+			{
+				clockTimes[index] = message.timestamp();
+				clocks.store(index + 1, std::memory_order_release);
+			}
+		});
+
+		output.sync().startSync(options.bpm);
+		std::this_thread::sleep_for(std::chrono::seconds(options.duration));
+		output.sync().stopSync();
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		input.resetMessageHandlers();
+
+		const std::size_t received = clocks.load(std::memory_order_acquire);
+		const double expectedPeriod = 60e9 / (options.bpm * 24.0);
+		std::vector<unsigned long long> periodErrors;
+		periodErrors.reserve(received);
+		for (std::size_t i = 1; i < received; ++i)
+		{
+			const double period = static_cast<double>(clockTimes[i] - clockTimes[i - 1]);
+			periodErrors.push_back(static_cast<unsigned long long>(std::fabs(period - expectedPeriod)));
+		}
+		const double drift = received > 1 ? static_cast<double>(clockTimes[received - 1] - clockTimes[0]) - expectedPeriod * (received - 1) : 0.0;
+
+		const Distribution periodError(periodErrors);
+		const MidiSyncMetrics metrics = output.sync().metrics();
+		if (options.json)
+		{
+			std::cout << "{\n  \"bpm\": " << options.bpm << ", \"clocks\": " << received
+			          << ", \"expected_period_ns\": " << expectedPeriod << ", \"drift_ns\": " << drift
+			          << ", \"generator_max_lateness_ns\": " << metrics.maxPeriodError
+			          << ", \"phase_corrections\": " << metrics.phaseCorrections << ",\n";
+			writeJsonDistribution(std::cout, "period_error", periodError);
+			std::cout << "\n}\n";
+		}
+		else
+		{
+			std::cout << "Received " << received << " MIDI Clocks at " << options.bpm << " BPM, expected period "
+			          << formatNanoseconds(static_cast<unsigned long long>(expectedPeriod)) << ", total drift " << drift / 1e3 << " us\n"
+			          << "Generator: " << metrics.periods << " beats, max lateness " << formatNanoseconds(static_cast<unsigned long long>(std::max(metrics.maxPeriodError, 0LL)))
+			          << ", " << metrics.phaseCorrections << " phase corrections\n\n";
+			printDistribution("MIDI Clock period error", periodError);
+		}
+		return received > 1 ? 0 : 2;
+	}
+
+	//! Note On probes at every tick, a tick lasts one probe interval
+	class ProbeSource : public MidiPlayer::Source
+	{
+	public:
+		explicit ProbeSource(unsigned int count)
+			: _count(count)
+			, _next(0)
+			, _bytes{0, 0}
+		{
+		}
+
+		virtual void seek(unsigned long long tick) override
+		{
+			_next = static_cast<unsigned int>(std::min<unsigned long long>(tick, _count));
+		}
+
+		virtual bool next(MidiFileEvent& event) override
+		{
+			const bool result = _next < _count;
+			if (result)
+			{
+				const unsigned int id = _next % kProbeIdWindow;
+				_bytes[0] = static_cast<unsigned char>(id % 128);
+				_bytes[1] = static_cast<unsigned char>(1 + id / 128);
+				event = MidiFileEvent();
+				event.tick = _next++;
+				event.data = _bytes;
+				event.size = 2;
+				event.kind = MidiFileEvent::Channel;
+				event.status = MidiMessage::NoteOn;
+			}
+			return result;
+		}
+
+	private:
+		unsigned int  _count;
+		unsigned int  _next;
+		unsigned char _bytes[2];
+	};
+
+	unsigned long long processCpuTime()
+	{
+		timespec time = {};
+		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+		return static_cast<unsigned long long>(time.tv_sec) * 1000000000ULL + static_cast<unsigned long long>(time.tv_nsec);
+	}
+
+	int measurePlayer(const Options& options, MidiInPort& input, const std::shared_ptr<MidiOutPort>& output)
+	{
+		const unsigned int rate = std::max(options.rate, 1u);
+		const unsigned int count = rate * std::max(options.duration, 1u);
+		ProbeSource* source = new ProbeSource(count);
+
+		// 1000 ticks per quarter note, the tempo makes a tick as long as the probe interval
+		MidiTempoMap tempoMap(1000);
+		tempoMap.addTempo(0, static_cast<unsigned int>(1000000000ULL / rate));
+
+		ProbeReceiver receiver(count);
+		input.setMessageHandler([&receiver](const MidiMessage& message) { receiver(message); });
+
+		MidiPlayer::Options playerOptions;
+		playerOptions.lookahead = std::chrono::milliseconds(options.lookahead);
+		MidiPlayer player(output, playerOptions);
+		player.load(std::unique_ptr<MidiPlayer::Source>(source), tempoMap);
+
+		const unsigned long long cpuBefore = processCpuTime();
+		const unsigned long long timeBefore = MidiTimestamp::now();
+		player.play();
+		while (player.isPlaying())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		const unsigned long long deadline = MidiTimestamp::now() + 2000000000ULL;
+		while (receiver.received() < count && MidiTimestamp::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		const unsigned long long cpuTime = processCpuTime() - cpuBefore;
+		const unsigned long long wallTime = MidiTimestamp::now() - timeBefore;
+		input.resetMessageHandlers();
+
+		// the error is measured against the first probe, the player start time isn't known to the receiver
+		const std::size_t received = receiver.received();
+		const unsigned long long interval = 1000000000ULL / rate;
+		std::vector<unsigned long long> errors;
+		errors.reserve(received);
+		std::size_t expectedIndex = 0;
+		for (std::size_t r = 0; r < received; ++r)
+		{
+			const unsigned int id = receiver.id(r);
+			const std::size_t index = expectedIndex + (id + kProbeIdWindow - expectedIndex % kProbeIdWindow) % kProbeIdWindow;
+			if (index >= count)
+			{
+				break;
+			}
+			const long long expected = static_cast<long long>(receiver.arrivalTime(0) + index * interval);
+			errors.push_back(static_cast<unsigned long long>(std::llabs(static_cast<long long>(receiver.arrivalTime(r)) - expected)));
+			expectedIndex = index + 1;
+		}
+
+		const Distribution error(errors);
+		const MidiPlayer::Counters counters = player.counters();
+		const double cpuLoad = wallTime ? 100.0 * static_cast<double>(cpuTime) / static_cast<double>(wallTime) : 0.0;
+		if (options.json)
+		{
+			std::cout << "{\n  \"rate\": " << rate << ", \"played\": " << counters.messages << ", \"received\": " << errors.size()
+			          << ", \"queue_scheduling\": " << (player.isQueueScheduling() ? "true" : "false")
+			          << ", \"lookahead_ms\": " << options.lookahead << ", \"late\": " << counters.late
+			          << ", \"cpu_percent\": " << cpuLoad << ",\n";
+			writeJsonDistribution(std::cout, "timing_error", error);
+			std::cout << "\n}\n";
+		}
+		else
+		{
+			std::cout << "Played " << counters.messages << " notes at " << rate << "/s with "
+			          << (player.isQueueScheduling() ? "queue scheduling" : "software scheduling") << ", lookahead " << options.lookahead
+			          << " ms, received " << errors.size() << " (late: " << counters.late << ")\n"
+			          << "Process CPU time " << formatNanoseconds(cpuTime) << " in " << formatNanoseconds(wallTime)
+			          << " (" << cpuLoad << "% of one core, receiving included)\n\n";
+			printDistribution("Arrival time error against the first note", error);
+		}
+		return errors.size() == count ? 0 : 2;
+	}
+
+	void printUsage(const char* name)
+	{
+		std::cerr << "Usage: " << name << " [options]\n"
+		          << "  --device=<name>     loopback device (default: \"" << kMidiThroughName << "\" or the bridge)\n"
+		          << "  --bridge            use in-process duplex bridge client as the loopback\n"
+		          << "  --rate=<n>          probes per second (default 1000)\n"
+		          << "  --count=<n>         number of probes (default 10000)\n"
+		          << "  --mix=<kinds>       comma separated probe kinds: note, cc, pitch, sysex (default note)\n"
+		          << "  --sysex-size=<n>    SysEx probe size in bytes (default 256)\n"
+		          << "  --sysex-burst=<n>   SysEx probes sent back-to-back (default 4)\n"
+		          << "  --sync              measure MIDI Clock period stability of MidiSync instead\n"
+		          << "  --bpm=<n>           sync tempo (default 120)\n"
+		          << "  --duration=<s>      sync or player measurement duration (default 10)\n"
+		          << "  --player            measure timing of MidiPlayer playing notes at the probe rate instead\n"
+		          << "  --lookahead=<ms>    player lookahead (default 100)\n"
+		          << "  --json              print results as JSON\n";
+	}
+
+	bool parseOptions(int argc, char* argv[], Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string argument(argv[i]);
+			const std::size_t separator = argument.find('=');
+			const std::string name = argument.substr(0, separator);
+			const std::string value = separator == std::string::npos ? std::string() : argument.substr(separator + 1);
+			if (name == "--device")
+			{
+				options.device = value;
+			}
+			else if (name == "--bridge")
+			{
+				options.bridge = true;
+			}
+			else if (name == "--rate")
+			{
+				options.rate = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			}
+			else if (name == "--count")
+			{
+				options.count = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			}
+			else if (name == "--mix")
+			{
+				options.mix.clear();
+				std::istringstream stream(value);
+				std::string kind;
+				while (std::getline(stream, kind, ','))
+				{
+					if (kind != "note" && kind != "cc" && kind != "pitch" && kind != "sysex")
+					{
+						return false;
+					}
+					options.mix.push_back(kind);
+				}
+			}
+			else if (name == "--sysex-size")
+			{
+				options.sysExSize = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			}
+			else if (name == "--sysex-burst")
+			{
+				options.sysExBurst = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			}
+			else if (name == "--sync")
+			{
+				options.sync = true;
+			}
+			else if (name == "--bpm")
+			{
+				options.bpm = std::strtod(value.c_str(), nullptr);
+			}
+			else if (name == "--duration")
+			{
+				options.duration = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			}
+			else if (name == "--player")
+			{
+				options.player = true;
+			}
+			else if (name == "--lookahead")
+			{
+				options.lookahead = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			}
+			else if (name == "--json")
+			{
+				options.json = true;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		return !options.mix.empty() && options.count > 0 && options.bpm > 0.0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	// the bridge client must exist before the enumerator lists the devices
+	std::unique_ptr<Bridge> bridge;
+	std::string deviceName = options.device;
+	if (deviceName.empty())
+	{
+		MidiDeviceEnumerator probe;
+		const std::list<std::string> names = probe.deviceNames();
+		const bool hasMidiThrough = std::find(names.begin(), names.end(), kMidiThroughName) != names.end();
+		if (options.bridge || !hasMidiThrough)
+		{
+			bridge.reset(new Bridge());
+			if (!bridge->isValid())
+			{
+				std::cerr << "Couldn't create loopback bridge client, is ALSA sequencer available?\n";
+				return 1;
+			}
+			deviceName = kBridgeClientName;
+		}
+		else
+		{
+			deviceName = kMidiThroughName;
+		}
+	}
+
+	MidiDeviceEnumerator enumerator;
+	std::shared_ptr<MidiDevice> device = enumerator.createDevice(deviceName);
+	if (!device || device->inputPorts().empty() || device->outputPorts().empty())
+	{
+		std::cerr << "Device \"" << deviceName << "\" doesn't have both input and output ports\n";
+		return 1;
+	}
+
+	MidiInPort& input = *device->inputPorts().front();
+	const std::shared_ptr<MidiOutPort> outputPort = device->outputPorts().front();
+	MidiOutPort& output = *outputPort;
+	if (!options.json)
+	{
+		std::cout << "Loopback: " << deviceName << " (" << output.name() << " -> " << input.name() << ")\n";
+	}
+	input.start();
+	output.start();
+
+	int result = 0;
+	if (options.player)
+	{
+		result = measurePlayer(options, input, outputPort);
+	}
+	else
+	{
+		result = options.sync ? measureSync(options, input, output) : measureLatency(options, input, output);
+	}
+
+	output.stop();
+	input.stop();
+	return result;
+}
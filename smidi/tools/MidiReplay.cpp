@@ -0,0 +1,327 @@
+/*!
+ * \file MidiReplay.cpp
+ * smidi_replay - plays a MidiCapture file into output ports.
+ *
+ * Messages of every captured port go to the output port of the device it is mapped to (`--device=<name>` for all
+ * ports, `--map=<index>:<name>` for one of them). Without any device the messages go to an in-process MidiLoopback,
+ * so a capture can be replayed as a reproducible benchmark input of the library itself.
+ *
+ * By default the original timing is kept (`--speed` scales it) and the lateness of every message is measured.
+ * With `--max-speed` the messages are sent back-to-back and the throughput is measured. `--dump` prints the
+ * records instead of playing them.
+ */
+
+#include <smidi/MidiCapture.h>
+#include <smidi/MidiClock.h>
+#include <smidi/MidiDevice.h>
+#include <smidi/MidiDeviceEnumerator.h>
+#include <smidi/MidiInPort.h>
+#include <smidi/MidiLoopback.h>
+#include <smidi/MidiOutPort.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char* const kLoopbackName = "smidi replay";
+
+	struct Options
+	{
+		std::string                        path;
+		std::string                        device;
+		std::map<std::size_t, std::string> devices;
+		double                             speed = 1.0;
+		bool                               maxSpeed = false;
+		bool                               dump = false;
+		bool                               json = false;
+	};
+
+	struct Result
+	{
+		unsigned long long              messages = 0;
+		unsigned long long              bytes = 0;
+		unsigned long long              unmapped = 0;
+		unsigned long long              wallTime = 0;
+		unsigned long long              captureTime = 0;
+		std::vector<unsigned long long> lateness;
+	};
+
+	std::string formatNanoseconds(unsigned long long value)
+	{
+		char text[32];
+		if (value < 10000ULL)
+		{
+			std::snprintf(text, sizeof(text), "%llu ns", value);
+		}
+		else if (value < 10000000ULL)
+		{
+			std::snprintf(text, sizeof(text), "%.1f us", value / 1e3);
+		}
+		else
+		{
+			std::snprintf(text, sizeof(text), "%.2f ms", value / 1e6);
+		}
+		return text;
+	}
+
+	unsigned long long percentile(const std::vector<unsigned long long>& sorted, double percentile)
+	{
+		const std::size_t index = static_cast<std::size_t>(percentile * sorted.size());
+		return sorted.empty() ? 0 : sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	void dump(MidiCaptureReader& reader)
+	{
+		MidiCaptureRecord record;
+		while (reader.next(record))
+		{
+			const std::string& port = (record.port < reader.portNames().size()) ? reader.portNames()[record.port] : std::string("?");
+			char line[64];
+			std::snprintf(line, sizeof(line), "%llu.%09llu ", record.timestamp / 1000000000ULL, record.timestamp % 1000000000ULL);
+			std::cout << line << port << ":";
+			for (std::size_t i = 0; i < record.size; ++i)
+			{
+				std::snprintf(line, sizeof(line), " %02X", record.data[i]);
+				std::cout << line;
+			}
+			std::cout << "\n";
+		}
+	}
+
+	Result replay(const Options& options, MidiCaptureReader& reader, const std::vector<MidiOutPort*>& outputs, const std::shared_ptr<MidiInPort>& loopbackInput)
+	{
+		Result result;
+		const std::shared_ptr<MidiClock> clock = MidiClock::system();
+		MidiMessage message;
+		MidiCaptureRecord record;
+		unsigned long long firstTimestamp = 0;
+		const unsigned long long start = clock->now() + 1000000;
+		while (reader.next(record))
+		{
+			firstTimestamp = (result.messages + result.unmapped == 0) ? record.timestamp : firstTimestamp;
+			MidiOutPort* output = (record.port < outputs.size()) ? outputs[record.port] : nullptr;
+			if (output)
+			{
+				// earlier timestamps than the first one (other ports stamp differently) are played right away
+				const unsigned long long offset = (record.timestamp > firstTimestamp) ? record.timestamp - firstTimestamp : 0;
+				const unsigned long long due = start + static_cast<unsigned long long>(offset / options.speed);
+				// no sleep at all when behind, dense captures are played as fast as possible until caught up
+				if (!options.maxSpeed && clock->now() < due)
+				{
+					clock->sleepUntil(due);
+				}
+
+				record.copyTo(message);
+				message.setTimestamp(0);
+				output->sendMessage(message);
+				if (loopbackInput)
+				{
+					loopbackInput->processPending();
+				}
+
+				if (!options.maxSpeed)
+				{
+					const unsigned long long now = clock->now();
+					result.lateness.push_back(now > due ? now - due : 0);
+				}
+				++result.messages;
+				result.bytes += record.size;
+				result.captureTime = std::max(result.captureTime, offset);
+			}
+			else
+			{
+				++result.unmapped;
+			}
+		}
+		result.wallTime = clock->now() - start;
+		return result;
+	}
+
+	void printResult(const Options& options, Result& result)
+	{
+		std::sort(result.lateness.begin(), result.lateness.end());
+		const double seconds = std::max(result.wallTime, 1ULL) / 1e9;
+		if (options.json)
+		{
+			std::cout << "{\n"
+			          << "  \"messages\": " << result.messages << ",\n"
+			          << "  \"bytes\": " << result.bytes << ",\n"
+			          << "  \"unmapped\": " << result.unmapped << ",\n"
+			          << "  \"capture_ns\": " << result.captureTime << ",\n"
+			          << "  \"wall_ns\": " << result.wallTime << ",\n"
+			          << "  \"messages_per_second\": " << static_cast<unsigned long long>(result.messages / seconds);
+			if (!options.maxSpeed)
+			{
+				std::cout << ",\n  \"lateness\": {\"p50_ns\": " << percentile(result.lateness, 0.5)
+				          << ", \"p99_ns\": " << percentile(result.lateness, 0.99)
+				          << ", \"max_ns\": " << (result.lateness.empty() ? 0 : result.lateness.back()) << "}";
+			}
+			std::cout << "\n}\n";
+		}
+		else
+		{
+			std::cout << "Replayed " << result.messages << " messages (" << result.bytes << " bytes) of "
+			          << formatNanoseconds(result.captureTime) << " in " << formatNanoseconds(result.wallTime)
+			          << ", " << static_cast<unsigned long long>(result.messages / seconds) << " messages/s\n";
+			if (result.unmapped > 0)
+			{
+				std::cout << "Skipped " << result.unmapped << " messages of ports without output\n";
+			}
+			if (!options.maxSpeed)
+			{
+				std::cout << "Lateness against the captured timing\n"
+				          << "  p50:   " << formatNanoseconds(percentile(result.lateness, 0.5)) << "\n"
+				          << "  p99:   " << formatNanoseconds(percentile(result.lateness, 0.99)) << "\n"
+				          << "  max:   " << formatNanoseconds(result.lateness.empty() ? 0 : result.lateness.back()) << "\n";
+			}
+		}
+	}
+
+	void printUsage(const char* name)
+	{
+		std::cerr << "Usage: " << name << " <capture file> [options]\n"
+		          << "  --device=<name>        output device for all captured ports\n"
+		          << "  --map=<port>:<name>    output device for the captured port with the index\n"
+		          << "  --speed=<factor>       timing scale, 2 plays twice as fast (default 1)\n"
+		          << "  --max-speed            send messages back-to-back and measure the throughput\n"
+		          << "  --dump                 print the records instead of playing them\n"
+		          << "  --json                 print results as JSON\n"
+		          << "Without devices the messages go to an in-process loopback.\n";
+	}
+
+	bool parseOptions(int argc, char* argv[], Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string argument(argv[i]);
+			const std::size_t separator = argument.find('=');
+			const std::string name = argument.substr(0, separator);
+			const std::string value = separator == std::string::npos ? std::string() : argument.substr(separator + 1);
+			if (argument.compare(0, 2, "--") != 0 && options.path.empty())
+			{
+				options.path = argument;
+			}
+			else if (name == "--device")
+			{
+				options.device = value;
+			}
+			else if (name == "--map")
+			{
+				const std::size_t colon = value.find(':');
+				if (colon == std::string::npos)
+				{
+					return false;
+				}
+				options.devices[std::strtoul(value.substr(0, colon).c_str(), nullptr, 10)] = value.substr(colon + 1);
+			}
+			else if (name == "--speed")
+			{
+				options.speed = std::strtod(value.c_str(), nullptr);
+			}
+			else if (name == "--max-speed")
+			{
+				options.maxSpeed = true;
+			}
+			else if (name == "--dump")
+			{
+				options.dump = true;
+			}
+			else if (name == "--json")
+			{
+				options.json = true;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		return !options.path.empty() && options.speed > 0.0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	MidiCaptureReader reader;
+	if (!reader.open(options.path))
+	{
+		std::cerr << "Couldn't read capture file " << options.path << "\n";
+		return 1;
+	}
+	if (options.dump)
+	{
+		dump(reader);
+		return 0;
+	}
+
+	// every device is created once, however many captured ports go to it
+	const std::vector<std::string>& portNames = reader.portNames();
+	MidiDeviceEnumerator enumerator;
+	std::map<std::string, std::shared_ptr<MidiDevice>> devices;
+	std::unique_ptr<MidiLoopback> loopback;
+	std::vector<MidiOutPort*> outputs(portNames.size(), nullptr);
+	for (std::size_t port = 0; port < portNames.size(); ++port)
+	{
+		const std::map<std::size_t, std::string>::const_iterator mapped = options.devices.find(port);
+		const std::string deviceName = (mapped != options.devices.end()) ? mapped->second : options.device;
+		if (!deviceName.empty())
+		{
+			std::shared_ptr<MidiDevice>& device = devices[deviceName];
+			device = device ? device : enumerator.createDevice(deviceName);
+			if (!device || device->outputPorts().empty())
+			{
+				std::cerr << "Device \"" << deviceName << "\" doesn't have output ports\n";
+				return 1;
+			}
+			outputs[port] = device->outputPorts().front().get();
+		}
+		else if (options.devices.empty())
+		{
+			if (!loopback)
+			{
+				loopback.reset(new MidiLoopback(kLoopbackName));
+				loopback->inputPort()->setDispatchMode(MidiInPort::DispatchMode::CallerThread);
+			}
+			outputs[port] = loopback->outputPort().get();
+		}
+		if (!options.json)
+		{
+			std::cout << "Port " << port << " \"" << portNames[port] << "\" -> " << (outputs[port] ? outputs[port]->name() : std::string("(skipped)")) << "\n";
+		}
+	}
+
+	std::vector<MidiOutPort*> used(outputs);
+	std::sort(used.begin(), used.end());
+	used.erase(std::unique(used.begin(), used.end()), used.end());
+	used.erase(std::remove(used.begin(), used.end(), nullptr), used.end());
+	for (MidiOutPort* output : used)
+	{
+		output->start();
+	}
+	const std::shared_ptr<MidiInPort> loopbackInput = loopback ? loopback->inputPort() : nullptr;
+	if (loopbackInput)
+	{
+		loopbackInput->start();
+	}
+
+	Result result = replay(options, reader, outputs, loopbackInput);
+	printResult(options, result);
+
+	for (MidiOutPort* output : used)
+	{
+		output->stop();
+	}
+	return 0;
+}